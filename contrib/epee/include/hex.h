@@ -62,4 +62,17 @@ namespace epee
     //! Write `src` bytes as hex to `out`. `out` must be twice the length
     static void buffer_unchecked(char* out, const span<const std::uint8_t> src) noexcept;
   };
+
+  //! Convert hex (upper or lower case) to binary with a lookup table
+  struct from_hex
+  {
+    //! \return True and `src` decoded into `out`, false if `src` has an odd length or a non hex character.
+    static bool string(std::string& out, const span<const char> src);
+
+    //! \return True if `src` is exactly twice the size of `out` and was decoded into it.
+    static bool buffer(span<std::uint8_t> out, const span<const char> src) noexcept;
+
+    //! \return Value of hex digit `c`, or -1 if it is not one.
+    static int digit(char c) noexcept;
+  };
 }
@@ -0,0 +1,146 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace epee
+{
+namespace metrics
+{
+  // All metrics are updated with relaxed atomics only. Registration takes a
+  // lock, so call sites keep a reference to the metric (usually in a function
+  // local static) and never look it up on the hot path.
+
+  class counter
+  {
+  public:
+    counter(): m_value(0) {}
+    void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+    void reset() { m_value.store(0, std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> m_value;
+  };
+
+  class gauge
+  {
+  public:
+    gauge(): m_value(0) {}
+    void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+    void inc(int64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    void dec(int64_t n = 1) { m_value.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t get() const { return m_value.load(std::memory_order_relaxed); }
+    void reset() { m_value.store(0, std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> m_value;
+  };
+
+  // HDR style histogram: values below 16 get their own bucket, above that each
+  // power of two is split into 8 linear sub buckets, so any recorded value is
+  // known to within 12.5% over the whole uint64_t range
+  class histogram
+  {
+  public:
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr size_t N_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    histogram(double scale = 1.0);
+
+    void record(uint64_t v)
+    {
+      m_buckets[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+      m_count.fetch_add(1, std::memory_order_relaxed);
+      m_sum.fetch_add(v, std::memory_order_relaxed);
+      uint64_t max = m_max.load(std::memory_order_relaxed);
+      while (v > max && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed));
+    }
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+    uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+    // raw values are multiplied by this when exported, eg 1e-9 for ns timings reported in seconds
+    double scale() const { return m_scale; }
+    // upper bound of the bucket the requested quantile (0 to 1) falls in
+    uint64_t quantile(double q) const;
+    // number of recorded values in buckets entirely below v, exact when v is a power of two
+    uint64_t count_below(uint64_t v) const;
+    // number of recorded values up to and including the bucket v falls in
+    uint64_t count_through(uint64_t v) const;
+    void reset();
+
+    static size_t bucket_index(uint64_t v)
+    {
+      if (v < 2 * SUB_BUCKETS)
+        return v;
+      const unsigned msb = 63 - __builtin_clzll(v);
+      const unsigned shift = msb - SUB_BUCKET_BITS;
+      return (shift + 1) * SUB_BUCKETS + ((v >> shift) - SUB_BUCKETS);
+    }
+    static uint64_t bucket_lower_bound(size_t idx);
+    static uint64_t bucket_upper_bound(size_t idx);
+
+  private:
+    const double m_scale;
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+    std::atomic<uint64_t> m_buckets[N_BUCKETS];
+  };
+
+  // name may carry Prometheus labels, eg: rpc_requests_total{method="get_info"}
+  // asking for an existing name returns the same metric; asking for it with a
+  // different type throws
+  counter &get_counter(const std::string &name, const std::string &help = std::string());
+  gauge &get_gauge(const std::string &name, const std::string &help = std::string());
+  histogram &get_histogram(const std::string &name, const std::string &help = std::string(), double scale = 1.0);
+
+  struct metric_summary
+  {
+    std::string name;
+    std::string type;
+    double value; // counter or gauge value, or the histogram sum
+    uint64_t count; // histograms only
+    double p50;
+    double p99;
+    double max;
+  };
+
+  // Prometheus text exposition format (version 0.0.4)
+  std::string to_prometheus();
+  std::vector<metric_summary> get_summaries();
+  void reset_all();
+}
+}
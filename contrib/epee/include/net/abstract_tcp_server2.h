@@ -118,7 +118,8 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
-    virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
+    virtual bool do_send(const std::shared_ptr<const std::string>& buffer); ///< (see do_send from i_service_endpoint)
+    virtual bool do_send_chunk(const std::shared_ptr<const std::string>& buffer, size_t offset, size_t cb); ///< will send (or queue) a part of data
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
@@ -90,7 +90,15 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    /// a queued write: part of a buffer which may be shared with other connections
+    struct send_buffer
+    {
+      std::shared_ptr<const std::string> buffer;
+      size_t offset;
+      size_t size;
+      const char *data() const { return buffer->data() + offset; }
+    };
+    std::list<send_buffer> m_send_que;
     volatile bool m_is_multithreaded;
     double m_start_time;
     /// Strand to ensure the connection's handlers are not called concurrently.
@@ -30,6 +30,8 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <cctype>
+#include <limits>
 #include <string>
 #include <utility>
 
@@ -201,6 +203,180 @@ namespace net_utils
 				new(this) http_response_info();
 			}
 		};
+
+		inline bool equals_no_case(const boost::string_ref a, const boost::string_ref b)
+		{
+			if(a.size() != b.size())
+				return false;
+			for(std::size_t i = 0; i != a.size(); ++i)
+				if(std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i]))
+					return false;
+			return true;
+		}
+
+		inline boost::string_ref trim_blanks(boost::string_ref str)
+		{
+			while(!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+				str.remove_prefix(1);
+			while(!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+				str.remove_suffix(1);
+			return str;
+		}
+
+		//! \return True if the comma separated `Connection` field value lists `token`
+		inline bool has_connection_token(const boost::string_ref value, const boost::string_ref token)
+		{
+			boost::string_ref rest = value;
+			for(;;)
+			{
+				const std::size_t end = rest.find(',');
+				if(equals_no_case(trim_blanks(rest.substr(0, end)), token))
+					return true;
+				if(end == boost::string_ref::npos)
+					return false;
+				rest.remove_prefix(end + 1);
+			}
+		}
+
+		inline bool parse_decimal(const boost::string_ref digits, std::size_t& out)
+		{
+			if(digits.empty())
+				return false;
+			out = 0;
+			for(const char c: digits)
+			{
+				if(c < '0' || c > '9')
+					return false;
+				const std::size_t d = c - '0';
+				if(out > (std::numeric_limits<std::size_t>::max() - d) / 10)
+					return false;
+				out = out * 10 + d;
+			}
+			return true;
+		}
+
+		inline bool parse_content_length(const boost::string_ref value, std::size_t& len)
+		{
+			return parse_decimal(trim_blanks(value), len);
+		}
+
+		/*! Calls `f(name, value)` for every `name: value` line of `head`,
+		    stopping at the first empty line. Lines without a colon are skipped,
+		    folded continuation lines are not supported. */
+		template<typename t_callback>
+		inline void for_each_header_field(boost::string_ref head, t_callback f)
+		{
+			while(!head.empty())
+			{
+				std::size_t eol = head.find('\n');
+				boost::string_ref line = head.substr(0, eol);
+				head.remove_prefix(eol == boost::string_ref::npos ? head.size() : eol + 1);
+				if(!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+				if(line.empty())
+					break;
+
+				const std::size_t colon = line.find(':');
+				if(colon == boost::string_ref::npos || colon == 0)
+					continue;
+				f(trim_blanks(line.substr(0, colon)), trim_blanks(line.substr(colon + 1)));
+			}
+		}
+
+		inline void parse_header_fields(const boost::string_ref head, http_header_info& info)
+		{
+			info.clear();
+			for_each_header_field(head, [&info](const boost::string_ref name, const boost::string_ref value)
+			{
+				std::string* field = nullptr;
+				switch(name.empty() ? 0 : std::tolower((unsigned char)name.front()))
+				{
+				case 'c':
+					if(equals_no_case(name, "Connection"))
+						field = &info.m_connection;
+					else if(equals_no_case(name, "Content-Length"))
+						field = &info.m_content_length;
+					else if(equals_no_case(name, "Content-Type"))
+						field = &info.m_content_type;
+					else if(equals_no_case(name, "Content-Encoding"))
+						field = &info.m_content_encoding;
+					else if(equals_no_case(name, "Cookie"))
+						field = &info.m_cookie;
+					break;
+				case 'h':
+					if(equals_no_case(name, "Host"))
+						field = &info.m_host;
+					break;
+				case 'o':
+					if(equals_no_case(name, "Origin"))
+						field = &info.m_origin;
+					break;
+				case 'r':
+					if(equals_no_case(name, "Referer"))
+						field = &info.m_referer;
+					break;
+				case 't':
+					if(equals_no_case(name, "Transfer-Encoding"))
+						field = &info.m_transfer_encoding;
+					break;
+				case 'u':
+					if(equals_no_case(name, "User-Agent"))
+						field = &info.m_user_agent;
+					break;
+				}
+				if(field)
+					field->assign(value.data(), value.size());
+				else
+					info.m_etc_fields.emplace_back(std::string(name.data(), name.size()), std::string(value.data(), value.size()));
+			});
+		}
+
+		/*! Parses a "METHOD URI HTTP/x.y" request line, `line` excluding the
+		    line break. Only fills the method, version and URI of `info`. */
+		inline bool parse_request_line(const boost::string_ref line, http_request_info& info)
+		{
+			const std::size_t method_end = line.find(' ');
+			if(method_end == boost::string_ref::npos)
+				return false;
+			const boost::string_ref method = line.substr(0, method_end);
+			if(equals_no_case(method, "OPTIONS"))
+				info.m_http_method = http_method_options;
+			else if(equals_no_case(method, "GET"))
+				info.m_http_method = http_method_get;
+			else if(equals_no_case(method, "HEAD"))
+				info.m_http_method = http_method_head;
+			else if(equals_no_case(method, "POST"))
+				info.m_http_method = http_method_post;
+			else if(equals_no_case(method, "PUT"))
+				info.m_http_method = http_method_put;
+			else if(equals_no_case(method, "DELETE") || equals_no_case(method, "TRACE"))
+				info.m_http_method = http_method_etc;
+			else
+				return false;
+
+			boost::string_ref uri = line.substr(method_end + 1);
+			const std::size_t uri_end = uri.find(' ');
+			if(uri_end == boost::string_ref::npos || uri_end == 0)
+				return false;
+			boost::string_ref version = uri.substr(uri_end + 1);
+			uri = uri.substr(0, uri_end);
+
+			if(!equals_no_case(version.substr(0, 5), "HTTP/"))
+				return false;
+			version.remove_prefix(5);
+			const std::size_t dot = version.find('.');
+			std::size_t ver_hi = 0, ver_lo = 0;
+			if(dot == boost::string_ref::npos || !parse_decimal(version.substr(0, dot), ver_hi) || !parse_decimal(version.substr(dot + 1), ver_lo))
+				return false;
+			if(ver_hi > 99 || ver_lo > 99)
+				return false;
+
+			info.m_http_method_str.assign(method.data(), method.size());
+			info.m_URI.assign(uri.data(), uri.size());
+			info.m_http_ver_hi = ver_hi;
+			info.m_http_ver_lo = ver_lo;
+			return true;
+		}
 	}
 }
 }
@@ -492,7 +492,7 @@ namespace net_utils
 				m_header_cache.clear();
 				if(m_state != reciev_machine_state_error)
 				{
-					if(m_response_info.m_header_info.m_connection.size() && !string_tools::compare_no_case("close", m_response_info.m_header_info.m_connection))
+					if(is_connection_close_field(m_response_info.m_header_info.m_connection))
 						disconnect();
 
 					return true;
@@ -756,66 +756,7 @@ namespace net_utils
 			inline bool parse_header(http_header_info& body_info, const std::string& m_cache_to_process)
 			{
 				MTRACE("http_stream_filter::parse_cached_header(*)");
-
-				const char *ptr = m_cache_to_process.c_str();
-				while (ptr[0] != '\r' || ptr[1] != '\n')
-				{
-					// optional \n
-					if (*ptr == '\n')
-						++ptr;
-					// an identifier composed of letters or -
-					const char *key_pos = ptr;
-					while (isalnum(*ptr) || *ptr == '_' || *ptr == '-')
-						++ptr;
-					const char *key_end = ptr;
-					// optional space (not in RFC, but in previous code)
-					if (*ptr == ' ')
-						++ptr;
-					CHECK_AND_ASSERT_MES(*ptr == ':', true, "http_stream_filter::parse_cached_header() invalid header in: " << m_cache_to_process);
-					++ptr;
-					// optional whitespace, but not newlines - line folding is obsolete, let's ignore it
-					while (isblank(*ptr))
-						++ptr;
-					const char *value_pos = ptr;
-					while (*ptr != '\r' && *ptr != '\n')
-						++ptr;
-					const char *value_end = ptr;
-					// optional trailing whitespace
-					while (value_end > value_pos && isblank(*(value_end-1)))
-						--value_end;
-					if (*ptr == '\r')
-						++ptr;
-					CHECK_AND_ASSERT_MES(*ptr == '\n', true, "http_stream_filter::parse_cached_header() invalid header in: " << m_cache_to_process);
-					++ptr;
-
-					const std::string key = std::string(key_pos, key_end - key_pos);
-					const std::string value = std::string(value_pos, value_end - value_pos);
-					if (!key.empty())
-					{
-						if (!string_tools::compare_no_case(key, "Connection"))
-							body_info.m_connection = value;
-						else if(!string_tools::compare_no_case(key, "Referrer"))
-							body_info.m_referer = value;
-						else if(!string_tools::compare_no_case(key, "Content-Length"))
-							body_info.m_content_length = value;
-						else if(!string_tools::compare_no_case(key, "Content-Type"))
-							body_info.m_content_type = value;
-						else if(!string_tools::compare_no_case(key, "Transfer-Encoding"))
-							body_info.m_transfer_encoding = value;
-						else if(!string_tools::compare_no_case(key, "Content-Encoding"))
-							body_info.m_content_encoding = value;
-						else if(!string_tools::compare_no_case(key, "Host"))
-							body_info.m_host = value;
-						else if(!string_tools::compare_no_case(key, "Cookie"))
-							body_info.m_cookie = value;
-						else if(!string_tools::compare_no_case(key, "User-Agent"))
-							body_info.m_user_agent = value;
-						else if(!string_tools::compare_no_case(key, "Origin"))
-							body_info.m_origin = value;
-						else
-							body_info.m_etc_fields.emplace_back(key, value);
-					}
-				}
+				parse_header_fields(m_cache_to_process, body_info);
 				return true;
 			}
 			//---------------------------------------------------------------------------
@@ -954,12 +895,7 @@ namespace net_utils
 			inline 
 				bool is_connection_close_field(const std::string& str)
 			{
-				STATIC_REGEXP_EXPR_1(rexp_match_close, "^\\s*close", boost::regex::icase | boost::regex::normal);
-				boost::smatch result;
-				if(boost::regex_search( str, result, rexp_match_close, boost::match_default) && result[0].matched)
-					return true;
-				else
-					return false;
+				return has_connection_token(str, "close");
 			}
 			inline
 				bool is_multipart_body(const http_header_info& head_info, OUT std::string& boundary)
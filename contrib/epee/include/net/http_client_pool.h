@@ -0,0 +1,206 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/optional/optional.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "http_client.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "net.http"
+
+namespace epee
+{
+namespace net_utils
+{
+  namespace http
+  {
+    /*! Up to `max_connections` keep-alive clients to one server. Each caller
+        gets a client of its own for the duration of a request, so requests
+        from different threads go out on separate connections instead of
+        queueing behind a single one. Idle connections are reused. */
+    template<typename t_client>
+    class http_client_pool_template
+    {
+      struct entry
+      {
+        std::unique_ptr<t_client> client;
+        unsigned generation;
+      };
+
+    public:
+      //! Gives the client back to the pool when destroyed
+      class handle
+      {
+      public:
+        handle(handle&& other) noexcept
+          : m_pool(other.m_pool), m_entry(std::move(other.m_entry))
+        {
+          other.m_pool = nullptr;
+        }
+        handle(const handle&) = delete;
+        handle& operator=(const handle&) = delete;
+        ~handle()
+        {
+          if (m_pool)
+            m_pool->release(std::move(m_entry));
+        }
+
+        t_client& operator*() const { return *m_entry.client; }
+        t_client* operator->() const { return m_entry.client.get(); }
+
+      private:
+        friend class http_client_pool_template;
+        handle(http_client_pool_template* pool, entry&& e)
+          : m_pool(pool), m_entry(std::move(e))
+        {}
+
+        http_client_pool_template* m_pool;
+        entry m_entry;
+      };
+
+      explicit http_client_pool_template(std::size_t max_connections = 4)
+        : m_in_use(0), m_max_connections(max_connections ? max_connections : 1), m_ssl(false), m_generation(0)
+      {}
+
+      http_client_pool_template(const http_client_pool_template&) = delete;
+      http_client_pool_template& operator=(const http_client_pool_template&) = delete;
+
+      ~http_client_pool_template()
+      {
+        // handles must not outlive the pool
+        assert(m_in_use == 0);
+      }
+
+      bool set_server(const std::string& address, boost::optional<login> user, bool ssl = false)
+      {
+        http::url_content parsed{};
+        const bool r = parse_url(address, parsed);
+        CHECK_AND_ASSERT_MES(r, false, "failed to parse url: " << address);
+        set_server(std::move(parsed.host), std::to_string(parsed.port), std::move(user), ssl);
+        return true;
+      }
+
+      //! Clients in use keep their connection until they are given back
+      void set_server(std::string host, std::string port, boost::optional<login> user, bool ssl = false)
+      {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_host = std::move(host);
+        m_port = std::move(port);
+        m_user = std::move(user);
+        m_ssl = ssl;
+        ++m_generation;
+        m_idle.clear();
+      }
+
+      void set_max_connections(std::size_t max_connections)
+      {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_max_connections = max_connections ? max_connections : 1;
+        while (m_idle.size() + m_in_use > m_max_connections && !m_idle.empty())
+          m_idle.pop_back();
+        m_cond.notify_all();
+      }
+
+      std::size_t get_max_connections() const
+      {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        return m_max_connections;
+      }
+
+      //! Blocks until a client is free, or a new one may be opened
+      handle acquire()
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (m_idle.empty() && m_in_use >= m_max_connections)
+          m_cond.wait(lock);
+
+        entry e;
+        if (!m_idle.empty())
+        {
+          // most recently used first, it is the likeliest to still be connected
+          e = std::move(m_idle.back());
+          m_idle.pop_back();
+        }
+        else
+        {
+          e.client.reset(new t_client());
+          e.generation = m_generation - 1;
+        }
+        if (e.generation != m_generation)
+        {
+          e.client->set_server(m_host, m_port, m_user, m_ssl);
+          e.generation = m_generation;
+        }
+        ++m_in_use;
+        return handle(this, std::move(e));
+      }
+
+      //! Closes idle connections, they are reopened on demand
+      void disconnect()
+      {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        for (entry& e: m_idle)
+          e.client->disconnect();
+      }
+
+    private:
+      void release(entry&& e)
+      {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        --m_in_use;
+        // drop clients for an old server, or beyond a lowered limit
+        if (e.generation == m_generation && m_idle.size() + m_in_use < m_max_connections)
+          m_idle.push_back(std::move(e));
+        m_cond.notify_one();
+      }
+
+      mutable boost::mutex m_mutex;
+      boost::condition_variable m_cond;
+      std::vector<entry> m_idle;
+      std::size_t m_in_use;
+      std::size_t m_max_connections;
+      std::string m_host;
+      std::string m_port;
+      boost::optional<login> m_user;
+      bool m_ssl;
+      unsigned m_generation;
+    };
+
+    typedef http_client_pool_template<http_simple_client> http_client_pool;
+  }
+}
+}
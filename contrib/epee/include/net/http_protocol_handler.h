@@ -111,7 +111,7 @@ namespace net_utils
 				http_body_transfer_undefined
 			};
 
-			bool handle_buff_in(std::string& buf);
+			bool handle_buff_in();
 
 			bool analize_cached_request_header_and_invoke_state(size_t pos);
 
@@ -124,7 +124,7 @@ namespace net_utils
 			bool set_ready_state();
 			bool slash_to_back_slash(std::string& str);
 			std::string get_file_mime_tipe(const std::string& path);
-			std::string get_response_header(const http_response_info& response);
+			void get_response_header(const http_response_info& response, std::string& buf);
 
 			//major function 
 			inline bool handle_request_and_send_response(const http::http_request_info& query_info);
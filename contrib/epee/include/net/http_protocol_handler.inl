@@ -25,12 +25,11 @@
 // 
 
 
-#include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
 #include "http_protocol_handler.h"
-#include "reg_exp_definer.h"
 #include "string_tools.h"
 #include "file_io_utils.h"
+#include "time_helper.h"
 #include "net_parse_helpers.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -38,6 +37,7 @@
 
 #define HTTP_MAX_URI_LEN		 9000 
 #define HTTP_MAX_HEADER_LEN		 100000
+#define HTTP_MAX_MERGED_BODY_LEN	 65536
 
 namespace epee
 {
@@ -57,52 +57,35 @@ namespace net_utils
 		inline
 			bool match_boundary(const std::string& content_type, std::string& boundary)
 		{
-			STATIC_REGEXP_EXPR_1(rexp_match_boundary, "boundary=(.*?)(($)|([;\\s,]))", boost::regex::icase | boost::regex::normal);
-			//											        1
-			boost::smatch result;	
-			if(boost::regex_search(content_type, result, rexp_match_boundary, boost::match_default) && result[0].matched)
+			std::size_t pos = 0;
+			while((pos = content_type.find('=', pos)) != std::string::npos)
 			{
-				boundary = result[1];
-				return true;
+				const std::size_t name_start = pos >= 8 ? pos - 8 : 0;
+				if(pos >= 8 && equals_no_case(boost::string_ref(content_type).substr(name_start, 8), "boundary"))
+				{
+					const std::size_t end = content_type.find_first_of("; \t\r\n,", pos + 1);
+					boundary = content_type.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+					return true;
+				}
+				++pos;
 			}
-
 			return false;
 		}
 
 		inline 
 			bool parse_header(std::string::const_iterator it_begin, std::string::const_iterator it_end, multipart_entry& entry)
 		{
-			STATIC_REGEXP_EXPR_1(rexp_mach_field, 
-				"\n?((Content-Disposition)|(Content-Type)"
-				//  12                     3 
-				"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-				//4               56    7 
-				boost::regex::icase | boost::regex::normal);
-
-			boost::smatch		result;
-			std::string::const_iterator it_current_bound = it_begin;
-			std::string::const_iterator it_end_bound = it_end;
-
-			//lookup all fields and fill well-known fields
-			while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched) 
+			if(it_begin == it_end)
+				return true;
+			for_each_header_field(boost::string_ref(&*it_begin, it_end - it_begin), [&entry](const boost::string_ref name, const boost::string_ref value)
 			{
-				const size_t field_val = 6;
-				const size_t field_etc_name = 4;
-
-				int i = 2; //start position = 2
-				if(result[i++].matched)//"Content-Disposition"
-					entry.m_content_disposition = result[field_val];
-				else if(result[i++].matched)//"Content-Type"
-					entry.m_content_type = result[field_val];
-				else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
-					entry.m_etc_header_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
+				if(equals_no_case(name, "Content-Disposition"))
+					entry.m_content_disposition.assign(value.data(), value.size());
+				else if(equals_no_case(name, "Content-Type"))
+					entry.m_content_type.assign(value.data(), value.size());
 				else
-				{
-					LOG_ERROR("simple_http_connection_handler::parse_header() not matched last entry in:"<<std::string(it_current_bound, it_end));
-				}
-
-				it_current_bound = result[(int)result.size()-1].first;
-			}
+					entry.m_etc_header_fields.emplace_back(std::string(name.data(), name.size()), std::string(value.data(), value.size()));
+			});
 			return  true;
 		}
 
@@ -222,27 +205,20 @@ namespace net_utils
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_recv(const void* ptr, size_t cb)
 	{
-		std::string buf((const char*)ptr, cb);
-		//LOG_PRINT_L0("HTTP_RECV: " << ptr << "\r\n" << buf);
-		//file_io_utils::save_string_to_file(string_tools::get_current_module_folder() + "/" + boost::lexical_cast<std::string>(ptr), std::string((const char*)ptr, cb));
-
-		bool res = handle_buff_in(buf);
+		m_cache.append((const char*)ptr, cb);
+		bool res = handle_buff_in();
 		if(m_want_close/*m_state == http_state_connection_close || m_state == http_state_error*/)
 			return false;
 		return res;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::handle_buff_in(std::string& buf)
+	bool simple_http_connection_handler<t_connection_context>::handle_buff_in()
 	{
-
-		if(m_cache.size())
-			m_cache += buf;
-		else
-			m_cache.swap(buf);
-
+		// the cache may hold several pipelined requests, they are answered in
+		// order until it runs dry or a response asks to close the connection
 		m_is_stop_handling = false;
-		while(!m_is_stop_handling)
+		while(!m_is_stop_handling && !m_want_close)
 		{
 			switch(m_state)
 			{
@@ -293,7 +269,9 @@ namespace net_utils
 					break;
 				}
 			case http_state_retriving_body:
-				return handle_retriving_query_body();
+				if (!handle_retriving_query_body())
+					return false;
+				break;
 			case http_state_connection_close:
 				return false;
 			default:
@@ -310,63 +288,33 @@ namespace net_utils
 
 		return true;
 	}
-	//--------------------------------------------------------------------------------------------
-	inline bool analize_http_method(const boost::smatch& result, http::http_method& method, int& http_ver_major, int& http_ver_minor)
-	{
-		CHECK_AND_ASSERT_MES(result[0].matched, false, "simple_http_connection_handler::analize_http_method() assert failed...");
-		http_ver_major = boost::lexical_cast<int>(result[11]);
-		http_ver_minor = boost::lexical_cast<int>(result[12]);
-
-		if(result[3].matched)
-			method = http::http_method_options;
-		else if(result[4].matched)
-			method = http::http_method_get;
-		else if(result[5].matched)
-			method = http::http_method_head;
-		else if(result[6].matched)
-			method = http::http_method_post;
-		else if(result[7].matched)
-			method = http::http_method_put;
-		else 
-			method = http::http_method_etc;
-
-		return true;
-	}
-
   //--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_invoke_query_line()
 	{ 
-		STATIC_REGEXP_EXPR_1(rexp_match_command_line, "^(((OPTIONS)|(GET)|(HEAD)|(POST)|(PUT)|(DELETE)|(TRACE)) (\\S+) HTTP/(\\d+).(\\d+))\r?\n", boost::regex::icase | boost::regex::normal);
-		//											    123         4     5      6      7     8        9        10          11     12    
-		//size_t match_len = 0;
-		boost::smatch result;	
-		if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
-		{
-			analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi);
-			m_query_info.m_URI = result[10];
-			if (!parse_uri(m_query_info.m_URI, m_query_info.m_uri_content))
-			{
-				m_state = http_state_error;
-				MERROR("Failed to parse URI: m_query_info.m_URI");
-				return false;
-			}
-			m_query_info.m_http_method_str = result[2];
-			m_query_info.m_full_request_str = result[0];
-
-			m_cache.erase(m_cache.begin(),  to_nonsonst_iterator(m_cache, result[0].second));
-
-			m_state = http_state_retriving_header;
-
-			return true;
-		}else
+		const std::string::size_type eol = m_cache.find('\n');
+		std::string::size_type line_len = eol;
+		if(line_len && m_cache[line_len - 1] == '\r')
+			--line_len;
+		if(!parse_request_line(boost::string_ref(m_cache.data(), line_len), m_query_info))
 		{
 			m_state = http_state_error;
 			LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(): Failed to match first line: " << m_cache);
 			return false;
 		}
+		if (!parse_uri(m_query_info.m_URI, m_query_info.m_uri_content))
+		{
+			m_state = http_state_error;
+			MERROR("Failed to parse URI: m_query_info.m_URI");
+			return false;
+		}
+		m_query_info.m_full_request_str.assign(m_cache, 0, eol + 1);
+
+		m_cache.erase(0, eol + 1);
 
-		return false;
+		m_state = http_state_retriving_header;
+
+		return true;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
@@ -374,6 +322,11 @@ namespace net_utils
 	{
 
     //Here we returning head size, including terminating sequence (\r\n\r\n or \n\n)
+		//a request without header fields has only the empty line left
+		if(!buf.compare(0, 2, "\r\n"))
+			return 2;
+		if(!buf.compare(0, 1, "\n"))
+			return 1;
 		std::string::size_type res = buf.find("\r\n\r\n");
 		if(std::string::npos != res)
 			return res+4;
@@ -400,7 +353,6 @@ namespace net_utils
 
 		m_cache.erase(0, pos);
 
-		std::string req_command_str = m_query_info.m_full_request_str;
     //if we have POST or PUT command, it is very possible tha we will get body
     //but now, we suppose than we have body only in case of we have "ContentLength" 
 		if(m_query_info.m_header_info.m_content_length.size())
@@ -457,7 +409,10 @@ namespace net_utils
 		if(m_len_remain >= m_cache.size())
 		{
 			m_len_remain -= m_cache.size();
-			m_query_info.m_body += m_cache;
+			if(m_query_info.m_body.empty())
+				m_query_info.m_body.swap(m_cache); // the whole body came in one piece, no need to copy it
+			else
+				m_query_info.m_body += m_cache;
 			m_cache.clear();
 		}else
 		{
@@ -479,69 +434,14 @@ namespace net_utils
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos)
 	{ 
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, 
-			"\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)|(User-Agent)|(Origin)"
-			//  12            3         4                5              6                   7                  8      9        10           11
-			"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-			//11             1213   14 
-			boost::regex::icase | boost::regex::normal);
-
-		boost::smatch		result;
-		std::string::const_iterator it_current_bound = m_cache_to_process.begin();
-		std::string::const_iterator it_end_bound = m_cache_to_process.begin()+pos;
-
-		body_info.clear();
-
-		//lookup all fields and fill well-known fields
-		while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched) 
-		{
-			const size_t field_val = 14;
-			const size_t field_etc_name = 12;
-
-			int i = 2; //start position = 2
-			if(result[i++].matched)//"Connection"
-				body_info.m_connection = result[field_val];
-			else if(result[i++].matched)//"Referer"
-				body_info.m_referer = result[field_val];
-			else if(result[i++].matched)//"Content-Length"
-				body_info.m_content_length = result[field_val];
-			else if(result[i++].matched)//"Content-Type"
-				body_info.m_content_type = result[field_val];
-			else if(result[i++].matched)//"Transfer-Encoding"
-				body_info.m_transfer_encoding = result[field_val];
-			else if(result[i++].matched)//"Content-Encoding"
-				body_info.m_content_encoding = result[field_val];
-			else if(result[i++].matched)//"Host"
-				body_info.m_host = result[field_val];
-			else if(result[i++].matched)//"Cookie"
-				body_info.m_cookie = result[field_val];
-			else if(result[i++].matched)//"User-Agent"
-				body_info.m_user_agent = result[field_val];
-			else if(result[i++].matched)//"Origin"
-				body_info.m_origin = result[field_val];
-			else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
-				body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
-			else
-			{
-				LOG_ERROR("simple_http_connection_handler<t_connection_context>::parse_cached_header() not matched last entry in:"<<m_cache_to_process);
-			}
-
-			it_current_bound = result[(int)result.size()-1]. first;
-		}
+		parse_header_fields(boost::string_ref(m_cache_to_process.data(), pos), body_info);
 		return  true;
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::get_len_from_content_lenght(const std::string& str, size_t& OUT len)
 	{
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, "\\d+", boost::regex::normal);
-		std::string res;
-		boost::smatch result;
-		if(!(boost::regex_search( str, result, rexp_mach_field, boost::match_default) && result[0].matched))
-			return false;
-
-		len = boost::lexical_cast<size_t>(result[0]);
-		return true;
+		return parse_content_length(str, len);
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
@@ -561,13 +461,20 @@ namespace net_utils
 			response.m_response_comment = "OK";
 		}
 
-		std::string response_data = get_response_header(response);
-		//LOG_PRINT_L0("HTTP_SEND: << \r\n" << response_data + response.m_body);
+		const bool send_body = (response.m_body.size() && (query_info.m_http_method != http::http_method_head)) || (query_info.m_http_method == http::http_method_options);
+		// small bodies go out in the same buffer as the head, saving a write
+		const bool merge_body = send_body && response.m_body.size() <= HTTP_MAX_MERGED_BODY_LEN;
+
+		std::string response_data;
+		response_data.reserve(512 + (merge_body ? response.m_body.size() : 0));
+		get_response_header(response, response_data);
 
     LOG_PRINT_L3("HTTP_RESPONSE_HEAD: << \r\n" << response_data);
-		
+
+		if (merge_body)
+			response_data += response.m_body;
 		m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size());
-		if ((response.m_body.size() && (query_info.m_http_method != http::http_method_head)) || (query_info.m_http_method == http::http_method_options))
+		if (send_body && !merge_body)
 			m_psnd_hndlr->do_send((void*)response.m_body.data(), response.m_body.size());
 		return res;
 	}
@@ -603,18 +510,23 @@ namespace net_utils
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
-	std::string simple_http_connection_handler<t_connection_context>::get_response_header(const http_response_info& response)
+	void simple_http_connection_handler<t_connection_context>::get_response_header(const http_response_info& response, std::string& buf)
 	{
-		std::string buf = "HTTP/1.1 ";
-		buf += boost::lexical_cast<std::string>(response.m_response_code) + " " + response.m_response_comment + "\r\n" +
+		buf += "HTTP/1.1 ";
+		buf += std::to_string(response.m_response_code);
+		buf += " ";
+		buf += response.m_response_comment;
+		buf += "\r\n"
 			"Server: Epee-based\r\n"
 			"Content-Length: ";
-		buf += boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
+		buf += std::to_string(response.m_body.size());
+		buf += "\r\n";
 
 		if(!response.m_mime_tipe.empty())
 		{
 			buf += "Content-Type: ";
-			buf += response.m_mime_tipe + "\r\n";
+			buf += response.m_mime_tipe;
+			buf += "\r\n";
 		}
 
 		buf += "Last-Modified: ";
@@ -624,17 +536,18 @@ namespace net_utils
 		buf += "Accept-Ranges: bytes\r\n";
 		//Wed, 01 Dec 2010 03:27:41 GMT"
 
-		string_tools::trim(m_query_info.m_header_info.m_connection);
-		if(m_query_info.m_header_info.m_connection.size())
+		//HTTP/1.1 connections persist unless asked otherwise, HTTP/1.0 ones only on request
+		const std::string& connection = m_query_info.m_header_info.m_connection;
+		const bool http_1_0 = m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo == 0;
+		if(has_connection_token(connection, "close") || (http_1_0 && !has_connection_token(connection, "keep-alive")))
 		{
-			if(!string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection))
-			{
-        //closing connection after sending
-				buf += "Connection: close\r\n";
-				m_state = http_state_connection_close;
-				m_want_close = true;
-			}
+			//closing connection after sending
+			buf += "Connection: close\r\n";
+			m_state = http_state_connection_close;
+			m_want_close = true;
 		}
+		else if(http_1_0)
+			buf += "Connection: keep-alive\r\n";
 
 		// Cross-origin resource sharing
 		if(m_query_info.m_header_info.m_origin.size())
@@ -653,11 +566,14 @@ namespace net_utils
 
 		//add additional fields, if it is
 		for(fields_list::const_iterator it = response.m_additional_fields.begin(); it!=response.m_additional_fields.end(); it++)
-			buf += it->first + ":" + it->second + "\r\n";
+		{
+			buf += it->first;
+			buf += ":";
+			buf += it->second;
+			buf += "\r\n";
+		}
 
 		buf+="\r\n";
-
-		return buf;
 	}
 	//-----------------------------------------------------------------------------------
 	template<class t_connection_context>
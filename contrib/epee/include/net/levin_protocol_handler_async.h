@@ -32,11 +32,13 @@
 #include <boost/smart_ptr/make_shared.hpp>
 
 #include <atomic>
+#include <memory>
 
 #include "levin_base.h"
 #include "misc_language.h"
 #include "syncobj.h"
 #include "misc_os_dependent.h"
+#include "metrics.h"
 
 #include <random>
 #include <chrono>
@@ -53,6 +55,28 @@ namespace epee
 namespace levin
 {
 
+/************************************************************************/
+/* A notification framed once, which can then be sent as is to any     */
+/* number of connections without copying it for each of them          */
+/************************************************************************/
+inline std::shared_ptr<const std::string> make_notify(int command, const std::string& in_buff)
+{
+  bucket_head2 head = {0};
+  head.m_signature = LEVIN_SIGNATURE;
+  head.m_have_to_return_data = false;
+  head.m_cb = in_buff.size();
+
+  head.m_command = command;
+  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+  head.m_flags = LEVIN_PACKET_REQUEST;
+
+  std::shared_ptr<std::string> message = std::make_shared<std::string>();
+  message->reserve(sizeof(head) + in_buff.size());
+  message->append((const char*)&head, sizeof(head));
+  message->append(in_buff);
+  return message;
+}
+
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
@@ -89,6 +113,7 @@ public:
   int invoke_async(int command, const std::string& in_buff, boost::uuids::uuid connection_id, const callback_t &cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const std::string& in_buff, boost::uuids::uuid connection_id);
+  int notify(const std::shared_ptr<const std::string>& message, boost::uuids::uuid connection_id); // message from make_notify
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -352,6 +377,24 @@ public:
     m_config.m_pcommands_handler->callback(m_connection_context);
   }
 
+  bool send_bytes(const void* ptr, size_t cb)
+  {
+    static epee::metrics::counter &bytes_sent = epee::metrics::get_counter("levin_bytes_sent_total", "Bytes sent on levin connections");
+    if(!m_pservice_endpoint->do_send(ptr, cb))
+      return false;
+    bytes_sent.inc(cb);
+    return true;
+  }
+
+  bool send_bytes(const std::shared_ptr<const std::string>& buffer)
+  {
+    static epee::metrics::counter &bytes_sent = epee::metrics::get_counter("levin_bytes_sent_total", "Bytes sent on levin connections");
+    if(!m_pservice_endpoint->do_send(buffer))
+      return false;
+    bytes_sent.inc(buffer->size());
+    return true;
+  }
+
   virtual bool handle_recv(const void* ptr, size_t cb)
   {
     if(boost::interprocess::ipcdetail::atomic_read32(&m_close_called))
@@ -371,6 +414,9 @@ public:
       return false;
     }
 
+    static epee::metrics::counter &bytes_received = epee::metrics::get_counter("levin_bytes_received_total", "Bytes received on levin connections");
+    bytes_received.inc(cb);
+
     m_cache_in_buffer.append((const char*)ptr, cb);
 
     bool is_continue = true;
@@ -407,6 +453,14 @@ public:
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
+          static epee::metrics::histogram &packet_size = epee::metrics::get_histogram("levin_packet_size_bytes", "Size of levin packets received");
+          static epee::metrics::counter &responses_received = epee::metrics::get_counter("levin_packets_received_total{type=\"response\"}", "Levin packets received");
+          static epee::metrics::counter &invokes_received = epee::metrics::get_counter("levin_packets_received_total{type=\"invoke\"}", "Levin packets received");
+          static epee::metrics::counter &notifies_received = epee::metrics::get_counter("levin_packets_received_total{type=\"notify\"}", "Levin packets received");
+          static epee::metrics::histogram &invoke_time = epee::metrics::get_histogram("levin_invoke_handler_seconds", "Time spent handling levin invokes from peers", 1e-9);
+          packet_size.record(buff_to_invoke.size());
+          (is_response ? responses_received : m_current_head.m_have_to_return_data ? invokes_received : notifies_received).inc();
+
           MDEBUG(m_connection_context << "LEVIN_PACKET_RECIEVED. [len=" << m_current_head.m_cb
             << ", flags" << m_current_head.m_flags 
             << ", r?=" << m_current_head.m_have_to_return_data 
@@ -452,11 +506,13 @@ public:
             if(m_current_head.m_have_to_return_data)
             {
               std::string return_buff;
+              const uint64_t invoke_start = misc_utils::get_ns_count();
               m_current_head.m_return_code = m_config.m_pcommands_handler->invoke(
                                                                   m_current_head.m_command, 
                                                                   buff_to_invoke, 
                                                                   return_buff, 
                                                                   m_connection_context);
+              invoke_time.record(misc_utils::get_ns_count() - invoke_start);
               m_current_head.m_cb = return_buff.size();
               m_current_head.m_have_to_return_data = false;
               m_current_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
@@ -464,7 +520,7 @@ public:
               std::string send_buff((const char*)&m_current_head, sizeof(m_current_head));
               send_buff += return_buff;
               CRITICAL_REGION_BEGIN(m_send_lock);
-              if(!m_pservice_endpoint->do_send(send_buff.data(), send_buff.size()))
+              if(!send_bytes(send_buff.data(), send_buff.size()))
                 return false;
               CRITICAL_REGION_END();
               MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << m_current_head.m_cb
@@ -569,14 +625,14 @@ public:
       boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 0);
       CRITICAL_REGION_BEGIN(m_send_lock);
       CRITICAL_REGION_LOCAL1(m_invoke_response_handlers_lock);
-      if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
+      if(!send_bytes(&head, sizeof(head)))
       {
         LOG_ERROR_CC(m_connection_context, "Failed to do_send");
         err_code = LEVIN_ERROR_CONNECTION;
         break;
       }
 
-      if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+      if(!send_bytes(in_buff.data(), (int)in_buff.size()))
       {
         LOG_ERROR_CC(m_connection_context, "Failed to do_send");
         err_code = LEVIN_ERROR_CONNECTION;
@@ -626,13 +682,13 @@ public:
 
     boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 0);
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
+    if(!send_bytes(&head, sizeof(head)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send");
       return LEVIN_ERROR_CONNECTION;
     }
 
-    if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+    if(!send_bytes(in_buff.data(), (int)in_buff.size()))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send");
       return LEVIN_ERROR_CONNECTION;
@@ -698,13 +754,13 @@ public:
     head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
     head.m_flags = LEVIN_PACKET_REQUEST;
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
+    if(!send_bytes(&head, sizeof(head)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
       return -1;
     }
 
-    if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+    if(!send_bytes(in_buff.data(), (int)in_buff.size()))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
       return -1;
@@ -719,6 +775,31 @@ public:
     return 1;
   }
   //------------------------------------------------------------------------------------------
+  int notify(const std::shared_ptr<const std::string>& message)
+  {
+    misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
+                          boost::bind(&async_protocol_handler::finish_outer_call, this));
+
+    if(m_deletion_initiated)
+      return LEVIN_ERROR_CONNECTION_DESTROYED;
+
+    CRITICAL_REGION_LOCAL(m_call_lock);
+
+    if(m_deletion_initiated)
+      return LEVIN_ERROR_CONNECTION_DESTROYED;
+
+    CRITICAL_REGION_BEGIN(m_send_lock);
+    if(!send_bytes(message))
+    {
+      LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
+      return -1;
+    }
+    CRITICAL_REGION_END();
+    LOG_DEBUG_CC(m_connection_context, "LEVIN_PACKET_SENT. [len=" << message->size() << ", shared notify]");
+
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------
   boost::uuids::uuid get_connection_id() {return m_connection_context.m_connection_id;}
   //------------------------------------------------------------------------------------------
   t_connection_context& get_context_ref() {return m_connection_context;}
@@ -874,6 +955,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(const std::shared_ptr<const std::string>& message, boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify(message) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
   CRITICAL_REGION_LOCAL(m_connects_lock);
@@ -29,6 +29,8 @@
 #ifndef _NET_UTILS_BASE_H_
 #define _NET_UTILS_BASE_H_
 
+#include <memory>
+#include <string>
 #include <boost/uuid/uuid.hpp>
 #include <boost/asio/io_service.hpp>
 #include <typeinfo>
@@ -280,6 +282,8 @@ namespace net_utils
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    //buffer may be sent to several connections, implementations should queue it without copying
+    virtual bool do_send(const std::shared_ptr<const std::string>& buffer) { return do_send(buffer->data(), buffer->size()); }
     virtual bool close()=0;
     virtual bool call_run_once_service_io()=0;
     virtual bool request_callback()=0;
@@ -69,6 +69,7 @@ namespace epee
       harray insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section);
       template<class t_value>
       bool          insert_next_value(harray hval_array, const t_value& target);
+      bool          insert_next_value(harray hval_array, std::string&& target);
       //sections
       harray get_first_section(const std::string& pSectionName, hsection& h_child_section, hsection hparent_section);
       bool            get_next_section(harray hSecArray, hsection& h_child_section);
@@ -398,6 +399,20 @@ namespace epee
       CATCH_ENTRY("portable_storage::insert_next_value", false);
     }
     //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage::insert_next_value(harray hval_array, std::string&& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hval_array, false);
+
+      CHECK_AND_ASSERT_MES(hval_array->type() == typeid(array_entry_t<std::string>),
+        false, "unexpected type in insert_next_value: " << typeid(array_entry_t<std::string>).name());
+
+      boost::get<array_entry_t<std::string> >(*hval_array).insert_next_value(std::move(target));
+      return true;
+      CATCH_ENTRY("portable_storage::insert_next_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
     //sections
     inline
     harray portable_storage::get_first_section(const std::string& sec_name, hsection& h_child_section, hsection hparent_section)
@@ -119,6 +119,12 @@ namespace epee
         return m_array.back();
       }
 
+      t_entry_type& insert_next_value(t_entry_type&& v)
+      {
+        m_array.push_back(std::move(v));
+        return m_array.back();
+      }
+
       std::list<t_entry_type> m_array;
       mutable typename std::list<t_entry_type>::const_iterator m_it;
     };
@@ -25,10 +25,14 @@
 // 
 
 #pragma once
+#include <limits>
+#include <vector>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include "parserse_base_utils.h"
 #include "file_io_utils.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/memorystream.h"
 
 namespace epee
 {
@@ -356,9 +360,141 @@ namespace epee
     ]
 }
 */
+      // SAX handler filling the storage straight from rapidjson events. It
+      // follows run_handler's rules: the root must be an object, nulls are
+      // skipped, arrays hold a single type and may not nest, integers in
+      // arrays are signed
+      template<class t_storage>
+      class sax_handler: public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, sax_handler<t_storage>>
+      {
+      public:
+        sax_handler(t_storage& stg): m_stg(stg) {}
+
+        bool StartObject()
+        {
+          typename t_storage::hsection new_sec = nullptr; // the root section
+          if (!m_stack.empty())
+          {
+            frame &f = m_stack.back();
+            if (!f.in_array)
+              new_sec = m_stg.open_section(f.name, f.section, true);
+            else if (!f.array)
+              f.array = m_stg.insert_first_section(f.name, new_sec, f.section);
+            else if (!m_stg.insert_next_section(f.array, new_sec))
+              return false;
+            if (!new_sec)
+              return false;
+          }
+          m_stack.push_back(frame{new_sec, nullptr, std::string(), false});
+          return true;
+        }
+        bool EndObject(rapidjson::SizeType)
+        {
+          m_stack.pop_back();
+          return true;
+        }
+        bool Key(const char* str, rapidjson::SizeType len, bool)
+        {
+          m_stack.back().name.assign(str, len);
+          return true;
+        }
+        bool StartArray()
+        {
+          if (m_stack.empty() || m_stack.back().in_array)
+            return false;
+          const frame &f = m_stack.back();
+          m_stack.push_back(frame{f.section, nullptr, f.name, true});
+          return true;
+        }
+        bool EndArray(rapidjson::SizeType)
+        {
+          m_stack.pop_back();
+          return true;
+        }
+        bool Null()
+        {
+          return !m_stack.empty() && !m_stack.back().in_array;
+        }
+        bool Bool(bool b)
+        {
+          return add_value(b);
+        }
+        // rapidjson has already decoded \uXXXX escapes to UTF-8 here; the
+        // lenient parser keeps them as a literal "uXXXX"
+        bool String(const char* str, rapidjson::SizeType len, bool)
+        {
+          return add_value(std::string(str, len));
+        }
+        bool RawNumber(const char* str, rapidjson::SizeType len, bool)
+        {
+          bool is_float = false;
+          for (rapidjson::SizeType i = 0; i < len; ++i)
+            if (str[i] == '.' || str[i] == 'e' || str[i] == 'E')
+              is_float = true;
+          if (is_float)
+            return add_value(boost::lexical_cast<double>(std::string(str, len)));
+          const bool is_signed = len && str[0] == '-';
+          uint64_t v = 0;
+          for (rapidjson::SizeType i = is_signed; i < len; ++i)
+          {
+            const unsigned d = str[i] - '0';
+            if (v > (std::numeric_limits<uint64_t>::max() - d) / 10)
+              return false;
+            v = v * 10 + d;
+          }
+          if (is_signed || m_stack.back().in_array)
+          {
+            const uint64_t limit = (uint64_t)std::numeric_limits<int64_t>::max() + is_signed;
+            if (v > limit)
+              return false;
+            return add_value(is_signed ? (int64_t)(0 - v) : (int64_t)v);
+          }
+          return add_value(v);
+        }
+
+      private:
+        template<class t_value>
+        bool add_value(t_value&& v)
+        {
+          if (m_stack.empty())
+            return false;
+          frame &f = m_stack.back();
+          if (!f.in_array)
+            return m_stg.set_value(f.name, v, f.section);
+          if (f.array)
+            return m_stg.insert_next_value(f.array, std::forward<t_value>(v));
+          f.array = m_stg.insert_first_value(f.name, v, f.section);
+          return f.array != nullptr;
+        }
+
+        struct frame
+        {
+          typename t_storage::hsection section;
+          typename t_storage::harray array;
+          std::string name;
+          bool in_array;
+        };
+
+        t_storage& m_stg;
+        std::vector<frame> m_stack;
+      };
+
       template<class t_storage>
       inline bool load_from_json(const std::string& buff_json, t_storage& stg)
       {
+        try
+        {
+          sax_handler<t_storage> handler(stg);
+          rapidjson::Reader reader;
+          rapidjson::MemoryStream ms(buff_json.data(), buff_json.size());
+          if (reader.Parse<rapidjson::kParseIterativeFlag | rapidjson::kParseStopWhenDoneFlag | rapidjson::kParseNumbersAsStringsFlag>(ms, handler))
+            return true;
+        }
+        catch(...) {}
+
+        // not strict JSON, eg binary blobs as written by dump_as_json, or an
+        // empty body: start again with the lenient parser
+        stg = t_storage();
         std::string::const_iterator sec_buf_begin  = buff_json.begin();
         try
         {
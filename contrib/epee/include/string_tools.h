@@ -96,51 +96,38 @@ namespace string_tools
     return to_hex::string(to_byte_span(to_span(src)));
   }
   //----------------------------------------------------------------------------
-  template<class CharT>
-  bool parse_hexstr_to_binbuff(const std::basic_string<CharT>& s, std::basic_string<CharT>& res, bool allow_partial_byte = false)
+  inline bool parse_hexstr_to_binbuff(const std::string& s, std::string& res, bool allow_partial_byte = false)
   {
-    res.clear();
-    if (!allow_partial_byte && (s.size() & 1))
+    const bool partial = s.size() & 1;
+    if (partial && !allow_partial_byte)
+    {
+      res.clear();
       return false;
-    try
+    }
+    if (!from_hex::string(res, {s.data(), s.size() - partial}))
+      return false;
+    if (partial)
     {
-      long v = 0;
-      for(size_t i = 0; i < (s.size() + 1) / 2; i++)
+      const int v = from_hex::digit(s.back());
+      if (v < 0)
       {
-        CharT byte_str[3];
-        size_t copied = s.copy(byte_str, 2, 2 * i);
-        byte_str[copied] = CharT(0);
-        CharT* endptr;
-        v = strtoul(byte_str, &endptr, 16);
-        if (v < 0 || 0xFF < v || endptr != byte_str + copied)
-        {
-          return false;
-        }
-        res.push_back(static_cast<unsigned char>(v));
+        res.clear();
+        return false;
       }
-
-      return true;
-    }catch(...)
-    {
-      return false;
+      res.push_back(static_cast<char>(v));
     }
+    return true;
   }
   //----------------------------------------------------------------------------
   template<class t_pod_type>
   bool parse_tpod_from_hex_string(const std::string& str_hash, t_pod_type& t_pod)
   {
     static_assert(std::is_pod<t_pod_type>::value, "expected pod type");
-    std::string buf;
-    bool res = epee::string_tools::parse_hexstr_to_binbuff(str_hash, buf);
-    if (!res || buf.size() != sizeof(t_pod_type))
-    {
+    t_pod_type pod;
+    if (!from_hex::buffer({reinterpret_cast<std::uint8_t*>(&pod), sizeof(pod)}, {str_hash.data(), str_hash.size()}))
       return false;
-    }
-    else
-    {
-      buf.copy(reinterpret_cast<char *>(&t_pod), sizeof(t_pod_type));
-      return true;
-    }
+    t_pod = pod;
+    return true;
   }
   //----------------------------------------------------------------------------
 PUSH_WARNINGS
@@ -50,6 +50,40 @@ namespace epee
         ++out;
       }
     }
+
+    // statically initialized, so it is usable from other static initializers
+    constexpr const std::int8_t from_hex_table[256] = {
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1,
+      -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+    };
+
+    bool read_hex(std::uint8_t* out, const char* src, std::size_t count) noexcept
+    {
+      // OR the digits together, so the loop has no data dependent branch
+      int bad = 0;
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        const int hi = from_hex_table[static_cast<unsigned char>(src[2 * i])];
+        const int lo = from_hex_table[static_cast<unsigned char>(src[2 * i + 1])];
+        bad |= hi | lo;
+        out[i] = static_cast<std::uint8_t>(((hi & 0x0F) << 4) | (lo & 0x0F));
+      }
+      return bad >= 0;
+    }
   }
 
   std::string to_hex::string(const span<const std::uint8_t> src)
@@ -79,4 +113,30 @@ namespace epee
   {
     return write_hex(out, src);
   }
+
+  bool from_hex::string(std::string& out, const span<const char> src)
+  {
+    out.clear();
+    if (src.size() % 2)
+      return false;
+    out.resize(src.size() / 2);
+    if (!read_hex(reinterpret_cast<std::uint8_t*>(std::addressof(out[0])), src.data(), out.size()))
+    {
+      out.clear();
+      return false;
+    }
+    return true;
+  }
+
+  bool from_hex::buffer(span<std::uint8_t> out, const span<const char> src) noexcept
+  {
+    if (src.size() != out.size() * 2)
+      return false;
+    return read_hex(out.data(), src.data(), out.size());
+  }
+
+  int from_hex::digit(const char c) noexcept
+  {
+    return from_hex_table[static_cast<unsigned char>(c)];
+  }
 }
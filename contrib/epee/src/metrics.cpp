@@ -0,0 +1,312 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include "misc_log_ex.h"
+#include "metrics.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "metrics"
+
+// exported histogram buckets end with the buckets holding 4^0 .. 4^EXPORTED_BUCKETS-1
+// in raw units, which covers 1 ns to ~18 minutes for timings and 1 byte to ~275 GB
+// for sizes
+#define EXPORTED_BUCKETS 20
+
+namespace
+{
+  enum metric_type { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM };
+
+  const char *type_name(metric_type type)
+  {
+    switch (type)
+    {
+      case METRIC_COUNTER: return "counter";
+      case METRIC_GAUGE: return "gauge";
+      case METRIC_HISTOGRAM: return "histogram";
+      default: return "untyped";
+    }
+  }
+
+  struct family
+  {
+    metric_type type;
+    std::string help;
+  };
+
+  struct metric
+  {
+    std::unique_ptr<epee::metrics::counter> c;
+    std::unique_ptr<epee::metrics::gauge> g;
+    std::unique_ptr<epee::metrics::histogram> h;
+  };
+
+  struct registry
+  {
+    boost::mutex mutex;
+    std::map<std::string, family> families;
+    // keyed by (family name, labels) so a family's series are contiguous
+    std::map<std::pair<std::string, std::string>, metric> metrics;
+  };
+
+  registry &get_registry()
+  {
+    static registry r;
+    return r;
+  }
+
+  std::pair<std::string, std::string> split_name(const std::string &name)
+  {
+    const size_t brace = name.find('{');
+    if (brace == std::string::npos)
+      return std::make_pair(name, std::string());
+    CHECK_AND_ASSERT_THROW_MES(name.back() == '}', "Invalid metric name: " << name);
+    return std::make_pair(name.substr(0, brace), name.substr(brace + 1, name.size() - brace - 2));
+  }
+
+  metric &get_metric(const std::string &name, const std::string &help, metric_type type, double scale = 1.0)
+  {
+    registry &r = get_registry();
+    const auto key = split_name(name);
+    boost::lock_guard<boost::mutex> lock(r.mutex);
+    auto f = r.families.find(key.first);
+    if (f == r.families.end())
+      f = r.families.insert(std::make_pair(key.first, family{type, help})).first;
+    CHECK_AND_ASSERT_THROW_MES(f->second.type == type, "Metric " << key.first << " is already registered as a " << type_name(f->second.type));
+    if (f->second.help.empty())
+      f->second.help = help;
+    metric &m = r.metrics[key];
+    switch (type)
+    {
+      case METRIC_COUNTER: if (!m.c) m.c.reset(new epee::metrics::counter()); break;
+      case METRIC_GAUGE: if (!m.g) m.g.reset(new epee::metrics::gauge()); break;
+      case METRIC_HISTOGRAM: if (!m.h) m.h.reset(new epee::metrics::histogram(scale)); break;
+    }
+    return m;
+  }
+
+  std::string with_label(const std::string &labels, const std::string &extra)
+  {
+    if (labels.empty())
+      return "{" + extra + "}";
+    return "{" + labels + "," + extra + "}";
+  }
+}
+
+namespace epee
+{
+namespace metrics
+{
+
+histogram::histogram(double scale): m_scale(scale), m_count(0), m_sum(0), m_max(0)
+{
+  for (size_t i = 0; i < N_BUCKETS; ++i)
+    m_buckets[i] = 0;
+}
+
+uint64_t histogram::bucket_lower_bound(size_t idx)
+{
+  if (idx < 2 * SUB_BUCKETS)
+    return idx;
+  const unsigned shift = idx / SUB_BUCKETS - 1;
+  return (uint64_t)(SUB_BUCKETS + idx % SUB_BUCKETS) << shift;
+}
+
+uint64_t histogram::bucket_upper_bound(size_t idx)
+{
+  if (idx < 2 * SUB_BUCKETS)
+    return idx;
+  const unsigned shift = idx / SUB_BUCKETS - 1;
+  return bucket_lower_bound(idx) + (((uint64_t)1 << shift) - 1);
+}
+
+uint64_t histogram::quantile(double q) const
+{
+  const uint64_t total = count();
+  if (total == 0)
+    return 0;
+  uint64_t target = (uint64_t)(q * total + 0.5);
+  if (target == 0)
+    target = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < N_BUCKETS; ++i)
+  {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (seen >= target)
+      return std::min(bucket_upper_bound(i), max());
+  }
+  return max();
+}
+
+uint64_t histogram::count_below(uint64_t v) const
+{
+  const size_t idx = bucket_index(v);
+  uint64_t n = 0;
+  for (size_t i = 0; i < idx; ++i)
+    n += m_buckets[i].load(std::memory_order_relaxed);
+  return n;
+}
+
+uint64_t histogram::count_through(uint64_t v) const
+{
+  return count_below(v) + m_buckets[bucket_index(v)].load(std::memory_order_relaxed);
+}
+
+void histogram::reset()
+{
+  for (size_t i = 0; i < N_BUCKETS; ++i)
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  m_count.store(0, std::memory_order_relaxed);
+  m_sum.store(0, std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+counter &get_counter(const std::string &name, const std::string &help)
+{
+  return *get_metric(name, help, METRIC_COUNTER).c;
+}
+
+gauge &get_gauge(const std::string &name, const std::string &help)
+{
+  return *get_metric(name, help, METRIC_GAUGE).g;
+}
+
+histogram &get_histogram(const std::string &name, const std::string &help, double scale)
+{
+  return *get_metric(name, help, METRIC_HISTOGRAM, scale).h;
+}
+
+std::string to_prometheus()
+{
+  registry &r = get_registry();
+  std::ostringstream ss;
+  boost::lock_guard<boost::mutex> lock(r.mutex);
+  std::string current_family;
+  for (const auto &e: r.metrics)
+  {
+    const std::string &name = e.first.first;
+    const std::string &labels = e.first.second;
+    const family &f = r.families[name];
+    if (name != current_family)
+    {
+      if (!f.help.empty())
+        ss << "# HELP " << name << " " << f.help << "\n";
+      ss << "# TYPE " << name << " " << type_name(f.type) << "\n";
+      current_family = name;
+    }
+    const std::string l = labels.empty() ? std::string() : "{" + labels + "}";
+    switch (f.type)
+    {
+      case METRIC_COUNTER:
+        ss << name << l << " " << e.second.c->get() << "\n";
+        break;
+      case METRIC_GAUGE:
+        ss << name << l << " " << e.second.g->get() << "\n";
+        break;
+      case METRIC_HISTOGRAM:
+      {
+        const histogram &h = *e.second.h;
+        // le is inclusive, so each exported bucket ends where the histogram
+        // bucket holding 4^i does, and counts exactly the values up to there;
+        // record() bumps the bucket before the count, so read the count last
+        // and clamp, or a racing record() could put a bucket above +Inf
+        std::vector<uint64_t> buckets(EXPORTED_BUCKETS);
+        for (unsigned i = 0; i < EXPORTED_BUCKETS; ++i)
+          buckets[i] = h.count_through((uint64_t)1 << (2 * i));
+        const uint64_t count = h.count();
+        for (unsigned i = 0; i < EXPORTED_BUCKETS; ++i)
+        {
+          const uint64_t upper = histogram::bucket_upper_bound(histogram::bucket_index((uint64_t)1 << (2 * i)));
+          std::ostringstream le;
+          le << "le=\"" << upper * h.scale() << "\"";
+          ss << name << "_bucket" << with_label(labels, le.str()) << " " << std::min(buckets[i], count) << "\n";
+        }
+        ss << name << "_bucket" << with_label(labels, "le=\"+Inf\"") << " " << count << "\n";
+        ss << name << "_sum" << l << " " << h.sum() * h.scale() << "\n";
+        ss << name << "_count" << l << " " << count << "\n";
+        break;
+      }
+    }
+  }
+  return ss.str();
+}
+
+std::vector<metric_summary> get_summaries()
+{
+  registry &r = get_registry();
+  std::vector<metric_summary> summaries;
+  boost::lock_guard<boost::mutex> lock(r.mutex);
+  for (const auto &e: r.metrics)
+  {
+    metric_summary s = {};
+    s.name = e.first.second.empty() ? e.first.first : e.first.first + "{" + e.first.second + "}";
+    if (e.second.c)
+    {
+      s.type = type_name(METRIC_COUNTER);
+      s.value = e.second.c->get();
+    }
+    else if (e.second.g)
+    {
+      s.type = type_name(METRIC_GAUGE);
+      s.value = e.second.g->get();
+    }
+    else if (e.second.h)
+    {
+      const histogram &h = *e.second.h;
+      s.type = type_name(METRIC_HISTOGRAM);
+      s.count = h.count();
+      s.value = h.sum() * h.scale();
+      s.p50 = h.quantile(0.5) * h.scale();
+      s.p99 = h.quantile(0.99) * h.scale();
+      s.max = h.max() * h.scale();
+    }
+    summaries.push_back(s);
+  }
+  return summaries;
+}
+
+void reset_all()
+{
+  registry &r = get_registry();
+  boost::lock_guard<boost::mutex> lock(r.mutex);
+  for (auto &e: r.metrics)
+  {
+    if (e.second.c) e.second.c->reset();
+    if (e.second.g) e.second.g->reset();
+    if (e.second.h) e.second.h->reset();
+  }
+}
+
+}
+}
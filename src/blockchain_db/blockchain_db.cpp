@@ -309,6 +309,21 @@ bool BlockchainDB::get_tx(const crypto::hash& h, cryptonote::transaction &tx) co
   return true;
 }
 
+void BlockchainDB::get_tx_blobs(const std::vector<crypto::hash>& hs, std::vector<cryptonote::blobdata> &bds, std::vector<bool> &found) const
+{
+  bds.resize(hs.size());
+  found.resize(hs.size());
+  for (size_t n = 0; n < hs.size(); ++n)
+    found[n] = get_tx_blob(hs[n], bds[n]);
+}
+
+void BlockchainDB::has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool> &spent) const
+{
+  spent.resize(imgs.size());
+  for (size_t n = 0; n < imgs.size(); ++n)
+    spent[n] = has_key_image(imgs[n]);
+}
+
 transaction BlockchainDB::get_tx(const crypto::hash& h) const
 {
   transaction tx;
@@ -1119,6 +1119,19 @@ public:
    */
   virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const = 0;
 
+  /**
+   * @brief fetches the transaction blobs with the given hashes
+   *
+   * Batch version of get_tx_blob().  The default implementation looks the
+   * hashes up one by one; a subclass may reorder the lookups to suit its
+   * storage, but results are always returned in the order of the request.
+   *
+   * @param hs the hashes to look for
+   * @param bds return-by-reference the blob for each hash found
+   * @param found return-by-reference whether each hash was found
+   */
+  virtual void get_tx_blobs(const std::vector<crypto::hash>& hs, std::vector<cryptonote::blobdata> &bds, std::vector<bool> &found) const;
+
   /**
    * @brief fetches the total number of transactions ever
    *
@@ -1302,6 +1315,17 @@ public:
    */
   virtual bool has_key_image(const crypto::key_image& img) const = 0;
 
+  /**
+   * @brief check if several key images are stored as spent
+   *
+   * Batch version of has_key_image(), with the same ordering guarantees
+   * as get_tx_blobs().
+   *
+   * @param imgs the key images to check for
+   * @param spent return-by-reference whether each image is present
+   */
+  virtual void has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool> &spent) const;
+
   /**
    * @brief add a txpool transaction
    *
@@ -33,6 +33,7 @@
 #include <memory>  // std::unique_ptr
 #include <cstring>  // memcpy
 #include <random>
+#include <algorithm>
 
 #include "string_tools.h"
 #include "common/util.h"
@@ -149,6 +150,22 @@ int compare_hash32(const MDB_val *a, const MDB_val *b)
   return 0;
 }
 
+// Indices of 32 byte keys, in the order compare_hash32 stores them, so that
+// a batch of lookups walks the B-tree front to back
+template<typename T>
+std::vector<size_t> hash32_lookup_order(const std::vector<T> &keys)
+{
+  static_assert(sizeof(T) == 32, "hash32_lookup_order needs 32 byte keys");
+  std::vector<size_t> order(keys.size());
+  for (size_t n = 0; n < order.size(); ++n)
+    order[n] = n;
+  std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+    MDB_val va = {sizeof(T), (void *)&keys[a]}, vb = {sizeof(T), (void *)&keys[b]};
+    return compare_hash32(&va, &vb) < 0;
+  });
+  return order;
+}
+
 int compare_string(const MDB_val *a, const MDB_val *b)
 {
   const char *va = (const char*) a->mv_data;
@@ -2181,6 +2198,21 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   return true;
 }
 
+void BlockchainLMDB::get_tx_blobs(const std::vector<crypto::hash>& hs, std::vector<cryptonote::blobdata> &bds, std::vector<bool> &found) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  bds.resize(hs.size());
+  found.resize(hs.size());
+
+  // one read txn for the whole batch, the per hash lookups reuse it
+  TXN_PREFIX_RDONLY();
+  for (size_t n: hash32_lookup_order(hs))
+    found[n] = get_tx_blob(hs[n], bds[n]);
+  TXN_POSTFIX_RDONLY();
+}
+
 uint64_t BlockchainLMDB::get_tx_count() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -2432,6 +2464,25 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   return ret;
 }
 
+void BlockchainLMDB::has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool> &spent) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  spent.resize(imgs.size());
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(spent_keys);
+
+  for (size_t n: hash32_lookup_order(imgs))
+  {
+    MDB_val k = {sizeof(imgs[n]), (void *)&imgs[n]};
+    spent[n] = (mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
+  }
+
+  TXN_POSTFIX_RDONLY();
+}
+
 bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -218,6 +218,7 @@ public:
   virtual uint64_t get_tx_unlock_time(const crypto::hash& h) const;
 
   virtual bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const;
+  virtual void get_tx_blobs(const std::vector<crypto::hash>& hs, std::vector<cryptonote::blobdata> &bds, std::vector<bool> &found) const;
 
   virtual uint64_t get_tx_count() const;
 
@@ -241,6 +242,7 @@ public:
   virtual std::vector<uint64_t> get_tx_amount_output_indices(const uint64_t tx_id) const;
 
   virtual bool has_key_image(const crypto::key_image& img) const;
+  virtual void has_key_images(const std::vector<crypto::key_image>& imgs, std::vector<bool> &spent) const;
 
   virtual void add_txpool_tx(const transaction &tx, const txpool_tx_meta_t& meta);
   virtual void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t& meta);
@@ -26,13 +26,18 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <lmdb.h>
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 #include "common/command_line.h"
 #include "common/varint.h"
-#include "cryptonote_core/tx_pool.h"
+#include "common/util.h"
+#include "string_tools.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_core.h"
-#include "cryptonote_core/blockchain.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/db_types.h"
 #include "wallet/ringdb.h"
@@ -41,6 +46,9 @@
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "bcutil"
 
+#define SCAN_STATE_DIRNAME "scan-state"
+#define SCAN_BATCH_RINGS 10000 // rings a scanning thread gathers before writing them to the scan state
+
 namespace po = boost::program_options;
 using namespace epee;
 using namespace cryptonote;
@@ -66,6 +74,19 @@ namespace std
   };
 }
 
+struct ring_data
+{
+  crypto::key_image key_image;
+  uint64_t amount;
+  std::vector<uint64_t> ring; // absolute offsets
+};
+
+struct scan_progress
+{
+  uint64_t height;
+  crypto::hash top_hash;
+};
+
 static std::string get_default_db_path()
 {
   boost::filesystem::path dir = tools::get_default_data_dir();
@@ -75,71 +96,402 @@ static std::string get_default_db_path()
   return dir.string();
 }
 
-static bool for_all_transactions(const std::string &filename, const std::function<bool(const cryptonote::transaction_prefix&)> &f)
+static std::string ring_to_string(const std::vector<uint64_t> &ring)
+{
+  return boost::join(ring | boost::adaptors::transformed([](uint64_t out){return std::to_string(out);}), " ");
+}
+
+static void throw_on_mdb_error(int dbr, const std::string &msg)
 {
-  MDB_env *env;
-  MDB_dbi dbi;
-  MDB_txn *txn;
-  MDB_cursor *cur;
-  int dbr;
-  bool tx_active = false;
-
-  dbr = mdb_env_create(&env);
-  if (dbr) throw std::runtime_error("Failed to create LDMB environment: " + std::string(mdb_strerror(dbr)));
-  dbr = mdb_env_set_maxdbs(env, 2);
-  if (dbr) throw std::runtime_error("Failed to set max env dbs: " + std::string(mdb_strerror(dbr)));
-  const std::string actual_filename = filename;
-  dbr = mdb_env_open(env, actual_filename.c_str(), 0, 0664);
-  if (dbr) throw std::runtime_error("Failed to open rings database file '"
-      + actual_filename + "': " + std::string(mdb_strerror(dbr)));
-
-  dbr = mdb_txn_begin(env, NULL, 0, &txn);
-  if (dbr) throw std::runtime_error("Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
-  epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([&](){if (tx_active) mdb_txn_abort(txn);});
-  tx_active = true;
-
-  dbr = mdb_dbi_open(txn, "txs_pruned", MDB_INTEGERKEY, &dbi);
   if (dbr)
-    dbr = mdb_dbi_open(txn, "txs", MDB_INTEGERKEY, &dbi);
-  if (dbr) throw std::runtime_error("Failed to open LMDB dbi: " + std::string(mdb_strerror(dbr)));
-  dbr = mdb_cursor_open(txn, dbi, &cur);
-  if (dbr) throw std::runtime_error("Failed to create LMDB cursor: " + std::string(mdb_strerror(dbr)));
+    throw std::runtime_error(msg + ": " + std::string(mdb_strerror(dbr)));
+}
+
+static int resize_env(MDB_env *env, const char *db_path, size_t needed)
+{
+  MDB_envinfo mei;
+  MDB_stat mst;
+  int ret;
+
+  needed = std::max(needed, (size_t)(64ul * 1024 * 1024)); // at least 64 MB
+
+  ret = mdb_env_info(env, &mei);
+  if (ret)
+    return ret;
+  ret = mdb_env_stat(env, &mst);
+  if (ret)
+    return ret;
+  uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+  uint64_t mapsize = mei.me_mapsize;
+  if (size_used + needed > mei.me_mapsize)
+  {
+    try
+    {
+      boost::filesystem::path path(db_path);
+      boost::filesystem::space_info si = boost::filesystem::space(path);
+      if(si.available < needed)
+      {
+        MERROR("!! WARNING: Insufficient free space to extend database !!: " << (si.available >> 20L) << " MB available");
+        return ENOSPC;
+      }
+    }
+    catch(...)
+    {
+      // print something but proceed.
+      MWARNING("Unable to query free disk space.");
+    }
+
+    mapsize += needed;
+  }
+  return mdb_env_set_mapsize(env, mapsize);
+}
+
+class scan_txn
+{
+public:
+  scan_txn(MDB_env *env, bool readonly): active(false)
+  {
+    throw_on_mdb_error(mdb_txn_begin(env, NULL, readonly ? MDB_RDONLY : 0, &txn), "Failed to create LMDB transaction");
+    active = true;
+  }
+  ~scan_txn() { if (active) mdb_txn_abort(txn); }
+  void commit()
+  {
+    active = false;
+    throw_on_mdb_error(mdb_txn_commit(txn), "Failed to commit LMDB transaction");
+  }
+  operator MDB_txn*() { return txn; }
+
+private:
+  MDB_txn *txn;
+  bool active;
+};
+
+// On disk scan state: the rings seen so far, which rings each output is in, outputs known to
+// be spent, and how far each input was scanned. This keeps memory use flat on large chains,
+// and lets a later run carry on from where the previous one stopped.
+class scan_state
+{
+public:
+  scan_state(const std::string &path);
+  ~scan_state();
+
+  bool get_progress(const std::string &input, scan_progress &progress);
+  void set_progress(const std::string &input, const scan_progress &progress);
+  void add_rings(const std::vector<ring_data> &rings, bool index_outputs, std::vector<output_data> &spent, std::vector<output_data> &touched);
+  void find_spent_by_elimination(const output_data &od, std::vector<output_data> &spent);
+
+private:
+  bool is_spent(MDB_txn *txn, const output_data &od);
+  bool set_spent(MDB_txn *txn, const output_data &od);
+  bool get_ring(MDB_txn *txn, const crypto::key_image &key_image, uint64_t &amount, std::vector<uint64_t> &ring);
+  void put_ring(MDB_txn *txn, const crypto::key_image &key_image, uint64_t amount, const std::vector<uint64_t> &ring);
+
+private:
+  std::string path;
+  MDB_env *env;
+  MDB_dbi dbi_rings;
+  MDB_dbi dbi_outputs;
+  MDB_dbi dbi_spent;
+  MDB_dbi dbi_progress;
+};
+
+scan_state::scan_state(const std::string &path): path(path)
+{
+  tools::create_directories_if_necessary(path);
+
+  throw_on_mdb_error(mdb_env_create(&env), "Failed to create LMDB environment");
+  throw_on_mdb_error(mdb_env_set_maxdbs(env, 4), "Failed to set max env dbs");
+  throw_on_mdb_error(mdb_env_open(env, path.c_str(), MDB_NOSYNC, 0664), "Failed to open scan state database '" + path + "'");
+
+  scan_txn txn(env, false);
+  throw_on_mdb_error(mdb_dbi_open(txn, "rings", MDB_CREATE, &dbi_rings), "Failed to open LMDB dbi");
+  throw_on_mdb_error(mdb_dbi_open(txn, "outputs", MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, &dbi_outputs), "Failed to open LMDB dbi");
+  throw_on_mdb_error(mdb_dbi_open(txn, "spent", MDB_CREATE, &dbi_spent), "Failed to open LMDB dbi");
+  throw_on_mdb_error(mdb_dbi_open(txn, "progress", MDB_CREATE, &dbi_progress), "Failed to open LMDB dbi");
+  txn.commit();
+}
+
+scan_state::~scan_state()
+{
+  mdb_env_sync(env, 1);
+  mdb_dbi_close(env, dbi_rings);
+  mdb_dbi_close(env, dbi_outputs);
+  mdb_dbi_close(env, dbi_spent);
+  mdb_dbi_close(env, dbi_progress);
+  mdb_env_close(env);
+}
+
+bool scan_state::get_progress(const std::string &input, scan_progress &progress)
+{
+  scan_txn txn(env, true);
+  MDB_val k = {input.size(), (void*)input.data()}, v;
+  int dbr = mdb_get(txn, dbi_progress, &k, &v);
+  if (dbr == MDB_NOTFOUND)
+    return false;
+  throw_on_mdb_error(dbr, "Failed to read scan progress");
+  if (v.mv_size != sizeof(progress))
+    throw std::runtime_error("Invalid scan progress data");
+  memcpy(&progress, v.mv_data, sizeof(progress));
+  return true;
+}
+
+void scan_state::set_progress(const std::string &input, const scan_progress &progress)
+{
+  throw_on_mdb_error(resize_env(env, path.c_str(), 0), "Failed to set env map size");
+  scan_txn txn(env, false);
+  MDB_val k = {input.size(), (void*)input.data()}, v = {sizeof(progress), (void*)&progress};
+  throw_on_mdb_error(mdb_put(txn, dbi_progress, &k, &v, 0), "Failed to write scan progress");
+  txn.commit();
+}
+
+bool scan_state::is_spent(MDB_txn *txn, const output_data &od)
+{
+  MDB_val k = {sizeof(od), (void*)&od}, v;
+  int dbr = mdb_get(txn, dbi_spent, &k, &v);
+  if (dbr == MDB_NOTFOUND)
+    return false;
+  throw_on_mdb_error(dbr, "Failed to look up spent output");
+  return true;
+}
+
+bool scan_state::set_spent(MDB_txn *txn, const output_data &od)
+{
+  MDB_val k = {sizeof(od), (void*)&od}, v = {0, NULL};
+  int dbr = mdb_put(txn, dbi_spent, &k, &v, MDB_NOOVERWRITE);
+  if (dbr == MDB_KEYEXIST)
+    return false;
+  throw_on_mdb_error(dbr, "Failed to record spent output");
+  return true;
+}
+
+bool scan_state::get_ring(MDB_txn *txn, const crypto::key_image &key_image, uint64_t &amount, std::vector<uint64_t> &ring)
+{
+  MDB_val k = {sizeof(key_image), (void*)&key_image}, v;
+  int dbr = mdb_get(txn, dbi_rings, &k, &v);
+  if (dbr == MDB_NOTFOUND)
+    return false;
+  throw_on_mdb_error(dbr, "Failed to look up ring");
+
+  // amount, then relative offsets, all varints
+  const char *data = (const char*)v.mv_data;
+  std::string::const_iterator i, end;
+  const std::string s(data, v.mv_size);
+  i = s.begin();
+  end = s.end();
+  std::vector<uint64_t> relative;
+  bool first = true;
+  while (i != end)
+  {
+    uint64_t value;
+    const int read = tools::read_varint<std::numeric_limits<uint64_t>::digits>(i, end, value);
+    if (read <= 0)
+      throw std::runtime_error("Invalid ring data for key image " + epee::string_tools::pod_to_hex(key_image));
+    if (first)
+      amount = value;
+    else
+      relative.push_back(value);
+    first = false;
+  }
+  ring = cryptonote::relative_output_offsets_to_absolute(relative);
+  return true;
+}
+
+void scan_state::put_ring(MDB_txn *txn, const crypto::key_image &key_image, uint64_t amount, const std::vector<uint64_t> &ring)
+{
+  std::string s = tools::get_varint_data(amount);
+  for (uint64_t out: cryptonote::absolute_output_offsets_to_relative(ring))
+    s += tools::get_varint_data(out);
+  MDB_val k = {sizeof(key_image), (void*)&key_image}, v = {s.size(), (void*)s.data()};
+  throw_on_mdb_error(mdb_put(txn, dbi_rings, &k, &v, 0), "Failed to store ring");
+}
+
+void scan_state::add_rings(const std::vector<ring_data> &rings, bool index_outputs, std::vector<output_data> &spent, std::vector<output_data> &touched)
+{
+  size_t needed = 0;
+  for (const ring_data &rd: rings)
+    needed += 64 + rd.ring.size() * (index_outputs ? 64 : 8);
+  throw_on_mdb_error(resize_env(env, path.c_str(), needed), "Failed to set env map size");
+
+  scan_txn txn(env, false);
+  for (const ring_data &rd: rings)
+  {
+    uint64_t amount;
+    std::vector<uint64_t> ring, stored;
+    const bool seen = get_ring(txn, rd.key_image, amount, stored);
+    if (seen)
+    {
+      if (stored == rd.ring)
+        continue;
+      MINFO("Key image " << rd.key_image << " already seen: rings " << ring_to_string(stored) << ", " << ring_to_string(rd.ring));
+      for (uint64_t out: stored)
+        if (std::find(rd.ring.begin(), rd.ring.end(), out) != rd.ring.end())
+          ring.push_back(out);
+      if (ring.empty())
+      {
+        MERROR("Rings for the same key image are disjoint");
+        continue;
+      }
+      if (ring.size() == stored.size())
+        continue;
+      if (ring.size() > 1)
+        MINFO("The intersection has more than one element, it's still ok");
+    }
+    else
+    {
+      ring = rd.ring;
+    }
+    put_ring(txn, rd.key_image, rd.amount, ring);
+
+    if (index_outputs && !seen)
+    {
+      for (uint64_t out: ring)
+      {
+        const output_data od(rd.amount, out);
+        MDB_val k = {sizeof(od), (void*)&od}, v = {sizeof(rd.key_image), (void*)&rd.key_image};
+        int dbr = mdb_put(txn, dbi_outputs, &k, &v, MDB_NODUPDATA);
+        if (dbr != MDB_KEYEXIST)
+          throw_on_mdb_error(dbr, "Failed to index output");
+      }
+    }
 
-  MDB_val k;
-  MDB_val v;
-  bool fret = true;
+    if (ring.size() == 1)
+    {
+      const output_data od(rd.amount, ring[0]);
+      MINFO("Output " << od.amount << "/" << od.index << " is spent, due to being used in " << (seen ? "rings with a single common element" : "a 1-ring"));
+      if (set_spent(txn, od))
+        spent.push_back(od);
+    }
+    else
+    {
+      // rings referencing already spent outputs need looking at again
+      for (uint64_t out: ring)
+      {
+        const output_data od(rd.amount, out);
+        if (is_spent(txn, od))
+          touched.push_back(od);
+      }
+    }
+  }
+  txn.commit();
+}
 
-  MDB_cursor_op op = MDB_FIRST;
+void scan_state::find_spent_by_elimination(const output_data &od, std::vector<output_data> &spent)
+{
+  throw_on_mdb_error(resize_env(env, path.c_str(), 0), "Failed to set env map size");
+
+  scan_txn txn(env, false);
+  std::vector<crypto::key_image> key_images;
+  MDB_cursor *cur;
+  throw_on_mdb_error(mdb_cursor_open(txn, dbi_outputs, &cur), "Failed to create LMDB cursor");
+  MDB_val k = {sizeof(od), (void*)&od}, v;
+  MDB_cursor_op op = MDB_SET_KEY;
   while (1)
   {
-    int ret = mdb_cursor_get(cur, &k, &v, op);
-    op = MDB_NEXT;
-    if (ret == MDB_NOTFOUND)
-      break;
-    if (ret)
-      throw std::runtime_error("Failed to enumerate transactions: " + std::string(mdb_strerror(ret)));
-
-    cryptonote::transaction_prefix tx;
-    blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
-    std::stringstream ss;
-    ss << bd;
-    binary_archive<false> ba(ss);
-    bool r = do_serialize(ba, tx);
-    CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
-
-    if (!f(tx)) {
-      fret = false;
+    int dbr = mdb_cursor_get(cur, &k, &v, op);
+    op = MDB_NEXT_DUP;
+    if (dbr == MDB_NOTFOUND)
       break;
+    if (dbr)
+    {
+      mdb_cursor_close(cur);
+      throw_on_mdb_error(dbr, "Failed to enumerate key images for output");
     }
+    key_images.push_back(*(const crypto::key_image*)v.mv_data);
   }
-
   mdb_cursor_close(cur);
-  mdb_txn_commit(txn);
-  tx_active = false;
-  mdb_dbi_close(env, dbi);
-  mdb_env_close(env);
-  return fret;
+
+  for (const crypto::key_image &ki: key_images)
+  {
+    uint64_t amount;
+    std::vector<uint64_t> absolute;
+    if (!get_ring(txn, ki, amount, absolute))
+      continue;
+    size_t known = 0;
+    uint64_t last_unknown = 0;
+    for (uint64_t out: absolute)
+    {
+      if (is_spent(txn, output_data(od.amount, out)))
+        ++known;
+      else
+        last_unknown = out;
+    }
+    if (known == absolute.size() - 1)
+    {
+      const output_data new_od(od.amount, last_unknown);
+      if (set_spent(txn, new_od))
+      {
+        MINFO("Output " << new_od.amount << "/" << new_od.index << " is spent, due to being used in a " <<
+            absolute.size() << "-ring where all other outputs are known to be spent");
+        spent.push_back(new_od);
+      }
+    }
+  }
+  txn.commit();
+}
+
+static bool parse_tx_prefix(const cryptonote::blobdata &bd, cryptonote::transaction_prefix &tx)
+{
+  std::stringstream ss;
+  ss << bd;
+  binary_archive<false> ba(ss);
+  return do_serialize(ba, tx);
+}
+
+static void scan_range(BlockchainDB &db, uint64_t start_height, uint64_t end_height, bool rct_only, const std::function<void(std::vector<ring_data>&)> &flush)
+{
+  std::vector<ring_data> rings;
+  for (uint64_t height = start_height; height < end_height; ++height)
+  {
+    const cryptonote::block b = db.get_block_from_height(height);
+    for (const crypto::hash &txid: b.tx_hashes)
+    {
+      cryptonote::blobdata bd;
+      if (!db.get_tx_blob(txid, bd))
+        throw std::runtime_error("Transaction " + epee::string_tools::pod_to_hex(txid) + " not found");
+      cryptonote::transaction_prefix tx;
+      if (!parse_tx_prefix(bd, tx))
+        throw std::runtime_error("Failed to parse transaction " + epee::string_tools::pod_to_hex(txid));
+
+      for (const auto &in: tx.vin)
+      {
+        if (in.type() != typeid(txin_to_key))
+          continue;
+        const auto &txin = boost::get<txin_to_key>(in);
+        if (rct_only && txin.amount != 0)
+          continue;
+        rings.push_back({txin.k_image, txin.amount, cryptonote::relative_output_offsets_to_absolute(txin.key_offsets)});
+      }
+    }
+    if (rings.size() >= SCAN_BATCH_RINGS)
+    {
+      flush(rings);
+      rings.clear();
+    }
+  }
+  flush(rings);
+}
+
+// the first height at which the two chains differ
+static uint64_t get_fork_height(BlockchainDB &db0, BlockchainDB &db1)
+{
+  uint64_t lo = 0, hi = std::min(db0.height(), db1.height());
+  while (lo < hi)
+  {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if (db0.get_block_hash_from_height(mid) == db1.get_block_hash_from_height(mid))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void blackball(tools::ringdb &ringdb, BlockchainDB &db, const output_data &od)
+{
+  const crypto::public_key pkey = db.get_output_key(od.amount, od.index).pubkey;
+  MINFO("Blackballing output " << pkey);
+  ringdb.blackball(pkey);
 }
 
 int main(int argc, char* argv[])
@@ -178,6 +530,7 @@ int main(int argc, char* argv[])
     "database", available_dbs.c_str(), default_db_type
   };
   const command_line::arg_descriptor<bool> arg_rct_only  = {"rct-only", "Only work on ringCT outputs", false};
+  const command_line::arg_descriptor<unsigned> arg_threads  = {"threads", "Number of threads to scan each blockchain with (0 = number of CPUs)", 0};
   const command_line::arg_descriptor<std::vector<std::string> > arg_inputs = {"inputs", "Path to Monero DB, and path to any fork DBs"};
 
   command_line::add_arg(desc_cmd_sett, arg_blackball_db_dir);
@@ -186,6 +539,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_log_level);
   command_line::add_arg(desc_cmd_sett, arg_database);
   command_line::add_arg(desc_cmd_sett, arg_rct_only);
+  command_line::add_arg(desc_cmd_sett, arg_threads);
   command_line::add_arg(desc_cmd_sett, arg_inputs);
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
@@ -221,11 +575,11 @@ int main(int argc, char* argv[])
 
   LOG_PRINT_L0("Starting...");
 
-  bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
-  bool opt_stagenet = command_line::get_arg(vm, cryptonote::arg_stagenet_on);
-  network_type net_type = opt_testnet ? TESTNET : opt_stagenet ? STAGENET : MAINNET;
   output_file_path = command_line::get_arg(vm, arg_blackball_db_dir);
   bool opt_rct_only = command_line::get_arg(vm, arg_rct_only);
+  unsigned threads = command_line::get_arg(vm, arg_threads);
+  if (threads == 0)
+    threads = std::max(1u, tools::get_max_concurrency());
 
   std::string db_type = command_line::get_arg(vm, arg_database);
   if (!cryptonote::blockchain_valid_db_type(db_type))
@@ -234,17 +588,8 @@ int main(int argc, char* argv[])
     return 1;
   }
 
-  // If we wanted to use the memory pool, we would set up a fake_core.
-
-  // Use Blockchain instead of lower-level BlockchainDB for two reasons:
-  // 1. Blockchain has the init() method for easy setup
-  // 2. exporter needs to use get_current_blockchain_height(), get_block_id_by_height(), get_block_by_hash()
-  //
-  // cannot match blockchain_storage setup above with just one line,
-  // e.g.
-  //   Blockchain* core_storage = new Blockchain(NULL);
-  // because unlike blockchain_storage constructor, which takes a pointer to
-  // tx_memory_pool, Blockchain's constructor takes tx_memory_pool object.
+  // Only read access to the chains is needed, so BlockchainDB is used directly,
+  // without setting up a Blockchain and tx pool around each of them
   LOG_PRINT_L0("Initializing source blockchain (BlockchainDB)");
   const std::vector<std::string> inputs = command_line::get_arg(vm, arg_inputs);
   if (inputs.empty())
@@ -252,15 +597,12 @@ int main(int argc, char* argv[])
     LOG_PRINT_L0("No inputs given");
     return 1;
   }
-  std::vector<std::unique_ptr<Blockchain>> core_storage(inputs.size());
-  Blockchain *blockchain = NULL;
-  tx_memory_pool m_mempool(*blockchain);
+  std::vector<std::unique_ptr<BlockchainDB>> dbs(inputs.size());
+  std::vector<std::string> filenames(inputs.size());
   for (size_t n = 0; n < inputs.size(); ++n)
   {
-    core_storage[n].reset(new Blockchain(m_mempool));
-
-    BlockchainDB* db = new_db(db_type);
-    if (db == NULL)
+    dbs[n].reset(new_db(db_type));
+    if (!dbs[n])
     {
       LOG_ERROR("Attempted to use non-existent database type: " << db_type);
       throw std::runtime_error("Attempting to use non-existent database type");
@@ -274,16 +616,14 @@ int main(int argc, char* argv[])
 
     try
     {
-      db->open(filename, DBF_RDONLY);
+      dbs[n]->open(filename, DBF_RDONLY);
     }
     catch (const std::exception& e)
     {
       LOG_PRINT_L0("Error opening database: " << e.what());
       return 1;
     }
-    r = core_storage[n]->init(db, net_type);
-
-    CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize source blockchain storage");
+    filenames[n] = boost::filesystem::absolute(filename).string();
     LOG_PRINT_L0("Source blockchain storage initialized OK");
   }
 
@@ -307,116 +647,97 @@ int main(int argc, char* argv[])
 
   LOG_PRINT_L0("Scanning for blackballable outputs...");
 
-  size_t done = 0;
-  std::unordered_map<crypto::key_image, std::vector<uint64_t>> relative_rings;
-  std::unordered_map<output_data, std::unordered_set<crypto::key_image>> outputs;
-  std::unordered_set<output_data> spent, newly_spent;
+  const crypto::hash genesis = dbs[0]->get_block_hash_from_height(0);
+  tools::ringdb ringdb(output_file_path.string(), epee::string_tools::pod_to_hex(genesis));
+  scan_state state((direc / SCAN_STATE_DIRNAME / epee::string_tools::pod_to_hex(genesis)).string());
 
-  cryptonote::block b = core_storage[0]->get_db().get_block_from_height(0);
-  tools::ringdb ringdb(output_file_path.string(), epee::string_tools::pod_to_hex(get_block_hash(b)));
+  boost::mutex state_lock;
+  std::unordered_set<output_data> work;
 
   for (size_t n = 0; n < inputs.size(); ++n)
   {
-    LOG_PRINT_L0("Reading blockchain from " << inputs[n]);
-    for_all_transactions(inputs[n], [&](const cryptonote::transaction_prefix &tx)->bool
+    BlockchainDB &db = *dbs[n];
+    const uint64_t db_height = db.height();
+
+    // history shared with the main chain was covered when scanning it
+    uint64_t start_height = n == 0 ? 0 : get_fork_height(*dbs[0], db);
+    scan_progress progress;
+    if (state.get_progress(filenames[n], progress))
     {
-      for (const auto &in: tx.vin)
-      {
-        if (in.type() != typeid(txin_to_key))
-          continue;
-        const auto &txin = boost::get<txin_to_key>(in);
-        if (opt_rct_only && txin.amount != 0)
-          continue;
+      if (progress.height > 0 && progress.height <= db_height && db.get_block_hash_from_height(progress.height - 1) == progress.top_hash)
+        start_height = std::max(start_height, progress.height);
+      else
+        MWARNING("Blockchain " << inputs[n] << " changed since the last scan, rescanning it");
+    }
+    if (start_height >= db_height)
+    {
+      LOG_PRINT_L0("Blockchain " << inputs[n] << " is already scanned up to height " << db_height);
+      continue;
+    }
 
-        const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
-        if (n == 0)
-          for (uint64_t out: absolute)
-            outputs[output_data(txin.amount, out)].insert(txin.k_image);
+    const uint64_t nthreads = std::min<uint64_t>(threads, db_height - start_height);
+    const uint64_t range = (db_height - start_height + nthreads - 1) / nthreads;
+    LOG_PRINT_L0("Reading blockchain from " << inputs[n] << ", heights " << start_height << " to " << db_height - 1 << " on " << nthreads << " threads");
 
-        std::vector<uint64_t> new_ring = txin.key_offsets;
-        const uint32_t ring_size = txin.key_offsets.size();
-        if (ring_size == 1)
+    std::string error;
+    auto flush = [&](std::vector<ring_data> &rings)
+    {
+      boost::unique_lock<boost::mutex> lock(state_lock);
+      std::vector<output_data> spent, touched;
+      state.add_rings(rings, n == 0, spent, touched);
+      for (const output_data &od: spent)
+      {
+        blackball(ringdb, db, od);
+        work.insert(od);
+      }
+      work.insert(touched.begin(), touched.end());
+    };
+    std::vector<boost::thread> scanners;
+    for (uint64_t t = 0; t < nthreads; ++t)
+    {
+      const uint64_t range_start = start_height + t * range;
+      const uint64_t range_end = std::min(range_start + range, db_height);
+      if (range_start >= range_end)
+        break;
+      scanners.emplace_back([&, range_start, range_end]()
+      {
+        try
         {
-          const crypto::public_key pkey = core_storage[n]->get_output_key(txin.amount, txin.key_offsets[0]);
-          MINFO("Blackballing output " << pkey << ", due to being used in a 1-ring");
-          ringdb.blackball(pkey);
-          newly_spent.insert(output_data(txin.amount, txin.key_offsets[0]));
-          spent.insert(output_data(txin.amount, txin.key_offsets[0]));
+          scan_range(db, range_start, range_end, opt_rct_only, flush);
+          MINFO("Scanned heights " << range_start << " to " << range_end - 1 << " of " << inputs[n]);
         }
-        else if (relative_rings.find(txin.k_image) != relative_rings.end())
+        catch (const std::exception &e)
         {
-          MINFO("Key image " << txin.k_image << " already seen: rings " <<
-              boost::join(relative_rings[txin.k_image] | boost::adaptors::transformed([](uint64_t out){return std::to_string(out);}), " ") <<
-              ", " << boost::join(txin.key_offsets | boost::adaptors::transformed([](uint64_t out){return std::to_string(out);}), " "));
-          if (relative_rings[txin.k_image] != txin.key_offsets)
-          {
-            MINFO("Rings are different");
-            const std::vector<uint64_t> r0 = cryptonote::relative_output_offsets_to_absolute(relative_rings[txin.k_image]);
-            const std::vector<uint64_t> r1 = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
-            std::vector<uint64_t> common;
-            for (uint64_t out: r0)
-            {
-              if (std::find(r1.begin(), r1.end(), out) != r1.end())
-                common.push_back(out);
-            }
-            if (common.empty())
-            {
-              MERROR("Rings for the same key image are disjoint");
-            }
-            else if (common.size() == 1)
-            {
-              const crypto::public_key pkey = core_storage[n]->get_output_key(txin.amount, common[0]);
-              MINFO("Blackballing output " << pkey << ", due to being used in rings with a single common element");
-              ringdb.blackball(pkey);
-              newly_spent.insert(output_data(txin.amount, common[0]));
-              spent.insert(output_data(txin.amount, common[0]));
-            }
-            else
-            {
-              MINFO("The intersection has more than one element, it's still ok");
-              for (const auto &out: r0)
-                if (std::find(common.begin(), common.end(), out) != common.end())
-                  new_ring.push_back(out);
-              new_ring = cryptonote::absolute_output_offsets_to_relative(new_ring);
-            }
-          }
+          boost::unique_lock<boost::mutex> lock(state_lock);
+          error = e.what();
         }
-        relative_rings[txin.k_image] = new_ring;
-      }
-      return true;
-    });
+      });
+    }
+    for (boost::thread &scanner: scanners)
+      scanner.join();
+    if (!error.empty())
+    {
+      MERROR("Error scanning " << inputs[n] << ": " << error);
+      return 1;
+    }
+
+    state.set_progress(filenames[n], {db_height, db.get_block_hash_from_height(db_height - 1)});
   }
 
-  while (!newly_spent.empty())
+  while (!work.empty())
   {
-    LOG_PRINT_L0("Secondary pass due to " << newly_spent.size() << " newly found spent outputs");
-    std::unordered_set<output_data> work_spent = std::move(newly_spent);
-    newly_spent.clear();
+    LOG_PRINT_L0("Secondary pass due to " << work.size() << " newly found spent outputs");
+    std::unordered_set<output_data> work_spent = std::move(work);
+    work.clear();
 
     for (const output_data &od: work_spent)
     {
-      for (const crypto::key_image &ki: outputs[od])
+      std::vector<output_data> spent;
+      state.find_spent_by_elimination(od, spent);
+      for (const output_data &new_od: spent)
       {
-        std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(relative_rings[ki]);
-        size_t known = 0;
-        uint64_t last_unknown = 0;
-        for (uint64_t out: absolute)
-        {
-          output_data new_od(od.amount, out);
-          if (spent.find(new_od) != spent.end())
-            ++known;
-          else
-            last_unknown = out;
-        }
-        if (known == absolute.size() - 1)
-        {
-          const crypto::public_key pkey = core_storage[0]->get_output_key(od.amount, last_unknown);
-          MINFO("Blackballing output " << pkey << ", due to being used in a " <<
-              absolute.size() << "-ring where all other outputs are known to be spent");
-          ringdb.blackball(pkey);
-          newly_spent.insert(output_data(od.amount, last_unknown));
-          spent.insert(output_data(od.amount, last_unknown));
-        }
+        blackball(ringdb, *dbs[0], new_od);
+        work.insert(new_od);
       }
     }
   }
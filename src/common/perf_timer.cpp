@@ -27,6 +27,8 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include "misc_os_dependent.h"
 #include "perf_timer.h"
 
@@ -85,6 +87,9 @@ el::Level performance_timer_log_level = el::Level::Debug;
 
 static __thread std::vector<PerformanceTimer*> *performance_timers = NULL;
 
+static boost::mutex performance_timer_histograms_mutex;
+static std::map<std::string, epee::metrics::histogram*> performance_timer_histograms;
+
 void set_performance_timer_log_level(el::Level level)
 {
   if (level != el::Level::Debug && level != el::Level::Trace && level != el::Level::Info
@@ -96,7 +101,37 @@ void set_performance_timer_log_level(el::Level level)
   performance_timer_log_level = level;
 }
 
-PerformanceTimer::PerformanceTimer(const std::string &s, uint64_t unit, el::Level l): name(s), unit(unit), level(l), started(false), paused(false)
+epee::metrics::histogram &get_performance_timer_histogram(const std::string &name)
+{
+  epee::metrics::histogram &h = epee::metrics::get_histogram("perf_timer_seconds{timer=\"" + name + "\"}", "Time spent in PERF_TIMER sites", 1e-9);
+  boost::lock_guard<boost::mutex> lock(performance_timer_histograms_mutex);
+  performance_timer_histograms[name] = &h;
+  return h;
+}
+
+std::map<std::string, performance_timer_stats> get_performance_timer_stats()
+{
+  std::map<std::string, performance_timer_stats> stats;
+  boost::lock_guard<boost::mutex> lock(performance_timer_histograms_mutex);
+  for (const auto &e: performance_timer_histograms)
+  {
+    if (e.second->count() == 0)
+      continue;
+    performance_timer_stats &s = stats[e.first];
+    s.count = e.second->count();
+    s.ns = e.second->sum();
+  }
+  return stats;
+}
+
+void reset_performance_timer_stats()
+{
+  boost::lock_guard<boost::mutex> lock(performance_timer_histograms_mutex);
+  for (auto &e: performance_timer_histograms)
+    e.second->reset();
+}
+
+PerformanceTimer::PerformanceTimer(const std::string &s, uint64_t unit, el::Level l, epee::metrics::histogram *histogram): name(s), unit(unit), level(l), started(false), paused(false), histogram(histogram)
 {
   ticks = get_tick_count();
   if (!performance_timers)
@@ -126,6 +161,8 @@ PerformanceTimer::~PerformanceTimer()
   snprintf(s, sizeof(s), "%8llu  ", (unsigned long long)(ticks_to_ns(ticks) / (1000000000 / unit)));
   size_t size = 0; for (const auto *tmp: *performance_timers) if (!tmp->paused || tmp==this) ++size;
   MLOG(level, "PERF " << s << std::string(size * 2, ' ') << "  " << name);
+  if (histogram)
+    histogram->record(ticks_to_ns(ticks));
   if (performance_timers->empty())
   {
     delete performance_timers;
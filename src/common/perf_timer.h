@@ -28,10 +28,12 @@
 
 #pragma once
 
+#include <map>
 #include <string>
 #include <stdio.h>
 #include <memory>
 #include "misc_log_ex.h"
+#include "metrics.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "perf"
@@ -46,7 +48,7 @@ extern el::Level performance_timer_log_level;
 class PerformanceTimer
 {
 public:
-  PerformanceTimer(const std::string &s, uint64_t unit, el::Level l = el::Level::Debug);
+  PerformanceTimer(const std::string &s, uint64_t unit, el::Level l = el::Level::Debug, epee::metrics::histogram *histogram = NULL);
   ~PerformanceTimer();
   void pause();
   void resume();
@@ -58,15 +60,29 @@ private:
   uint64_t ticks;
   bool started;
   bool paused;
+  epee::metrics::histogram *histogram;
 };
 
 void set_performance_timer_log_level(el::Level level);
 
-#define PERF_TIMER_UNIT(name, unit) tools::PerformanceTimer pt_##name(#name, unit, tools::performance_timer_log_level)
-#define PERF_TIMER_UNIT_L(name, unit, l) tools::PerformanceTimer pt_##name(#name, unit, l)
+// every timer site feeds the perf_timer_seconds{timer="<name>"} histogram in the metrics registry
+epee::metrics::histogram &get_performance_timer_histogram(const std::string &name);
+
+// totals per timer name since start or the last reset
+struct performance_timer_stats
+{
+  uint64_t count;
+  uint64_t ns;
+};
+std::map<std::string, performance_timer_stats> get_performance_timer_stats();
+void reset_performance_timer_stats();
+
+#define PERF_TIMER_HISTOGRAM(name) static epee::metrics::histogram &pt_##name##_histogram = tools::get_performance_timer_histogram(#name)
+#define PERF_TIMER_UNIT(name, unit) PERF_TIMER_HISTOGRAM(name); tools::PerformanceTimer pt_##name(#name, unit, tools::performance_timer_log_level, &pt_##name##_histogram)
+#define PERF_TIMER_UNIT_L(name, unit, l) PERF_TIMER_HISTOGRAM(name); tools::PerformanceTimer pt_##name(#name, unit, l, &pt_##name##_histogram)
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000)
 #define PERF_TIMER_L(name, l) PERF_TIMER_UNIT_L(name, 1000, l)
-#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::PerformanceTimer> pt_##name(new tools::PerformanceTimer(#name, unit, el::Level::Info))
+#define PERF_TIMER_START_UNIT(name, unit) PERF_TIMER_HISTOGRAM(name); std::unique_ptr<tools::PerformanceTimer> pt_##name(new tools::PerformanceTimer(#name, unit, el::Level::Info, &pt_##name##_histogram))
 #define PERF_TIMER_START(name) PERF_TIMER_START_UNIT(name, 1000)
 #define PERF_TIMER_STOP(name) do { pt_##name.reset(NULL); } while(0)
 #define PERF_TIMER_PAUSE(name) pt_##name->pause()
@@ -0,0 +1,235 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace tools
+{
+  /**
+   * @brief a window over the last N values pushed into it
+   *
+   * Values can be read in the order they were pushed, or by rank. Ranks come
+   * from an order statistic tree (a treap keyed on the value, then on push
+   * order) over the same nodes as the ring buffer, so a push (which evicts
+   * the oldest value once full) and a rank lookup are both O(log N). Nodes
+   * are kept in a flat array, so copying a window, eg to follow a fork of
+   * a chain, is a plain array copy.
+   */
+  template<typename T>
+  class rolling_window
+  {
+  public:
+    rolling_window(size_t capacity = 0): m_capacity(capacity), m_head(0), m_root(NIL), m_seq(0) {}
+
+    size_t capacity() const { return m_capacity; }
+    size_t size() const { return m_nodes.size(); }
+    bool empty() const { return m_nodes.empty(); }
+    bool full() const { return m_nodes.size() == m_capacity; }
+
+    void clear()
+    {
+      m_nodes.clear();
+      m_head = 0;
+      m_root = NIL;
+    }
+
+    void push_back(const T &value)
+    {
+      if (m_capacity == 0)
+        return;
+      uint32_t n;
+      if (full())
+      {
+        n = m_head;
+        m_root = erase(m_root, n);
+        m_head = (m_head + 1) % m_capacity;
+      }
+      else
+      {
+        n = m_nodes.size();
+        m_nodes.push_back(node());
+      }
+      node &nd = m_nodes[n];
+      nd.value = value;
+      nd.seq = m_seq++;
+      nd.priority = mix(nd.seq);
+      nd.left = nd.right = NIL;
+      nd.count = 1;
+      m_root = insert(m_root, n);
+    }
+
+    // i-th value in push order, 0 being the oldest
+    const T &operator[](size_t i) const { return m_nodes[full() ? (m_head + i) % m_capacity : i].value; }
+    const T &front() const { return (*this)[0]; }
+    const T &back() const { return (*this)[size() - 1]; }
+
+    // k-th smallest value, 0 being the smallest
+    const T &nth(size_t k) const
+    {
+      uint32_t t = m_root;
+      while (1)
+      {
+        const size_t left_count = count(m_nodes[t].left);
+        if (k < left_count)
+          t = m_nodes[t].left;
+        else if (k == left_count)
+          return m_nodes[t].value;
+        else
+        {
+          k -= left_count + 1;
+          t = m_nodes[t].right;
+        }
+      }
+    }
+
+    // same semantics as epee::misc_utils::median
+    T median() const
+    {
+      const size_t n = size();
+      if (n == 0)
+        return T();
+      if (n % 2)
+        return nth(n / 2);
+      return (nth(n / 2 - 1) + nth(n / 2)) / 2;
+    }
+
+  private:
+    static const uint32_t NIL = (uint32_t)-1;
+
+    struct node
+    {
+      T value;
+      uint64_t seq;
+      uint32_t priority;
+      uint32_t left;
+      uint32_t right;
+      uint32_t count;
+    };
+
+    // priorities only need to look random, and being derived from the push
+    // order keeps copies of a window in step with each other
+    static uint32_t mix(uint64_t x)
+    {
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+      return (uint32_t)(x ^ (x >> 31));
+    }
+
+    uint32_t count(uint32_t t) const { return t == NIL ? 0 : m_nodes[t].count; }
+    void update(uint32_t t) { m_nodes[t].count = 1 + count(m_nodes[t].left) + count(m_nodes[t].right); }
+
+    bool less(uint32_t a, uint32_t b) const
+    {
+      const node &na = m_nodes[a], &nb = m_nodes[b];
+      if (na.value < nb.value)
+        return true;
+      if (nb.value < na.value)
+        return false;
+      return na.seq < nb.seq;
+    }
+
+    // all of the subtree at t lower than n goes to l, the rest to r
+    void split(uint32_t t, uint32_t n, uint32_t &l, uint32_t &r)
+    {
+      if (t == NIL)
+      {
+        l = r = NIL;
+        return;
+      }
+      if (less(t, n))
+      {
+        split(m_nodes[t].right, n, m_nodes[t].right, r);
+        l = t;
+      }
+      else
+      {
+        split(m_nodes[t].left, n, l, m_nodes[t].left);
+        r = t;
+      }
+      update(t);
+    }
+
+    // all of l must be lower than all of r
+    uint32_t merge(uint32_t l, uint32_t r)
+    {
+      if (l == NIL)
+        return r;
+      if (r == NIL)
+        return l;
+      if (m_nodes[l].priority > m_nodes[r].priority)
+      {
+        m_nodes[l].right = merge(m_nodes[l].right, r);
+        update(l);
+        return l;
+      }
+      m_nodes[r].left = merge(l, m_nodes[r].left);
+      update(r);
+      return r;
+    }
+
+    uint32_t insert(uint32_t t, uint32_t n)
+    {
+      if (t == NIL)
+        return n;
+      if (m_nodes[n].priority > m_nodes[t].priority)
+      {
+        split(t, n, m_nodes[n].left, m_nodes[n].right);
+        update(n);
+        return n;
+      }
+      if (less(n, t))
+        m_nodes[t].left = insert(m_nodes[t].left, n);
+      else
+        m_nodes[t].right = insert(m_nodes[t].right, n);
+      update(t);
+      return t;
+    }
+
+    uint32_t erase(uint32_t t, uint32_t n)
+    {
+      if (t == n)
+        return merge(m_nodes[t].left, m_nodes[t].right);
+      if (less(n, t))
+        m_nodes[t].left = erase(m_nodes[t].left, n);
+      else
+        m_nodes[t].right = erase(m_nodes[t].right, n);
+      update(t);
+      return t;
+    }
+
+  private:
+    size_t m_capacity;
+    size_t m_head; // slot of the oldest value once full
+    uint32_t m_root;
+    uint64_t m_seq;
+    std::vector<node> m_nodes;
+  };
+}
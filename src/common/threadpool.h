@@ -31,6 +31,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <cstddef>
+#include <exception>
 #include <functional>
 #include <utility>
 #include <vector>
@@ -66,6 +67,24 @@ public:
   // task to finish.
   void submit(waiter *waiter, std::function<void()> f);
 
+  // Run f(0) to f(n-1) as tasks and wait for all of them.
+  // If any of them throws, the first exception (by index)
+  // is rethrown once they are all done.
+  template<typename F>
+  void parallel_for(size_t n, const F &f) {
+    std::vector<std::exception_ptr> errors(n);
+    waiter waiter;
+    for (size_t i = 0; i < n; ++i)
+      submit(&waiter, [&f, &errors, i]() {
+        try { f(i); }
+        catch (...) { errors[i] = std::current_exception(); }
+      });
+    waiter.wait();
+    for (const std::exception_ptr &e: errors)
+      if (e)
+        std::rethrow_exception(e);
+  }
+
   int get_max_concurrency();
 
   private:
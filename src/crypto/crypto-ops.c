@@ -1194,16 +1194,23 @@ B is the Ed25519 base point (x,4/5) with x positive.
 */
 
 void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+
+  ge_dsm_precomp(Ai, A);
+  ge_double_scalarmult_base_precomp_vartime(r, a, Ai, b);
+}
+
+/* As ge_double_scalarmult_base_vartime, with A given as the output of ge_dsm_precomp */
+
+void ge_double_scalarmult_base_precomp_vartime(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b) {
   signed char aslide[256];
   signed char bslide[256];
-  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
   ge_p1p1 t;
   ge_p3 u;
   int i;
 
   slide(aslide, a);
   slide(bslide, b);
-  ge_dsm_precomp(Ai, A);
 
   ge_p2_0(r);
 
@@ -1663,6 +1670,41 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+/*
+Serializes n points with a single field inversion, using Montgomery's trick
+to get every 1/Z from the inverse of their product. tmp must have room for n
+field elements, and s for 32 * n bytes.
+*/
+
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, fe *tmp, uint32_t n) {
+  fe acc;
+  fe recip;
+  fe x;
+  fe y;
+  uint32_t i;
+
+  if (n == 0) {
+    return;
+  }
+  fe_copy(tmp[0], h[0].Z);
+  for (i = 1; i < n; ++i) {
+    fe_mul(tmp[i], tmp[i - 1], h[i].Z);
+  }
+  fe_invert(acc, tmp[n - 1]);
+  for (i = n - 1; i > 0; --i) {
+    fe_mul(recip, acc, tmp[i - 1]);
+    fe_mul(acc, acc, h[i].Z);
+    fe_mul(x, h[i].X, recip);
+    fe_mul(y, h[i].Y, recip);
+    fe_tobytes(s + 32 * i, y);
+    s[32 * i + 31] ^= fe_isnegative(x) << 7;
+  }
+  fe_mul(x, h[0].X, acc);
+  fe_mul(y, h[0].Y, acc);
+  fe_tobytes(s, y);
+  s[31] ^= fe_isnegative(x) << 7;
+}
+
 /* From sc_reduce.c */
 
 /*
@@ -1984,11 +2026,32 @@ static void ge_cached_cmov(ge_cached *t, const ge_cached *u, unsigned char b) {
   fe_cmov(t->T2d, u->T2d, b);
 }
 
+void ge_sm_precomp(ge_smp Ai, const ge_p3 *A) {
+  ge_p1p1 t;
+  ge_p3 u;
+  int i;
+
+  ge_p3_to_cached(&Ai[0], A);
+  for (i = 0; i < 7; i++) {
+    ge_add(&t, A, &Ai[i]);
+    ge_p1p1_to_p3(&u, &t);
+    ge_p3_to_cached(&Ai[i + 1], &u);
+  }
+}
+
 /* Assumes that a[31] <= 127 */
 void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
+  ge_smp Ai; /* 1 * A, 2 * A, ..., 8 * A */
+
+  ge_sm_precomp(Ai, A);
+  ge_scalarmult_precomp(r, a, Ai);
+}
+
+/* As ge_scalarmult, with A given as the output of ge_sm_precomp */
+
+void ge_scalarmult_precomp(ge_p2 *r, const unsigned char *a, const ge_smp Ai) {
   signed char e[64];
   int carry, carry2, i;
-  ge_cached Ai[8]; /* 1 * A, 2 * A, ..., 8 * A */
   ge_p1p1 t;
   ge_p3 u;
 
@@ -2005,13 +2068,6 @@ void ge_scalarmult(ge_p2 *r, const unsigned char *a, const ge_p3 *A) {
   e[62] = carry - (carry2 << 4); /* -8..7 */
   e[63] = carry2; /* 0..8 */
 
-  ge_p3_to_cached(&Ai[0], A);
-  for (i = 0; i < 7; i++) {
-    ge_add(&t, A, &Ai[i]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[i + 1], &u);
-  }
-
   ge_p2_0(r);
   for (i = 63; i >= 0; i--) {
     signed char b = e[i];
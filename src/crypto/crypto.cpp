@@ -29,12 +29,16 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <unistd.h>
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <boost/shared_ptr.hpp>
@@ -533,6 +537,71 @@ POP_WARNINGS
     sc_mulsub(&sig[sec_index].r, &sig[sec_index].c, &sec, &k);
   }
 
+  // Popular outputs end up as ring members in many signatures, so the points
+  // check_ring_signature derives from a ring member (the decompressed key and
+  // its hash_to_ec) are kept in a bounded cache. Entries go to the newer of
+  // two generations, the older one being dropped when the newer one is full,
+  // and entries found in the older one are moved back to the newer one.
+  // The cache is split in shards, picked by the first byte of the key, each
+  // with its own lock, so that verification threads rarely wait on each other.
+  namespace {
+    struct ring_member_points {
+      ge_p3 key;
+      ge_p3 hp;
+    };
+
+    class ring_member_cache_shard {
+    public:
+      bool get(const public_key &key, ring_member_points &points) {
+        {
+          boost::lock_guard<boost::mutex> lock(m_lock);
+          auto i = m_current.find(key);
+          if (i != m_current.end()) {
+            points = i->second;
+            return true;
+          }
+          i = m_previous.find(key);
+          if (i != m_previous.end()) {
+            points = i->second;
+            m_previous.erase(i);
+            add(key, points);
+            return true;
+          }
+        }
+        if (ge_frombytes_vartime(&points.key, &key) != 0) {
+          return false;
+        }
+        hash_to_ec(key, points.hp);
+        boost::lock_guard<boost::mutex> lock(m_lock);
+        add(key, points);
+        return true;
+      }
+
+      static const size_t GENERATION_SIZE = 256;
+
+    private:
+      void add(const public_key &key, const ring_member_points &points) {
+        if (m_current.size() >= GENERATION_SIZE) {
+          m_previous = std::move(m_current);
+          m_current.clear();
+        }
+        m_current.emplace(key, points);
+      }
+
+      boost::mutex m_lock;
+      std::unordered_map<public_key, ring_member_points> m_current;
+      std::unordered_map<public_key, ring_member_points> m_previous;
+    };
+
+    static const size_t RING_MEMBER_CACHE_SHARDS = 16;
+    ring_member_cache_shard ring_members[RING_MEMBER_CACHE_SHARDS];
+
+    bool get_ring_member(const public_key &key, ring_member_points &points) {
+      const unsigned char shard = static_cast<unsigned char>(key.data[0]);
+      return ring_members[shard % RING_MEMBER_CACHE_SHARDS].get(key, points);
+    }
+  }
+
   bool crypto_ops::check_ring_signature(const hash &prefix_hash, const key_image &image,
     const public_key *const *pubs, size_t pubs_count,
     const signature *sig) {
@@ -556,17 +625,16 @@ POP_WARNINGS
     buf->h = prefix_hash;
     for (i = 0; i < pubs_count; i++) {
       ge_p2 tmp2;
-      ge_p3 tmp3;
+      ring_member_points points;
       if (sc_check(&sig[i].c) != 0 || sc_check(&sig[i].r) != 0) {
         return false;
       }
-      if (ge_frombytes_vartime(&tmp3, &*pubs[i]) != 0) {
+      if (!get_ring_member(*pubs[i], points)) {
         return false;
       }
-      ge_double_scalarmult_base_vartime(&tmp2, &sig[i].c, &tmp3, &sig[i].r);
+      ge_double_scalarmult_base_vartime(&tmp2, &sig[i].c, &points.key, &sig[i].r);
       ge_tobytes(&buf->ab[i].a, &tmp2);
-      hash_to_ec(*pubs[i], tmp3);
-      ge_double_scalarmult_precomp_vartime(&tmp2, &sig[i].r, &tmp3, &sig[i].c, image_pre);
+      ge_double_scalarmult_precomp_vartime(&tmp2, &sig[i].r, &points.hp, &sig[i].c, image_pre);
       ge_tobytes(&buf->ab[i].b, &tmp2);
       sc_add(&sum, &sum, &sig[i].c);
     }
@@ -574,4 +642,71 @@ POP_WARNINGS
     sc_sub(&h, &h, &sum);
     return sc_isnonzero(&h) == 0;
   }
+
+  bool crypto_ops::check_ring_signatures(const ring_signature_check *checks, size_t count, bool *results) {
+    static const size_t invalid = std::numeric_limits<size_t>::max();
+    std::vector<ge_p2> points;
+    std::vector<size_t> offsets(count, invalid);
+    size_t max_pubs_count = 0;
+    bool all_valid = true;
+    for (size_t n = 0; n < count; ++n) {
+      const ring_signature_check &check = checks[n];
+      const size_t offset = points.size();
+      ge_p3 image_unp;
+      ge_dsmp image_pre;
+      bool valid = ge_frombytes_vartime(&image_unp, &*check.image) == 0;
+      if (valid) {
+        ge_dsm_precomp(image_pre, &image_unp);
+        points.resize(offset + 2 * check.pubs_count);
+      }
+      for (size_t i = 0; valid && i < check.pubs_count; ++i) {
+        const signature &sig = check.sig[i];
+        ring_member_points member;
+        if (sc_check(&sig.c) != 0 || sc_check(&sig.r) != 0 || !get_ring_member(*check.pubs[i], member)) {
+          valid = false;
+          break;
+        }
+        ge_double_scalarmult_base_vartime(&points[offset + 2 * i], &sig.c, &member.key, &sig.r);
+        ge_double_scalarmult_precomp_vartime(&points[offset + 2 * i + 1], &sig.r, &member.hp, &sig.c, image_pre);
+      }
+      if (!valid) {
+        points.resize(offset);
+        all_valid = false;
+        continue;
+      }
+      offsets[n] = offset;
+      max_pubs_count = std::max(max_pubs_count, check.pubs_count);
+    }
+
+    std::vector<ec_point> bytes(points.size());
+    if (!points.empty()) {
+      std::unique_ptr<fe[]> tmp(new fe[points.size()]);
+      ge_tobytes_batch(reinterpret_cast<unsigned char*>(bytes.data()), points.data(), tmp.get(), points.size());
+    }
+
+    boost::shared_ptr<rs_comm> buf(reinterpret_cast<rs_comm *>(malloc(rs_comm_size(max_pubs_count))), free);
+    if (!buf)
+      local_abort("malloc failure");
+    for (size_t n = 0; n < count; ++n) {
+      const ring_signature_check &check = checks[n];
+      bool valid = offsets[n] != invalid;
+      if (valid) {
+        ec_scalar sum, h;
+        sc_0(&sum);
+        buf->h = *check.prefix_hash;
+        memcpy(buf->ab, &bytes[offsets[n]], check.pubs_count * sizeof(ec_point_pair));
+        for (size_t i = 0; i < check.pubs_count; ++i) {
+          sc_add(&sum, &sum, &check.sig[i].c);
+        }
+        hash_to_scalar(buf.get(), rs_comm_size(check.pubs_count), h);
+        sc_sub(&h, &h, &sum);
+        valid = sc_isnonzero(&h) == 0;
+        all_valid &= valid;
+      }
+      if (results) {
+        results[n] = valid;
+      }
+    }
+    return all_valid;
+  }
 }
@@ -119,24 +119,8 @@ namespace cryptonote {
     return !carry;
   }
 
-  difficulty_type next_difficulty(std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
-
-    if(timestamps.size() > DIFFICULTY_WINDOW)
-    {
-      timestamps.resize(DIFFICULTY_WINDOW);
-      cumulative_difficulties.resize(DIFFICULTY_WINDOW);
-    }
-
-
-    size_t length = timestamps.size();
-    assert(length == cumulative_difficulties.size());
-    if (length <= 1) {
-      return 1;
-    }
+  static void get_cut(size_t length, size_t &cut_begin, size_t &cut_end) {
     static_assert(DIFFICULTY_WINDOW >= 2, "Window is too small");
-    assert(length <= DIFFICULTY_WINDOW);
-    sort(timestamps.begin(), timestamps.end());
-    size_t cut_begin, cut_end;
     static_assert(2 * DIFFICULTY_CUT <= DIFFICULTY_WINDOW - 2, "Cut length is too large");
     if (length <= DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT) {
       cut_begin = 0;
@@ -146,11 +130,12 @@ namespace cryptonote {
       cut_end = cut_begin + (DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT);
     }
     assert(/*cut_begin >= 0 &&*/ cut_begin + 2 <= cut_end && cut_end <= length);
-    uint64_t time_span = timestamps[cut_end - 1] - timestamps[cut_begin];
+  }
+
+  static difficulty_type next_difficulty_for_work(difficulty_type total_work, uint64_t time_span, size_t target_seconds) {
     if (time_span == 0) {
       time_span = 1;
     }
-    difficulty_type total_work = cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin];
     assert(total_work > 0);
     uint64_t low, high;
     mul(total_work, target_seconds, low, high);
@@ -162,4 +147,59 @@ namespace cryptonote {
     return (low + time_span - 1) / time_span;
   }
 
+  difficulty_type next_difficulty(std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
+
+    if(timestamps.size() > DIFFICULTY_WINDOW)
+    {
+      timestamps.resize(DIFFICULTY_WINDOW);
+      cumulative_difficulties.resize(DIFFICULTY_WINDOW);
+    }
+
+
+    size_t length = timestamps.size();
+    assert(length == cumulative_difficulties.size());
+    if (length <= 1) {
+      return 1;
+    }
+    assert(length <= DIFFICULTY_WINDOW);
+    sort(timestamps.begin(), timestamps.end());
+    size_t cut_begin, cut_end;
+    get_cut(length, cut_begin, cut_end);
+    uint64_t time_span = timestamps[cut_end - 1] - timestamps[cut_begin];
+    difficulty_type total_work = cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin];
+    return next_difficulty_for_work(total_work, time_span, target_seconds);
+  }
+
+  difficulty_window::difficulty_window():
+    m_blocks(DIFFICULTY_BLOCKS_COUNT),
+    m_timestamps(DIFFICULTY_WINDOW)
+  {
+  }
+
+  void difficulty_window::push_back(uint64_t timestamp, difficulty_type cumulative_difficulty) {
+    // the oldest block leaving the lag window enters the difficulty window,
+    // which then drops its own oldest block at the same time
+    const bool evicting = m_blocks.full();
+    m_blocks.push_back(std::make_pair(timestamp, cumulative_difficulty));
+    if (evicting || m_blocks.size() <= DIFFICULTY_WINDOW)
+      m_timestamps.push_back(m_blocks[m_timestamps.size() - (evicting ? 1 : 0)].first);
+  }
+
+  void difficulty_window::clear() {
+    m_blocks.clear();
+    m_timestamps.clear();
+  }
+
+  difficulty_type difficulty_window::next_difficulty(size_t target_seconds) const {
+    size_t length = m_timestamps.size();
+    if (length <= 1) {
+      return 1;
+    }
+    size_t cut_begin, cut_end;
+    get_cut(length, cut_begin, cut_end);
+    uint64_t time_span = m_timestamps.nth(cut_end - 1) - m_timestamps.nth(cut_begin);
+    difficulty_type total_work = m_blocks[cut_end - 1].second - m_blocks[cut_begin].second;
+    return next_difficulty_for_work(total_work, time_span, target_seconds);
+  }
+
 }
@@ -32,8 +32,10 @@
 
 #include <cstdint>
 #include <vector>
+#include <boost/circular_buffer.hpp>
 
 #include "crypto/hash.h"
+#include "common/rolling_window.h"
 
 namespace cryptonote
 {
@@ -53,4 +55,28 @@ namespace cryptonote
      */
     bool check_hash(const crypto::hash &hash, difficulty_type difficulty);
     difficulty_type next_difficulty(std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds);
+
+    /**
+     * @brief next_difficulty over the last DIFFICULTY_BLOCKS_COUNT blocks of a chain, kept up to date as blocks are added
+     *
+     * Gives the same result as next_difficulty on the timestamps and cumulative
+     * difficulties of the blocks pushed so far, without copying or sorting them
+     * again for every block. A window is cheap to copy, so an alternative chain
+     * can carry on from a copy of the window at its fork point.
+     */
+    class difficulty_window
+    {
+    public:
+      difficulty_window();
+
+      void push_back(std::uint64_t timestamp, difficulty_type cumulative_difficulty);
+      void clear();
+      size_t size() const { return m_blocks.size(); }
+
+      difficulty_type next_difficulty(size_t target_seconds) const;
+
+    private:
+      boost::circular_buffer<std::pair<std::uint64_t, difficulty_type>> m_blocks;
+      tools::rolling_window<std::uint64_t> m_timestamps; // of the oldest DIFFICULTY_WINDOW blocks, the rest being the lag
+    };
 }
@@ -91,6 +91,7 @@
 #define BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT          10000  //by default, blocks ids count in synchronizing
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT_PRE_V4       100    //by default, blocks count in blocks downloading
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT              20     //by default, blocks count in blocks downloading
+#define BLOCKS_DOWNLOAD_MAX_SIZE_DEFAULT                (100*1024*1024) // bytes of downloaded but unprocessed blocks to queue
 
 #define CRYPTONOTE_MEMPOOL_TX_LIVETIME                    (86400*3) //seconds, three days
 #define CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME     604800 //seconds, one week
@@ -117,7 +118,14 @@
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_TX_ANNOUNCE                    0x02
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_TX_ANNOUNCE)
+
+#define P2P_TX_ANNOUNCE_MAX_BATCH                       1024
+#define P2P_TX_ANNOUNCE_KNOWN_TXS_MAX                   8192         //per peer
+#define P2P_TX_REQUEST_TIMEOUT                          30           //seconds
+#define P2P_TX_REQUESTS_PER_PEER_MAX                    4096
+#define P2P_TX_REQUESTS_MAX                             65536        //across all peers
 
 #define ALLOW_DEBUG_COMMANDS
 
@@ -0,0 +1,172 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <limits>
+#include "misc_log_ex.h"
+#include "cryptonote_config.h"
+#include "block_hash_check.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain"
+
+namespace cryptonote
+{
+
+block_hash_check::block_hash_check():
+  m_hash_of_hashes(nullptr),
+  m_hash_of_hashes_size(0)
+{
+}
+
+void block_hash_check::set_hash_of_hashes(const crypto::hash *hash_of_hashes, size_t size)
+{
+  m_hash_of_hashes = hash_of_hashes;
+  m_hash_of_hashes_size = size;
+  m_groups.clear();
+}
+
+bool block_hash_check::is_within_area(uint64_t height) const
+{
+  return height < m_hash_of_hashes_size * HASH_OF_HASHES_STEP;
+}
+
+uint64_t block_hash_check::prevalidate(uint64_t height, const std::list<crypto::hash> &hashes, uint64_t db_height, const std::function<crypto::hash(uint64_t)> &get_block_hash)
+{
+  // new: . . . . . X X X X X . . . . . .
+  // pre: A A A A B B B B C C C C D D D D
+
+  // easy case: height >= hashes, or we've jettisoned the hashes already
+  if (height >= m_hash_of_hashes_size * HASH_OF_HASHES_STEP)
+    return hashes.size();
+
+  // find hashes encompassing those block
+  size_t first_index = height / HASH_OF_HASHES_STEP;
+  size_t last_index = (height + hashes.size() - 1) / HASH_OF_HASHES_STEP;
+  MDEBUG("Blocks " << height << " - " << (height + hashes.size() - 1) << " start at " << first_index << " and end at " << last_index);
+
+  // case of not enough to calculate even a single hash
+  if (first_index == last_index && hashes.size() < HASH_OF_HASHES_STEP && (height + hashes.size()) % HASH_OF_HASHES_STEP)
+    return hashes.size();
+
+  // build hashes vector to hash hashes together
+  std::vector<crypto::hash> data;
+  data.reserve(hashes.size() + HASH_OF_HASHES_STEP - 1); // may be a bit too much
+
+  // we expect height to be either equal or a bit below db height
+  bool disconnected = (height > db_height);
+  size_t pop;
+  if (disconnected && height % HASH_OF_HASHES_STEP)
+  {
+    ++first_index;
+    pop = HASH_OF_HASHES_STEP - height % HASH_OF_HASHES_STEP;
+  }
+  else
+  {
+    // we might need some already in the chain for the first part of the first hash
+    for (uint64_t h = first_index * HASH_OF_HASHES_STEP; h < height; ++h)
+    {
+      data.push_back(get_block_hash(h));
+    }
+    pop = 0;
+  }
+
+  // push the data to check
+  for (const auto &h: hashes)
+  {
+    if (pop)
+      --pop;
+    else
+      data.push_back(h);
+  }
+
+  // hash and check
+  uint64_t usable = first_index * HASH_OF_HASHES_STEP - height; // may start negative, but unsigned under/overflow is not UB
+  for (size_t n = first_index; n <= last_index; ++n)
+  {
+    if (n < m_hash_of_hashes_size)
+    {
+      // if the last index isn't fully filled, we can't tell if valid
+      if (data.size() < (n - first_index) * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP)
+        break;
+
+      crypto::hash hash;
+      cn_fast_hash(data.data() + (n - first_index) * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash);
+      bool valid = hash == m_hash_of_hashes[n];
+
+      // add to the known hashes array
+      if (!valid)
+      {
+        MWARNING("invalid hash for blocks " << n * HASH_OF_HASHES_STEP << " - " << (n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP - 1));
+        break;
+      }
+
+      const auto begin = data.begin() + (n - first_index) * HASH_OF_HASHES_STEP;
+      std::vector<crypto::hash> &group = m_groups[n];
+      if (group.empty())
+        group.assign(begin, begin + HASH_OF_HASHES_STEP);
+      else
+        CHECK_AND_ASSERT_MES(std::equal(group.begin(), group.end(), begin),
+            0, "Consistency failure in prevalidated block hashes");
+      usable += HASH_OF_HASHES_STEP;
+    }
+    else
+    {
+      // if after the end of the precomputed blocks, accept anything
+      usable += HASH_OF_HASHES_STEP;
+      if (usable > hashes.size())
+        usable = hashes.size();
+    }
+  }
+  MDEBUG("usable: " << usable << " / " << hashes.size());
+  CHECK_AND_ASSERT_MES(usable < std::numeric_limits<uint64_t>::max() / 2, 0, "usable is negative");
+  return usable;
+}
+
+block_hash_check::result block_hash_check::check(uint64_t height, const crypto::hash &hash) const
+{
+  const auto group = m_groups.find(height / HASH_OF_HASHES_STEP);
+  if (group == m_groups.end())
+    return unknown;
+  return group->second[height % HASH_OF_HASHES_STEP] == hash ? valid : invalid;
+}
+
+void block_hash_check::cleanup(uint64_t height)
+{
+  // drop the prevalidated hashes for blocks we've now added
+  m_groups.erase(m_groups.begin(), m_groups.lower_bound(height / HASH_OF_HASHES_STEP));
+
+  // when we're well clear of the precomputed hashes, stop using them
+  if (m_hash_of_hashes_size > 0 && height > m_hash_of_hashes_size * HASH_OF_HASHES_STEP + 4096)
+  {
+    MINFO("Dumping block hashes, we're now 4k past " << m_hash_of_hashes_size * HASH_OF_HASHES_STEP);
+    set_hash_of_hashes(nullptr, 0);
+  }
+}
+
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /* The hash of hashes table linked into the binary, and the block       */
+  /* hashes checked against it, by HASH_OF_HASHES_STEP group. Blocks in   */
+  /* a checked group only need their hash compared before being added    */
+  /************************************************************************/
+  class block_hash_check
+  {
+  public:
+    enum result { unknown, valid, invalid };
+
+    block_hash_check();
+
+    void set_hash_of_hashes(const crypto::hash *hash_of_hashes, size_t size);
+    bool is_within_area(uint64_t height) const;
+    size_t size() const { return m_hash_of_hashes_size; }
+    size_t groups() const { return m_groups.size(); }
+
+    /**
+     * @brief checks hashes, the hashes of the blocks from height on, against
+     * the hash of hashes table, and keeps the groups that match
+     *
+     * @param db_height the height of the chain
+     * @param get_block_hash the hash of a block already in the chain
+     *
+     * @return how many of hashes can be used
+     */
+    uint64_t prevalidate(uint64_t height, const std::list<crypto::hash> &hashes, uint64_t db_height, const std::function<crypto::hash(uint64_t)> &get_block_hash);
+
+    // valid or invalid if the group holding height was prevalidated
+    result check(uint64_t height, const crypto::hash &hash) const;
+
+    /**
+     * @brief forgets the groups below height, and the whole table once
+     * height is 4096 blocks past it
+     */
+    void cleanup(uint64_t height);
+
+  private:
+    // points into the read only data linked into the binary
+    const crypto::hash *m_hash_of_hashes;
+    size_t m_hash_of_hashes_size;
+    std::map<uint64_t, std::vector<crypto::hash>> m_groups;
+  };
+}
@@ -30,6 +30,7 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <memory>
 #include <boost/filesystem.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 
@@ -52,6 +53,7 @@
 #include "cryptonote_core.h"
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
+#include "metrics.h"
 #if defined(PER_BLOCK_CHECKPOINT)
 #include "blocks/blocks.h"
 #endif
@@ -83,6 +85,12 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+#define ALT_DIFFICULTY_WINDOWS_CACHE_SIZE 64
+
+#define VERIFIED_TX_CACHE_SIZE 16384
+
+#define BATCH_LOOKUP_SLICE_SIZE 1024 // smallest slice of a batched db lookup worth its own thread
+
 static const struct {
   uint8_t version;
   uint64_t height;
@@ -155,8 +163,8 @@ static const struct {
 
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
-  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_current_block_cumul_sz_limit(0), m_current_block_cumul_sz_median(0),
-  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_cancel(false)
+  m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_block_sizes_window(CRYPTONOTE_REWARD_BLOCKS_WINDOW), m_timestamps_window(BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW), m_rolling_windows_height(0), m_current_block_cumul_sz_limit(0), m_current_block_cumul_sz_median(0),
+  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_verified_txes(VERIFIED_TX_CACHE_SIZE), m_cancel(false)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -181,6 +189,43 @@ bool Blockchain::have_tx_keyimg_as_spent(const crypto::key_image &key_im) const
   return  m_db->has_key_image(key_im);
 }
 //------------------------------------------------------------------
+// Splits [0, n) into slices of at least BATCH_LOOKUP_SLICE_SIZE and calls
+// f(first, last) for each, on the threadpool when there is more than one.
+// Each thread uses its own db read txn, so this must not be used while the
+// calling thread holds a write txn whose changes f needs to see.
+template<typename F>
+static void for_each_lookup_slice(size_t n, const F &f)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t threads = std::max<int>(1, tpool.get_max_concurrency());
+  const size_t slice = std::max<size_t>(BATCH_LOOKUP_SLICE_SIZE, (n + threads - 1) / threads);
+  const size_t slices = (n + slice - 1) / slice;
+  if (slices <= 1)
+  {
+    f(0, n);
+    return;
+  }
+  tpool.parallel_for(slices, [&f, n, slice](size_t i) {
+    f(i * slice, std::min(n, (i + 1) * slice));
+  });
+}
+//------------------------------------------------------------------
+bool Blockchain::are_key_images_spent(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  // WARNING: like have_tx_keyimg_as_spent, this does not take m_blockchain_lock
+  std::vector<char> flags(key_images.size(), 0); // not vector<bool>, slices write concurrently
+  for_each_lookup_slice(key_images.size(), [this, &key_images, &flags](size_t first, size_t last) {
+    const std::vector<crypto::key_image> slice(key_images.begin() + first, key_images.begin() + last);
+    std::vector<bool> slice_spent;
+    m_db->has_key_images(slice, slice_spent);
+    for (size_t n = 0; n < slice.size(); ++n)
+      flags[first + n] = slice_spent[n];
+  });
+  spent.assign(flags.begin(), flags.end());
+  return true;
+}
+//------------------------------------------------------------------
 // This function makes sure that each "input" in an input (mixins) exists
 // and collects the public key for each from the transaction it was included in
 // via the visitor passed to it.
@@ -533,7 +578,7 @@ block Blockchain::pop_block_from_blockchain()
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
+  m_rolling_windows_height = 0;
 
   block popped_block;
   std::vector<transaction> popped_txs;
@@ -594,8 +639,11 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_timestamps_and_difficulties_height = 0;
+  m_rolling_windows_height = 0;
   m_alternative_chains.clear();
+  m_alt_difficulty_windows.clear();
+  m_alt_difficulty_windows_order.clear();
+  m_verified_txes.clear();
   m_db->reset();
   m_hardfork->init();
 
@@ -744,57 +792,54 @@ bool Blockchain::get_block_by_hash(const crypto::hash &h, block &blk, bool *orph
   return false;
 }
 //------------------------------------------------------------------
-// This function aggregates the cumulative difficulties and timestamps of the
-// last DIFFICULTY_BLOCKS_COUNT blocks and passes them to next_difficulty,
-// returning the result of that call.  Ignores the genesis block, and can use
+// This function returns the difficulty for the next block from the rolling
+// window over the cumulative difficulties and timestamps of the last
+// DIFFICULTY_BLOCKS_COUNT blocks.  Ignores the genesis block, and can use
 // less blocks than desired if there aren't enough.
 difficulty_type Blockchain::get_difficulty_for_next_block()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> difficulties;
-  auto height = m_db->height();
-  // ND: Speedup
-  // 1. Keep a list of the last 735 (or less) blocks that is used to compute difficulty,
-  //    then when the next block difficulty is queried, push the latest height data and
-  //    pop the oldest one from the list. This only requires 1x read per height instead
-  //    of doing 735 (DIFFICULTY_BLOCKS_COUNT).
-  if (m_timestamps_and_difficulties_height != 0 && ((height - m_timestamps_and_difficulties_height) == 1))
-  {
-    uint64_t index = height - 1;
-    m_timestamps.push_back(m_db->get_block_timestamp(index));
-    m_difficulties.push_back(m_db->get_block_cumulative_difficulty(index));
-
-    while (m_timestamps.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_timestamps.erase(m_timestamps.begin());
-    while (m_difficulties.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_difficulties.erase(m_difficulties.begin());
-
-    m_timestamps_and_difficulties_height = height;
-    timestamps = m_timestamps;
-    difficulties = m_difficulties;
+  update_rolling_windows();
+  size_t target = get_difficulty_target();
+  return m_difficulty_window.next_difficulty(target);
+}
+//------------------------------------------------------------------
+// This function keeps the rolling windows over the top of the main chain
+// (difficulty, block sizes and timestamps) in step with it.  Only the new
+// block is read when one was added since the last call, and the windows are
+// reloaded from the db otherwise, eg after blocks were popped.
+void Blockchain::update_rolling_windows() const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  const uint64_t height = m_db->height();
+  if (height == m_rolling_windows_height)
+    return;
+
+  uint64_t start_height;
+  if (m_rolling_windows_height != 0 && m_rolling_windows_height + 1 == height)
+  {
+    start_height = height - 1;
   }
   else
   {
-    size_t offset = height - std::min < size_t > (height, static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    if (offset == 0)
-      ++offset;
-
-    timestamps.clear();
-    difficulties.clear();
-    for (; offset < height; offset++)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(offset));
-      difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
-    }
+    m_difficulty_window.clear();
+    m_block_sizes_window.clear();
+    m_timestamps_window.clear();
+    const uint64_t count = std::max<uint64_t>(DIFFICULTY_BLOCKS_COUNT, std::max<uint64_t>(CRYPTONOTE_REWARD_BLOCKS_WINDOW, BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW));
+    start_height = height - std::min<uint64_t>(height, count);
+  }
 
-    m_timestamps_and_difficulties_height = height;
-    m_timestamps = timestamps;
-    m_difficulties = difficulties;
+  for (uint64_t h = start_height; h < height; ++h)
+  {
+    const uint64_t timestamp = m_db->get_block_timestamp(h);
+    m_timestamps_window.push_back(timestamp);
+    m_block_sizes_window.push_back(m_db->get_block_size(h));
+    if (h > 0)
+      m_difficulty_window.push_back(timestamp, m_db->get_block_cumulative_difficulty(h));
   }
-  size_t target = get_difficulty_target();
-  return next_difficulty(timestamps, difficulties, target);
+  m_rolling_windows_height = height;
 }
 //------------------------------------------------------------------
 // This function removes blocks from the blockchain until it gets to the
@@ -811,7 +856,7 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
     return true;
   }
 
-  m_timestamps_and_difficulties_height = 0;
+  m_rolling_windows_height = 0;
 
   // remove blocks from blockchain until we get back to where we should be.
   while (m_db->height() != rollback_height)
@@ -847,7 +892,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
+  m_rolling_windows_height = 0;
 
   // if empty alt chain passed (not sure how that could happen), return false
   CHECK_AND_ASSERT_MES(alt_chain.size(), false, "switch_to_alternative_blockchain: empty chain passed");
@@ -931,73 +976,88 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
 
   m_hardfork->reorganize_from_chain_height(split_height);
 
+  static epee::metrics::counter &reorganizations = epee::metrics::get_counter("blockchain_reorganizations_total", "Switches to an alternative chain");
+  static epee::metrics::histogram &reorganization_depth = epee::metrics::get_histogram("blockchain_reorganization_depth_blocks", "Number of main chain blocks disconnected by a reorganization");
+  reorganizations.inc();
+  reorganization_depth.record(disconnected_chain.size());
+
   MGINFO_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db->height());
   return true;
 }
 //------------------------------------------------------------------
 // This function calculates the difficulty target for the block being added to
-// an alternate chain.
+// an alternate chain.  The difficulty windows of alt chain blocks (and of the
+// main chain blocks they fork from) are cached, so a block normally costs a
+// copy of its parent's window rather than a reload of the main chain part.
 difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> cumulative_difficulties;
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  difficulty_window window;
 
-  // if the alt chain isn't long enough to calculate the difficulty target
-  // based on its blocks alone, need to get more blocks from the main chain
-  if(alt_chain.size()< DIFFICULTY_BLOCKS_COUNT)
+  // start from the most recent alt chain block we have a window for
+  auto alt_it = alt_chain.end();
+  bool found = false;
+  while (!found && alt_it != alt_chain.begin())
   {
-    CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
-    // Figure out start and stop offsets for main chain blocks
-    size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
-    size_t main_chain_count = DIFFICULTY_BLOCKS_COUNT - std::min(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT), alt_chain.size());
-    main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
-    size_t main_chain_start_offset = main_chain_stop_offset - main_chain_count;
-
-    if(!main_chain_start_offset)
-      ++main_chain_start_offset; //skip genesis block
-
-    // get difficulties and timestamps from relevant main chain blocks
-    for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+    --alt_it;
+    const auto i = m_alt_difficulty_windows.find((*alt_it)->first);
+    if (i != m_alt_difficulty_windows.end())
     {
-      timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
-      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
+      window = i->second;
+      ++alt_it;
+      found = true;
     }
+  }
 
-    // make sure we haven't accidentally grabbed too many blocks...maybe don't need this check?
-    CHECK_AND_ASSERT_MES((alt_chain.size() + timestamps.size()) <= DIFFICULTY_BLOCKS_COUNT, false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + vtimestampsec.size()[" << timestamps.size() << "] NOT <= DIFFICULTY_WINDOW[]" << DIFFICULTY_BLOCKS_COUNT);
-
-    for (auto it : alt_chain)
+  // if there is none, start from the main chain block the alt chain forks from,
+  // unless the alt chain is long enough to calculate the difficulty target based
+  // on its blocks alone
+  if (!found)
+  {
+    const crypto::hash &main_chain_parent = alt_chain.size() ? alt_chain.front()->second.bl.prev_id : bei.bl.prev_id;
+    const auto i = m_alt_difficulty_windows.find(main_chain_parent);
+    if (i != m_alt_difficulty_windows.end())
     {
-      timestamps.push_back(it->second.bl.timestamp);
-      cumulative_difficulties.push_back(it->second.cumulative_difficulty);
+      window = i->second;
     }
-  }
-  // if the alt chain is long enough for the difficulty calc, grab difficulties
-  // and timestamps from it alone
-  else
-  {
-    timestamps.resize(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    cumulative_difficulties.resize(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    size_t count = 0;
-    size_t max_i = timestamps.size()-1;
-    // get difficulties and timestamps from most recent blocks in alt chain
-    for(auto it: boost::adaptors::reverse(alt_chain))
+    else if (alt_chain.size() < DIFFICULTY_BLOCKS_COUNT)
     {
-      timestamps[max_i - count] = it->second.bl.timestamp;
-      cumulative_difficulties[max_i - count] = it->second.cumulative_difficulty;
-      count++;
-      if(count >= DIFFICULTY_BLOCKS_COUNT)
-        break;
+      // Figure out start and stop offsets for main chain blocks
+      uint64_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
+      uint64_t main_chain_start_offset = main_chain_stop_offset - std::min<uint64_t>(main_chain_stop_offset, DIFFICULTY_BLOCKS_COUNT);
+      if(!main_chain_start_offset)
+        ++main_chain_start_offset; //skip genesis block
+
+      // get difficulties and timestamps from relevant main chain blocks
+      for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+        window.push_back(m_db->get_block_timestamp(main_chain_start_offset), m_db->get_block_cumulative_difficulty(main_chain_start_offset));
+      add_alt_difficulty_window(main_chain_parent, window);
     }
   }
 
+  for (; alt_it != alt_chain.end(); ++alt_it)
+    window.push_back((*alt_it)->second.bl.timestamp, (*alt_it)->second.cumulative_difficulty);
+  if (alt_chain.size())
+    add_alt_difficulty_window(alt_chain.back()->first, window);
+
   // FIXME: This will fail if fork activation heights are subject to voting
   size_t target = get_ideal_hard_fork_version(bei.height) < 2 ? DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
 
   // calculate the difficulty target for the block and return it
-  return next_difficulty(timestamps, cumulative_difficulties, target);
+  return window.next_difficulty(target);
+}
+//------------------------------------------------------------------
+void Blockchain::add_alt_difficulty_window(const crypto::hash &id, const difficulty_window &window) const
+{
+  if (!m_alt_difficulty_windows.emplace(id, window).second)
+    return;
+  m_alt_difficulty_windows_order.push_back(id);
+  while (m_alt_difficulty_windows_order.size() > ALT_DIFFICULTY_WINDOWS_CACHE_SIZE)
+  {
+    m_alt_difficulty_windows.erase(m_alt_difficulty_windows_order.front());
+    m_alt_difficulty_windows_order.pop_front();
+  }
 }
 //------------------------------------------------------------------
 // This function does a sanity check on basic things that all miner
@@ -1050,9 +1110,8 @@ bool Blockchain::validate_miner_transaction(const block& b, size_t cumulative_bl
     }
   }
 
-  std::vector<size_t> last_blocks_sizes;
-  get_last_n_blocks_sizes(last_blocks_sizes, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
-  if (!get_block_reward(epee::misc_utils::median(last_blocks_sizes), cumulative_block_size, already_generated_coins, base_reward, version))
+  update_rolling_windows();
+  if (!get_block_reward(m_block_sizes_window.median(), cumulative_block_size, already_generated_coins, base_reward, version))
   {
     MERROR_VER("block size " << cumulative_block_size << " is bigger than allowed for this blockchain");
     return false;
@@ -1307,7 +1366,6 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_timestamps_and_difficulties_height = 0;
   uint64_t block_height = get_block_height(b);
   if(0 == block_height)
   {
@@ -1472,6 +1530,8 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     }
     else
     {
+      static epee::metrics::counter &alt_blocks = epee::metrics::get_counter("blockchain_alt_blocks_total", "Blocks added to an alternative chain");
+      alt_blocks.inc();
       MGINFO_BLUE("----- BLOCK ADDED AS ALTERNATIVE ON HEIGHT " << bei.height << std::endl << "id:\t" << id << std::endl << "PoW:\t" << proof_of_work << std::endl << "difficulty:\t" << current_diff);
       return true;
     }
@@ -2059,20 +2119,24 @@ bool Blockchain::get_transactions_blobs(const t_ids_container& txs_ids, t_tx_con
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  for (const auto& tx_hash : txs_ids)
+  const std::vector<crypto::hash> ids(txs_ids.begin(), txs_ids.end());
+  std::vector<cryptonote::blobdata> blobs;
+  std::vector<bool> found;
+  try
   {
-    try
-    {
-      cryptonote::blobdata tx;
-      if (m_db->get_tx_blob(tx_hash, tx))
-        txs.push_back(std::move(tx));
-      else
-        missed_txs.push_back(tx_hash);
-    }
-    catch (const std::exception& e)
-    {
-      return false;
-    }
+    m_db->get_tx_blobs(ids, blobs, found);
+  }
+  catch (const std::exception& e)
+  {
+    return false;
+  }
+
+  for (size_t n = 0; n < ids.size(); ++n)
+  {
+    if (found[n])
+      txs.push_back(std::move(blobs[n]));
+    else
+      missed_txs.push_back(ids[n]);
   }
   return true;
 }
@@ -2083,27 +2147,39 @@ bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  for (const auto& tx_hash : txs_ids)
+  // large batches are fetched and parsed in slices on the threadpool
+  enum { TX_MISSING, TX_FOUND, TX_INVALID };
+  const std::vector<crypto::hash> ids(txs_ids.begin(), txs_ids.end());
+  std::vector<transaction> found_txs(ids.size());
+  std::vector<char> status(ids.size(), TX_MISSING);
+  try
   {
-    try
-    {
-      cryptonote::blobdata tx;
-      if (m_db->get_tx_blob(tx_hash, tx))
-      {
-        txs.push_back(transaction());
-        if (!parse_and_validate_tx_from_blob(tx, txs.back()))
-        {
-          LOG_ERROR("Invalid transaction");
-          return false;
-        }
-      }
-      else
-        missed_txs.push_back(tx_hash);
-    }
-    catch (const std::exception& e)
+    for_each_lookup_slice(ids.size(), [this, &ids, &found_txs, &status](size_t first, size_t last) {
+      const std::vector<crypto::hash> slice(ids.begin() + first, ids.begin() + last);
+      std::vector<cryptonote::blobdata> blobs;
+      std::vector<bool> found;
+      m_db->get_tx_blobs(slice, blobs, found);
+      for (size_t n = 0; n < slice.size(); ++n)
+        if (found[n])
+          status[first + n] = parse_and_validate_tx_from_blob(blobs[n], found_txs[first + n]) ? TX_FOUND : TX_INVALID;
+    });
+  }
+  catch (const std::exception& e)
+  {
+    return false;
+  }
+
+  for (size_t n = 0; n < ids.size(); ++n)
+  {
+    if (status[n] == TX_INVALID)
     {
+      LOG_ERROR("Invalid transaction");
       return false;
     }
+    if (status[n] == TX_FOUND)
+      txs.push_back(std::move(found_txs[n]));
+    else
+      missed_txs.push_back(ids[n]);
   }
   return true;
 }
@@ -2346,7 +2422,7 @@ void Blockchain::on_new_tx_from_block(const cryptonote::transaction &tx)
 {
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size())
+  if (is_within_compiled_block_hash_area())
   {
     TIME_MEASURE_START(a);
     m_blocks_txs_check.push_back(get_transaction_hash(tx));
@@ -2375,7 +2451,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, uint64_t& max_used_block_heigh
 
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size() && kept_by_block)
+  if (kept_by_block && is_within_compiled_block_hash_area())
   {
     max_used_block_id = null_hash;
     max_used_block_height = 0;
@@ -2545,7 +2621,7 @@ bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_pr
 //        check_tx_input() rather than here, and use this function simply
 //        to iterate the inputs as necessary (splitting the task
 //        using threads, etc.)
-bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height)
+bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height, ring_signature_batch *batch)
 {
   PERF_TIMER(check_tx_inputs);
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -2653,12 +2729,16 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
   }
 
   std::vector<std::vector<rct::ctkey>> pubkeys(tx.vin.size());
-  std::vector < uint64_t > results;
-  results.resize(tx.vin.size(), 0);
 
-  tools::threadpool& tpool = tools::threadpool::getInstance();
-  tools::threadpool::waiter waiter;
-  int threads = tpool.get_max_concurrency();
+  // v1 ring signatures are queued, and checked together once all inputs are
+  // known, or along with the rest of the block when the caller passes a batch
+  ring_signature_batch local_batch;
+  ring_signature_batch &sig_batch = batch ? *batch : local_batch;
+  const size_t sig_batch_start = sig_batch.size();
+
+  // the outputs the rings resolve to, which, with the txid and hard fork
+  // version, is everything the signature checks depend on
+  std::vector<rct::ctkey> ring_members;
 
   for (const auto& txin : tx.vin)
   {
@@ -2712,54 +2792,36 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
 
       return false;
     }
+    ring_members.insert(ring_members.end(), pubkeys[sig_index].begin(), pubkeys[sig_index].end());
 
     if (tx.version == 1)
     {
-      if (threads > 1)
-      {
-        // ND: Speedup
-        // 1. Thread ring signature verification if possible.
-        tpool.submit(&waiter, boost::bind(&Blockchain::check_ring_signature, this, std::cref(tx_prefix_hash), std::cref(in_to_key.k_image), std::cref(pubkeys[sig_index]), std::cref(tx.signatures[sig_index]), std::ref(results[sig_index])));
-      }
-      else
-      {
-        check_ring_signature(tx_prefix_hash, in_to_key.k_image, pubkeys[sig_index], tx.signatures[sig_index], results[sig_index]);
-        if (!results[sig_index])
-        {
-          it->second[in_to_key.k_image] = false;
-          MERROR_VER("Failed to check ring signature for tx " << get_transaction_hash(tx) << "  vin key with k_image: " << in_to_key.k_image << "  sig_index: " << sig_index);
-
-          if (pmax_used_block_height)  // a default value of NULL is used when called from Blockchain::handle_block_to_main_chain()
-          {
-            MERROR_VER("*pmax_used_block_height: " << *pmax_used_block_height);
-          }
-
-          return false;
-        }
-        it->second[in_to_key.k_image] = true;
-      }
+      sig_batch.push_back(ring_signature_entry());
+      ring_signature_entry &entry = sig_batch.back();
+      entry.tx_prefix_hash = tx_prefix_hash;
+      entry.key_image = in_to_key.k_image;
+      entry.pubkeys = std::move(pubkeys[sig_index]);
+      entry.sig = tx.signatures[sig_index];
     }
 
     sig_index++;
   }
-  if (tx.version == 1 && threads > 1)
-    waiter.wait();
+
+  const crypto::hash txid = get_transaction_hash(tx);
+  const crypto::hash ring_members_hash = crypto::cn_fast_hash(ring_members.data(), ring_members.size() * sizeof(rct::ctkey));
 
   if (tx.version == 1)
   {
-    if (threads > 1)
+    if (m_verified_txes.is_verified(txid, ring_members_hash, hf_version))
     {
-      // save results to table, passed or otherwise
-      bool failed = false;
-      for (size_t i = 0; i < tx.vin.size(); i++)
-      {
-        const txin_to_key& in_to_key = boost::get<txin_to_key>(tx.vin[i]);
-        it->second[in_to_key.k_image] = results[i];
-        if(!failed && !results[i])
-          failed = true;
-      }
-
-      if (failed)
+      MDEBUG("Ring signatures for tx " << txid << " already verified");
+      sig_batch.resize(sig_batch_start);
+      return true;
+    }
+    // a batch is checked with the rest of the block, its txes are not recorded
+    if (!batch)
+    {
+      if (!m_verified_txes.check(txid, ring_members_hash, hf_version, [&]() { return check_ring_signatures(local_batch); }))
       {
         MERROR_VER("Failed to check ring signatures!");
         return false;
@@ -2774,154 +2836,203 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
       return false;
     }
 
-    // from version 2, check ringct signatures
-    // obviously, the original and simple rct APIs use a mixRing that's indexes
-    // in opposite orders, because it'd be too simple otherwise...
-    const rct::rctSig &rv = tx.rct_signatures;
-    switch (rv.type)
-    {
-    case rct::RCTTypeNull: {
-      // we only accept no signatures for coinbase txes
-      MERROR_VER("Null rct signature on non-coinbase tx");
+    if (!m_verified_txes.check(txid, ring_members_hash, hf_version, [&]() { return check_rct_signatures(tx, pubkeys); }))
       return false;
-    }
-    case rct::RCTTypeSimple:
-    case rct::RCTTypeSimpleBulletproof:
+  }
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::check_rct_signatures(const transaction &tx, const std::vector<std::vector<rct::ctkey>> &pubkeys) const
+{
+  // from version 2, check ringct signatures
+  // obviously, the original and simple rct APIs use a mixRing that's indexes
+  // in opposite orders, because it'd be too simple otherwise...
+  const rct::rctSig &rv = tx.rct_signatures;
+  switch (rv.type)
+  {
+  case rct::RCTTypeNull: {
+    // we only accept no signatures for coinbase txes
+    MERROR_VER("Null rct signature on non-coinbase tx");
+    return false;
+  }
+  case rct::RCTTypeSimple:
+  case rct::RCTTypeSimpleBulletproof:
+  {
+    // check all this, either reconstructed (so should really pass), or not
     {
-      // check all this, either reconstructed (so should really pass), or not
+      if (pubkeys.size() != rv.mixRing.size())
+      {
+        MERROR_VER("Failed to check ringct signatures: mismatched pubkeys/mixRing size");
+        return false;
+      }
+      for (size_t i = 0; i < pubkeys.size(); ++i)
       {
-        if (pubkeys.size() != rv.mixRing.size())
+        if (pubkeys[i].size() != rv.mixRing[i].size())
         {
           MERROR_VER("Failed to check ringct signatures: mismatched pubkeys/mixRing size");
           return false;
         }
-        for (size_t i = 0; i < pubkeys.size(); ++i)
+      }
+
+      for (size_t n = 0; n < pubkeys.size(); ++n)
+      {
+        for (size_t m = 0; m < pubkeys[n].size(); ++m)
         {
-          if (pubkeys[i].size() != rv.mixRing[i].size())
+          if (pubkeys[n][m].dest != rct::rct2pk(rv.mixRing[n][m].dest))
           {
-            MERROR_VER("Failed to check ringct signatures: mismatched pubkeys/mixRing size");
+            MERROR_VER("Failed to check ringct signatures: mismatched pubkey at vin " << n << ", index " << m);
             return false;
           }
-        }
-
-        for (size_t n = 0; n < pubkeys.size(); ++n)
-        {
-          for (size_t m = 0; m < pubkeys[n].size(); ++m)
+          if (pubkeys[n][m].mask != rct::rct2pk(rv.mixRing[n][m].mask))
           {
-            if (pubkeys[n][m].dest != rct::rct2pk(rv.mixRing[n][m].dest))
-            {
-              MERROR_VER("Failed to check ringct signatures: mismatched pubkey at vin " << n << ", index " << m);
-              return false;
-            }
-            if (pubkeys[n][m].mask != rct::rct2pk(rv.mixRing[n][m].mask))
-            {
-              MERROR_VER("Failed to check ringct signatures: mismatched commitment at vin " << n << ", index " << m);
-              return false;
-            }
+            MERROR_VER("Failed to check ringct signatures: mismatched commitment at vin " << n << ", index " << m);
+            return false;
           }
         }
       }
+    }
 
-      if (rv.p.MGs.size() != tx.vin.size())
+    if (rv.p.MGs.size() != tx.vin.size())
+    {
+      MERROR_VER("Failed to check ringct signatures: mismatched MGs/vin sizes");
+      return false;
+    }
+    for (size_t n = 0; n < tx.vin.size(); ++n)
+    {
+      if (rv.p.MGs[n].II.empty() || memcmp(&boost::get<txin_to_key>(tx.vin[n]).k_image, &rv.p.MGs[n].II[0], 32))
       {
-        MERROR_VER("Failed to check ringct signatures: mismatched MGs/vin sizes");
+        MERROR_VER("Failed to check ringct signatures: mismatched key image");
         return false;
       }
-      for (size_t n = 0; n < tx.vin.size(); ++n)
-      {
-        if (rv.p.MGs[n].II.empty() || memcmp(&boost::get<txin_to_key>(tx.vin[n]).k_image, &rv.p.MGs[n].II[0], 32))
-        {
-          MERROR_VER("Failed to check ringct signatures: mismatched key image");
-          return false;
-        }
-      }
+    }
 
-      if (!rct::verRctSimple(rv, false))
-      {
-        MERROR_VER("Failed to check ringct signatures!");
-        return false;
-      }
-      break;
+    if (!rct::verRctSimple(rv, false))
+    {
+      MERROR_VER("Failed to check ringct signatures!");
+      return false;
     }
-    case rct::RCTTypeFull:
-    case rct::RCTTypeFullBulletproof:
+    break;
+  }
+  case rct::RCTTypeFull:
+  case rct::RCTTypeFullBulletproof:
+  {
+    // check all this, either reconstructed (so should really pass), or not
     {
-      // check all this, either reconstructed (so should really pass), or not
+      bool size_matches = true;
+      for (size_t i = 0; i < pubkeys.size(); ++i)
+        size_matches &= pubkeys[i].size() == rv.mixRing.size();
+      for (size_t i = 0; i < rv.mixRing.size(); ++i)
+        size_matches &= pubkeys.size() == rv.mixRing[i].size();
+      if (!size_matches)
       {
-        bool size_matches = true;
-        for (size_t i = 0; i < pubkeys.size(); ++i)
-          size_matches &= pubkeys[i].size() == rv.mixRing.size();
-        for (size_t i = 0; i < rv.mixRing.size(); ++i)
-          size_matches &= pubkeys.size() == rv.mixRing[i].size();
-        if (!size_matches)
-        {
-          MERROR_VER("Failed to check ringct signatures: mismatched pubkeys/mixRing size");
-          return false;
-        }
+        MERROR_VER("Failed to check ringct signatures: mismatched pubkeys/mixRing size");
+        return false;
+      }
 
-        for (size_t n = 0; n < pubkeys.size(); ++n)
+      for (size_t n = 0; n < pubkeys.size(); ++n)
+      {
+        for (size_t m = 0; m < pubkeys[n].size(); ++m)
         {
-          for (size_t m = 0; m < pubkeys[n].size(); ++m)
+          if (pubkeys[n][m].dest != rct::rct2pk(rv.mixRing[m][n].dest))
           {
-            if (pubkeys[n][m].dest != rct::rct2pk(rv.mixRing[m][n].dest))
-            {
-              MERROR_VER("Failed to check ringct signatures: mismatched pubkey at vin " << n << ", index " << m);
-              return false;
-            }
-            if (pubkeys[n][m].mask != rct::rct2pk(rv.mixRing[m][n].mask))
-            {
-              MERROR_VER("Failed to check ringct signatures: mismatched commitment at vin " << n << ", index " << m);
-              return false;
-            }
+            MERROR_VER("Failed to check ringct signatures: mismatched pubkey at vin " << n << ", index " << m);
+            return false;
+          }
+          if (pubkeys[n][m].mask != rct::rct2pk(rv.mixRing[m][n].mask))
+          {
+            MERROR_VER("Failed to check ringct signatures: mismatched commitment at vin " << n << ", index " << m);
+            return false;
           }
         }
       }
+    }
 
-      if (rv.p.MGs.size() != 1)
-      {
-        MERROR_VER("Failed to check ringct signatures: Bad MGs size");
-        return false;
-      }
-      if (rv.p.MGs.empty() || rv.p.MGs[0].II.size() != tx.vin.size())
+    if (rv.p.MGs.size() != 1)
+    {
+      MERROR_VER("Failed to check ringct signatures: Bad MGs size");
+      return false;
+    }
+    if (rv.p.MGs.empty() || rv.p.MGs[0].II.size() != tx.vin.size())
+    {
+      MERROR_VER("Failed to check ringct signatures: mismatched II/vin sizes");
+      return false;
+    }
+    for (size_t n = 0; n < tx.vin.size(); ++n)
+    {
+      if (memcmp(&boost::get<txin_to_key>(tx.vin[n]).k_image, &rv.p.MGs[0].II[n], 32))
       {
         MERROR_VER("Failed to check ringct signatures: mismatched II/vin sizes");
         return false;
       }
-      for (size_t n = 0; n < tx.vin.size(); ++n)
-      {
-        if (memcmp(&boost::get<txin_to_key>(tx.vin[n]).k_image, &rv.p.MGs[0].II[n], 32))
-        {
-          MERROR_VER("Failed to check ringct signatures: mismatched II/vin sizes");
-          return false;
-        }
-      }
-
-      if (!rct::verRct(rv, false))
-      {
-        MERROR_VER("Failed to check ringct signatures!");
-        return false;
-      }
-      break;
     }
-    default:
-      MERROR_VER("Unsupported rct type: " << rv.type);
+
+    if (!rct::verRct(rv, false))
+    {
+      MERROR_VER("Failed to check ringct signatures!");
       return false;
     }
+    break;
+  }
+  default:
+    MERROR_VER("Unsupported rct type: " << rv.type);
+    return false;
   }
   return true;
 }
-
 //------------------------------------------------------------------
-void Blockchain::check_ring_signature(const crypto::hash &tx_prefix_hash, const crypto::key_image &key_image, const std::vector<rct::ctkey> &pubkeys, const std::vector<crypto::signature>& sig, uint64_t &result)
+bool Blockchain::check_ring_signatures(const ring_signature_batch &batch)
 {
-  std::vector<const crypto::public_key *> p_output_keys;
-  for (auto &key : pubkeys)
+  const size_t count = batch.size();
+  if (count == 0)
+    return true;
+
+  std::vector<std::vector<const crypto::public_key *>> p_output_keys(count);
+  std::vector<crypto::ring_signature_check> checks(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    const ring_signature_entry &entry = batch[i];
+    p_output_keys[i].reserve(entry.pubkeys.size());
+    for (auto &key : entry.pubkeys)
+    {
+      // rct::key and crypto::public_key have the same structure, avoid object ctor/memcpy
+      p_output_keys[i].push_back(&(const crypto::public_key&)key.dest);
+    }
+    checks[i] = {&entry.tx_prefix_hash, &entry.key_image, p_output_keys[i].data(), p_output_keys[i].size(), entry.sig.data()};
+  }
+
+  // each thread gets a contiguous slice, which it checks as a single batch
+  std::unique_ptr<bool[]> results(new bool[count]());
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t threads = std::min<size_t>(tpool.get_max_concurrency(), count);
+  if (threads > 1)
+  {
+    tools::threadpool::waiter waiter;
+    const size_t slice = (count + threads - 1) / threads;
+    for (size_t start = 0; start < count; start += slice)
+    {
+      const size_t n = std::min(slice, count - start);
+      tpool.submit(&waiter, [&checks, &results, start, n]() { crypto::check_ring_signatures(checks.data() + start, n, results.get() + start); });
+    }
+    waiter.wait();
+  }
+  else
   {
-    // rct::key and crypto::public_key have the same structure, avoid object ctor/memcpy
-    p_output_keys.push_back(&(const crypto::public_key&)key.dest);
+    crypto::check_ring_signatures(checks.data(), count, results.get());
   }
 
-  result = crypto::check_ring_signature(tx_prefix_hash, key_image, p_output_keys, sig.data()) ? 1 : 0;
+  // save results to table, passed or otherwise
+  bool failed = false;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const ring_signature_entry &entry = batch[i];
+    m_check_txin_table[entry.tx_prefix_hash][entry.key_image] = results[i];
+    if (!results[i])
+    {
+      MERROR_VER("Failed to check ring signature for tx with prefix hash " << entry.tx_prefix_hash << "  vin key with k_image: " << entry.key_image);
+      failed = true;
+    }
+  }
+  return !failed;
 }
 
 //------------------------------------------------------------------
@@ -3130,8 +3241,11 @@ uint64_t Blockchain::get_adjusted_time() const
 bool Blockchain::check_block_timestamp(std::vector<uint64_t>& timestamps, const block& b) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  uint64_t median_ts = epee::misc_utils::median(timestamps);
-
+  return check_block_timestamp_median(epee::misc_utils::median(timestamps), b);
+}
+//------------------------------------------------------------------
+bool Blockchain::check_block_timestamp_median(uint64_t median_ts, const block& b) const
+{
   if(b.timestamp < median_ts)
   {
     MERROR_VER("Timestamp of block with id: " << get_block_hash(b) << ", " << b.timestamp << ", less than median of last " << BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW << " blocks, " << median_ts);
@@ -3163,17 +3277,8 @@ bool Blockchain::check_block_timestamp(const block& b) const
     return true;
   }
 
-  std::vector<uint64_t> timestamps;
-  auto h = m_db->height();
-
-  // need most recent 60 blocks, get index of first of those
-  size_t offset = h - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW;
-  for(;offset < h; ++offset)
-  {
-    timestamps.push_back(m_db->get_block_timestamp(offset));
-  }
-
-  return check_block_timestamp(timestamps, b);
+  update_rolling_windows();
+  return check_block_timestamp_median(m_timestamps_window.median(), b);
 }
 //------------------------------------------------------------------
 void Blockchain::return_tx_to_pool(std::vector<transaction> &txs)
@@ -3299,18 +3404,19 @@ leave:
   bool precomputed = false;
   bool fast_check = false;
 #if defined(PER_BLOCK_CHECKPOINT)
-  if (m_db->height() < m_blocks_hash_check.size())
+  if (is_within_compiled_block_hash_area())
   {
     auto hash = get_block_hash(bl);
-    const auto &expected_hash = m_blocks_hash_check[m_db->height()];
-    if (expected_hash != crypto::null_hash)
+    const uint64_t height = m_db->height();
+    const block_hash_check::result check = m_block_hash_check.check(height, hash);
+    if (check == block_hash_check::invalid)
+    {
+      MERROR_VER("Block with id is INVALID: " << id);
+      bvc.m_verifivation_failed = true;
+      goto leave;
+    }
+    else if (check == block_hash_check::valid)
     {
-      if (memcmp(&hash, &expected_hash, sizeof(hash)) != 0)
-      {
-        MERROR_VER("Block with id is INVALID: " << id);
-        bvc.m_verifivation_failed = true;
-        goto leave;
-      }
       fast_check = true;
     }
     else
@@ -3376,6 +3482,8 @@ leave:
   uint64_t t_exists = 0;
   uint64_t t_pool = 0;
   uint64_t t_dblspnd = 0;
+  uint64_t t_ringsig = 0;
+  ring_signature_batch ring_signatures;
   TIME_MEASURE_FINISH(t3);
 
 // XXX old code adds miner tx here
@@ -3445,7 +3553,7 @@ leave:
     {
       // validate that transaction inputs and the keys spending them are correct.
       tx_verification_context tvc;
-      if(!check_tx_inputs(tx, tvc))
+      if(!check_tx_inputs(tx, tvc, NULL, &ring_signatures))
       {
         MERROR_VER("Block with id: " << id  << " has at least one transaction (id: " << tx_id << ") with wrong inputs.");
 
@@ -3482,6 +3590,20 @@ leave:
 
   m_blocks_txs_check.clear();
 
+  // the v1 ring signatures of all the block's transactions are checked together
+  TIME_MEASURE_START(rs);
+  if (!check_ring_signatures(ring_signatures))
+  {
+    MERROR_VER("Block with id: " << id << " has at least one transaction with an invalid ring signature");
+    add_block_as_invalid(bl, id);
+    MERROR_VER("Block with id " << id << " added as invalid because of wrong inputs in transactions");
+    bvc.m_verifivation_failed = true;
+    return_tx_to_pool(txs);
+    goto leave;
+  }
+  TIME_MEASURE_FINISH(rs);
+  t_ringsig = rs;
+
   TIME_MEASURE_START(vmt);
   uint64_t base_reward = 0;
   uint64_t already_generated_coins = m_db->height() ? m_db->get_block_already_generated_coins(m_db->height() - 1) : 0;
@@ -3553,9 +3675,16 @@ leave:
         << cumulative_block_size << " p/t: " << block_processing_time << " ("
         << target_calculating_time << "/" << longhash_calculating_time << "/"
         << t1 << "/" << t2 << "/" << t3 << "/" << t_exists << "/" << t_pool
-        << "/" << t_checktx << "/" << t_dblspnd << "/" << vmt << "/" << addblock << ")ms");
+        << "/" << t_checktx << "/" << t_dblspnd << "/" << t_ringsig << "/" << vmt << "/" << addblock << ")ms");
   }
 
+  static epee::metrics::counter &blocks_added = epee::metrics::get_counter("blockchain_blocks_added_total", "Blocks added to the main chain");
+  static epee::metrics::counter &txs_added = epee::metrics::get_counter("blockchain_txs_added_total", "Transactions added to the main chain, excluding miner transactions");
+  static epee::metrics::gauge &height = epee::metrics::get_gauge("blockchain_height", "Main chain height");
+  blocks_added.inc();
+  txs_added.inc(txs.size());
+  height.set(new_height);
+
   bvc.m_added_to_main_chain = true;
   ++m_sync_counter;
 
@@ -3570,10 +3699,9 @@ bool Blockchain::update_next_cumulative_size_limit()
   uint64_t full_reward_zone = get_min_block_size(get_current_hard_fork_version());
 
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::vector<size_t> sz;
-  get_last_n_blocks_sizes(sz, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
+  update_rolling_windows();
 
-  uint64_t median = epee::misc_utils::median(sz);
+  uint64_t median = m_block_sizes_window.median();
   m_current_block_cumul_sz_median = median;
   if(median <= full_reward_zone)
     median = full_reward_zone;
@@ -3765,13 +3893,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   m_blocks_txs_check.clear();
   m_check_txin_table.clear();
 
-  // when we're well clear of the precomputed hashes, free the memory
-  if (!m_blocks_hash_check.empty() && m_db->height() > m_blocks_hash_check.size() + 4096)
-  {
-    MINFO("Dumping block hashes, we're now 4k past " << m_blocks_hash_check.size());
-    m_blocks_hash_check.clear();
-    m_blocks_hash_check.shrink_to_fit();
-  }
+  m_block_hash_check.cleanup(m_db->height());
 
   CRITICAL_REGION_END();
   m_tx_pool.unlock();
@@ -3799,98 +3921,10 @@ void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uin
 
 uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::list<crypto::hash> &hashes)
 {
-  // new: . . . . . X X X X X . . . . . .
-  // pre: A A A A B B B B C C C C D D D D
-
-  // easy case: height >= hashes
-  if (height >= m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP)
-    return hashes.size();
-
-  // if we're getting old blocks, we might have jettisoned the hashes already
-  if (m_blocks_hash_check.empty())
-    return hashes.size();
-
-  // find hashes encompassing those block
-  size_t first_index = height / HASH_OF_HASHES_STEP;
-  size_t last_index = (height + hashes.size() - 1) / HASH_OF_HASHES_STEP;
-  MDEBUG("Blocks " << height << " - " << (height + hashes.size() - 1) << " start at " << first_index << " and end at " << last_index);
-
-  // case of not enough to calculate even a single hash
-  if (first_index == last_index && hashes.size() < HASH_OF_HASHES_STEP && (height + hashes.size()) % HASH_OF_HASHES_STEP)
-    return hashes.size();
-
-  // build hashes vector to hash hashes together
-  std::vector<crypto::hash> data;
-  data.reserve(hashes.size() + HASH_OF_HASHES_STEP - 1); // may be a bit too much
-
-  // we expect height to be either equal or a bit below db height
-  bool disconnected = (height > m_db->height());
-  size_t pop;
-  if (disconnected && height % HASH_OF_HASHES_STEP)
-  {
-    ++first_index;
-    pop = HASH_OF_HASHES_STEP - height % HASH_OF_HASHES_STEP;
-  }
-  else
-  {
-    // we might need some already in the chain for the first part of the first hash
-    for (uint64_t h = first_index * HASH_OF_HASHES_STEP; h < height; ++h)
-    {
-      data.push_back(m_db->get_block_hash_from_height(h));
-    }
-    pop = 0;
-  }
-
-  // push the data to check
-  for (const auto &h: hashes)
-  {
-    if (pop)
-      --pop;
-    else
-      data.push_back(h);
-  }
-
-  // hash and check
-  uint64_t usable = first_index * HASH_OF_HASHES_STEP - height; // may start negative, but unsigned under/overflow is not UB
-  for (size_t n = first_index; n <= last_index; ++n)
-  {
-    if (n < m_blocks_hash_of_hashes.size())
-    {
-      // if the last index isn't fully filled, we can't tell if valid
-      if (data.size() < (n - first_index) * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP)
-        break;
-
-      crypto::hash hash;
-      cn_fast_hash(data.data() + (n - first_index) * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash);
-      bool valid = hash == m_blocks_hash_of_hashes[n];
-
-      // add to the known hashes array
-      if (!valid)
-      {
-        MWARNING("invalid hash for blocks " << n * HASH_OF_HASHES_STEP << " - " << (n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP - 1));
-        break;
-      }
-
-      size_t end = n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP;
-      for (size_t i = n * HASH_OF_HASHES_STEP; i < end; ++i)
-      {
-        CHECK_AND_ASSERT_MES(m_blocks_hash_check[i] == crypto::null_hash || m_blocks_hash_check[i] == data[i - first_index * HASH_OF_HASHES_STEP],
-            0, "Consistency failure in m_blocks_hash_check construction");
-        m_blocks_hash_check[i] = data[i - first_index * HASH_OF_HASHES_STEP];
-      }
-      usable += HASH_OF_HASHES_STEP;
-    }
-    else
-    {
-      // if after the end of the precomputed blocks, accept anything
-      usable += HASH_OF_HASHES_STEP;
-      if (usable > hashes.size())
-        usable = hashes.size();
-    }
-  }
-  MDEBUG("usable: " << usable << " / " << hashes.size());
-  CHECK_AND_ASSERT_MES(usable < std::numeric_limits<uint64_t>::max() / 2, 0, "usable is negative");
-  return usable;
+  // called from the p2p threads: the prevalidated hashes are changed by
+  // cleanup_handle_incoming_blocks under the same lock
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_block_hash_check.prevalidate(height, hashes, m_db->height(), [this](uint64_t h) { return m_db->get_block_hash_from_height(h); });
 }
 
 //------------------------------------------------------------------
@@ -3943,7 +3977,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
     m_blockchain_lock.lock();
   }
 
-  if ((m_db->height() + blocks_entry.size()) < m_blocks_hash_check.size())
+  if (is_within_compiled_block_hash_area(m_db->height() + blocks_entry.size()))
     return true;
 
   bool blocks_exist = false;
@@ -4410,16 +4444,9 @@ void Blockchain::load_compiled_in_block_hashes()
       const size_t size_needed = 4 + nblocks * sizeof(crypto::hash);
       if(nblocks > 0 && nblocks > (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP && get_blocks_dat_size(testnet, stagenet) >= size_needed)
       {
-        p += sizeof(uint32_t);
-        m_blocks_hash_of_hashes.reserve(nblocks);
-        for (uint32_t i = 0; i < nblocks; i++)
-        {
-          crypto::hash hash;
-          memcpy(hash.data, p, sizeof(hash.data));
-          p += sizeof(hash.data);
-          m_blocks_hash_of_hashes.push_back(hash);
-        }
-        m_blocks_hash_check.resize(m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP, crypto::null_hash);
+        // used in place: crypto::hash is a plain byte array, so needs no alignment
+        static_assert(alignof(crypto::hash) == 1, "crypto::hash must not need alignment");
+        m_block_hash_check.set_hash_of_hashes(reinterpret_cast<const crypto::hash*>(p + sizeof(uint32_t)), nblocks);
         MINFO(nblocks << " block hashes loaded");
 
         // FIXME: clear tx_pool because the process might have been
@@ -4450,7 +4477,8 @@ void Blockchain::load_compiled_in_block_hashes()
 bool Blockchain::is_within_compiled_block_hash_area(uint64_t height) const
 {
 #if defined(PER_BLOCK_CHECKPOINT)
-  return height < m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP;
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_block_hash_check.is_within_area(height);
 #else
   return false;
 #endif
@@ -38,6 +38,8 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <atomic>
+#include <deque>
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -49,6 +51,8 @@
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/difficulty.h"
 #include "cryptonote_tx_utils.h"
+#include "verified_tx_cache.h"
+#include "block_hash_check.h"
 #include "cryptonote_basic/verification_context.h"
 #include "crypto/hash.h"
 #include "checkpoints/checkpoints.h"
@@ -256,6 +260,19 @@ namespace cryptonote
      */
     bool have_tx_keyimg_as_spent(const crypto::key_image &key_im) const;
 
+    /**
+     * @brief check if several key images are already spent on the blockchain
+     *
+     * Batch version of have_tx_keyimg_as_spent().  Large batches are split
+     * over the threadpool, and each slice is looked up in db key order.
+     *
+     * @param key_images the key images to search for
+     * @param spent return-by-reference whether each key image is spent
+     *
+     * @return true
+     */
+    bool are_key_images_spent(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent) const;
+
     /**
      * @brief get the current height of the blockchain
      *
@@ -972,6 +989,16 @@ namespace cryptonote
 
     typedef std::map<uint64_t, std::vector<std::pair<crypto::hash, size_t>>> outputs_container; //crypto::hash - tx hash, size_t - index of out in transaction
 
+    // a v1 input's ring signature, along with what is needed to check it
+    struct ring_signature_entry
+    {
+      crypto::hash tx_prefix_hash;
+      crypto::key_image key_image;
+      std::vector<rct::ctkey> pubkeys;
+      std::vector<crypto::signature> sig;
+    };
+    typedef std::vector<ring_signature_entry> ring_signature_batch;
+
 
     BlockchainDB* m_db;
 
@@ -990,8 +1017,7 @@ namespace cryptonote
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, bool>> m_check_txin_table;
 
     // SHA-3 hashes for each block and for fast pow checking
-    std::vector<crypto::hash> m_blocks_hash_of_hashes;
-    std::vector<crypto::hash> m_blocks_hash_check;
+    block_hash_check m_block_hash_check;
     std::vector<crypto::hash> m_blocks_txs_check;
 
     blockchain_db_sync_mode m_db_sync_mode;
@@ -1003,9 +1029,23 @@ namespace cryptonote
     uint64_t m_fake_pow_calc_time;
     uint64_t m_fake_scan_time;
     uint64_t m_sync_counter;
-    std::vector<uint64_t> m_timestamps;
-    std::vector<difficulty_type> m_difficulties;
-    uint64_t m_timestamps_and_difficulties_height;
+
+    // rolling windows over the top of the main chain, valid for the chain
+    // height in m_rolling_windows_height (0 when they need reloading)
+    mutable difficulty_window m_difficulty_window;
+    mutable tools::rolling_window<size_t> m_block_sizes_window;
+    mutable tools::rolling_window<uint64_t> m_timestamps_window;
+    mutable uint64_t m_rolling_windows_height;
+
+    // difficulty windows ending at recently seen alt chain blocks, and at the
+    // main chain blocks they fork from, by block hash
+    mutable std::unordered_map<crypto::hash, difficulty_window> m_alt_difficulty_windows;
+    mutable std::deque<crypto::hash> m_alt_difficulty_windows_order;
+
+    // txids of recently verified transactions, with the ring members and
+    // hard fork version they were verified against, so transactions mined
+    // from the pool do not have their signatures checked twice
+    verified_tx_cache m_verified_txes;
 
     boost::asio::io_service m_async_service;
     boost::thread_group m_async_pool;
@@ -1083,16 +1123,18 @@ namespace cryptonote
      * If pmax_related_block_height is not NULL, its value is set to the height
      * of the most recent block which contains an output used in any input set
      *
-     * Currently this function calls ring signature validation for each
-     * transaction.
+     * The ring signatures of v1 transactions are checked as one batch per
+     * transaction, unless batch is not NULL, in which case they are added to
+     * it for the caller to check along with those of other transactions.
      *
      * @param tx the transaction to validate
      * @param tvc returned information about tx verification
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
+     * @param batch if not NULL, where to queue the v1 ring signatures instead of checking them
      *
      * @return false if any validation step fails, otherwise true
      */
-    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL);
+    bool check_tx_inputs(transaction& tx, tx_verification_context &tvc, uint64_t* pmax_used_block_height = NULL, ring_signature_batch *batch = NULL);
 
     /**
      * @brief performs a blockchain reorganization according to the longest chain rule
@@ -1169,6 +1211,14 @@ namespace cryptonote
      */
     difficulty_type get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei) const;
 
+    /**
+     * @brief caches the difficulty window ending at a given block, evicting the oldest if full
+     *
+     * @param id the hash of the last block in the window
+     * @param window the difficulty window
+     */
+    void add_alt_difficulty_window(const crypto::hash &id, const difficulty_window &window) const;
+
     /**
      * @brief sanity checks a miner transaction before validating an entire block
      *
@@ -1310,6 +1360,16 @@ namespace cryptonote
      */
     bool check_block_timestamp(std::vector<uint64_t>& timestamps, const block& b) const;
 
+    /**
+     * @brief checks a block's timestamp against the median of the recent ones
+     *
+     * @param median_ts the median of the recent timestamps
+     * @param b the block to be checked
+     *
+     * @return true if the block's timestamp is not less than median_ts
+     */
+    bool check_block_timestamp_median(uint64_t median_ts, const block& b) const;
+
     /**
      * @brief get the "adjusted time"
      *
@@ -1339,6 +1399,14 @@ namespace cryptonote
      * @return true
      */
     bool update_next_cumulative_size_limit();
+
+    /**
+     * @brief brings the rolling windows over the top of the main chain up to date
+     *
+     * This only reads the top block when one block was added since the last
+     * call, and reloads the windows otherwise.
+     */
+    void update_rolling_windows() const;
     void return_tx_to_pool(std::vector<transaction> &txs);
 
     /**
@@ -1352,16 +1420,27 @@ namespace cryptonote
     bool check_for_double_spend(const transaction& tx, key_images_container& keys_this_block) const;
 
     /**
-     * @brief validates a transaction input's ring signature
+     * @brief validates a batch of transaction inputs' ring signatures
+     *
+     * The batch is split across the threadpool, each thread checking its
+     * share with a single call to crypto::check_ring_signatures. The result
+     * of each input is recorded in m_check_txin_table.
+     *
+     * @param batch the ring signatures to check
+     *
+     * @return false if any ring signature is invalid, otherwise true
+     */
+    bool check_ring_signatures(const ring_signature_batch &batch);
+
+    /**
+     * @brief checks the ringct signatures of an expanded v2 transaction
+     *
+     * @param tx the transaction, expanded with expand_transaction_2
+     * @param pubkeys the outputs each input's ring resolves to
      *
-     * @param tx_prefix_hash the transaction prefix' hash
-     * @param key_image the key image generated from the true input
-     * @param pubkeys the public keys for each input in the ring signature
-     * @param sig the signature generated for each input in the ring signature
-     * @param result false if the ring signature is invalid, otherwise true
+     * @return true if the signatures verify against the ring members
      */
-    void check_ring_signature(const crypto::hash &tx_prefix_hash, const crypto::key_image &key_image,
-        const std::vector<rct::ctkey> &pubkeys, const std::vector<crypto::signature> &sig, uint64_t &result);
+    bool check_rct_signatures(const transaction &tx, const std::vector<std::vector<rct::ctkey>> &pubkeys) const;
 
     /**
      * @brief loads block hashes from compiled-in data set
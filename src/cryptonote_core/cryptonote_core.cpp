@@ -137,6 +137,11 @@ namespace cryptonote
   , "How many blocks to sync at once during chain synchronization (0 = adaptive)."
   , 0
   };
+  static const command_line::arg_descriptor<size_t> arg_block_download_max_size  = {
+    "block-download-max-size"
+  , "Maximum size in bytes of downloaded blocks queued for processing during chain synchronization."
+  , BLOCKS_DOWNLOAD_MAX_SIZE_DEFAULT
+  };
   static const command_line::arg_descriptor<std::string> arg_check_updates = {
     "check-updates"
   , "Check for new versions of monero: [disabled|notify|download|update]"
@@ -257,6 +262,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_fast_block_sync);
     command_line::add_arg(desc, arg_show_time_stats);
     command_line::add_arg(desc, arg_block_sync_size);
+    command_line::add_arg(desc, arg_block_download_max_size);
     command_line::add_arg(desc, arg_check_updates);
     command_line::add_arg(desc, arg_fluffy_blocks);
     command_line::add_arg(desc, arg_no_fluffy_blocks);
@@ -521,6 +527,7 @@ namespace cryptonote
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
 
     block_sync_size = command_line::get_arg(vm, arg_block_sync_size);
+    block_download_max_size = command_line::get_arg(vm, arg_block_download_max_size);
 
     MGINFO("Loading checkpoints");
 
@@ -706,6 +713,12 @@ namespace cryptonote
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay)
+  {
+    std::vector<crypto::hash> tx_hashes;
+    return handle_incoming_txs(tx_blobs, tvc, tx_hashes, keeped_by_block, relayed, do_not_relay);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, std::vector<crypto::hash>& tx_hashes, bool keeped_by_block, bool relayed, bool do_not_relay)
   {
     TRY_ENTRY();
 
@@ -759,6 +772,7 @@ namespace cryptonote
     waiter.wait();
 
     bool ok = true;
+    tx_hashes.assign(tx_blobs.size(), crypto::null_hash);
     it = tx_blobs.begin();
     for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
       if (!results[i].res)
@@ -766,6 +780,7 @@ namespace cryptonote
         ok = false;
         continue;
       }
+      tx_hashes[i] = results[i].hash;
 
       ok &= add_new_tx(results[i].tx, results[i].hash, results[i].prefix_hash, it->size(), tvc[i], keeped_by_block, relayed, do_not_relay);
       if(tvc[i].m_verifivation_failed)
@@ -791,6 +806,18 @@ namespace cryptonote
     return r;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, crypto::hash& tx_hash, bool keeped_by_block, bool relayed, bool do_not_relay)
+  {
+    std::list<cryptonote::blobdata> tx_blobs;
+    tx_blobs.push_back(tx_blob);
+    std::vector<tx_verification_context> tvcv(1);
+    std::vector<crypto::hash> tx_hashes;
+    bool r = handle_incoming_txs(tx_blobs, tvcv, tx_hashes, keeped_by_block, relayed, do_not_relay);
+    tvc = tvcv[0];
+    tx_hash = tx_hashes[0];
+    return r;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_stat_info(core_stat_info& st_inf) const
   {
     st_inf.mining_speed = m_miner.get_speed();
@@ -915,12 +942,7 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::are_key_images_spent(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
   {
-    spent.clear();
-    for(auto& ki: key_im)
-    {
-      spent.push_back(m_blockchain_storage.have_tx_keyimg_as_spent(ki));
-    }
-    return true;
+    return m_blockchain_storage.are_key_images_spent(key_im, spent);
   }
   //-----------------------------------------------------------------------------------------------
   size_t core::get_block_sync_size(uint64_t height) const
@@ -933,11 +955,16 @@ namespace cryptonote
     return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT_PRE_V4;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
+  size_t core::get_block_download_max_size() const
+  {
+    return block_download_max_size;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_sensitive_data) const
   {
     spent.clear();
 
-    return m_mempool.check_for_key_images(key_im, spent);
+    return m_mempool.check_for_key_images(key_im, spent, include_sensitive_data);
   }
   //-----------------------------------------------------------------------------------------------
   std::pair<uint64_t, uint64_t> core::get_coinbase_tx_sum(const uint64_t start_offset, const size_t count)
@@ -1052,28 +1079,21 @@ namespace cryptonote
       cryptonote_connection_context fake_context = AUTO_VAL_INIT(fake_context);
       tx_verification_context tvc = AUTO_VAL_INIT(tvc);
       NOTIFY_NEW_TRANSACTIONS::request r;
+      std::vector<crypto::hash> tx_hashes;
       for (auto it = txs.begin(); it != txs.end(); ++it)
       {
         r.txs.push_back(it->second);
+        tx_hashes.push_back(it->first);
       }
-      get_protocol()->relay_transactions(r, fake_context);
-      m_mempool.set_relayed(txs);
+      get_protocol()->relay_transactions(r, tx_hashes, fake_context);
+      m_mempool.set_relayed(tx_hashes);
     }
     return true;
   }
   //-----------------------------------------------------------------------------------------------
-  void core::on_transaction_relayed(const cryptonote::blobdata& tx_blob)
+  void core::on_transactions_relayed(const std::vector<crypto::hash>& tx_hashes)
   {
-    std::list<std::pair<crypto::hash, cryptonote::blobdata>> txs;
-    cryptonote::transaction tx;
-    crypto::hash tx_hash, tx_prefix_hash;
-    if (!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, tx_prefix_hash))
-    {
-      LOG_ERROR("Failed to parse relayed transaction");
-      return;
-    }
-    txs.push_back(std::make_pair(tx_hash, std::move(tx_blob)));
-    m_mempool.set_relayed(txs);
+    m_mempool.set_relayed(tx_hashes);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::get_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce)
@@ -1183,7 +1203,7 @@ namespace cryptonote
       for(auto& tx:  txs)
         arg.b.txs.push_back(tx);
 
-      m_pprotocol->relay_block(arg, exclude_context);
+      m_pprotocol->relay_block(arg, get_block_hash(b), b.tx_hashes, exclude_context);
     }
     return bvc.m_added_to_main_chain;
   }
@@ -1225,6 +1245,12 @@ namespace cryptonote
 
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate)
+  {
+    block b = AUTO_VAL_INIT(b);
+    return handle_incoming_block(block_blob, bvc, b, update_miner_blocktemplate);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, block& b, bool update_miner_blocktemplate)
   {
     TRY_ENTRY();
 
@@ -1240,7 +1266,6 @@ namespace cryptonote
       return false;
     }
 
-    block b = AUTO_VAL_INIT(b);
     if(!parse_and_validate_block_from_blob(block_blob, b))
     {
       LOG_PRINT_L1("Failed to parse and validate new block");
@@ -1320,6 +1345,16 @@ namespace cryptonote
     return m_mempool.get_transaction(id, tx);
   }  
   //-----------------------------------------------------------------------------------------------
+  bool core::get_pool_transaction(const crypto::hash &id, cryptonote::blobdata& tx, bool& double_spend_seen) const
+  {
+    return m_mempool.get_transaction(id, tx, double_spend_seen);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::get_relayed_pool_transaction(const crypto::hash &id, cryptonote::blobdata& tx) const
+  {
+    return m_mempool.get_relayed_transaction(id, tx);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::pool_has_tx(const crypto::hash &id) const
   {
     return m_mempool.have_tx(id);
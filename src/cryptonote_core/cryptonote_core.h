@@ -120,6 +120,13 @@ namespace cryptonote
       */
      bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block, bool relayed, bool do_not_relay);
 
+     /**
+      * @copydoc handle_incoming_tx
+      *
+      * @param tx_hash return-by-reference the hash of the transaction, if it parsed
+      */
+     bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, crypto::hash& tx_hash, bool keeped_by_block, bool relayed, bool do_not_relay);
+
      /**
       * @brief handles a list of incoming transactions
       *
@@ -136,6 +143,14 @@ namespace cryptonote
       */
      bool handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay);
 
+     /**
+      * @copydoc handle_incoming_txs
+      *
+      * @param tx_hashes return-by-reference the hashes of the transactions,
+      *        null for those which did not parse
+      */
+     bool handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, std::vector<crypto::hash>& tx_hashes, bool keeped_by_block, bool relayed, bool do_not_relay);
+
      /**
       * @brief handles an incoming block
       *
@@ -152,6 +167,13 @@ namespace cryptonote
       */
      bool handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate = true);
 
+     /**
+      * @copydoc handle_incoming_block
+      *
+      * @param b return-by-reference the block, if it parsed
+      */
+     bool handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, block& b, bool update_miner_blocktemplate = true);
+
      /**
       * @copydoc Blockchain::prepare_handle_incoming_blocks
       *
@@ -205,9 +227,11 @@ namespace cryptonote
      virtual bool get_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce);
 
      /**
-      * @brief called when a transaction is relayed
+      * @brief called when transactions are relayed
+      *
+      * @param tx_hashes the hashes of the relayed transactions
       */
-     virtual void on_transaction_relayed(const cryptonote::blobdata& tx);
+     virtual void on_transactions_relayed(const std::vector<crypto::hash>& tx_hashes);
 
 
      /**
@@ -462,6 +486,20 @@ namespace cryptonote
       */
      bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx) const;
 
+     /**
+      * @copydoc tx_memory_pool::get_transaction(const crypto::hash&, cryptonote::blobdata&, bool&) const
+      *
+      * @note see tx_memory_pool::get_transaction
+      */
+     bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx, bool& double_spend_seen) const;
+
+     /**
+      * @copydoc tx_memory_pool::get_relayed_transaction
+      *
+      * @note see tx_memory_pool::get_relayed_transaction
+      */
+     bool get_relayed_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx) const;
+
      /**
       * @copydoc tx_memory_pool::get_pool_transactions_and_spent_keys_info
       * @param include_unrelayed_txes include unrelayed txes in result
@@ -719,10 +757,11 @@ namespace cryptonote
       *
       * @param key_im list of key images to check
       * @param spent return-by-reference result for each image checked
+      * @param include_sensitive_data include key images from unrelayed txes
       *
       * @return true
       */
-     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const;
+     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_sensitive_data = true) const;
 
      /**
       * @brief get the number of blocks to sync in one go
@@ -731,6 +770,13 @@ namespace cryptonote
       */
      size_t get_block_sync_size(uint64_t height) const;
 
+     /**
+      * @brief get the maximum size of downloaded blocks waiting to be processed
+      *
+      * @return the block queue memory budget, in bytes
+      */
+     size_t get_block_download_max_size() const;
+
      /**
       * @brief get the sum of coinbase tx amounts between blocks
       *
@@ -978,6 +1024,7 @@ namespace cryptonote
      bool m_disable_dns_checkpoints;
 
      size_t block_sync_size;
+     size_t block_download_max_size;
 
      time_t start_time;
 
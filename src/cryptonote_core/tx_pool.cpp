@@ -44,6 +44,7 @@
 #include "misc_language.h"
 #include "warnings.h"
 #include "common/perf_timer.h"
+#include "metrics.h"
 #include "crypto/hash.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -113,6 +114,11 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
     PERF_TIMER(add_tx);
+    static epee::metrics::counter &txs_rejected = epee::metrics::get_counter("txpool_txs_rejected_total", "Transactions which failed verification on entry to the pool");
+    epee::misc_utils::auto_scope_leave_caller rejected_counter = epee::misc_utils::create_scope_leave_handler([&tvc]() {
+      if (tvc.m_verifivation_failed)
+        txs_rejected.inc();
+    });
     if (tx.version == 0)
     {
       // v0 never accepted
@@ -303,6 +309,8 @@ namespace cryptonote
 
     tvc.m_verifivation_failed = false;
     m_txpool_size += blob_size;
+    static epee::metrics::counter &txs_added = epee::metrics::get_counter("txpool_txs_added_total", "Transactions added to the pool");
+    txs_added.inc();
 
     MINFO("Transaction added to pool: txid " << id << " bytes: " << blob_size << " fee/byte: " << (fee / (double)blob_size));
 
@@ -373,6 +381,8 @@ namespace cryptonote
         m_blockchain.remove_txpool_tx(txid);
         m_txpool_size -= txblob.size();
         remove_transaction_keyimages(tx);
+        static epee::metrics::counter &txs_pruned = epee::metrics::get_counter("txpool_txs_removed_total{reason=\"pruned\"}", "Transactions removed from the pool");
+        txs_pruned.inc();
         MINFO("Pruned tx " << txid << " from txpool: size: " << it->first.second << ", fee/byte: " << it->first.first);
         m_txs_by_fee_and_receive_time.erase(it--);
       }
@@ -470,6 +480,8 @@ namespace cryptonote
       m_blockchain.remove_txpool_tx(id);
       m_txpool_size -= blob_size;
       remove_transaction_keyimages(tx);
+      static epee::metrics::counter &txs_mined = epee::metrics::get_counter("txpool_txs_removed_total{reason=\"mined\"}", "Transactions removed from the pool");
+      txs_mined.inc();
     }
     catch (const std::exception &e)
     {
@@ -543,6 +555,8 @@ namespace cryptonote
             m_blockchain.remove_txpool_tx(txid);
             m_txpool_size -= bd.size();
             remove_transaction_keyimages(tx);
+            static epee::metrics::counter &txs_expired = epee::metrics::get_counter("txpool_txs_removed_total{reason=\"expired\"}", "Transactions removed from the pool");
+            txs_expired.inc();
           }
         }
         catch (const std::exception &e)
@@ -588,7 +602,7 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  void tx_memory_pool::set_relayed(const std::list<std::pair<crypto::hash, cryptonote::blobdata>> &txs)
+  void tx_memory_pool::set_relayed(const std::vector<crypto::hash> &txs)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
@@ -599,11 +613,11 @@ namespace cryptonote
       try
       {
         txpool_tx_meta_t meta;
-        if (m_blockchain.get_txpool_tx_meta(it->first, meta))
+        if (m_blockchain.get_txpool_tx_meta(*it, meta))
         {
           meta.relayed = true;
           meta.last_relayed_time = now;
-          m_blockchain.update_txpool_tx(it->first, meta);
+          m_blockchain.update_txpool_tx(*it, meta);
         }
       }
       catch (const std::exception &e)
@@ -852,16 +866,41 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool> spent) const
+  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_sensitive_data) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
 
     spent.clear();
+    spent.reserve(key_images.size());
 
+    txpool_tx_meta_t meta;
     for (const auto& image : key_images)
     {
-      spent.push_back(m_spent_key_images.find(image) == m_spent_key_images.end() ? false : true);
+      const auto i = m_spent_key_images.find(image);
+      bool found = i != m_spent_key_images.end();
+      if (found && !include_sensitive_data)
+      {
+        // in restricted mode, only key images spent by a relayed tx are visible
+        found = false;
+        try
+        {
+          for (const crypto::hash& txid: i->second)
+          {
+            if (m_blockchain.get_txpool_tx_meta(txid, meta) && meta.relayed)
+            {
+              found = true;
+              break;
+            }
+          }
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to get tx meta from txpool: " << e.what());
+          return false;
+        }
+      }
+      spent.push_back(found);
     }
 
     return true;
@@ -881,6 +920,41 @@ namespace cryptonote
     }
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_transaction(const crypto::hash& id, cryptonote::blobdata& txblob, bool& double_spend_seen) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+    try
+    {
+      txpool_tx_meta_t meta;
+      if (!m_blockchain.get_txpool_tx_meta(id, meta) || !m_blockchain.get_txpool_tx_blob(id, txblob))
+        return false;
+      double_spend_seen = meta.double_spend_seen;
+      return true;
+    }
+    catch (const std::exception &e)
+    {
+      return false;
+    }
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_relayed_transaction(const crypto::hash& id, cryptonote::blobdata& txblob) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+    try
+    {
+      txpool_tx_meta_t meta;
+      if (!m_blockchain.get_txpool_tx_meta(id, meta) || !meta.relayed || meta.do_not_relay)
+        return false;
+      return m_blockchain.get_txpool_tx_blob(id, txblob);
+    }
+    catch (const std::exception &e)
+    {
+      return false;
+    }
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
     return true;
@@ -296,10 +296,11 @@ namespace cryptonote
      *
      * @param key_images [in] vector of key images to check
      * @param spent [out] vector of bool to return
+     * @param include_sensitive_data [in] also count key images only spent by unrelayed txes
      *
      * @return true
      */
-    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool> spent) const;
+    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_sensitive_data = true) const;
 
     /**
      * @brief get a specific transaction from the pool
@@ -311,6 +312,30 @@ namespace cryptonote
      */
     bool get_transaction(const crypto::hash& h, cryptonote::blobdata& txblob) const;
 
+    /**
+     * @brief get a specific transaction from the pool, with its double spend status
+     *
+     * @param h the hash of the transaction to get
+     * @param txblob return-by-reference the transaction blob requested
+     * @param double_spend_seen return-by-reference whether a double spend was seen for it
+     *
+     * @return true if the transaction is found, otherwise false
+     */
+    bool get_transaction(const crypto::hash& h, cryptonote::blobdata& txblob, bool& double_spend_seen) const;
+
+    /**
+     * @brief get a specific transaction from the pool, if it may be sent to peers
+     *
+     * Transactions which were never relayed, or are flagged do_not_relay,
+     * are not returned.
+     *
+     * @param h the hash of the transaction to get
+     * @param txblob return-by-reference the transaction blob requested
+     *
+     * @return true if the transaction is found and was relayed, otherwise false
+     */
+    bool get_relayed_transaction(const crypto::hash& h, cryptonote::blobdata& txblob) const;
+
     /**
      * @brief get a list of all relayable transactions and their hashes
      *
@@ -329,9 +354,9 @@ namespace cryptonote
     /**
      * @brief tell the pool that certain transactions were just relayed
      *
-     * @param txs the list of transactions (and their hashes)
+     * @param txs the hashes of the transactions
      */
-    void set_relayed(const std::list<std::pair<crypto::hash, cryptonote::blobdata>>& txs);
+    void set_relayed(const std::vector<crypto::hash>& txs);
 
     /**
      * @brief get the total number of transactions in the pool
@@ -0,0 +1,68 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "verified_tx_cache.h"
+
+namespace cryptonote
+{
+
+verified_tx_cache::verified_tx_cache(size_t max_entries):
+  m_max_entries(max_entries)
+{
+}
+
+bool verified_tx_cache::is_verified(const crypto::hash &txid, const crypto::hash &ring_members_hash, uint8_t hf_version) const
+{
+  const auto i = m_entries.find(txid);
+  return i != m_entries.end() && i->second.ring_members_hash == ring_members_hash && i->second.hf_version == hf_version;
+}
+
+void verified_tx_cache::add(const crypto::hash &txid, const crypto::hash &ring_members_hash, uint8_t hf_version)
+{
+  const auto i = m_entries.find(txid);
+  if (i != m_entries.end())
+  {
+    i->second = {ring_members_hash, hf_version};
+    return;
+  }
+  m_entries.emplace(txid, entry{ring_members_hash, hf_version});
+  m_order.push_back(txid);
+  while (m_order.size() > m_max_entries)
+  {
+    m_entries.erase(m_order.front());
+    m_order.pop_front();
+  }
+}
+
+void verified_tx_cache::clear()
+{
+  m_entries.clear();
+  m_order.clear();
+}
+
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /* Bounded FIFO of transactions whose signatures verified, with the     */
+  /* ring members and hard fork version they were verified against, so   */
+  /* transactions mined from the pool do not have them checked twice     */
+  /************************************************************************/
+  class verified_tx_cache
+  {
+  public:
+    verified_tx_cache(size_t max_entries);
+
+    bool is_verified(const crypto::hash &txid, const crypto::hash &ring_members_hash, uint8_t hf_version) const;
+    void add(const crypto::hash &txid, const crypto::hash &ring_members_hash, uint8_t hf_version);
+    size_t size() const { return m_entries.size(); }
+    void clear();
+
+    /**
+     * @brief runs verify unless the transaction already verified against the
+     * same ring members and hard fork version, and records it if verify passes
+     *
+     * @return true if the transaction was verified before or verify passed
+     */
+    template<typename F>
+    bool check(const crypto::hash &txid, const crypto::hash &ring_members_hash, uint8_t hf_version, F verify)
+    {
+      if (is_verified(txid, ring_members_hash, hf_version))
+        return true;
+      if (!verify())
+        return false;
+      add(txid, ring_members_hash, hf_version);
+      return true;
+    }
+
+  private:
+    struct entry
+    {
+      crypto::hash ring_members_hash;
+      uint8_t hf_version;
+    };
+
+    size_t m_max_entries;
+    std::unordered_map<crypto::hash, entry> m_entries;
+    std::deque<crypto::hash> m_order;
+  };
+}
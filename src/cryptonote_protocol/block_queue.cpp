@@ -50,21 +50,79 @@ namespace std {
 namespace cryptonote
 {
 
-void block_queue::add_blocks(uint64_t height, std::list<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size)
+bool block_queue::add_span(span &&s)
+{
+  const uint64_t height = s.start_block_height;
+  auto i = blocks.find(height);
+  if (i != blocks.end())
+    return false;
+  i = blocks.insert(std::make_pair(height, std::move(s))).first;
+  index_span(i->second);
+  return true;
+}
+
+block_queue::block_map::iterator block_queue::erase_span(block_map::iterator i)
+{
+  unindex_span(i->second);
+  return blocks.erase(i);
+}
+
+void block_queue::index_span(const span &s)
+{
+  for (const auto &h: s.hashes)
+    ++requested_hashes[h];
+  if (!s.blocks.empty())
+    filled_spans.insert(s.start_block_height);
+  data_size += s.size;
+}
+
+void block_queue::unindex_span(const span &s)
+{
+  for (const auto &h: s.hashes)
+  {
+    auto i = requested_hashes.find(h);
+    if (i != requested_hashes.end() && --i->second == 0)
+      requested_hashes.erase(i);
+  }
+  filled_spans.erase(s.start_block_height);
+  data_size -= s.size;
+}
+
+block_queue::block_map::const_iterator block_queue::first_span() const
+{
+  block_map::const_iterator i = blocks.begin();
+  if (i != blocks.end() && is_blockchain_placeholder(i->second))
+    ++i;
+  return i;
+}
+
+block_queue::block_map::const_iterator block_queue::first_filled_span() const
+{
+  for (uint64_t height: filled_spans)
+  {
+    block_map::const_iterator i = blocks.find(height);
+    if (i != blocks.end() && !is_blockchain_placeholder(i->second))
+      return i;
+  }
+  return blocks.end();
+}
+
+void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size)
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  std::list<crypto::hash> hashes;
+  std::vector<crypto::hash> hashes;
   bool has_hashes = remove_span(height, &hashes);
-  blocks.insert(span(height, std::move(bcel), connection_id, rate, size));
+  span s(height, std::move(bcel), connection_id, rate, size);
   if (has_hashes)
-    set_span_hashes(height, connection_id, hashes);
+    s.hashes = std::move(hashes);
+  add_span(std::move(s));
 }
 
 void block_queue::add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, boost::posix_time::ptime time)
 {
   CHECK_AND_ASSERT_THROW_MES(nblocks > 0, "Empty span");
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  blocks.insert(span(height, nblocks, connection_id, time));
+  add_span(span(height, nblocks, connection_id, time));
 }
 
 void block_queue::flush_spans(const boost::uuids::uuid &connection_id, bool all)
@@ -73,11 +131,10 @@ void block_queue::flush_spans(const boost::uuids::uuid &connection_id, bool all)
   block_map::iterator i = blocks.begin();
   while (i != blocks.end())
   {
-    block_map::iterator j = i++;
-    if (j->connection_id == connection_id && (all || j->blocks.size() == 0))
-    {
-      blocks.erase(j);
-    }
+    if (i->second.connection_id == connection_id && (all || i->second.blocks.size() == 0))
+      i = erase_span(i);
+    else
+      ++i;
   }
 }
 
@@ -85,44 +142,39 @@ void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_con
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   block_map::iterator i = blocks.begin();
-  if (i != blocks.end() && is_blockchain_placeholder(*i))
+  if (i != blocks.end() && is_blockchain_placeholder(i->second))
     ++i;
   while (i != blocks.end())
   {
-    block_map::iterator j = i++;
-    if (live_connections.find(j->connection_id) == live_connections.end() && j->blocks.size() == 0)
-    {
-      blocks.erase(j);
-    }
+    if (live_connections.find(i->second.connection_id) == live_connections.end() && i->second.blocks.size() == 0)
+      i = erase_span(i);
+    else
+      ++i;
   }
 }
 
-bool block_queue::remove_span(uint64_t start_block_height, std::list<crypto::hash> *hashes)
+bool block_queue::remove_span(uint64_t start_block_height, std::vector<crypto::hash> *hashes)
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  for (block_map::iterator i = blocks.begin(); i != blocks.end(); ++i)
-  {
-    if (i->start_block_height == start_block_height)
-    {
-      if (hashes)
-        *hashes = std::move(i->hashes);
-      blocks.erase(i);
-      return true;
-    }
-  }
-  return false;
+  block_map::iterator i = blocks.find(start_block_height);
+  if (i == blocks.end())
+    return false;
+  unindex_span(i->second);
+  if (hashes)
+    *hashes = std::move(i->second.hashes);
+  blocks.erase(i);
+  return true;
 }
 
 void block_queue::remove_spans(const boost::uuids::uuid &connection_id, uint64_t start_block_height)
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  for (block_map::iterator i = blocks.begin(); i != blocks.end(); )
+  for (block_map::iterator i = blocks.begin(); i != blocks.end() && i->first <= start_block_height; )
   {
-    block_map::iterator j = i++;
-    if (j->connection_id == connection_id && j->start_block_height <= start_block_height)
-    {
-      blocks.erase(j);
-    }
+    if (i->second.connection_id == connection_id)
+      i = erase_span(i);
+    else
+      ++i;
   }
 }
 
@@ -130,8 +182,9 @@ uint64_t block_queue::get_max_block_height() const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   uint64_t height = 0;
-  for (const auto &span: blocks)
+  for (const auto &e: blocks)
   {
+    const span &span = e.second;
     const uint64_t h = span.start_block_height + span.nblocks - 1;
     if (h > height)
       height = h;
@@ -143,8 +196,11 @@ void block_queue::print() const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   MDEBUG("Block queue has " << blocks.size() << " spans");
-  for (const auto &span: blocks)
+  for (const auto &e: blocks)
+  {
+    const span &span = e.second;
     MDEBUG("  " << span.start_block_height << " - " << (span.start_block_height+span.nblocks-1) << " (" << span.nblocks << ") - " << (is_blockchain_placeholder(span) ? "blockchain" : span.blocks.empty() ? "scheduled" : "filled    ") << "  " << span.connection_id << " (" << ((unsigned)(span.rate*10/1024.f))/10.f << " kB/s)");
+  }
 }
 
 std::string block_queue::get_overview() const
@@ -153,9 +209,9 @@ std::string block_queue::get_overview() const
   if (blocks.empty())
     return "[]";
   block_map::const_iterator i = blocks.begin();
-  std::string s = std::string("[") + std::to_string(i->start_block_height + i->nblocks - 1) + ":";
+  std::string s = std::string("[") + std::to_string(i->second.start_block_height + i->second.nblocks - 1) + ":";
   while (++i != blocks.end())
-    s += i->blocks.empty() ? "." : "o";
+    s += i->second.blocks.empty() ? "." : "o";
   s += "]";
   return s;
 }
@@ -163,13 +219,7 @@ std::string block_queue::get_overview() const
 bool block_queue::requested(const crypto::hash &hash) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  for (const auto &span: blocks)
-  {
-    for (const auto &h: span.hashes)
-      if (h == hash)
-        return true;
-  }
-  return false;
+  return requested_hashes.find(hash) != requested_hashes.end();
 }
 
 std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_height, uint64_t last_block_height, uint64_t max_blocks, const boost::uuids::uuid &connection_id, const std::list<crypto::hash> &block_hashes, boost::posix_time::ptime time)
@@ -190,7 +240,8 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
     ++span_start_height;
   }
   uint64_t span_length = 0;
-  std::list<crypto::hash> hashes;
+  std::vector<crypto::hash> hashes;
+  hashes.reserve(std::min<uint64_t>(max_blocks, block_hashes.size()));
   while (i != block_hashes.end() && span_length < max_blocks)
   {
     hashes.push_back(*i);
@@ -201,7 +252,7 @@ std::pair<uint64_t, uint64_t> block_queue::reserve_span(uint64_t first_block_hei
     return std::make_pair(0, 0);
   MDEBUG("Reserving span " << span_start_height << " - " << (span_start_height + span_length - 1) << " for " << connection_id);
   add_blocks(span_start_height, span_length, connection_id, time);
-  set_span_hashes(span_start_height, connection_id, hashes);
+  set_span_hashes(span_start_height, connection_id, std::move(hashes));
   return std::make_pair(span_start_height, span_length);
 }
 
@@ -216,13 +267,13 @@ std::pair<uint64_t, uint64_t> block_queue::get_start_gap_span() const
   if (blocks.empty())
     return std::make_pair(0, 0);
   block_map::const_iterator i = blocks.begin();
-  if (!is_blockchain_placeholder(*i))
+  if (!is_blockchain_placeholder(i->second))
     return std::make_pair(0, 0);
-  uint64_t current_height = i->start_block_height + i->nblocks - 1;
+  uint64_t current_height = i->second.start_block_height + i->second.nblocks - 1;
   ++i;
   if (i == blocks.end())
     return std::make_pair(0, 0);
-  uint64_t first_span_height = i->start_block_height;
+  uint64_t first_span_height = i->second.start_block_height;
   if (first_span_height <= current_height + 1)
     return std::make_pair(0, 0);
   MDEBUG("Found gap at start of spans: last blockchain block height " << current_height << ", first span's block height " << first_span_height);
@@ -230,97 +281,80 @@ std::pair<uint64_t, uint64_t> block_queue::get_start_gap_span() const
   return std::make_pair(current_height + 1, first_span_height - current_height - 1);
 }
 
-std::pair<uint64_t, uint64_t> block_queue::get_next_span_if_scheduled(std::list<crypto::hash> &hashes, boost::uuids::uuid &connection_id, boost::posix_time::ptime &time) const
+std::pair<uint64_t, uint64_t> block_queue::get_next_span_if_scheduled(std::vector<crypto::hash> &hashes, boost::uuids::uuid &connection_id, boost::posix_time::ptime &time) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  if (blocks.empty())
-    return std::make_pair(0, 0);
-  block_map::const_iterator i = blocks.begin();
-  if (is_blockchain_placeholder(*i))
-    ++i;
+  block_map::const_iterator i = first_span();
   if (i == blocks.end())
     return std::make_pair(0, 0);
-  if (!i->blocks.empty())
+  if (!i->second.blocks.empty())
     return std::make_pair(0, 0);
-  hashes = i->hashes;
-  connection_id = i->connection_id;
-  time = i->time;
-  return std::make_pair(i->start_block_height, i->nblocks);
+  hashes = i->second.hashes;
+  connection_id = i->second.connection_id;
+  time = i->second.time;
+  return std::make_pair(i->second.start_block_height, i->second.nblocks);
 }
 
-void block_queue::set_span_hashes(uint64_t start_height, const boost::uuids::uuid &connection_id, std::list<crypto::hash> hashes)
+void block_queue::set_span_hashes(uint64_t start_height, const boost::uuids::uuid &connection_id, std::vector<crypto::hash> hashes)
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  for (block_map::iterator i = blocks.begin(); i != blocks.end(); ++i)
+  block_map::iterator i = blocks.find(start_height);
+  if (i != blocks.end() && i->second.connection_id == connection_id)
   {
-    if (i->start_block_height == start_height && i->connection_id == connection_id)
-    {
-      span s = *i;
-      blocks.erase(i);
-      s.hashes = std::move(hashes);
-      blocks.insert(s);
-      return;
-    }
+    unindex_span(i->second);
+    i->second.hashes = std::move(hashes);
+    index_span(i->second);
   }
 }
 
 bool block_queue::get_next_span(uint64_t &height, std::list<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, bool filled) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  if (blocks.empty())
+  block_map::const_iterator i = filled ? first_filled_span() : first_span();
+  if (i == blocks.end())
     return false;
-  block_map::const_iterator i = blocks.begin();
-  if (is_blockchain_placeholder(*i))
-    ++i;
-  for (; i != blocks.end(); ++i)
-  {
-    if (!filled || !i->blocks.empty())
-    {
-      height = i->start_block_height;
-      bcel = i->blocks;
-      connection_id = i->connection_id;
-      return true;
-    }
-  }
-  return false;
+  height = i->second.start_block_height;
+  bcel.assign(i->second.blocks.begin(), i->second.blocks.end());
+  connection_id = i->second.connection_id;
+  return true;
 }
 
-bool block_queue::has_next_span(const boost::uuids::uuid &connection_id, bool &filled) const
+bool block_queue::get_next_span(uint64_t &height, boost::uuids::uuid &connection_id, bool filled) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  if (blocks.empty())
+  block_map::const_iterator i = filled ? first_filled_span() : first_span();
+  if (i == blocks.end())
     return false;
-  block_map::const_iterator i = blocks.begin();
-  if (is_blockchain_placeholder(*i))
-    ++i;
+  height = i->second.start_block_height;
+  connection_id = i->second.connection_id;
+  return true;
+}
+
+bool block_queue::has_next_span(const boost::uuids::uuid &connection_id, bool &filled) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  block_map::const_iterator i = first_span();
   if (i == blocks.end())
     return false;
-  if (i->connection_id != connection_id)
+  if (i->second.connection_id != connection_id)
     return false;
-  filled = !i->blocks.empty();
+  filled = !i->second.blocks.empty();
   return true;
 }
 
 size_t block_queue::get_data_size() const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  size_t size = 0;
-  for (const auto &span: blocks)
-    size += span.size;
-  return size;
+  return data_size;
 }
 
 size_t block_queue::get_num_filled_spans_prefix() const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
 
-  if (blocks.empty())
-    return 0;
-  block_map::const_iterator i = blocks.begin();
-  if (is_blockchain_placeholder(*i))
-    ++i;
+  block_map::const_iterator i = first_span();
   size_t size = 0;
-  while (i != blocks.end() && !i->blocks.empty())
+  while (i != blocks.end() && !i->second.blocks.empty())
   {
     ++i;
     ++size;
@@ -331,11 +365,7 @@ size_t block_queue::get_num_filled_spans_prefix() const
 size_t block_queue::get_num_filled_spans() const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  size_t size = 0;
-  for (const auto &span: blocks)
-  if (!span.blocks.empty())
-    ++size;
-  return size;
+  return filled_spans.size();
 }
 
 crypto::hash block_queue::get_last_known_hash(const boost::uuids::uuid &connection_id) const
@@ -343,8 +373,9 @@ crypto::hash block_queue::get_last_known_hash(const boost::uuids::uuid &connecti
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   crypto::hash hash = crypto::null_hash;
   uint64_t highest_height = 0;
-  for (const auto &span: blocks)
+  for (const auto &e: blocks)
   {
+    const span &span = e.second;
     if (span.connection_id != connection_id)
       continue;
     uint64_t h = span.start_block_height + span.nblocks - 1;
@@ -359,9 +390,10 @@ crypto::hash block_queue::get_last_known_hash(const boost::uuids::uuid &connecti
 
 bool block_queue::has_spans(const boost::uuids::uuid &connection_id) const
 {
-  for (const auto &span: blocks)
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  for (const auto &e: blocks)
   {
-    if (span.connection_id == connection_id)
+    if (e.second.connection_id == connection_id)
       return true;
   }
   return false;
@@ -371,10 +403,12 @@ float block_queue::get_speed(const boost::uuids::uuid &connection_id) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   std::unordered_map<boost::uuids::uuid, float> speeds;
-  for (const auto &span: blocks)
+  for (uint64_t height: filled_spans)
   {
-    if (span.blocks.empty())
+    block_map::const_iterator j = blocks.find(height);
+    if (j == blocks.end())
       continue;
+    const span &span = j->second;
     // note that the average below does not average over the whole set, but over the
     // previous pseudo average and the latest rate: this gives much more importance
     // to the latest measurements, which is fine here
@@ -406,11 +440,9 @@ float block_queue::get_speed(const boost::uuids::uuid &connection_id) const
 bool block_queue::foreach(std::function<bool(const span&)> f, bool include_blockchain_placeholder) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
-  block_map::const_iterator i = blocks.begin();
-  if (!include_blockchain_placeholder && i != blocks.end() && is_blockchain_placeholder(*i))
-    ++i;
+  block_map::const_iterator i = include_blockchain_placeholder ? blocks.begin() : first_span();
   while (i != blocks.end())
-    if (!f(*i++))
+    if (!f((i++)->second))
       return false;
   return true;
 }
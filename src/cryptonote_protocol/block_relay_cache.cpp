@@ -0,0 +1,140 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "block_relay_cache.h"
+
+// peers mostly ask for the same missing txes, do not let odd requests grow this
+#define MAX_FLUFFY_RESPONSES_PER_BLOCK 16
+
+namespace cryptonote
+{
+
+block_relay_cache::block_relay_cache(size_t max_blocks, time_t lifetime):
+  m_max_blocks(max_blocks), m_lifetime(lifetime)
+{
+}
+
+void block_relay_cache::add_block(const crypto::hash &block_hash, const blobdata &block_blob, const std::vector<crypto::hash> &tx_hashes)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  if (m_entries.find(block_hash) != m_entries.end())
+    return;
+  entry &e = m_entries[block_hash];
+  e.block_blob = std::make_shared<const std::string>(block_blob);
+  e.tx_hashes = tx_hashes;
+  e.tx_blobs.resize(tx_hashes.size());
+  e.time = time(NULL);
+  m_order.push_back(block_hash);
+  while (m_order.size() > m_max_blocks)
+  {
+    m_entries.erase(m_order.front());
+    m_order.pop_front();
+  }
+}
+
+bool block_relay_cache::get_block(const crypto::hash &block_hash, payload_ptr &block_blob, std::vector<crypto::hash> &tx_hashes) const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const auto i = m_entries.find(block_hash);
+  if (i == m_entries.end())
+    return false;
+  block_blob = i->second.block_blob;
+  tx_hashes = i->second.tx_hashes;
+  return true;
+}
+
+bool block_relay_cache::get_tx_blobs(const crypto::hash &block_hash, const std::vector<uint64_t> &indices, std::vector<payload_ptr> &tx_blobs) const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const auto i = m_entries.find(block_hash);
+  if (i == m_entries.end())
+    return false;
+  tx_blobs.clear();
+  tx_blobs.reserve(indices.size());
+  for (uint64_t index: indices)
+  {
+    if (index >= i->second.tx_blobs.size())
+      return false;
+    tx_blobs.push_back(i->second.tx_blobs[index]);
+  }
+  return true;
+}
+
+void block_relay_cache::add_tx_blob(const crypto::hash &block_hash, uint64_t index, const blobdata &tx_blob)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const auto i = m_entries.find(block_hash);
+  if (i == m_entries.end() || index >= i->second.tx_blobs.size())
+    return;
+  if (!i->second.tx_blobs[index])
+    i->second.tx_blobs[index] = std::make_shared<const std::string>(tx_blob);
+}
+
+block_relay_cache::payload_ptr block_relay_cache::get_fluffy_response(const crypto::hash &block_hash, uint64_t height, const std::vector<uint64_t> &indices) const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const auto i = m_entries.find(block_hash);
+  if (i == m_entries.end())
+    return payload_ptr();
+  const auto j = i->second.fluffy_responses.find(std::make_pair(height, indices));
+  if (j == i->second.fluffy_responses.end())
+    return payload_ptr();
+  return j->second;
+}
+
+void block_relay_cache::add_fluffy_response(const crypto::hash &block_hash, uint64_t height, const std::vector<uint64_t> &indices, const std::string &notification)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const auto i = m_entries.find(block_hash);
+  if (i == m_entries.end() || i->second.fluffy_responses.size() >= MAX_FLUFFY_RESPONSES_PER_BLOCK)
+    return;
+  i->second.fluffy_responses[std::make_pair(height, indices)] = std::make_shared<const std::string>(notification);
+}
+
+size_t block_relay_cache::size() const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  return m_entries.size();
+}
+
+void block_relay_cache::prune(time_t now)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  while (!m_order.empty())
+  {
+    const auto i = m_entries.find(m_order.front());
+    if (i != m_entries.end() && i->second.time + m_lifetime > now)
+      break;
+    if (i != m_entries.end())
+      m_entries.erase(i);
+    m_order.pop_front();
+  }
+}
+
+}
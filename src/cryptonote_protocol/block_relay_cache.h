@@ -0,0 +1,79 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /* Short lived cache of serialized relay payloads for recent blocks,    */
+  /* so the same block and txes are not serialized again for each peer   */
+  /************************************************************************/
+  class block_relay_cache
+  {
+  public:
+    typedef std::shared_ptr<const std::string> payload_ptr;
+
+    block_relay_cache(size_t max_blocks, time_t lifetime);
+
+    void add_block(const crypto::hash &block_hash, const blobdata &block_blob, const std::vector<crypto::hash> &tx_hashes);
+    bool get_block(const crypto::hash &block_hash, payload_ptr &block_blob, std::vector<crypto::hash> &tx_hashes) const;
+    bool get_tx_blobs(const crypto::hash &block_hash, const std::vector<uint64_t> &indices, std::vector<payload_ptr> &tx_blobs) const;
+    void add_tx_blob(const crypto::hash &block_hash, uint64_t index, const blobdata &tx_blob);
+    payload_ptr get_fluffy_response(const crypto::hash &block_hash, uint64_t height, const std::vector<uint64_t> &indices) const;
+    void add_fluffy_response(const crypto::hash &block_hash, uint64_t height, const std::vector<uint64_t> &indices, const std::string &notification);
+    size_t size() const;
+    void prune(time_t now = time(NULL));
+
+  private:
+    struct entry
+    {
+      payload_ptr block_blob;
+      std::vector<crypto::hash> tx_hashes;
+      std::vector<payload_ptr> tx_blobs; // by index in tx_hashes, null until loaded
+      std::map<std::pair<uint64_t, std::vector<uint64_t>>, payload_ptr> fluffy_responses; // serialized NOTIFY_NEW_FLUFFY_BLOCK by (height, tx indices)
+      time_t time;
+    };
+
+    size_t m_max_blocks;
+    time_t m_lifetime;
+    std::list<crypto::hash> m_order;
+    std::unordered_map<crypto::hash, entry> m_entries;
+    mutable boost::mutex m_mutex;
+  };
+}
@@ -36,6 +36,9 @@
 
 #include <boost/program_options/variables_map.hpp>
 #include <string>
+#include <map>
+#include <deque>
+#include <unordered_map>
 
 #include "math_helper.h"
 #include "storages/levin_abstract_invoke2.h"
@@ -43,6 +46,8 @@
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
 #include "block_queue.h"
+#include "known_tx_filter.h"
+#include "block_relay_cache.h"
 #include "cryptonote_basic/connection_context.h"
 #include "cryptonote_basic/cryptonote_stat_info.h"
 #include <boost/circular_buffer.hpp>
@@ -90,6 +95,8 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_CHAIN_ENTRY, &cryptonote_protocol_handler::handle_response_chain_entry)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, &cryptonote_protocol_handler::handle_notify_new_fluffy_block)			
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)						
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_TRANSACTION_HASHES, &cryptonote_protocol_handler::handle_notify_new_transaction_hashes)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_MISSING_TXS, &cryptonote_protocol_handler::handle_request_missing_txs)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -119,10 +126,12 @@ namespace cryptonote
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context);
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_transaction_hashes(int command, NOTIFY_NEW_TRANSACTION_HASHES::request& arg, cryptonote_connection_context& context);
+    int handle_request_missing_txs(int command, NOTIFY_REQUEST_MISSING_TXS::request& arg, cryptonote_connection_context& context);
 		
     //----------------- i_bc_protocol_layout ---------------------------------------
-    virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
-    virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context);
+    virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, const crypto::hash& block_hash, const std::vector<crypto::hash>& tx_hashes, cryptonote_connection_context& exclude_context);
+    virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const std::vector<crypto::hash> &tx_hashes, cryptonote_connection_context& exclude_context);
     //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
     bool request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks, bool force_next_span = false);
@@ -132,6 +141,7 @@ namespace cryptonote
     void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
     bool kick_idle_peers();
     int try_add_next_blocks(cryptonote_connection_context &context);
+    bool flush_tx_announcements();
 
     t_core& m_core;
 
@@ -144,6 +154,29 @@ namespace cryptonote
     block_queue m_block_queue;
     epee::math_helper::once_a_time_seconds<30> m_idle_peer_kicker;
 
+    // hash-first tx relay state, for peers with P2P_SUPPORT_FLAG_TX_ANNOUNCE
+    struct peer_tx_relay_state
+    {
+      known_tx_filter known_txs; // the peer has these, so we don't announce them
+      known_tx_filter announced_txs; // we announced these, so the peer may request them
+      std::vector<crypto::hash> pending_announces;
+      size_t requested_txs; // m_requested_txs entries added by its announcements
+      peer_tx_relay_state(): known_txs(P2P_TX_ANNOUNCE_KNOWN_TXS_MAX), announced_txs(P2P_TX_ANNOUNCE_KNOWN_TXS_MAX), requested_txs(0) {}
+    };
+    boost::mutex m_tx_relay_lock;
+    std::map<boost::uuids::uuid, peer_tx_relay_state> m_peer_tx_relay_state;
+    // a tx we asked one peer for, and the other peers which announced it meanwhile
+    struct requested_tx
+    {
+      boost::posix_time::ptime request_time;
+      boost::uuids::uuid first_announcer;
+      std::deque<boost::uuids::uuid> announcers;
+    };
+    std::unordered_map<crypto::hash, requested_tx> m_requested_txs; // across all peers
+    void release_requested_tx(const requested_tx &r);
+
+    block_relay_cache m_block_relay_cache;
+
     boost::mutex m_buffer_mutex;
     double get_avg_block_size();
     boost::circular_buffer<size_t> m_avg_buffer = boost::circular_buffer<size_t>(10);
@@ -48,11 +48,11 @@
 
 #define MLOG_P2P_MESSAGE(x) MCINFO("net.p2p.msg", context << x)
 
-#define BLOCK_QUEUE_NBLOCKS_THRESHOLD 10 // chunks of N blocks
-#define BLOCK_QUEUE_SIZE_THRESHOLD (100*1024*1024) // MB
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD (5 * 1000000) // microseconds
 #define IDLE_PEER_KICK_TIME (600 * 1000000) // microseconds
 #define PASSIVE_PEER_KICK_TIME (60 * 1000000) // microseconds
+#define BLOCK_RELAY_CACHE_MAX_BLOCKS 8
+#define BLOCK_RELAY_CACHE_LIFETIME 120 // seconds
 
 namespace cryptonote
 {
@@ -65,7 +65,8 @@ namespace cryptonote
                                                                                                               m_p2p(p_net_layout),
                                                                                                               m_syncronized_connections_count(0),
                                                                                                               m_synchronized(offline),
-                                                                                                              m_stopping(false)
+                                                                                                              m_stopping(false),
+                                                                                                              m_block_relay_cache(BLOCK_RELAY_CACHE_MAX_BLOCKS, BLOCK_RELAY_CACHE_LIFETIME)
 
   {
     if(!m_p2p)
@@ -368,7 +369,8 @@ namespace cryptonote
     }
 
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    m_core.handle_incoming_block(arg.b.block, bvc); // got block from handle_notify_new_block
+    block b = AUTO_VAL_INIT(b);
+    m_core.handle_incoming_block(arg.b.block, bvc, b); // got block from handle_notify_new_block
     if (!m_core.cleanup_handle_incoming_blocks(true))
     {
       LOG_PRINT_CCONTEXT_L0("Failure in cleanup_handle_incoming_blocks");
@@ -385,7 +387,7 @@ namespace cryptonote
     if(bvc.m_added_to_main_chain)
     {
       //TODO: Add here announce protocol usage
-      relay_block(arg, context);
+      relay_block(arg, get_block_hash(b), b.tx_hashes, context);
     }else if(bvc.m_marked_as_orphaned)
     {
       context.m_state = cryptonote_connection_context::state_synchronizing;
@@ -651,7 +653,7 @@ namespace cryptonote
           NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
           reg_arg.current_blockchain_height = arg.current_blockchain_height;
           reg_arg.b = b;
-          relay_block(reg_arg, context);
+          relay_block(reg_arg, get_block_hash(new_block), new_block.tx_hashes, context);
         }
         else if( bvc.m_marked_as_orphaned )
         {
@@ -685,28 +687,30 @@ namespace cryptonote
   int t_cryptonote_protocol_handler<t_core>::handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_FLUFFY_MISSING_TX (" << arg.missing_tx_indices.size() << " txes), block hash " << arg.block_hash);
-    
-    std::list<std::pair<cryptonote::blobdata, block>> local_blocks;
-    std::list<cryptonote::blobdata> local_txs;
 
-    block b;
-    if (!m_core.get_block_by_hash(arg.block_hash, b))
+    // a freshly relayed block gets asked for by many peers at once, so
+    // block, txes and responses are serialized once and kept for a while
+    block_relay_cache::payload_ptr block_blob;
+    std::vector<crypto::hash> tx_hashes;
+    if (!m_block_relay_cache.get_block(arg.block_hash, block_blob, tx_hashes))
     {
-      LOG_ERROR_CCONTEXT("failed to find block: " << arg.block_hash << ", dropping connection");
-      drop_connection(context, false, false);
-      return 1;
+      block b;
+      if (!m_core.get_block_by_hash(arg.block_hash, b))
+      {
+        LOG_ERROR_CCONTEXT("failed to find block: " << arg.block_hash << ", dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      block_blob = std::make_shared<const std::string>(t_serializable_object_to_blob(b));
+      tx_hashes = std::move(b.tx_hashes);
+      m_block_relay_cache.add_block(arg.block_hash, *block_blob, tx_hashes);
     }
 
-    std::vector<crypto::hash> txids;
-    NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_response;
-    fluffy_response.b.block = t_serializable_object_to_blob(b);
-    fluffy_response.current_blockchain_height = arg.current_blockchain_height;
     for(auto& tx_idx: arg.missing_tx_indices)
     {
-      if(tx_idx < b.tx_hashes.size())
+      if(tx_idx < tx_hashes.size())
       {
-        MDEBUG("  tx " << b.tx_hashes[tx_idx]);
-        txids.push_back(b.tx_hashes[tx_idx]);
+        MDEBUG("  tx " << tx_hashes[tx_idx]);
       }
       else
       {
@@ -714,7 +718,7 @@ namespace cryptonote
         (
           "Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX"
           << ", request is asking for a tx whose index is out of bounds "
-          << ", tx index = " << tx_idx << ", block tx count " << b.tx_hashes.size()
+          << ", tx index = " << tx_idx << ", block tx count " << tx_hashes.size()
           << ", block_height = " << arg.current_blockchain_height
           << ", dropping connection"
         );
@@ -724,26 +728,63 @@ namespace cryptonote
       }
     }    
 
-    std::list<cryptonote::transaction> txs;
-    std::list<crypto::hash> missed;
-    if (!m_core.get_transactions(txids, txs, missed))
+    block_relay_cache::payload_ptr response = m_block_relay_cache.get_fluffy_response(arg.block_hash, arg.current_blockchain_height, arg.missing_tx_indices);
+    if (response)
     {
-      LOG_ERROR_CCONTEXT("Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX, "
-        << "failed to get requested transactions");
-      drop_connection(context, false, false);
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_RESPONSE_FLUFFY_MISSING_TX: cached, " << response->size() << " bytes");
+      m_p2p->invoke_notify_to_peer(NOTIFY_NEW_FLUFFY_BLOCK::ID, *response, context);
       return 1;
     }
-    if (!missed.empty() || txs.size() != txids.size())
+
+    std::vector<block_relay_cache::payload_ptr> tx_blobs;
+    if (!m_block_relay_cache.get_tx_blobs(arg.block_hash, arg.missing_tx_indices, tx_blobs))
+      tx_blobs.assign(arg.missing_tx_indices.size(), block_relay_cache::payload_ptr());
+
+    std::vector<crypto::hash> txids;
+    std::vector<size_t> txid_positions;
+    for(size_t n = 0; n < tx_blobs.size(); ++n)
     {
-      LOG_ERROR_CCONTEXT("Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX, "
-        << missed.size() << " requested transactions not found" << ", dropping connection");
-      drop_connection(context, false, false);
-      return 1;
+      if (!tx_blobs[n])
+      {
+        txids.push_back(tx_hashes[arg.missing_tx_indices[n]]);
+        txid_positions.push_back(n);
+      }
     }
 
-    for(auto& tx: txs)
+    if (!txids.empty())
     {
-      fluffy_response.b.txs.push_back(t_serializable_object_to_blob(tx));
+      std::list<cryptonote::blobdata> txs;
+      std::list<crypto::hash> missed;
+      if (!m_core.get_transactions(txids, txs, missed))
+      {
+        LOG_ERROR_CCONTEXT("Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX, "
+          << "failed to get requested transactions");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      if (!missed.empty() || txs.size() != txids.size())
+      {
+        LOG_ERROR_CCONTEXT("Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX, "
+          << missed.size() << " requested transactions not found" << ", dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+
+      auto pos_it = txid_positions.begin();
+      for(auto& tx: txs)
+      {
+        const size_t n = *pos_it++;
+        m_block_relay_cache.add_tx_blob(arg.block_hash, arg.missing_tx_indices[n], tx);
+        tx_blobs[n] = std::make_shared<const std::string>(std::move(tx));
+      }
+    }
+
+    NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_response;
+    fluffy_response.b.block = *block_blob;
+    fluffy_response.current_blockchain_height = arg.current_blockchain_height;
+    for(const auto& tx_blob: tx_blobs)
+    {
+      fluffy_response.b.txs.push_back(*tx_blob);
     }
 
     LOG_PRINT_CCONTEXT_L2
@@ -752,8 +793,11 @@ namespace cryptonote
         << ", txs.size()=" << fluffy_response.b.txs.size()
         << ", rsp.current_blockchain_height=" << fluffy_response.current_blockchain_height
     );
-           
-    post_notify<NOTIFY_NEW_FLUFFY_BLOCK>(fluffy_response, context);    
+
+    std::string fluffy_response_blob;
+    epee::serialization::store_t_to_binary(fluffy_response, fluffy_response_blob);
+    m_block_relay_cache.add_fluffy_response(arg.block_hash, arg.current_blockchain_height, arg.missing_tx_indices, fluffy_response_blob);
+    m_p2p->invoke_notify_to_peer(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffy_response_blob, context);
     return 1;        
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -773,26 +817,173 @@ namespace cryptonote
       return 1;
     }
 
-    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end();)
+    // core parses each tx once and hands the hashes back for the relay
+    std::vector<cryptonote::tx_verification_context> tvc;
+    std::vector<crypto::hash> tx_hashes;
+    m_core.handle_incoming_txs(arg.txs, tvc, tx_hashes, false, true, false);
+    for(const auto &tx_tvc: tvc)
     {
-      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-      m_core.handle_incoming_tx(*tx_blob_it, tvc, false, true, false);
-      if(tvc.m_verifivation_failed)
+      if(tx_tvc.m_verifivation_failed)
       {
         LOG_PRINT_CCONTEXT_L1("Tx verification failed, dropping connection");
         drop_connection(context, false, false);
         return 1;
       }
-      if(tvc.m_should_be_relayed)
+    }
+
+    // the sender has these, whether we asked for them or not
+    {
+      CRITICAL_REGION_LOCAL(m_tx_relay_lock);
+      peer_tx_relay_state &state = m_peer_tx_relay_state[context.m_connection_id];
+      for(const auto &tx_hash: tx_hashes)
+      {
+        state.known_txs.insert(tx_hash);
+        auto it = m_requested_txs.find(tx_hash);
+        if(it != m_requested_txs.end())
+        {
+          release_requested_tx(it->second);
+          m_requested_txs.erase(it);
+        }
+      }
+    }
+
+    auto tvc_it = tvc.begin();
+    auto tx_hash_it = tx_hashes.begin();
+    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++tvc_it)
+    {
+      if(tvc_it->m_should_be_relayed)
+      {
         ++tx_blob_it;
+        ++tx_hash_it;
+      }
       else
+      {
         arg.txs.erase(tx_blob_it++);
+        tx_hash_it = tx_hashes.erase(tx_hash_it);
+      }
     }
 
     if(arg.txs.size())
     {
-      //TODO: add announce usage here
-      relay_transactions(arg, context);
+      relay_transactions(arg, tx_hashes, context);
+    }
+
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transaction_hashes(int command, NOTIFY_NEW_TRANSACTION_HASHES::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTION_HASHES (" << arg.tx_hashes.size() << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if(!is_synchronized())
+    {
+      LOG_DEBUG_CC(context, "Received new tx hashes while syncing, ignored");
+      return 1;
+    }
+
+    if(arg.tx_hashes.size() > P2P_TX_ANNOUNCE_MAX_BATCH)
+    {
+      LOG_ERROR_CCONTEXT("NOTIFY_NEW_TRANSACTION_HASHES: too many hashes (" << arg.tx_hashes.size() << "), dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    std::vector<crypto::hash> missing;
+    for(const auto &tx_hash: arg.tx_hashes)
+    {
+      if(!m_core.pool_has_tx(tx_hash))
+        missing.push_back(tx_hash);
+    }
+
+    NOTIFY_REQUEST_MISSING_TXS::request req;
+    {
+      CRITICAL_REGION_LOCAL(m_tx_relay_lock);
+      peer_tx_relay_state &state = m_peer_tx_relay_state[context.m_connection_id];
+      for(const auto &tx_hash: arg.tx_hashes)
+        state.known_txs.insert(tx_hash);
+
+      // only ask one peer at a time for a given tx, and remember the other
+      // announcers so flush_tx_announcements can ask the next one if that
+      // peer does not deliver in time
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      for(const auto &tx_hash: missing)
+      {
+        auto it = m_requested_txs.find(tx_hash);
+        if(it != m_requested_txs.end() && (now - it->second.request_time).total_seconds() < P2P_TX_REQUEST_TIMEOUT)
+        {
+          std::deque<boost::uuids::uuid> &announcers = it->second.announcers;
+          if(std::find(announcers.begin(), announcers.end(), context.m_connection_id) == announcers.end())
+            announcers.push_back(context.m_connection_id);
+          continue;
+        }
+        if(it == m_requested_txs.end())
+        {
+          // announcing made up hashes must not grow this without bounds
+          if(state.requested_txs >= P2P_TX_REQUESTS_PER_PEER_MAX || m_requested_txs.size() >= P2P_TX_REQUESTS_MAX)
+            continue;
+          it = m_requested_txs.emplace(tx_hash, requested_tx()).first;
+          it->second.first_announcer = context.m_connection_id;
+          ++state.requested_txs;
+        }
+        it->second.request_time = now;
+        req.tx_hashes.push_back(tx_hash);
+      }
+    }
+
+    if(!req.tx_hashes.empty())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_MISSING_TXS: tx_hashes.size()=" << req.tx_hashes.size());
+      post_notify<NOTIFY_REQUEST_MISSING_TXS>(req, context);
+    }
+
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_missing_txs(int command, NOTIFY_REQUEST_MISSING_TXS::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_MISSING_TXS (" << arg.tx_hashes.size() << " txes)");
+
+    if(arg.tx_hashes.size() > P2P_TX_ANNOUNCE_MAX_BATCH)
+    {
+      LOG_ERROR_CCONTEXT("NOTIFY_REQUEST_MISSING_TXS: too many hashes (" << arg.tx_hashes.size() << "), dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // only serve what we announced to this peer, so other pool txes (and
+    // those we were told not to relay) cannot be fished out by hash
+    std::vector<crypto::hash> announced;
+    {
+      CRITICAL_REGION_LOCAL(m_tx_relay_lock);
+      auto it = m_peer_tx_relay_state.find(context.m_connection_id);
+      if(it != m_peer_tx_relay_state.end())
+      {
+        for(const auto &tx_hash: arg.tx_hashes)
+        {
+          if(it->second.announced_txs.contains(tx_hash))
+            announced.push_back(tx_hash);
+        }
+      }
+    }
+
+    NOTIFY_NEW_TRANSACTIONS::request rsp;
+    for(const auto &tx_hash: announced)
+    {
+      cryptonote::blobdata tx_blob;
+      if(m_core.get_relayed_pool_transaction(tx_hash, tx_blob))
+        rsp.txs.push_back(std::move(tx_blob));
+      else
+        MDEBUG("Requested tx " << tx_hash << " is not in the pool anymore");
+    }
+
+    if(!rsp.txs.empty())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << rsp.txs.size());
+      post_notify<NOTIFY_NEW_TRANSACTIONS>(rsp, context);
     }
 
     return 1;
@@ -955,7 +1146,7 @@ namespace cryptonote
       const boost::posix_time::time_duration dt = now - context.m_last_request_time;
       const float rate = size * 1e6 / (dt.total_microseconds() + 1);
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.total_microseconds()/1e6 << " seconds, " << (rate/1e3) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
-      m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
+      m_block_queue.add_blocks(start_height, std::vector<cryptonote::block_complete_entry>(std::make_move_iterator(arg.blocks.begin()), std::make_move_iterator(arg.blocks.end())), context.m_connection_id, rate, blocks_size);
 
       context.m_last_known_hash = last_block_hash;
 
@@ -1194,6 +1385,8 @@ skip:
   bool t_cryptonote_protocol_handler<t_core>::on_idle()
   {
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
+    flush_tx_announcements();
+    m_block_relay_cache.prune();
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -1229,6 +1422,78 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::flush_tx_announcements()
+  {
+    std::list<std::pair<boost::uuids::uuid, std::string>> announcements;
+    std::map<boost::uuids::uuid, std::vector<crypto::hash>> rerequests;
+    {
+      CRITICAL_REGION_LOCAL(m_tx_relay_lock);
+      for(auto &e: m_peer_tx_relay_state)
+      {
+        std::vector<crypto::hash> &pending = e.second.pending_announces;
+        for(size_t i = 0; i < pending.size(); i += P2P_TX_ANNOUNCE_MAX_BATCH)
+        {
+          NOTIFY_NEW_TRANSACTION_HASHES::request arg;
+          const size_t end = std::min<size_t>(pending.size(), i + P2P_TX_ANNOUNCE_MAX_BATCH);
+          arg.tx_hashes.assign(pending.begin() + i, pending.begin() + end);
+          announcements.push_back(std::make_pair(e.first, std::string()));
+          epee::serialization::store_t_to_binary(arg, announcements.back().second);
+        }
+        pending.clear();
+      }
+
+      // ask the next announcer for txes the last one did not deliver in time,
+      // and forget about them once nobody else announced them
+      const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      for(auto it = m_requested_txs.begin(); it != m_requested_txs.end();)
+      {
+        if((now - it->second.request_time).total_seconds() < P2P_TX_REQUEST_TIMEOUT)
+        {
+          ++it;
+          continue;
+        }
+        std::deque<boost::uuids::uuid> &announcers = it->second.announcers;
+        while(!announcers.empty() && m_peer_tx_relay_state.find(announcers.front()) == m_peer_tx_relay_state.end())
+          announcers.pop_front();
+        if(announcers.empty())
+        {
+          release_requested_tx(it->second);
+          it = m_requested_txs.erase(it);
+          continue;
+        }
+        rerequests[announcers.front()].push_back(it->first);
+        announcers.pop_front();
+        it->second.request_time = now;
+        ++it;
+      }
+    }
+
+    for(const auto &announcement: announcements)
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTION_HASHES::ID, announcement.second, std::list<boost::uuids::uuid>(1, announcement.first));
+
+    for(auto &e: rerequests)
+    {
+      NOTIFY_REQUEST_MISSING_TXS::request req;
+      for(const auto &tx_hash: e.second)
+      {
+        if(!m_core.pool_has_tx(tx_hash))
+          req.tx_hashes.push_back(tx_hash);
+      }
+      for(size_t i = 0; i < req.tx_hashes.size(); i += P2P_TX_ANNOUNCE_MAX_BATCH)
+      {
+        NOTIFY_REQUEST_MISSING_TXS::request batch;
+        const size_t end = std::min<size_t>(req.tx_hashes.size(), i + P2P_TX_ANNOUNCE_MAX_BATCH);
+        batch.tx_hashes.assign(req.tx_hashes.begin() + i, req.tx_hashes.begin() + end);
+        std::string blob;
+        epee::serialization::store_t_to_binary(batch, blob);
+        MDEBUG("Re-requesting " << batch.tx_hashes.size() << " txes from " << e.first);
+        m_p2p->relay_notify_to_list(NOTIFY_REQUEST_MISSING_TXS::ID, blob, std::list<boost::uuids::uuid>(1, e.first));
+      }
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_CHAIN (" << arg.block_ids.size() << " blocks");
@@ -1247,7 +1512,7 @@ skip:
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::should_download_next_span(cryptonote_connection_context& context) const
   {
-    std::list<crypto::hash> hashes;
+    std::vector<crypto::hash> hashes;
     boost::uuids::uuid span_connection_id;
     boost::posix_time::ptime request_time;
     std::pair<uint64_t, uint64_t> span;
@@ -1266,8 +1531,7 @@ skip:
       // we might be in a weird case where there is a filled next span,
       // but it starts higher than the current height
       uint64_t height;
-      std::list<cryptonote::block_complete_entry> bcel;
-      if (!m_block_queue.get_next_span(height, bcel, span_connection_id, true))
+      if (!m_block_queue.get_next_span(height, span_connection_id, true))
         return false;
       if (height > m_core.get_current_blockchain_height())
       {
@@ -1327,7 +1591,7 @@ skip:
       {
         size_t nblocks = m_block_queue.get_num_filled_spans();
         size_t size = m_block_queue.get_data_size();
-        if (nblocks < BLOCK_QUEUE_NBLOCKS_THRESHOLD || size < BLOCK_QUEUE_SIZE_THRESHOLD)
+        if (size < m_core.get_block_download_max_size())
         {
           if (!first)
           {
@@ -1414,7 +1678,7 @@ skip:
       {
         if (span.second == 0)
         {
-          std::list<crypto::hash> hashes;
+          std::vector<crypto::hash> hashes;
           boost::uuids::uuid span_connection_id;
           boost::posix_time::ptime time;
           span = m_block_queue.get_next_span_if_scheduled(hashes, span_connection_id, time);
@@ -1455,7 +1719,7 @@ skip:
       if (span.second == 0 && !force_next_span)
       {
         MDEBUG(context << " still no span reserved, we may be in the corner case of next span scheduled and everything else scheduled/filled");
-        std::list<crypto::hash> hashes;
+        std::vector<crypto::hash> hashes;
         boost::uuids::uuid span_connection_id;
         boost::posix_time::ptime time;
         span = m_block_queue.get_next_span_if_scheduled(hashes, span_connection_id, time);
@@ -1659,8 +1923,11 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
-  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, const crypto::hash& block_hash, const std::vector<crypto::hash>& tx_hashes, cryptonote_connection_context& exclude_context)
   {
+    // keep the block around for the missing tx requests fluffy peers will send
+    m_block_relay_cache.add_block(block_hash, arg.b.block, tx_hashes);
+
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
     fluffy_arg.current_blockchain_height = arg.current_blockchain_height;    
     std::list<blobdata> fluffy_txs;
@@ -1700,12 +1967,54 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
-  bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)
+  bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const std::vector<crypto::hash> &tx_hashes, cryptonote_connection_context& exclude_context)
   {
     // no check for success, so tell core they're relayed unconditionally
-    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++tx_blob_it)
-      m_core.on_transaction_relayed(*tx_blob_it);
-    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+    m_core.on_transactions_relayed(tx_hashes);
+
+    // peers supporting announcements get the hashes they do not know yet in
+    // the next batch, others get the full blobs right away
+    std::list<boost::uuids::uuid> fullConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &tx_hashes, &fullConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    {
+      if (peer_id && exclude_context.m_connection_id != context.m_connection_id)
+      {
+        if (support_flags & P2P_SUPPORT_FLAG_TX_ANNOUNCE)
+        {
+          CRITICAL_REGION_LOCAL(m_tx_relay_lock);
+          peer_tx_relay_state &state = m_peer_tx_relay_state[context.m_connection_id];
+          for (const auto &tx_hash: tx_hashes)
+          {
+            if (state.known_txs.insert(tx_hash))
+            {
+              state.announced_txs.insert(tx_hash);
+              state.pending_announces.push_back(tx_hash);
+            }
+          }
+        }
+        else
+        {
+          fullConnections.push_back(context.m_connection_id);
+        }
+      }
+      return true;
+    });
+
+    if (fullConnections.empty())
+      return true;
+
+    std::string fullBlob;
+    epee::serialization::store_t_to_binary(arg, fullBlob);
+    return m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, fullBlob, fullConnections);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::release_requested_tx(const requested_tx &r)
+  {
+    // m_tx_relay_lock is held
+    auto it = m_peer_tx_relay_state.find(r.first_announcer);
+    if (it != m_peer_tx_relay_state.end() && it->second.requested_txs > 0)
+      --it->second.requested_txs;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
@@ -1736,6 +2045,9 @@ skip:
     }
 
     m_block_queue.flush_spans(context.m_connection_id, false);
+
+    CRITICAL_REGION_LOCAL(m_tx_relay_lock);
+    m_peer_tx_relay_state.erase(context.m_connection_id);
   }
 
   //------------------------------------------------------------------------------------------------------------------------
@@ -659,6 +659,13 @@ bool t_command_parser_executor::sync_info(const std::vector<std::string>& args)
   return m_executor.sync_info();
 }
 
+bool t_command_parser_executor::metrics(const std::vector<std::string>& args)
+{
+  if (args.size() > 1) return false;
+
+  return m_executor.metrics(args.empty() ? std::string() : args[0]);
+}
+
 bool t_command_parser_executor::version(const std::vector<std::string>& args)
 {
   std::cout << "Monero '" << MONERO_RELEASE_NAME << "' (v" << MONERO_VERSION_FULL << ")" << std::endl;
@@ -139,6 +139,8 @@ public:
 
   bool sync_info(const std::vector<std::string>& args);
 
+  bool metrics(const std::vector<std::string>& args);
+
   bool version(const std::vector<std::string>& args);
 };
 
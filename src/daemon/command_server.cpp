@@ -280,6 +280,12 @@ t_command_server::t_command_server(
     , std::bind(&t_command_parser_executor::sync_info, &m_parser, p::_1)
     , "Print information about the blockchain sync state."
     );
+    m_command_lookup.set_handler(
+      "metrics"
+    , std::bind(&t_command_parser_executor::metrics, &m_parser, p::_1)
+    , "metrics [<filter>]"
+    , "Print the daemon's counters, gauges and timing histograms, optionally only those whose name contains <filter>."
+    );
     m_command_lookup.set_handler(
       "version"
     , std::bind(&t_command_parser_executor::version, &m_parser, p::_1)
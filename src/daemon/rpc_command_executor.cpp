@@ -1914,4 +1914,50 @@ bool t_rpc_command_executor::sync_info()
     return true;
 }
 
+bool t_rpc_command_executor::metrics(const std::string &filter)
+{
+    cryptonote::COMMAND_RPC_GET_METRICS::request req;
+    cryptonote::COMMAND_RPC_GET_METRICS::response res;
+    std::string fail_message = "Unsuccessful";
+    epee::json_rpc::error error_resp;
+
+    if (m_is_rpc)
+    {
+        if (!m_rpc_client->json_rpc_request(req, res, "get_metrics", fail_message.c_str()))
+        {
+            return true;
+        }
+    }
+    else
+    {
+        if (!m_rpc_server->on_get_metrics(req, res, error_resp) || res.status != CORE_RPC_STATUS_OK)
+        {
+            tools::fail_msg_writer() << make_error(fail_message, res.status);
+            return true;
+        }
+    }
+
+    for (const auto &m: res.metrics)
+    {
+      if (!filter.empty() && m.name.find(filter) == std::string::npos)
+        continue;
+      std::string name = epee::string_tools::pad_string(m.name, 56);
+      if (m.type == "histogram")
+      {
+        // timing histograms are exported in seconds, everything else in raw units
+        const bool seconds = m.name.find("_seconds") != std::string::npos;
+        const double mult = seconds ? 1e3 : 1.0;
+        const char *unit = seconds ? " ms" : "";
+        tools::msg_writer() << name << "  " << m.count << " samples, p50 " << m.p50 * mult << unit << ", p99 " << m.p99 * mult << unit
+            << ", max " << m.max * mult << unit << ", total " << m.value * mult << unit;
+      }
+      else
+      {
+        tools::msg_writer() << name << "  " << (int64_t)m.value;
+      }
+    }
+
+    return true;
+}
+
 }// namespace daemonize
@@ -152,6 +152,8 @@ public:
   bool relay_tx(const std::string &txid);
 
   bool sync_info();
+
+  bool metrics(const std::string &filter);
 };
 
 } // namespace daemonize
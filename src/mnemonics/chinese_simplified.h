@@ -72,7 +72,14 @@ namespace Language
   class Chinese_Simplified: public Base
   {
   public:
-    Chinese_Simplified(): Base("简体中文 (中国)", "Chinese (simplified)", std::vector<std::string>({
+    Chinese_Simplified(): Base("简体中文 (中国)", "Chinese (simplified)", get_words(), 1)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
       "的",
       "一",
       "是",
@@ -1699,9 +1706,9 @@ namespace Language
       "秒",
       "浙",
       "貌"
-      }), 1)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Chinese_Simplified");
+      return words;
     }
   };
 }
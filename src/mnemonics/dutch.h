@@ -49,7 +49,14 @@ namespace Language
   class Dutch: public Base
   {
   public:
-    Dutch(): Base("Nederlands", "Dutch", std::vector<std::string>({
+    Dutch(): Base("Nederlands", "Dutch", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "aalglad",
         "aalscholver",
         "aambeeld",
@@ -1676,9 +1683,9 @@ namespace Language
         "zwiep",
         "zwijmel",
         "zworen"
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Dutch");
+      return words;
     }
   };
 }
@@ -103,40 +103,34 @@ namespace
     });
     Language::Base *fallback = NULL;
 
+    if (seed.empty())
+      return false;
+
     // Iterate through all the languages and find a match
     for (std::vector<Language::Base*>::iterator it1 = language_instances.begin();
       it1 != language_instances.end(); it1++)
     {
-      const std::unordered_map<std::string, uint32_t> &word_map = (*it1)->get_word_map();
-      const std::unordered_map<std::string, uint32_t> &trimmed_word_map = (*it1)->get_trimmed_word_map();
-      // To iterate through seed words
-      std::vector<std::string>::const_iterator it2;
-      bool full_match = true;
+      // With a checksum, words are matched on their unique prefix only
+      auto lookup = [&](const std::string &word, uint32_t &index) {
+        return has_checksum ? (*it1)->find_word_prefix(word, index) : (*it1)->find_word(word, index);
+      };
 
-      std::string trimmed_word;
-      // Iterate through all the words and see if they're all present
-      for (it2 = seed.begin(); it2 != seed.end(); it2++)
+      // The first word rules out most languages, only look at the rest
+      // of the seed for the ones it is in
+      uint32_t index;
+      if (!lookup(seed.front(), index))
+        continue;
+
+      bool full_match = true;
+      matched_indices.push_back(index);
+      for (std::vector<std::string>::const_iterator it2 = seed.begin() + 1; it2 != seed.end(); it2++)
       {
-        if (has_checksum)
+        if (!lookup(*it2, index))
         {
-          trimmed_word = Language::utf8prefix(*it2, (*it1)->get_unique_prefix_length());
-          // Use the trimmed words and map
-          if (trimmed_word_map.count(trimmed_word) == 0)
-          {
-            full_match = false;
-            break;
-          }
-          matched_indices.push_back(trimmed_word_map.at(trimmed_word));
-        }
-        else
-        {
-          if (word_map.count(*it2) == 0)
-          {
-            full_match = false;
-            break;
-          }
-          matched_indices.push_back(word_map.at(*it2));
+          full_match = false;
+          break;
         }
+        matched_indices.push_back(index);
       }
       if (full_match)
       {
@@ -277,7 +271,7 @@ namespace crypto
         return false;
       }
       language_name = language->get_language_name();
-      uint32_t word_list_length = language->get_word_list().size();
+      uint32_t word_list_length = Language::Base::NUM_WORDS;
 
       if (has_checksum)
       {
@@ -405,11 +399,10 @@ namespace crypto
       {
         return false;
       }
-      const std::vector<std::string> &word_list = language->get_word_list();
       // To store the words for random access to add the checksum word later.
       std::vector<std::string> words_store;
 
-      uint32_t word_list_length = word_list.size();
+      uint32_t word_list_length = Language::Base::NUM_WORDS;
       // 4 bytes -> 3 words.  8 digits base 16 -> 3 digits base 1626
       for (unsigned int i=0; i < len/4; i++, words += ' ')
       {
@@ -423,15 +416,15 @@ namespace crypto
         w2 = ((val / word_list_length) + w1) % word_list_length;
         w3 = (((val / word_list_length) / word_list_length) + w2) % word_list_length;
 
-        words += word_list[w1];
+        words += language->get_word(w1);
         words += ' ';
-        words += word_list[w2];
+        words += language->get_word(w2);
         words += ' ';
-        words += word_list[w3];
+        words += language->get_word(w3);
 
-        words_store.push_back(word_list[w1]);
-        words_store.push_back(word_list[w2]);
-        words_store.push_back(word_list[w3]);
+        words_store.push_back(language->get_word(w1));
+        words_store.push_back(language->get_word(w2));
+        words_store.push_back(language->get_word(w3));
       }
 
       words.pop_back();
@@ -49,7 +49,14 @@ namespace Language
   class English: public Base
   {
   public:
-    English(): Base("English", "English", std::vector<std::string>({
+    English(): Base("English", "English", get_words(), 3)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "abbey",
         "abducts",
         "ability",
@@ -1676,9 +1683,9 @@ namespace Language
         "zombie",
         "zones",
         "zoom"
-      }), 3)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for English");
+      return words;
     }
   };
 }
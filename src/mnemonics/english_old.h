@@ -51,7 +51,14 @@ namespace Language
   class EnglishOld: public Base
   {
   public:
-    EnglishOld(): Base("EnglishOld", "English (old)", std::vector<std::string>({
+    EnglishOld(): Base("EnglishOld", "English (old)", get_words(), 4, ALLOW_DUPLICATE_PREFIXES | ALLOW_SHORT_WORDS)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "like",
         "just",
         "love",
@@ -1678,9 +1685,9 @@ namespace Language
         "unseen",
         "weapon",
         "weary"
-      }), 4)
-    {
-      populate_maps(ALLOW_DUPLICATE_PREFIXES | ALLOW_SHORT_WORDS);
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for EnglishOld");
+      return words;
     }
   };
 }
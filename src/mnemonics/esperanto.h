@@ -58,7 +58,14 @@ namespace Language
   class Esperanto: public Base
   {
   public:
-    Esperanto(): Base("Esperanto", "Esperanto", std::vector<std::string>({
+    Esperanto(): Base("Esperanto", "Esperanto", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
       "abako",
       "abdiki",
       "abelo",
@@ -1685,9 +1692,9 @@ namespace Language
       "zorgi",
       "zukino",
       "zumilo",
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Esperanto");
+      return words;
     }
   };
 }
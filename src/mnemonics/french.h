@@ -49,7 +49,14 @@ namespace Language
   class French: public Base
   {
   public:
-    French(): Base("Français", "French", std::vector<std::string>({
+    French(): Base("Français", "French", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "abandon",
         "abattre",
         "aboi",
@@ -1676,9 +1683,9 @@ namespace Language
         "zinc",
         "zone",
         "zoom"
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for French");
+      return words;
     }
   };
 }
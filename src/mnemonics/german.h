@@ -51,7 +51,14 @@ namespace Language
   class German: public Base
   {
   public:
-    German(): Base("Deutsch", "German", std::vector<std::string>({
+    German(): Base("Deutsch", "German", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "Abakus",
         "Abart",
         "abbilden",
@@ -1678,9 +1685,9 @@ namespace Language
         "Zündung",
         "Zweck",
         "Zyklop"
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for German");
+      return words;
     }
   };
 }
@@ -51,7 +51,14 @@ namespace Language
   class Italian: public Base
   {
   public:
-    Italian(): Base("Italiano", "Italian", std::vector<std::string>({
+    Italian(): Base("Italiano", "Italian", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "abbinare",
         "abbonato",
         "abisso",
@@ -1678,9 +1685,9 @@ namespace Language
         "zolfo",
         "zombie",
         "zucchero"
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Italian");
+      return words;
     }
   };
 }
@@ -71,7 +71,14 @@ namespace Language
   class Japanese: public Base
   {
   public:
-    Japanese(): Base("日本語", "Japanese", std::vector<std::string>({
+    Japanese(): Base("日本語", "Japanese", get_words(), 3)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "あいこくしん",
         "あいさつ",
         "あいだ",
@@ -1698,9 +1705,9 @@ namespace Language
         "ひさん",
         "びじゅつかん",
         "ひしょ"
-      }), 3)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Japanese");
+      return words;
     }
   };
 }
@@ -56,7 +56,14 @@ namespace Language
   class Lojban: public Base
   {
   public:
-    Lojban(): Base("Lojban", "Lojban", std::vector<std::string>({
+    Lojban(): Base("Lojban", "Lojban", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
       "backi",
       "bacru",
       "badna",
@@ -1683,9 +1690,9 @@ namespace Language
       "noltruti'u",
       "samtci",
       "snaxa'a",
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Lojban");
+      return words;
     }
   };
 }
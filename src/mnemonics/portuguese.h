@@ -72,7 +72,14 @@ namespace Language
   class Portuguese: public Base
   {
   public:
-    Portuguese(): Base("Português", "Portuguese", std::vector<std::string>({
+    Portuguese(): Base("Português", "Portuguese", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "abaular",
         "abdominal",
         "abeto",
@@ -1699,9 +1706,9 @@ namespace Language
         "zeloso",
         "zenite",
         "zumbi"
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Portuguese");
+      return words;
     }
   };
 }
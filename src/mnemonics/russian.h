@@ -51,7 +51,14 @@ namespace Language
   class Russian: public Base
   {
   public:
-    Russian(): Base("русский язык", "Russian", std::vector<std::string>({
+    Russian(): Base("русский язык", "Russian", get_words(), 4)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "абажур",
         "абзац",
         "абонент",
@@ -1678,9 +1685,9 @@ namespace Language
         "яхта",
         "ячейка",
         "ящик"
-      }), 4)
-    {
-      populate_maps();
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Russian");
+      return words;
     }
   };
 }
@@ -72,7 +72,14 @@ namespace Language
   class Spanish: public Base
   {
   public:
-    Spanish(): Base("Español", "Spanish", std::vector<std::string>({
+    Spanish(): Base("Español", "Spanish", get_words(), 4, ALLOW_SHORT_WORDS)
+    {
+    }
+
+  private:
+    static const char *const *get_words()
+    {
+      static const char *const words[] = {
         "ábaco",
         "abdomen",
         "abeja",
@@ -1699,9 +1706,9 @@ namespace Language
         "risa",
         "ritmo",
         "rito"
-      }), 4)
-    {
-      populate_maps(ALLOW_SHORT_WORDS);
+      };
+      static_assert(sizeof(words) / sizeof(words[0]) == NUM_WORDS, "Wrong word list length for Spanish");
+      return words;
     }
   };
 }
@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #pragma once
+#include <unordered_map>
 #include <boost/thread.hpp>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -210,10 +211,11 @@ namespace nodetool
     bool make_new_connection_from_anchor_peerlist(const std::vector<anchor_peerlist_entry>& anchor_peerlist);
     bool make_new_connection_from_peerlist(bool use_white_list);
     bool try_to_connect_and_handshake_with_new_peer(const epee::net_utils::network_address& na, bool just_take_peerlist = false, uint64_t last_seen_stamp = 0, PeerType peer_type = white, uint64_t first_seen_stamp = 0);
-    size_t get_random_index_with_fixed_probability(size_t max_index);
     bool is_peer_used(const peerlist_entry& peer);
     bool is_peer_used(const anchor_peerlist_entry& peer);
+    bool is_peer_used(peerid_type id, const epee::net_utils::network_address& adr);
     bool is_addr_connected(const epee::net_utils::network_address& peer);
+    void set_connection_peer_id(p2p_connection_context& context, peerid_type peer_id);
     void add_upnp_port_mapping(uint32_t port);
     void delete_upnp_port_mapping(uint32_t port);
     template<class t_callback>
@@ -325,6 +327,10 @@ namespace nodetool
     std::map<epee::net_utils::network_address, time_t> m_conn_fails_cache;
     epee::critical_section m_conn_fails_cache_lock;
 
+    epee::critical_section m_connected_peers_lock;
+    std::map<epee::net_utils::network_address, size_t> m_connected_out_addrs; // outgoing connection count by address
+    std::unordered_map<peerid_type, size_t> m_connected_peer_ids; // connection count by peer id
+
     epee::critical_section m_blocked_hosts_lock;
     std::map<std::string, time_t> m_blocked_hosts;
 
@@ -38,6 +38,7 @@
 
 #include "version.h"
 #include "string_tools.h"
+#include "file_io_utils.h"
 #include "common/util.h"
 #include "common/dns_utils.h"
 #include "net/net_helper.h"
@@ -91,44 +92,53 @@ namespace nodetool
     //
     TRY_ENTRY();
     std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
-    std::ifstream p2p_data;
-    p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::in);
-    if(!p2p_data.fail())
+    std::string p2p_blob;
+    if (epee::file_io_utils::load_file_to_string(state_file_path, p2p_blob) && m_peerlist.load(p2p_blob))
     {
-      try
-      {
-        // first try reading in portable mode
-        boost::archive::portable_binary_iarchive a(p2p_data);
-        a >> *this;
-      }
-      catch (...)
+      MDEBUG("Loaded peerlist from " << state_file_path);
+    }
+    else
+    {
+      // older boost archive format, it gets rewritten in the current format on next save
+      std::ifstream p2p_data;
+      p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::in);
+      if(!p2p_data.fail())
       {
-        // if failed, try reading in unportable mode
-        boost::filesystem::copy_file(state_file_path, state_file_path + ".unportable", boost::filesystem::copy_option::overwrite_if_exists);
-        p2p_data.close();
-        p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::in);
-        if(!p2p_data.fail())
+        try
         {
-          try
+          // first try reading in portable mode
+          boost::archive::portable_binary_iarchive a(p2p_data);
+          a >> *this;
+        }
+        catch (...)
+        {
+          // if failed, try reading in unportable mode
+          boost::filesystem::copy_file(state_file_path, state_file_path + ".unportable", boost::filesystem::copy_option::overwrite_if_exists);
+          p2p_data.close();
+          p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::in);
+          if(!p2p_data.fail())
           {
-            boost::archive::binary_iarchive a(p2p_data);
-            a >> *this;
+            try
+            {
+              boost::archive::binary_iarchive a(p2p_data);
+              a >> *this;
+            }
+            catch (const std::exception &e)
+            {
+              MWARNING("Failed to load p2p config file, falling back to default config");
+              m_peerlist = peerlist_manager(); // it was probably half clobbered by the failed load
+              make_default_config();
+            }
           }
-          catch (const std::exception &e)
+          else
           {
-            MWARNING("Failed to load p2p config file, falling back to default config");
-            m_peerlist = peerlist_manager(); // it was probably half clobbered by the failed load
             make_default_config();
           }
         }
-        else
-        {
-          make_default_config();
-        }
+      }else
+      {
+        make_default_config();
       }
-    }else
-    {
-      make_default_config();
     }
 
     // always recreate a new peer id
@@ -649,16 +659,18 @@ namespace nodetool
     }
 
     std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
-    std::ofstream p2p_data;
-    p2p_data.open( state_file_path , std::ios_base::binary | std::ios_base::out| std::ios::trunc);
-    if(p2p_data.fail())
+    std::string p2p_blob;
+    if (!m_peerlist.store(p2p_blob))
     {
-      MWARNING("Failed to save config to file " << state_file_path);
+      MWARNING("Failed to serialize peerlist");
       return false;
-    };
+    }
 
-    boost::archive::portable_binary_oarchive a(p2p_data);
-    a << *this;
+    if (!epee::file_io_utils::save_string_to_file(state_file_path, p2p_blob))
+    {
+      MWARNING("Failed to save config to file " << state_file_path);
+      return false;
+    }
     return true;
     CATCH_ENTRY_L0("blockchain_storage::save", false);
 
@@ -731,7 +743,8 @@ namespace nodetool
           return;
         }
 
-        pi = context.peer_id = rsp.node_data.peer_id;
+        set_connection_peer_id(context, rsp.node_data.peer_id);
+        pi = context.peer_id;
         m_peerlist.set_peer_just_seen(rsp.node_data.peer_id, context.m_remote_address);
 
         if(rsp.node_data.peer_id == m_config.m_peer_id)
@@ -804,78 +817,49 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  size_t node_server<t_payload_net_handler>::get_random_index_with_fixed_probability(size_t max_index)
+  bool node_server<t_payload_net_handler>::is_peer_used(const peerlist_entry& peer)
   {
-    //divide by zero workaround
-    if(!max_index)
-      return 0;
-
-    size_t x = crypto::rand<size_t>()%(max_index+1);
-    size_t res = (x*x*x)/(max_index*max_index); //parabola \/
-    MDEBUG("Random connection index=" << res << "(x="<< x << ", max_index=" << max_index << ")");
-    return res;
+    return is_peer_used(peer.id, peer.adr);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::is_peer_used(const peerlist_entry& peer)
+  bool node_server<t_payload_net_handler>::is_peer_used(const anchor_peerlist_entry& peer)
   {
-
-    if(m_config.m_peer_id == peer.id)
-      return true;//dont make connections to ourself
-
-    bool used = false;
-    m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
-    {
-      if(cntxt.peer_id == peer.id || (!cntxt.m_is_income && peer.adr == cntxt.m_remote_address))
-      {
-        used = true;
-        return false;//stop enumerating
-      }
-      return true;
-    });
-
-    return used;
+    return is_peer_used(peer.id, peer.adr);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::is_peer_used(const anchor_peerlist_entry& peer)
+  bool node_server<t_payload_net_handler>::is_peer_used(peerid_type id, const epee::net_utils::network_address& adr)
   {
-    if(m_config.m_peer_id == peer.id) {
-        return true;//dont make connections to ourself
-    }
-
-    bool used = false;
-
-    m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
-    {
-      if(cntxt.peer_id == peer.id || (!cntxt.m_is_income && peer.adr == cntxt.m_remote_address))
-      {
-        used = true;
-
-        return false;//stop enumerating
-      }
-
-      return true;
-    });
+    if(m_config.m_peer_id == id)
+      return true;//dont make connections to ourself
 
-    return used;
+    CRITICAL_REGION_LOCAL(m_connected_peers_lock);
+    return m_connected_peer_ids.find(id) != m_connected_peer_ids.end() || m_connected_out_addrs.find(adr) != m_connected_out_addrs.end();
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::is_addr_connected(const epee::net_utils::network_address& peer)
   {
-    bool connected = false;
-    m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
+    CRITICAL_REGION_LOCAL(m_connected_peers_lock);
+    return m_connected_out_addrs.find(peer) != m_connected_out_addrs.end();
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::set_connection_peer_id(p2p_connection_context& context, peerid_type peer_id)
+  {
+    CRITICAL_REGION_LOCAL(m_connected_peers_lock);
+    if (context.peer_id == peer_id)
+      return;
+    if (context.peer_id)
     {
-      if(!cntxt.m_is_income && peer == cntxt.m_remote_address)
-      {
-        connected = true;
-        return false;//stop enumerating
-      }
-      return true;
-    });
-
-    return connected;
+      auto i = m_connected_peer_ids.find(context.peer_id);
+      if (i != m_connected_peer_ids.end() && --i->second == 0)
+        m_connected_peer_ids.erase(i);
+    }
+    context.peer_id = peer_id;
+    if (peer_id)
+      ++m_connected_peer_ids[peer_id];
   }
 
 #define LOG_PRINT_CC_PRIORITY_NODE(priority, con, msg) \
@@ -1063,40 +1047,25 @@ namespace nodetool
     if(!local_peers_count)
       return false;//no peers
 
-    size_t max_random_index = std::min<uint64_t>(local_peers_count -1, 20);
+    const size_t max_rand_count = std::min<size_t>(local_peers_count, 21) * 3;
 
-    std::set<size_t> tried_peers;
+    std::set<epee::net_utils::network_address> tried_peers;
 
     size_t try_count = 0;
     size_t rand_count = 0;
-    while(rand_count < (max_random_index+1)*3 &&  try_count < 10 && !m_net_server.is_stop_signal_sent())
+    while(rand_count < max_rand_count &&  try_count < 10 && !m_net_server.is_stop_signal_sent())
     {
       ++rand_count;
-      size_t random_index;
-
-      if (use_white_list) {
-        local_peers_count = m_peerlist.get_white_peers_count();
-        if (!local_peers_count)
-          return false;
-        max_random_index = std::min<uint64_t>(local_peers_count -1, 20);
-        random_index = get_random_index_with_fixed_probability(max_random_index);
-      } else {
-        local_peers_count = m_peerlist.get_gray_peers_count();
-        if (!local_peers_count)
-          return false;
-        random_index = crypto::rand<size_t>() % local_peers_count;
-      }
 
-      CHECK_AND_ASSERT_MES(random_index < local_peers_count, false, "random_starter_index < peers_local.size() failed!!");
+      peerlist_entry pe = AUTO_VAL_INIT(pe);
+      bool r = use_white_list ? m_peerlist.get_random_white_peer(pe):m_peerlist.get_random_gray_peer(pe);
+      if (!r)
+        return false;
 
-      if(tried_peers.count(random_index))
+      if(tried_peers.count(pe.adr))
         continue;
 
-      tried_peers.insert(random_index);
-      peerlist_entry pe = AUTO_VAL_INIT(pe);
-      bool r = use_white_list ? m_peerlist.get_white_peer_by_index(pe, random_index):m_peerlist.get_gray_peer_by_index(pe, random_index);
-      CHECK_AND_ASSERT_MES(r, false, "Failed to get random peer from peerlist(white:" << use_white_list << ")");
-
+      tried_peers.insert(pe.adr);
       ++try_count;
 
       _note("Considering connecting (out) to peer: " << peerid_to_string(pe.id) << " " << pe.adr.str());
@@ -1463,9 +1432,11 @@ namespace nodetool
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const std::string& data_buff, const std::list<boost::uuids::uuid> &connections)
   {
+    // frame the message once, every connection queues the same buffer
+    const std::shared_ptr<const std::string> message = epee::levin::make_notify(command, data_buff);
     for(const auto& c_id: connections)
     {
-      m_net_server.get_config_object().notify(command, data_buff, c_id);
+      m_net_server.get_config_object().notify(message, c_id);
     }
     return true;
   }
@@ -1674,7 +1645,7 @@ namespace nodetool
     }
 
     //associate peer_id with this connection
-    context.peer_id = arg.node_data.peer_id;
+    set_connection_peer_id(context, arg.node_data.peer_id);
     context.m_in_timedsync = false;
 
     if(arg.node_data.peer_id != m_config.m_peer_id && arg.node_data.my_port)
@@ -1758,6 +1729,11 @@ namespace nodetool
   template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::on_connection_new(p2p_connection_context& context)
   {
+    if (!context.m_is_income)
+    {
+      CRITICAL_REGION_LOCAL(m_connected_peers_lock);
+      ++m_connected_out_addrs[context.m_remote_address];
+    }
     MINFO("["<< epee::net_utils::print_connection_context(context) << "] NEW CONNECTION");
   }
   //-----------------------------------------------------------------------------------
@@ -1771,9 +1747,19 @@ namespace nodetool
       m_peerlist.remove_from_peer_anchor(na);
     }
 
+    if (!context.m_is_income)
+    {
+      CRITICAL_REGION_LOCAL(m_connected_peers_lock);
+      auto i = m_connected_out_addrs.find(context.m_remote_address);
+      if (i != m_connected_out_addrs.end() && --i->second == 0)
+        m_connected_out_addrs.erase(i);
+    }
+
     m_payload_handler.on_connection_close(context);
 
     MINFO("["<< epee::net_utils::print_connection_context(context) << "] CLOSE CONNECTION");
+
+    set_connection_peer_id(context, 0);
   }
 
   template<class t_payload_net_handler>
@@ -33,6 +33,11 @@
 #include <list>
 #include <set>
 #include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/portable_binary_oarchive.hpp>
 #include <boost/archive/portable_binary_iarchive.hpp>
@@ -42,28 +47,242 @@
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/member.hpp>
-#include <boost/range/adaptor/reversed.hpp>
 
 
 #include "syncobj.h"
 #include "net/local_ip.h"
 #include "p2p_protocol_defs.h"
 #include "cryptonote_config.h"
+#include "common/varint.h"
 #include "net_peerlist_boost_serialization.h"
 
 
 #define CURRENT_PEERLIST_STORAGE_ARCHIVE_VER    6
 
+#define PEERLIST_STORAGE_SIGNATURE              "MNPEERS1"
+#define PEERLIST_STORAGE_VERSION                1
+#define PEERLIST_EVICTION_SAMPLES               4
+
 namespace nodetool
 {
 
 
+  /************************************************************************/
+  /* Peers keyed by address and bucketed by /16 subnet, so that random    */
+  /* selection and eviction are O(1) and spread across subnets, and       */
+  /* ordered by last_seen, so that the most recent ones are a walk away   */
+  /************************************************************************/
+  class peerlist_table
+  {
+  public:
+    typedef std::vector<peerlist_entry>::const_iterator const_iterator;
+
+    explicit peerlist_table(size_t max_size): m_max_size(max_size) {}
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+    const_iterator begin() const { return m_entries.begin(); }
+    const_iterator end() const { return m_entries.end(); }
+    void clear();
+    const peerlist_entry *find(const epee::net_utils::network_address &adr) const;
+    bool insert(const peerlist_entry &ple);
+    bool erase(const epee::net_utils::network_address &adr);
+    const peerlist_entry *get_random() const;
+    std::vector<const peerlist_entry*> get_most_recent(size_t count, bool seen_only) const;
+
+    static uint32_t get_bucket_key(const epee::net_utils::network_address &adr);
+
+  private:
+    struct bucket
+    {
+      std::vector<size_t> slots;
+      size_t key_index; // position of this bucket's key in m_bucket_keys
+    };
+
+    typedef std::multimap<int64_t, size_t, std::greater<int64_t>> time_index;
+
+    void erase_slot(size_t slot);
+    size_t get_eviction_slot(uint32_t key) const;
+
+    size_t m_max_size;
+    std::vector<peerlist_entry> m_entries;
+    std::vector<std::pair<uint32_t, size_t>> m_positions; // bucket key and index in that bucket, parallel to m_entries
+    std::map<epee::net_utils::network_address, size_t> m_by_addr;
+    time_index m_by_time; // most recently seen first
+    std::vector<time_index::iterator> m_time_positions; // parallel to m_entries
+    std::unordered_map<uint32_t, bucket> m_buckets;
+    std::vector<uint32_t> m_bucket_keys;
+  };
+  //--------------------------------------------------------------------------------------------------
+  inline
+  uint32_t peerlist_table::get_bucket_key(const epee::net_utils::network_address &adr)
+  {
+    // ips are in network byte order, so the /16 is the low 16 bits
+    if (adr.get_type_id() == epee::net_utils::ipv4_network_address::ID)
+      return adr.as<epee::net_utils::ipv4_network_address>().ip() & 0xffff;
+    return 0x10000 | adr.get_type_id();
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_table::clear()
+  {
+    m_entries.clear();
+    m_positions.clear();
+    m_by_addr.clear();
+    m_by_time.clear();
+    m_time_positions.clear();
+    m_buckets.clear();
+    m_bucket_keys.clear();
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  const peerlist_entry *peerlist_table::find(const epee::net_utils::network_address &adr) const
+  {
+    auto i = m_by_addr.find(adr);
+    if (i == m_by_addr.end())
+      return NULL;
+    return &m_entries[i->second];
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_table::insert(const peerlist_entry &ple)
+  {
+    auto i = m_by_addr.find(ple.adr);
+    if (i != m_by_addr.end())
+    {
+      const size_t slot = i->second;
+      if (m_entries[slot].last_seen != ple.last_seen)
+      {
+        m_by_time.erase(m_time_positions[slot]);
+        m_time_positions[slot] = m_by_time.insert(std::make_pair(ple.last_seen, slot));
+      }
+      m_entries[slot] = ple;
+      return true;
+    }
+
+    const uint32_t key = get_bucket_key(ple.adr);
+    if (m_max_size && m_entries.size() >= m_max_size)
+    {
+      const size_t victim = get_eviction_slot(key);
+      if (m_entries[victim].last_seen > ple.last_seen)
+        return false;
+      erase_slot(victim);
+    }
+
+    auto b = m_buckets.find(key);
+    if (b == m_buckets.end())
+    {
+      b = m_buckets.insert(std::make_pair(key, bucket())).first;
+      b->second.key_index = m_bucket_keys.size();
+      m_bucket_keys.push_back(key);
+    }
+    const size_t slot = m_entries.size();
+    m_entries.push_back(ple);
+    m_positions.push_back(std::make_pair(key, b->second.slots.size()));
+    b->second.slots.push_back(slot);
+    m_by_addr.insert(std::make_pair(ple.adr, slot));
+    m_time_positions.push_back(m_by_time.insert(std::make_pair(ple.last_seen, slot)));
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_table::erase(const epee::net_utils::network_address &adr)
+  {
+    auto i = m_by_addr.find(adr);
+    if (i == m_by_addr.end())
+      return false;
+    erase_slot(i->second);
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  void peerlist_table::erase_slot(size_t slot)
+  {
+    // remove from its bucket, moving the bucket's last slot in its place
+    const uint32_t key = m_positions[slot].first;
+    auto b = m_buckets.find(key);
+    std::vector<size_t> &slots = b->second.slots;
+    const size_t pos = m_positions[slot].second;
+    slots[pos] = slots.back();
+    m_positions[slots[pos]].second = pos;
+    slots.pop_back();
+    if (slots.empty())
+    {
+      const size_t key_index = b->second.key_index;
+      m_bucket_keys[key_index] = m_bucket_keys.back();
+      m_buckets.find(m_bucket_keys[key_index])->second.key_index = key_index;
+      m_bucket_keys.pop_back();
+      m_buckets.erase(b);
+    }
+    m_by_addr.erase(m_entries[slot].adr);
+    m_by_time.erase(m_time_positions[slot]);
+
+    // move the last entry into the freed slot
+    const size_t last = m_entries.size() - 1;
+    if (slot != last)
+    {
+      m_entries[slot] = std::move(m_entries[last]);
+      m_positions[slot] = m_positions[last];
+      m_buckets.find(m_positions[slot].first)->second.slots[m_positions[slot].second] = slot;
+      m_by_addr[m_entries[slot].adr] = slot;
+      m_time_positions[slot] = m_time_positions[last];
+      m_time_positions[slot]->second = slot;
+    }
+    m_entries.pop_back();
+    m_positions.pop_back();
+    m_time_positions.pop_back();
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  size_t peerlist_table::get_eviction_slot(uint32_t key) const
+  {
+    // evict from the more crowded of the new peer's subnet and a random peer's subnet,
+    // picking the stalest of a few random peers in there
+    auto b = m_buckets.find(m_positions[crypto::rand<size_t>() % m_positions.size()].first);
+    auto own = m_buckets.find(key);
+    if (own != m_buckets.end() && own->second.slots.size() >= b->second.slots.size())
+      b = own;
+    const std::vector<size_t> &slots = b->second.slots;
+    size_t victim = slots[crypto::rand<size_t>() % slots.size()];
+    for (size_t n = 1; n < PEERLIST_EVICTION_SAMPLES && n < slots.size(); ++n)
+    {
+      const size_t slot = slots[crypto::rand<size_t>() % slots.size()];
+      if (m_entries[slot].last_seen < m_entries[victim].last_seen)
+        victim = slot;
+    }
+    return victim;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  const peerlist_entry *peerlist_table::get_random() const
+  {
+    if (m_bucket_keys.empty())
+      return NULL;
+    const uint32_t key = m_bucket_keys[crypto::rand<size_t>() % m_bucket_keys.size()];
+    const std::vector<size_t> &slots = m_buckets.find(key)->second.slots;
+    return &m_entries[slots[crypto::rand<size_t>() % slots.size()]];
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  std::vector<const peerlist_entry*> peerlist_table::get_most_recent(size_t count, bool seen_only) const
+  {
+    std::vector<const peerlist_entry*> peers;
+    peers.reserve(std::min(count, m_entries.size()));
+    for (auto i = m_by_time.begin(); i != m_by_time.end() && peers.size() < count; ++i)
+      if (!seen_only || i->first)
+        peers.push_back(&m_entries[i->second]);
+    return peers;
+  }
+
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
   class peerlist_manager
   {
   public: 
+    peerlist_manager(): m_allow_local_ip(false), m_peers_gray(P2P_LOCAL_GRAY_PEERLIST_LIMIT), m_peers_white(P2P_LOCAL_WHITE_PEERLIST_LIMIT) {}
+
     bool init(bool allow_local_ip);
     bool deinit();
     size_t get_white_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_white.size();}
@@ -71,8 +290,7 @@ namespace nodetool
     bool merge_peerlist(const std::list<peerlist_entry>& outer_bs);
     bool get_peerlist_head(std::list<peerlist_entry>& bs_head, uint32_t depth = P2P_DEFAULT_PEERS_IN_HANDSHAKE);
     bool get_peerlist_full(std::list<peerlist_entry>& pl_gray, std::list<peerlist_entry>& pl_white);
-    bool get_white_peer_by_index(peerlist_entry& p, size_t i);
-    bool get_gray_peer_by_index(peerlist_entry& p, size_t i);
+    bool get_random_white_peer(peerlist_entry& pe);
     bool append_with_peer_white(const peerlist_entry& pr);
     bool append_with_peer_gray(const peerlist_entry& pr);
     bool append_with_peer_anchor(const anchor_peerlist_entry& ple);
@@ -83,68 +301,13 @@ namespace nodetool
     bool remove_from_peer_gray(const peerlist_entry& pe);
     bool get_and_empty_anchor_peerlist(std::vector<anchor_peerlist_entry>& apl);
     bool remove_from_peer_anchor(const epee::net_utils::network_address& addr);
+    bool store(std::string& blob);
+    bool load(const std::string& blob);
     
   private:
     struct by_time{};
-    struct by_id{};
     struct by_addr{};
 
-    struct modify_all_but_id
-    {
-      modify_all_but_id(const peerlist_entry& ple):m_ple(ple){}
-      void operator()(peerlist_entry& e)
-      {
-        e.id = m_ple.id;
-      }
-    private:
-      const peerlist_entry& m_ple;
-    };
-
-    struct modify_all
-    {
-      modify_all(const peerlist_entry& ple):m_ple(ple){}
-      void operator()(peerlist_entry& e)
-      {
-        e = m_ple;
-      }
-    private:
-      const peerlist_entry& m_ple;
-    };
-
-    struct modify_last_seen
-    {
-      modify_last_seen(time_t last_seen):m_last_seen(last_seen){}
-      void operator()(peerlist_entry& e)
-      {
-        e.last_seen = m_last_seen;
-      }
-    private:
-      time_t m_last_seen;
-    };
-
-
-    typedef boost::multi_index_container<
-      peerlist_entry,
-      boost::multi_index::indexed_by<
-      // access by peerlist_entry::net_adress
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
-      // sort by peerlist_entry::last_seen<
-      boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
-      > 
-    > peers_indexed;
-
-    typedef boost::multi_index_container<
-      peerlist_entry,
-      boost::multi_index::indexed_by<
-      // access by peerlist_entry::id<
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_id>, boost::multi_index::member<peerlist_entry,uint64_t,&peerlist_entry::id> >,
-      // access by peerlist_entry::net_adress
-      boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
-      // sort by peerlist_entry::last_seen<
-      boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
-      > 
-    > peers_indexed_old;
-
     typedef boost::multi_index_container<
       anchor_peerlist_entry,
       boost::multi_index::indexed_by<
@@ -203,9 +366,13 @@ namespace nodetool
     }
 
   private: 
-    bool peers_indexed_from_old(const peers_indexed_old& pio, peers_indexed& pi);
-    void trim_white_peerlist();
-    void trim_gray_peerlist();
+    template<typename T> static void store_int(std::string& blob, T v);
+    template<typename T> static bool load_int(std::string::const_iterator& i, std::string::const_iterator& end, T& v);
+    static bool load_varint(std::string::const_iterator& i, std::string::const_iterator& end, uint64_t& v);
+    static bool store_address(std::string& blob, const epee::net_utils::network_address& adr);
+    static bool load_address(std::string::const_iterator& i, std::string::const_iterator& end, epee::net_utils::network_address& adr);
+    static bool store_peers(std::string& blob, const peerlist_table& peers);
+    static bool load_peers(std::string::const_iterator& i, std::string::const_iterator& end, peerlist_table& peers);
 
     friend class boost::serialization::access;
     epee::critical_section m_peerlist_lock;
@@ -213,8 +380,8 @@ namespace nodetool
     bool m_allow_local_ip;
 
 
-    peers_indexed m_peers_gray;
-    peers_indexed m_peers_white;
+    peerlist_table m_peers_gray;
+    peerlist_table m_peers_white;
     anchor_peers_indexed m_peers_anchor;
   };
   //--------------------------------------------------------------------------------------------------
@@ -232,39 +399,6 @@ namespace nodetool
   }
   //--------------------------------------------------------------------------------------------------
   inline 
-  bool peerlist_manager::peers_indexed_from_old(const peers_indexed_old& pio, peers_indexed& pi)
-  {
-    for(auto x: pio)
-    {
-      auto by_addr_it = pi.get<by_addr>().find(x.adr);
-      if(by_addr_it == pi.get<by_addr>().end())
-      {
-        pi.insert(x);
-      }
-    }
-
-    return true;
-  }
-  //--------------------------------------------------------------------------------------------------
-  inline void peerlist_manager::trim_gray_peerlist()
-  {
-    while(m_peers_gray.size() > P2P_LOCAL_GRAY_PEERLIST_LIMIT)
-    {
-      peers_indexed::index<by_time>::type& sorted_index=m_peers_gray.get<by_time>();
-      sorted_index.erase(sorted_index.begin());
-    }
-  }
-  //--------------------------------------------------------------------------------------------------
-  inline void peerlist_manager::trim_white_peerlist()
-  {
-    while(m_peers_white.size() > P2P_LOCAL_WHITE_PEERLIST_LIMIT)
-    {
-      peers_indexed::index<by_time>::type& sorted_index=m_peers_white.get<by_time>();
-      sorted_index.erase(sorted_index.begin());
-    }
-  }
-  //--------------------------------------------------------------------------------------------------
-  inline 
   bool peerlist_manager::merge_peerlist(const std::list<peerlist_entry>& outer_bs)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
@@ -272,32 +406,22 @@ namespace nodetool
     {
       append_with_peer_gray(be);
     }
-    // delete extra elements
-    trim_gray_peerlist();    
-    return true;
-  }
-  //--------------------------------------------------------------------------------------------------
-  inline
-  bool peerlist_manager::get_white_peer_by_index(peerlist_entry& p, size_t i)
-  {
-    CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    if(i >= m_peers_white.size())
-      return false;
-
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_white.get<by_time>();
-    p = *epee::misc_utils::move_it_backward(--by_time_index.end(), i);    
     return true;
   }
   //--------------------------------------------------------------------------------------------------
   inline
-    bool peerlist_manager::get_gray_peer_by_index(peerlist_entry& p, size_t i)
+  bool peerlist_manager::get_random_white_peer(peerlist_entry& pe)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    if(i >= m_peers_gray.size())
+    const peerlist_entry *p = m_peers_white.get_random();
+    if (!p)
       return false;
 
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
-    p = *epee::misc_utils::move_it_backward(--by_time_index.end(), i);    
+    // favour recently seen peers, taking the fresher of two random picks
+    const peerlist_entry *q = m_peers_white.get_random();
+    if (q->last_seen > p->last_seen)
+      p = q;
+    pe = *p;
     return true;
   }
   //--------------------------------------------------------------------------------------------------
@@ -319,17 +443,9 @@ namespace nodetool
   {
     
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    peers_indexed::index<by_time>::type& by_time_index=m_peers_white.get<by_time>();
-    uint32_t cnt = 0;
-    for(const peers_indexed::value_type& vl: boost::adaptors::reverse(by_time_index))
+    for(const peerlist_entry *pe: m_peers_white.get_most_recent(depth, true))
     {
-      if(!vl.last_seen)
-        continue;
-
-      if(cnt++ >= depth)
-        break;
-
-      bs_head.push_back(vl);
+      bs_head.push_back(*pe);
     }
     return true;
   }
@@ -338,16 +454,14 @@ namespace nodetool
   bool peerlist_manager::get_peerlist_full(std::list<peerlist_entry>& pl_gray, std::list<peerlist_entry>& pl_white)
   {    
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    peers_indexed::index<by_time>::type& by_time_index_gr=m_peers_gray.get<by_time>();
-    for(const peers_indexed::value_type& vl: boost::adaptors::reverse(by_time_index_gr))
+    for(const peerlist_entry *pe: m_peers_gray.get_most_recent(m_peers_gray.size(), false))
     {
-      pl_gray.push_back(vl);      
+      pl_gray.push_back(*pe);
     }
 
-    peers_indexed::index<by_time>::type& by_time_index_wt=m_peers_white.get<by_time>();
-    for(const peers_indexed::value_type& vl: boost::adaptors::reverse(by_time_index_wt))
+    for(const peerlist_entry *pe: m_peers_white.get_most_recent(m_peers_white.size(), false))
     {
-      pl_white.push_back(vl);      
+      pl_white.push_back(*pe);
     }
 
     return true;
@@ -374,25 +488,11 @@ namespace nodetool
     if(!is_host_allowed(ple.adr))
       return true;
 
-     CRITICAL_REGION_LOCAL(m_peerlist_lock);
-    //find in white list
-    auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
-    if(by_addr_it_wt == m_peers_white.get<by_addr>().end())
-    {
-      //put new record into white list
-      m_peers_white.insert(ple);
-      trim_white_peerlist();
-    }else
-    {
-      //update record in white list 
-      m_peers_white.replace(by_addr_it_wt, ple);      
-    }
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    //put new record into white list, or update it
+    m_peers_white.insert(ple);
     //remove from gray list, if need
-    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
-    if(by_addr_it_gr != m_peers_gray.get<by_addr>().end())
-    {
-      m_peers_gray.erase(by_addr_it_gr);
-    }
+    m_peers_gray.erase(ple.adr);
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_white()", false);
   }
@@ -406,22 +506,11 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
     //find in white list
-    auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
-    if(by_addr_it_wt != m_peers_white.get<by_addr>().end())
+    if(m_peers_white.find(ple.adr))
       return true;
 
-    //update gray list
-    auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
-    if(by_addr_it_gr == m_peers_gray.get<by_addr>().end())
-    {
-      //put new record into white list
-      m_peers_gray.insert(ple);
-      trim_gray_peerlist();    
-    }else
-    {
-      //update record in white list 
-      m_peers_gray.replace(by_addr_it_gr, ple);      
-    }
+    //put new record into gray list, or update it
+    m_peers_gray.insert(ple);
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_gray()", false);
   }
@@ -451,14 +540,12 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
 
-    if (m_peers_gray.empty()) {
+    const peerlist_entry *p = m_peers_gray.get_random();
+    if (!p) {
       return false;
     }
 
-    size_t random_index = crypto::rand<size_t>() % m_peers_gray.size();
-
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
-    pe = *epee::misc_utils::move_it_backward(--by_time_index.end(), random_index);
+    pe = *p;
 
     return true;
 
@@ -472,11 +559,7 @@ namespace nodetool
 
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
 
-    peers_indexed::index_iterator<by_addr>::type iterator = m_peers_gray.get<by_addr>().find(pe.adr);
-
-    if (iterator != m_peers_gray.get<by_addr>().end()) {
-      m_peers_gray.erase(iterator);
-    }
+    m_peers_gray.erase(pe.adr);
 
     return true;
 
@@ -522,6 +605,166 @@ namespace nodetool
     CATCH_ENTRY_L0("peerlist_manager::remove_from_peer_anchor()", false);
   }
   //--------------------------------------------------------------------------------------------------
+  template<typename T>
+  inline
+  void peerlist_manager::store_int(std::string& blob, T v)
+  {
+    for (size_t n = 0; n < sizeof(T); ++n)
+      blob.push_back((char)((v >> (8 * n)) & 0xff));
+  }
+  //--------------------------------------------------------------------------------------------------
+  template<typename T>
+  inline
+  bool peerlist_manager::load_int(std::string::const_iterator& i, std::string::const_iterator& end, T& v)
+  {
+    if ((size_t)(end - i) < sizeof(T))
+      return false;
+    v = 0;
+    for (size_t n = 0; n < sizeof(T); ++n)
+      v |= ((T)(uint8_t)*i++) << (8 * n);
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::load_varint(std::string::const_iterator& i, std::string::const_iterator& end, uint64_t& v)
+  {
+    // read_varint stops quietly at the end of the input, so check the varint was terminated
+    const int read = tools::read_varint<std::numeric_limits<uint64_t>::digits>(i, end, v);
+    return read > 0 && !(*(i - 1) & 0x80);
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::store_address(std::string& blob, const epee::net_utils::network_address& adr)
+  {
+    const uint8_t type = adr.get_type_id();
+    if (type != epee::net_utils::ipv4_network_address::ID)
+      return false;
+    const epee::net_utils::ipv4_network_address &ipv4 = adr.as<epee::net_utils::ipv4_network_address>();
+    store_int(blob, type);
+    store_int(blob, ipv4.ip());
+    store_int(blob, ipv4.port());
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::load_address(std::string::const_iterator& i, std::string::const_iterator& end, epee::net_utils::network_address& adr)
+  {
+    uint8_t type;
+    uint32_t ip;
+    uint16_t port;
+    if (!load_int(i, end, type) || type != epee::net_utils::ipv4_network_address::ID)
+      return false;
+    if (!load_int(i, end, ip) || !load_int(i, end, port))
+      return false;
+    adr = epee::net_utils::ipv4_network_address{ip, port};
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::store_peers(std::string& blob, const peerlist_table& peers)
+  {
+    tools::write_varint(std::back_inserter(blob), (uint64_t)peers.size());
+    for (const peerlist_entry &pe: peers)
+    {
+      if (!store_address(blob, pe.adr))
+        return false;
+      store_int(blob, pe.id);
+      tools::write_varint(std::back_inserter(blob), (uint64_t)std::max<int64_t>(pe.last_seen, 0));
+    }
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::load_peers(std::string::const_iterator& i, std::string::const_iterator& end, peerlist_table& peers)
+  {
+    uint64_t count, last_seen;
+    if (!load_varint(i, end, count))
+      return false;
+    while (count--)
+    {
+      peerlist_entry pe;
+      if (!load_address(i, end, pe.adr) || !load_int(i, end, pe.id))
+        return false;
+      if (!load_varint(i, end, last_seen))
+        return false;
+      pe.last_seen = last_seen;
+      peers.insert(pe);
+    }
+    return true;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::store(std::string& blob)
+  {
+    TRY_ENTRY();
+
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+
+    blob = PEERLIST_STORAGE_SIGNATURE;
+    tools::write_varint(std::back_inserter(blob), (uint64_t)PEERLIST_STORAGE_VERSION);
+    if (!store_peers(blob, m_peers_white) || !store_peers(blob, m_peers_gray))
+      return false;
+
+    tools::write_varint(std::back_inserter(blob), (uint64_t)m_peers_anchor.size());
+    for (const anchor_peerlist_entry &ape: m_peers_anchor)
+    {
+      if (!store_address(blob, ape.adr))
+        return false;
+      store_int(blob, ape.id);
+      tools::write_varint(std::back_inserter(blob), (uint64_t)std::max<int64_t>(ape.first_seen, 0));
+    }
+    return true;
+
+    CATCH_ENTRY_L0("peerlist_manager::store()", false);
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::load(const std::string& blob)
+  {
+    TRY_ENTRY();
+
+    static const size_t signature_size = sizeof(PEERLIST_STORAGE_SIGNATURE) - 1;
+    if (blob.size() < signature_size || blob.compare(0, signature_size, PEERLIST_STORAGE_SIGNATURE) != 0)
+      return false;
+
+    std::string::const_iterator i = blob.begin() + signature_size, end = blob.end();
+    uint64_t version;
+    if (!load_varint(i, end, version) || version != PEERLIST_STORAGE_VERSION)
+    {
+      MWARNING("Unsupported peerlist storage version");
+      return false;
+    }
+
+    peerlist_table white(P2P_LOCAL_WHITE_PEERLIST_LIMIT), gray(P2P_LOCAL_GRAY_PEERLIST_LIMIT);
+    if (!load_peers(i, end, white) || !load_peers(i, end, gray))
+      return false;
+
+    anchor_peers_indexed anchor;
+    uint64_t count, first_seen;
+    if (!load_varint(i, end, count))
+      return false;
+    while (count--)
+    {
+      anchor_peerlist_entry ape;
+      if (!load_address(i, end, ape.adr) || !load_int(i, end, ape.id))
+        return false;
+      if (!load_varint(i, end, first_seen))
+        return false;
+      ape.first_seen = first_seen;
+      anchor.insert(ape);
+    }
+    if (i != end)
+      return false;
+
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    m_peers_white = std::move(white);
+    m_peers_gray = std::move(gray);
+    m_peers_anchor.swap(anchor);
+    return true;
+
+    CATCH_ENTRY_L0("peerlist_manager::load()", false);
+  }
+  //--------------------------------------------------------------------------------------------------
 }
 
 BOOST_CLASS_VERSION(nodetool::peerlist_manager, CURRENT_PEERLIST_STORAGE_ARCHIVE_VER)
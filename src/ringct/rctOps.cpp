@@ -41,6 +41,26 @@ using namespace std;
 
 namespace rct {
 
+    namespace {
+        //tables of multiples of H, which are computed on first use rather than
+        //every time H gets multiplied
+        struct H_tables {
+            ge_smp sm;
+            ge_dsmp dsm;
+            H_tables() {
+                ge_p3 H3;
+                CHECK_AND_ASSERT_THROW_MES_L1(ge_frombytes_vartime(&H3, H.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
+                ge_sm_precomp(sm, &H3);
+                ge_dsm_precomp(dsm, &H3);
+            }
+        };
+
+        const H_tables &get_H_tables() {
+            static const H_tables tables;
+            return tables;
+        }
+    }
+
     //Various key initialization functions
 
     //initializes a key matrix;
@@ -198,10 +218,8 @@ namespace rct {
 
     //Computes aH where H= toPoint(cn_fast_hash(G)), G the basepoint
     key scalarmultH(const key & a) {
-        ge_p3 A;
         ge_p2 R;
-        CHECK_AND_ASSERT_THROW_MES_L1(ge_frombytes_vartime(&A, H.bytes) == 0, "ge_frombytes_vartime failed at "+boost::lexical_cast<std::string>(__LINE__));
-        ge_scalarmult(&R, a.bytes, &A);
+        ge_scalarmult_precomp(&R, a.bytes, get_H_tables().sm);
         key aP;
         ge_tobytes(aP.bytes, &R);
         return aP;
@@ -245,6 +263,20 @@ namespace rct {
         ge_tobytes(aGbB.bytes, &rv);
     }
 
+    //addKeys2
+    //aGbB = aG + bB where a, b are scalars, G is the basepoint and B is a point
+    //B must be input after applying "precomp"
+    void addKeys2(key &aGbB, const key &a, const key &b, const ge_dsmp B) {
+        ge_p2 rv;
+        ge_double_scalarmult_base_precomp_vartime(&rv, b.bytes, B, a.bytes);
+        ge_tobytes(aGbB.bytes, &rv);
+    }
+
+    //H after applying "precomp"
+    const ge_cached *precompH() {
+        return get_H_tables().dsm;
+    }
+
     //Does some precomputation to make addKeys3 more efficient
     // input B a curve point and output a ge_dsmp which has precomputation applied
     void precomp(ge_dsmp rv, const key & B) {
@@ -749,14 +749,16 @@ namespace rct {
           rv.p.rangeSigs.resize(destinations.size());
         rv.ecdhInfo.resize(destinations.size());
 
+        // the default device keeps no state, so with it the range proofs and
+        // MLSAGs, which are independent of each other, are made on the threadpool
+        tools::threadpool& tpool = tools::threadpool::getInstance();
+        const bool parallel = &hwdev == &hw::get_device("default") && tpool.get_max_concurrency() > 1;
+
         size_t i;
         keyV masks(destinations.size()); //sk mask..
         outSk.resize(destinations.size());
         key sumout = zero();
-        for (i = 0; i < destinations.size(); i++) {
-
-            //add destination to sig
-            rv.outPk[i].dest = copy(destinations[i]);
+        auto prove_range = [&](size_t i) {
             //compute range proof
             if (bulletproof)
               rv.p.bulletproofs[i] = proveRangeBulletproof(rv.outPk[i].mask, outSk[i].mask, outamounts[i]);
@@ -768,6 +770,15 @@ namespace rct {
             else
                 CHECK_AND_ASSERT_THROW_MES(verRange(rv.outPk[i].mask, rv.p.rangeSigs[i]), "verRange failed on newly created proof");
             #endif
+        };
+        if (parallel)
+            tpool.parallel_for(destinations.size(), prove_range);
+        for (i = 0; i < destinations.size(); i++) {
+
+            //add destination to sig
+            rv.outPk[i].dest = copy(destinations[i]);
+            if (!parallel)
+                prove_range(i);
          
             sc_add(sumout.bytes, outSk[i].mask.bytes, sumout.bytes);
 
@@ -800,9 +811,14 @@ namespace rct {
         key full_message = get_pre_mlsag_hash(rv,hwdev);
         if (msout)
           msout->c.resize(inamounts.size());
-        for (i = 0 ; i < inamounts.size(); i++) {
+        auto prove_mg = [&](size_t i) {
             rv.p.MGs[i] = proveRctMGSimple(full_message, rv.mixRing[i], inSk[i], a[i], pseudoOuts[i], kLRki ? &(*kLRki)[i]: NULL, msout ? &msout->c[i] : NULL, index[i], hwdev);
-        }
+        };
+        if (parallel)
+            tpool.parallel_for(inamounts.size(), prove_mg);
+        else
+            for (i = 0 ; i < inamounts.size(); i++)
+                prove_mg(i);
         return rv;
     }
 
@@ -1038,7 +1054,7 @@ namespace rct {
         DP("C");
         DP(C);
         key Ctmp;
-        addKeys2(Ctmp, mask, amount, H);
+        addKeys2(Ctmp, mask, amount, precompH());
         DP("Ctmp");
         DP(Ctmp);
         if (equalKeys(C, Ctmp) == false) {
@@ -1066,7 +1082,7 @@ namespace rct {
         DP("C");
         DP(C);
         key Ctmp;
-        addKeys2(Ctmp, mask, amount, H);
+        addKeys2(Ctmp, mask, amount, precompH());
         DP("Ctmp");
         DP(Ctmp);
         if (equalKeys(C, Ctmp) == false) {
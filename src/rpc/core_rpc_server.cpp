@@ -38,6 +38,7 @@ using namespace epee;
 #include "common/download.h"
 #include "common/util.h"
 #include "common/perf_timer.h"
+#include "metrics.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
@@ -141,6 +142,8 @@ namespace cryptonote
   {
     if(!m_p2p.get_payload_object().is_synchronized())
     {
+      static epee::metrics::counter &busy = epee::metrics::get_counter("rpc_busy_responses_total", "RPC requests refused because the daemon is not synchronized");
+      busy.inc();
       return false;
     }
     return true;
@@ -572,71 +575,67 @@ namespace cryptonote
     size_t found_in_pool = 0;
     std::unordered_set<crypto::hash> pool_tx_hashes;
     std::unordered_map<crypto::hash, bool> double_spend_seen;
-    if (!missed_txs.empty())
+    std::vector<crypto::hash> found_hashes;
+    if (missed_txs.empty())
     {
-      std::vector<tx_info> pool_tx_info;
-      std::vector<spent_key_image_info> pool_key_image_info;
-      bool r = m_core.get_pool_transactions_and_spent_keys_info(pool_tx_info, pool_key_image_info);
-      if(r)
+      found_hashes = vh;
+    }
+    else
+    {
+      // sort to match original request
+      const std::unordered_set<crypto::hash> missed_set(missed_txs.begin(), missed_txs.end());
+      std::list<transaction> sorted_txs;
+      for (const crypto::hash &h: vh)
       {
-        // sort to match original request
-        std::list<transaction> sorted_txs;
-        std::vector<tx_info>::const_iterator i;
-        for (const crypto::hash &h: vh)
+        if (missed_set.find(h) == missed_set.end())
         {
-          if (std::find(missed_txs.begin(), missed_txs.end(), h) == missed_txs.end())
+          if (txs.empty())
           {
-            if (txs.empty())
-            {
-              res.status = "Failed: internal error - txs is empty";
-              return true;
-            }
-            // core returns the ones it finds in the right order
-            if (get_transaction_hash(txs.front()) != h)
-            {
-              res.status = "Failed: tx hash mismatch";
-              return true;
-            }
-            sorted_txs.push_back(std::move(txs.front()));
-            txs.pop_front();
+            res.status = "Failed: internal error - txs is empty";
+            return true;
           }
-          else if ((i = std::find_if(pool_tx_info.begin(), pool_tx_info.end(), [h](const tx_info &txi) { return epee::string_tools::pod_to_hex(h) == txi.id_hash; })) != pool_tx_info.end())
+          // core returns the ones it finds in the right order
+          if (get_transaction_hash(txs.front()) != h)
+          {
+            res.status = "Failed: tx hash mismatch";
+            return true;
+          }
+          sorted_txs.push_back(std::move(txs.front()));
+          txs.pop_front();
+          found_hashes.push_back(h);
+        }
+        else
+        {
+          cryptonote::blobdata tx_blob;
+          bool ds;
+          if (!m_core.get_pool_transaction(h, tx_blob, ds))
+            continue;
+          cryptonote::transaction tx;
+          if (!cryptonote::parse_and_validate_tx_from_blob(tx_blob, tx))
           {
-            cryptonote::transaction tx;
-            if (!cryptonote::parse_and_validate_tx_from_blob(i->tx_blob, tx))
-            {
-              res.status = "Failed to parse and validate tx from blob";
-              return true;
-            }
-            sorted_txs.push_back(tx);
-            missed_txs.remove(h);
-            pool_tx_hashes.insert(h);
-            const std::string hash_string = epee::string_tools::pod_to_hex(h);
-            for (const auto &ti: pool_tx_info)
-            {
-              if (ti.id_hash == hash_string)
-              {
-                double_spend_seen.insert(std::make_pair(h, ti.double_spend_seen));
-                break;
-              }
-            }
-            ++found_in_pool;
+            res.status = "Failed to parse and validate tx from blob";
+            return true;
           }
+          sorted_txs.push_back(std::move(tx));
+          found_hashes.push_back(h);
+          pool_tx_hashes.insert(h);
+          double_spend_seen[h] = ds;
+          ++found_in_pool;
         }
-        txs = sorted_txs;
       }
+      txs = std::move(sorted_txs);
+      missed_txs.remove_if([&pool_tx_hashes](const crypto::hash &h) { return pool_tx_hashes.find(h) != pool_tx_hashes.end(); });
       LOG_PRINT_L2("Found " << found_in_pool << "/" << vh.size() << " transactions in the pool");
     }
 
-    std::list<std::string>::const_iterator txhi = req.txs_hashes.begin();
-    std::vector<crypto::hash>::const_iterator vhi = vh.begin();
+    std::vector<crypto::hash>::const_iterator vhi = found_hashes.begin();
     for(auto& tx: txs)
     {
       res.txs.push_back(COMMAND_RPC_GET_TRANSACTIONS::entry());
       COMMAND_RPC_GET_TRANSACTIONS::entry &e = res.txs.back();
 
       crypto::hash tx_hash = *vhi++;
-      e.tx_hash = *txhi++;
+      e.tx_hash = string_tools::pod_to_hex(tx_hash);
       blobdata blob = req.prune ? get_pruned_tx_blob(tx) : t_serializable_object_to_blob(tx);
       e.as_hex = string_tools::buff_to_hex_nodelimer(blob);
       if (req.decode_as_json)
@@ -708,6 +707,7 @@ namespace cryptonote
       if(b.size() != sizeof(crypto::key_image))
       {
         res.status = "Failed, size of data mismatch";
+        return true;
       }
       key_images.push_back(*reinterpret_cast<const crypto::key_image*>(b.data()));
     }
@@ -722,34 +722,18 @@ namespace cryptonote
     for (size_t n = 0; n < spent_status.size(); ++n)
       res.spent_status.push_back(spent_status[n] ? COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN : COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT);
 
-    // check the pool too
-    std::vector<cryptonote::tx_info> txs;
-    std::vector<cryptonote::spent_key_image_info> ki;
-    r = m_core.get_pool_transactions_and_spent_keys_info(txs, ki, !request_has_rpc_origin || !m_restricted);
-    if(!r)
+    // check the pool too, with hash lookups into its spent key image index
+    std::vector<bool> pool_spent_status;
+    r = m_core.are_key_images_spent_in_pool(key_images, pool_spent_status, !request_has_rpc_origin || !m_restricted);
+    if(!r || pool_spent_status.size() != key_images.size())
     {
       res.status = "Failed";
       return true;
     }
-    for (std::vector<cryptonote::spent_key_image_info>::const_iterator i = ki.begin(); i != ki.end(); ++i)
+    for (size_t n = 0; n < res.spent_status.size(); ++n)
     {
-      crypto::hash hash;
-      crypto::key_image spent_key_image;
-      if (parse_hash256(i->id_hash, hash))
-      {
-        memcpy(&spent_key_image, &hash, sizeof(hash)); // a bit dodgy, should be other parse functions somewhere
-        for (size_t n = 0; n < res.spent_status.size(); ++n)
-        {
-          if (res.spent_status[n] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT)
-          {
-            if (key_images[n] == spent_key_image)
-            {
-              res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
-              break;
-            }
-          }
-        }
-      }
+      if (res.spent_status[n] == COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT && pool_spent_status[n])
+        res.spent_status[n] = COMMAND_RPC_IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
     }
 
     res.status = CORE_RPC_STATUS_OK;
@@ -775,7 +759,8 @@ namespace cryptonote
 
     cryptonote_connection_context fake_context = AUTO_VAL_INIT(fake_context);
     tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-    if(!m_core.handle_incoming_tx(tx_blob, tvc, false, false, req.do_not_relay) || tvc.m_verifivation_failed)
+    crypto::hash tx_hash;
+    if(!m_core.handle_incoming_tx(tx_blob, tvc, tx_hash, false, false, req.do_not_relay) || tvc.m_verifivation_failed)
     {
       res.status = "Failed";
       res.reason = "";
@@ -818,7 +803,7 @@ namespace cryptonote
 
     NOTIFY_NEW_TRANSACTIONS::request r;
     r.txs.push_back(tx_blob);
-    m_core.get_protocol()->relay_transactions(r, fake_context);
+    m_core.get_protocol()->relay_transactions(r, std::vector<crypto::hash>(1, tx_hash), fake_context);
     //TODO: make sure that tx has reached other nodes here, probably wait to receive reflections from other nodes
     res.status = CORE_RPC_STATUS_OK;
     return true;
@@ -1989,6 +1974,41 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  void core_rpc_server::update_metrics()
+  {
+    // these are cheaper to sample when scraped than to track on every change
+    static epee::metrics::gauge &txpool_txs = epee::metrics::get_gauge("txpool_transactions", "Transactions in the pool");
+    static epee::metrics::gauge &outgoing = epee::metrics::get_gauge("p2p_connections{direction=\"out\"}", "Open peer connections");
+    static epee::metrics::gauge &incoming = epee::metrics::get_gauge("p2p_connections{direction=\"in\"}", "Open peer connections");
+    static epee::metrics::gauge &target_height = epee::metrics::get_gauge("blockchain_target_height", "Height of the longest chain seen on the network");
+    txpool_txs.set(m_core.get_pool_transactions_count());
+    outgoing.set(m_p2p.get_outgoing_connections_count());
+    incoming.set(m_p2p.get_incoming_connections_count());
+    target_height.set(m_core.get_target_blockchain_height());
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, const connection_context& context)
+  {
+    PERF_TIMER(on_metrics);
+    if (m_restricted)
+      return false;
+    update_metrics();
+    response_info.m_body = epee::metrics::to_prometheus();
+    response_info.m_mime_tipe = "text/plain; version=0.0.4";
+    response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_metrics(const COMMAND_RPC_GET_METRICS::request& req, COMMAND_RPC_GET_METRICS::response& res, epee::json_rpc::error& error_resp)
+  {
+    PERF_TIMER(on_get_metrics);
+    update_metrics();
+    for (const auto &m: epee::metrics::get_summaries())
+      res.metrics.push_back({m.name, m.type, m.value, m.count, m.p50, m.p99, m.max});
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_relay_tx(const COMMAND_RPC_RELAY_TX::request& req, COMMAND_RPC_RELAY_TX::response& res, epee::json_rpc::error& error_resp)
   {
     PERF_TIMER(on_relay_tx);
@@ -2014,7 +2034,7 @@ namespace cryptonote
         cryptonote_connection_context fake_context = AUTO_VAL_INIT(fake_context);
         NOTIFY_NEW_TRANSACTIONS::request r;
         r.txs.push_back(txblob);
-        m_core.get_protocol()->relay_transactions(r, fake_context);
+        m_core.get_protocol()->relay_transactions(r, std::vector<crypto::hash>(1, txid), fake_context);
         //TODO: make sure that tx has reached other nodes here, probably wait to receive reflections from other nodes
       }
       else
@@ -2080,9 +2100,8 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, epee::json_rpc::error& error_resp)
+  bool core_rpc_server::get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, bool compress, std::string &error)
   {
-    PERF_TIMER(on_get_output_distribution);
     try
     {
       for (uint64_t amount: req.amounts)
@@ -2099,7 +2118,7 @@ namespace cryptonote
 
         if (d.cached && amount == 0 && d.cached_from == req.from_height && d.cached_to == req.to_height)
         {
-          res.distributions.push_back({amount, d.cached_start_height, d.cached_distribution, d.cached_base});
+          res.distributions.push_back({amount, d.cached_start_height, d.cached_distribution, d.cached_base, compress});
           continue;
         }
 
@@ -2107,8 +2126,7 @@ namespace cryptonote
         uint64_t start_height, base;
         if (!m_core.get_output_distribution(amount, req.from_height, start_height, distribution, base))
         {
-          error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
-          error_resp.message = "Failed to get rct distribution";
+          error = "Failed to get rct distribution";
           return false;
         }
         if (req.to_height > 0 && req.to_height >= req.from_height)
@@ -2134,13 +2152,12 @@ namespace cryptonote
           d.cached = true;
         }
 
-        res.distributions.push_back({amount, start_height, std::move(distribution), base});
+        res.distributions.push_back({amount, start_height, std::move(distribution), base, compress});
       }
     }
     catch (const std::exception &e)
     {
-      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
-      error_resp.message = "Failed to get output distribution";
+      error = "Failed to get output distribution";
       return false;
     }
 
@@ -2148,6 +2165,32 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, epee::json_rpc::error& error_resp)
+  {
+    PERF_TIMER(on_get_output_distribution);
+    std::string error;
+    // compressed data is binary, so it is only sent from the .bin endpoint
+    if (!get_output_distribution(req, res, false, error))
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = error;
+      return false;
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_output_distribution_bin(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res)
+  {
+    PERF_TIMER(on_get_output_distribution_bin);
+    std::string error;
+    if (!get_output_distribution(req, res, req.compress, error))
+    {
+      res.distributions.clear();
+      res.status = error;
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
 
 
   const command_line::arg_descriptor<std::string, false, true, 2> core_rpc_server::arg_rpc_bind_port = {
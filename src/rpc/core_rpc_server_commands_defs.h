@@ -29,10 +29,14 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #pragma once
+#include <iterator>
+#include <limits>
+#include <stdexcept>
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/difficulty.h"
 #include "crypto/hash.h"
+#include "common/varint.h"
 
 namespace cryptonote
 {
@@ -49,7 +53,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 1
-#define CORE_RPC_VERSION_MINOR 19
+#define CORE_RPC_VERSION_MINOR 21
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -2206,6 +2210,41 @@ namespace cryptonote
     };
   };
 
+  // Stores each value as a varint of its zigzag encoded difference to the
+  // previous one, which for an output distribution, cumulative or not, is
+  // mostly one or two bytes per block
+  inline std::string compress_integer_array(const std::vector<uint64_t> &v)
+  {
+    std::string s;
+    s.reserve(v.size() * 2);
+    uint64_t previous = 0;
+    for (uint64_t i: v)
+    {
+      const uint64_t delta = i - previous;
+      tools::write_varint(std::back_inserter(s), (delta << 1) ^ (0 - (delta >> 63)));
+      previous = i;
+    }
+    return s;
+  }
+
+  inline std::vector<uint64_t> decompress_integer_array(const std::string &s)
+  {
+    std::vector<uint64_t> v;
+    v.reserve(s.size());
+    uint64_t previous = 0;
+    std::string::const_iterator i = s.begin(), end = s.end();
+    while (i != end)
+    {
+      uint64_t zigzag;
+      int read = tools::read_varint<std::numeric_limits<uint64_t>::digits>(i, end, zigzag);
+      if (read <= 0 || (*(i - 1) & 0x80))
+        throw std::runtime_error("Invalid compressed integer array");
+      previous += (zigzag >> 1) ^ (0 - (zigzag & 1));
+      v.push_back(previous);
+    }
+    return v;
+  }
+
   struct COMMAND_RPC_GET_OUTPUT_DISTRIBUTION
   {
     struct request
@@ -2214,12 +2253,14 @@ namespace cryptonote
       uint64_t from_height;
       uint64_t to_height;
       bool cumulative;
+      bool compress;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(amounts)
         KV_SERIALIZE_OPT(from_height, (uint64_t)0)
         KV_SERIALIZE_OPT(to_height, (uint64_t)0)
         KV_SERIALIZE_OPT(cumulative, false)
+        KV_SERIALIZE_OPT(compress, false)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -2229,11 +2270,25 @@ namespace cryptonote
       uint64_t start_height;
       std::vector<uint64_t> distribution;
       uint64_t base;
+      bool compress;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(amount)
         KV_SERIALIZE(start_height)
-        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(distribution)
+        KV_SERIALIZE_OPT(compress, false)
+        if (this_ref.compress)
+        {
+          std::string compressed_data;
+          if (is_store)
+            compressed_data = compress_integer_array(this_ref.distribution);
+          epee::serialization::selector<is_store>::serialize(compressed_data, stg, hparent_section, "compressed_data");
+          if (!is_store)
+            const_cast<std::vector<uint64_t>&>(this_ref.distribution) = decompress_integer_array(compressed_data);
+        }
+        else
+        {
+          KV_SERIALIZE_CONTAINER_POD_AS_BLOB(distribution)
+        }
         KV_SERIALIZE(base)
       END_KV_SERIALIZE_MAP()
     };
@@ -2250,4 +2305,45 @@ namespace cryptonote
     };
   };
 
+  struct COMMAND_RPC_GET_METRICS
+  {
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct metric
+    {
+      std::string name;
+      std::string type;
+      double value;
+      uint64_t count;
+      double p50;
+      double p99;
+      double max;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(type)
+        KV_SERIALIZE(value)
+        KV_SERIALIZE_OPT(count, (uint64_t)0)
+        KV_SERIALIZE_OPT(p50, 0.0)
+        KV_SERIALIZE_OPT(p99, 0.0)
+        KV_SERIALIZE_OPT(max, 0.0)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      std::vector<metric> metrics;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(metrics)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
 }
@@ -39,6 +39,7 @@
 
 #include <string>
 #include <list>
+#include <algorithm>
 
 using namespace epee;
 
@@ -48,15 +49,17 @@ TransactionHistory::~TransactionHistory() {}
 
 
 TransactionHistoryImpl::TransactionHistoryImpl(WalletImpl *wallet)
-    : m_wallet(wallet)
+    : m_syncedHeight(0)
+    , m_syncedTopHash(crypto::null_hash)
+    , m_invalidated(false)
+    , m_wallet(wallet)
 {
 
 }
 
 TransactionHistoryImpl::~TransactionHistoryImpl()
 {
-    for (auto t : m_history)
-        delete t;
+    clear();
 }
 
 int TransactionHistoryImpl::count() const
@@ -92,6 +95,95 @@ std::vector<TransactionInfo *> TransactionHistoryImpl::getAll() const
     return m_history;
 }
 
+std::vector<TransactionInfo *> TransactionHistoryImpl::getByHeight(uint64_t min_height, uint64_t max_height, size_t offset, size_t count) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_historyMutex);
+    return range(m_byHeight, min_height, max_height, offset, count);
+}
+
+std::vector<TransactionInfo *> TransactionHistoryImpl::getByTimestamp(uint64_t min_timestamp, uint64_t max_timestamp, size_t offset, size_t count) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_historyMutex);
+    return range(m_byTimestamp, min_timestamp, max_timestamp, offset, count);
+}
+
+std::vector<TransactionInfo *> TransactionHistoryImpl::range(const ordered_index &index, uint64_t min, uint64_t max, size_t offset, size_t count)
+{
+    std::vector<TransactionInfo*> result;
+    if (min > max)
+        return result;
+    auto i = index.lower_bound(min);
+    const auto end = index.upper_bound(max);
+    for (; i != end && offset > 0; ++i)
+        --offset;
+    for (; i != end && result.size() < count; ++i)
+        result.push_back(i->second);
+    return result;
+}
+
+// incoming transfers are per subaddress, outgoing ones per transaction
+std::string TransactionHistoryImpl::key(int direction, const std::string &hash, uint32_t account, uint32_t minor)
+{
+    if (direction == TransactionInfo::Direction_Out)
+        return "out:" + hash;
+    return "in:" + hash + ":" + std::to_string(account) + "." + std::to_string(minor);
+}
+
+std::string TransactionHistoryImpl::key(const TransactionInfoImpl *ti)
+{
+    return key(ti->m_direction, ti->m_hash, ti->m_subaddrAccount, ti->m_subaddrIndex.empty() ? 0 : *ti->m_subaddrIndex.begin());
+}
+
+void TransactionHistoryImpl::add(TransactionInfoImpl *ti)
+{
+    m_history.push_back(ti);
+    m_byKey[key(ti)] = ti;
+    index(ti);
+}
+
+void TransactionHistoryImpl::index(TransactionInfoImpl *ti)
+{
+    m_byHeight.insert(std::make_pair(ti->m_blockheight, ti));
+    m_byTimestamp.insert(std::make_pair(static_cast<uint64_t>(ti->m_timestamp), ti));
+}
+
+void TransactionHistoryImpl::unindex(TransactionInfoImpl *ti)
+{
+    auto erase = [ti](ordered_index &idx, uint64_t k) {
+        auto range = idx.equal_range(k);
+        for (auto i = range.first; i != range.second; ++i)
+        {
+            if (i->second == ti)
+            {
+                idx.erase(i);
+                break;
+            }
+        }
+    };
+    erase(m_byHeight, ti->m_blockheight);
+    erase(m_byTimestamp, static_cast<uint64_t>(ti->m_timestamp));
+}
+
+void TransactionHistoryImpl::clear()
+{
+    for (auto t : m_history)
+        delete t;
+    m_history.clear();
+    m_byKey.clear();
+    m_byHeight.clear();
+    m_byTimestamp.clear();
+    m_syncedHeight = 0;
+    m_syncedTopHash = crypto::null_hash;
+    m_syncedAddress.clear();
+    m_invalidated = false;
+}
+
+void TransactionHistoryImpl::invalidate()
+{
+    boost::unique_lock<boost::shared_mutex> lock(m_historyMutex);
+    m_invalidated = true;
+}
+
 void TransactionHistoryImpl::refresh()
 {
     // multithreaded access:
@@ -99,45 +191,83 @@ void TransactionHistoryImpl::refresh()
     // for "write" access, locking exclusively
     boost::unique_lock<boost::shared_mutex> lock(m_historyMutex);
 
-    // TODO: configurable values;
-    uint64_t min_height = 0;
-    uint64_t max_height = (uint64_t)-1;
+    tools::wallet2 *wallet = m_wallet->m_wallet;
     uint64_t wallet_height = m_wallet->blockChainHeight();
+    const std::string address = wallet->get_account().get_public_address_str(wallet->nettype());
+
+    // start over if this is another wallet, blocks we already looked at
+    // were detached or rescanned, or older transfers were changed
+    if (m_invalidated || address != m_syncedAddress || wallet_height < m_syncedHeight ||
+        (m_syncedHeight > 0 && wallet->get_blockchain_hash(m_syncedHeight - 1) != m_syncedTopHash))
+    {
+        clear();
+        m_syncedAddress = address;
+    }
 
-    // delete old transactions;
-    for (auto t : m_history)
-        delete t;
-    m_history.clear();
+    // get_payments and get_payments_out exclude min_height itself
+    uint64_t min_height = m_syncedHeight > 0 ? m_syncedHeight - 1 : 0;
+    uint64_t max_height = wallet_height > 0 ? wallet_height - 1 : 0;
 
     // transactions are stored in wallet2:
     // - confirmed_transfer_details   - out transfers
     // - unconfirmed_transfer_details - pending out transfers
     // - payment_details              - input transfers
 
+    // pending entries still in the wallet are marked here; the rest have
+    // been confirmed (and updated in place) or dropped
+    std::unordered_map<TransactionInfoImpl*, bool> pending;
+    for (auto t : m_history)
+    {
+        TransactionInfoImpl *ti = static_cast<TransactionInfoImpl*>(t);
+        if (ti->m_pending)
+            pending[ti] = false;
+    }
+
+    // finds the existing entry for a transfer, or makes a new one; confirmed
+    // entries are never turned back into pending ones
+    auto get_entry = [this](TransactionInfo::Direction direction, const crypto::hash &hash, uint32_t account, uint32_t minor, bool is_pending) -> TransactionInfoImpl* {
+        const std::string hash_str = string_tools::pod_to_hex(hash);
+        auto i = m_byKey.find(key(direction, hash_str, account, minor));
+        if (i == m_byKey.end())
+        {
+            TransactionInfoImpl *ti = new TransactionInfoImpl();
+            ti->m_direction = direction;
+            ti->m_hash = hash_str;
+            ti->m_subaddrAccount = account;
+            ti->m_subaddrIndex = { minor };
+            add(ti);
+            return ti;
+        }
+        if (is_pending && !i->second->m_pending)
+            return nullptr;
+        unindex(i->second);
+        return i->second;
+    };
+
+    auto short_payment_id = [](const crypto::hash &id) {
+        std::string payment_id = string_tools::pod_to_hex(id);
+        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
+            payment_id = payment_id.substr(0,16);
+        return payment_id;
+    };
+
     // payments are "input transactions";
     // one input transaction contains only one transfer. e.g. <transaction_id> - <100XMR>
 
     std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> in_payments;
-    m_wallet->m_wallet->get_payments(in_payments, min_height, max_height);
+    if (wallet_height > 0)
+        wallet->get_payments(in_payments, min_height, max_height);
     for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = in_payments.begin(); i != in_payments.end(); ++i) {
         const tools::wallet2::payment_details &pd = i->second;
-        std::string payment_id = string_tools::pod_to_hex(i->first);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
-        TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
+        TransactionInfoImpl * ti = get_entry(TransactionInfo::Direction_In, pd.m_tx_hash, pd.m_subaddr_index.major, pd.m_subaddr_index.minor, false);
+        ti->m_paymentid = short_payment_id(i->first);
         ti->m_amount    = pd.m_amount;
-        ti->m_direction = TransactionInfo::Direction_In;
-        ti->m_hash      = string_tools::pod_to_hex(pd.m_tx_hash);
+        ti->m_pending   = false;
         ti->m_blockheight = pd.m_block_height;
-        ti->m_subaddrIndex = { pd.m_subaddr_index.minor };
-        ti->m_subaddrAccount = pd.m_subaddr_index.major;
-        ti->m_label     = m_wallet->m_wallet->get_subaddress_label(pd.m_subaddr_index);
+        ti->m_label     = wallet->get_subaddress_label(pd.m_subaddr_index);
         ti->m_timestamp = pd.m_timestamp;
-        ti->m_confirmations = (wallet_height > pd.m_block_height) ? wallet_height - pd.m_block_height : 0;
         ti->m_unlock_time = pd.m_unlock_time;
-        m_history.push_back(ti);
-
+        index(ti);
     }
 
     // confirmed output transactions
@@ -149,7 +279,8 @@ void TransactionHistoryImpl::refresh()
     //
 
     std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> out_payments;
-    m_wallet->m_wallet->get_payments_out(out_payments, min_height, max_height);
+    if (wallet_height > 0)
+        wallet->get_payments_out(out_payments, min_height, max_height);
 
     for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = out_payments.begin();
          i != out_payments.end(); ++i) {
@@ -159,88 +290,101 @@ void TransactionHistoryImpl::refresh()
         
         uint64_t change = pd.m_change == (uint64_t)-1 ? 0 : pd.m_change; // change may not be known
         uint64_t fee = pd.m_amount_in - pd.m_amount_out;
-        
 
-        std::string payment_id = string_tools::pod_to_hex(i->second.m_payment_id);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
-
-
-        TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
+        TransactionInfoImpl * ti = get_entry(TransactionInfo::Direction_Out, hash, pd.m_subaddr_account, 0, false);
+        ti->m_paymentid = short_payment_id(pd.m_payment_id);
         ti->m_amount = pd.m_amount_in - change - fee;
         ti->m_fee    = fee;
-        ti->m_direction = TransactionInfo::Direction_Out;
-        ti->m_hash = string_tools::pod_to_hex(hash);
+        ti->m_failed = false;
+        ti->m_pending = false;
         ti->m_blockheight = pd.m_block_height;
         ti->m_subaddrIndex = pd.m_subaddr_indices;
-        ti->m_subaddrAccount = pd.m_subaddr_account;
-        ti->m_label = pd.m_subaddr_indices.size() == 1 ? m_wallet->m_wallet->get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
+        ti->m_label = pd.m_subaddr_indices.size() == 1 ? wallet->get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
         ti->m_timestamp = pd.m_timestamp;
-        ti->m_confirmations = (wallet_height > pd.m_block_height) ? wallet_height - pd.m_block_height : 0;
 
         // single output transaction might contain multiple transfers
+        ti->m_transfers.clear();
         for (const auto &d: pd.m_dests) {
-            ti->m_transfers.push_back({d.amount, get_account_address_as_str(m_wallet->m_wallet->nettype(), d.is_subaddress, d.addr)});
+            ti->m_transfers.push_back({d.amount, get_account_address_as_str(wallet->nettype(), d.is_subaddress, d.addr)});
         }
-        m_history.push_back(ti);
+        index(ti);
     }
 
     // unconfirmed output transactions
     std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments_out;
-    m_wallet->m_wallet->get_unconfirmed_payments_out(upayments_out);
+    wallet->get_unconfirmed_payments_out(upayments_out);
     for (std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>>::const_iterator i = upayments_out.begin(); i != upayments_out.end(); ++i) {
         const tools::wallet2::unconfirmed_transfer_details &pd = i->second;
         const crypto::hash &hash = i->first;
         uint64_t amount = pd.m_amount_in;
         uint64_t fee = amount - pd.m_amount_out;
-        std::string payment_id = string_tools::pod_to_hex(i->second.m_payment_id);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
         bool is_failed = pd.m_state == tools::wallet2::unconfirmed_transfer_details::failed;
 
-        TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
+        TransactionInfoImpl * ti = get_entry(TransactionInfo::Direction_Out, hash, pd.m_subaddr_account, 0, true);
+        if (!ti)
+            continue;
+        ti->m_paymentid = short_payment_id(pd.m_payment_id);
         ti->m_amount = amount - pd.m_change - fee;
         ti->m_fee    = fee;
-        ti->m_direction = TransactionInfo::Direction_Out;
         ti->m_failed = is_failed;
         ti->m_pending = true;
-        ti->m_hash = string_tools::pod_to_hex(hash);
         ti->m_subaddrIndex = pd.m_subaddr_indices;
-        ti->m_subaddrAccount = pd.m_subaddr_account;
-        ti->m_label = pd.m_subaddr_indices.size() == 1 ? m_wallet->m_wallet->get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
+        ti->m_label = pd.m_subaddr_indices.size() == 1 ? wallet->get_subaddress_label({pd.m_subaddr_account, *pd.m_subaddr_indices.begin()}) : "";
         ti->m_timestamp = pd.m_timestamp;
-        ti->m_confirmations = 0;
-        m_history.push_back(ti);
+        index(ti);
+        pending[ti] = true;
     }
     
     
     // unconfirmed payments (tx pool)
     std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>> upayments;
-    m_wallet->m_wallet->get_unconfirmed_payments(upayments);
+    wallet->get_unconfirmed_payments(upayments);
     for (std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>>::const_iterator i = upayments.begin(); i != upayments.end(); ++i) {
         const tools::wallet2::payment_details &pd = i->second.m_pd;
-        std::string payment_id = string_tools::pod_to_hex(i->first);
-        if (payment_id.substr(16).find_first_not_of('0') == std::string::npos)
-            payment_id = payment_id.substr(0,16);
-        TransactionInfoImpl * ti = new TransactionInfoImpl();
-        ti->m_paymentid = payment_id;
+        TransactionInfoImpl * ti = get_entry(TransactionInfo::Direction_In, pd.m_tx_hash, pd.m_subaddr_index.major, pd.m_subaddr_index.minor, true);
+        if (!ti)
+            continue;
+        ti->m_paymentid = short_payment_id(i->first);
         ti->m_amount    = pd.m_amount;
-        ti->m_direction = TransactionInfo::Direction_In;
-        ti->m_hash      = string_tools::pod_to_hex(pd.m_tx_hash);
         ti->m_blockheight = pd.m_block_height;
         ti->m_pending = true;
-        ti->m_subaddrIndex = { pd.m_subaddr_index.minor };
-        ti->m_subaddrAccount = pd.m_subaddr_index.major;
-        ti->m_label     = m_wallet->m_wallet->get_subaddress_label(pd.m_subaddr_index);
+        ti->m_label     = wallet->get_subaddress_label(pd.m_subaddr_index);
         ti->m_timestamp = pd.m_timestamp;
-        ti->m_confirmations = 0;
-        m_history.push_back(ti);
-        
+        index(ti);
+        pending[ti] = true;
+
         LOG_PRINT_L1(__FUNCTION__ << ": Unconfirmed payment found " << pd.m_amount);
     }
-     
+
+    // pending transfers which neither got confirmed nor are pending any more
+    std::vector<TransactionInfo*> dropped;
+    for (const auto &p: pending)
+    {
+        if (!p.second && p.first->m_pending)
+        {
+            unindex(p.first);
+            m_byKey.erase(key(p.first));
+            dropped.push_back(p.first);
+        }
+    }
+    if (!dropped.empty())
+    {
+        m_history.erase(std::remove_if(m_history.begin(), m_history.end(), [&dropped](TransactionInfo *t) {
+            return std::find(dropped.begin(), dropped.end(), t) != dropped.end();
+        }), m_history.end());
+        for (auto t: dropped)
+            delete t;
+    }
+
+    // confirmations are the only thing that changes for every entry
+    for (auto t : m_history)
+    {
+        TransactionInfoImpl *ti = static_cast<TransactionInfoImpl*>(t);
+        ti->m_confirmations = (!ti->m_pending && wallet_height > ti->m_blockheight) ? wallet_height - ti->m_blockheight : 0;
+    }
+
+    m_syncedHeight = wallet_height;
+    m_syncedTopHash = wallet_height > 0 ? wallet->get_blockchain_hash(wallet_height - 1) : crypto::null_hash;
 }
 
 } // namespace
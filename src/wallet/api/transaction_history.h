@@ -29,11 +29,15 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include "wallet/api/wallet2_api.h"
+#include "crypto/hash.h"
 #include <boost/thread/shared_mutex.hpp>
+#include <map>
+#include <unordered_map>
 
 namespace Monero {
 
 class WalletImpl;
+class TransactionInfoImpl;
 
 class TransactionHistoryImpl : public TransactionHistory
 {
@@ -44,12 +48,38 @@ public:
     virtual TransactionInfo * transaction(int index)  const;
     virtual TransactionInfo * transaction(const std::string &id) const;
     virtual std::vector<TransactionInfo*> getAll() const;
+    virtual std::vector<TransactionInfo*> getByHeight(uint64_t min_height, uint64_t max_height, size_t offset, size_t count) const;
+    virtual std::vector<TransactionInfo*> getByTimestamp(uint64_t min_timestamp, uint64_t max_timestamp, size_t offset, size_t count) const;
     virtual void refresh();
+    // makes the next refresh() start over, for changes wallet2 makes to
+    // transfers below the height refresh() already looked at
+    void invalidate();
 
 private:
+    typedef std::multimap<uint64_t, TransactionInfoImpl*> ordered_index;
+
+    static std::string key(int direction, const std::string &hash, uint32_t account, uint32_t minor);
+    static std::string key(const TransactionInfoImpl *ti);
+    static std::vector<TransactionInfo*> range(const ordered_index &index, uint64_t min, uint64_t max, size_t offset, size_t count);
+    void add(TransactionInfoImpl *ti);
+    void index(TransactionInfoImpl *ti);
+    void unindex(TransactionInfoImpl *ti);
+    void clear();
 
     // TransactionHistory is responsible of memory management
     std::vector<TransactionInfo*> m_history;
+    std::unordered_map<std::string, TransactionInfoImpl*> m_byKey;
+    ordered_index m_byHeight;
+    ordered_index m_byTimestamp;
+
+    // confirmed transfers are known up to (excluding) m_syncedHeight, for
+    // the wallet with address m_syncedAddress whose block m_syncedHeight - 1
+    // had hash m_syncedTopHash
+    uint64_t m_syncedHeight;
+    crypto::hash m_syncedTopHash;
+    std::string m_syncedAddress;
+    bool m_invalidated;
+
     WalletImpl *m_wallet;
     mutable boost::shared_mutex   m_historyMutex;
 };
@@ -1026,11 +1026,14 @@ bool WalletImpl::importKeyImages(const string &filename)
   {
     uint64_t spent = 0, unspent = 0;
     uint64_t height = m_wallet->import_key_images(filename, spent, unspent);
+    m_history->invalidate();
     LOG_PRINT_L2("Signed key images imported to height " << height << ", "
         << print_money(spent) << " spent, " << print_money(unspent) << " unspent");
   }
   catch (const std::exception &e)
   {
+    // some key images may have been imported before the failure
+    m_history->invalidate();
     LOG_ERROR("Error exporting key images: " << e.what());
     m_errorString = string(tr("Failed to import key images: ")) + e.what();
     m_status = Status_Error;
@@ -1074,7 +1077,8 @@ void WalletImpl::setSubaddressLabel(uint32_t accountIndex, uint32_t addressIndex
 {
     try
     {
-        return m_wallet->set_subaddress_label({accountIndex, addressIndex}, label);
+        m_wallet->set_subaddress_label({accountIndex, addressIndex}, label);
+        m_history->invalidate();
     }
     catch (const std::exception &e)
     {
@@ -1888,7 +1892,9 @@ bool WalletImpl::rescanSpent()
   }
   try {
       m_wallet->rescan_spent();
+      m_history->invalidate();
   } catch (const std::exception &e) {
+      m_history->invalidate();
       LOG_ERROR(__FUNCTION__ << " error: " << e.what());
       m_status = Status_Error;
       m_errorString = e.what();
@@ -39,6 +39,7 @@
 #include <boost/thread/thread.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+class WalletTransactionHistory;
 
 namespace Monero {
 class TransactionHistoryImpl;
@@ -189,6 +190,7 @@ private:
     friend class AddressBookImpl;
     friend class SubaddressImpl;
     friend class SubaddressAccountImpl;
+    friend class ::WalletTransactionHistory;
 
     tools::wallet2 * m_wallet;
     mutable std::atomic<int>  m_status;
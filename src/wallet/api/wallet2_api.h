@@ -182,6 +182,25 @@ struct TransactionHistory
     virtual TransactionInfo * transaction(int index)  const = 0;
     virtual TransactionInfo * transaction(const std::string &id) const = 0;
     virtual std::vector<TransactionInfo*> getAll() const = 0;
+    /**
+     * @brief getByHeight - transactions with min_height <= blockHeight() <= max_height, oldest first
+     * @param offset      - number of matching transactions to skip, for paging
+     * @param count       - maximum number of transactions to return
+     * @return              pending transactions have height 0
+     */
+    virtual std::vector<TransactionInfo*> getByHeight(uint64_t min_height, uint64_t max_height, size_t offset = 0, size_t count = (size_t)-1) const = 0;
+    /**
+     * @brief getByTimestamp - transactions with min_timestamp <= timestamp() <= max_timestamp, oldest first
+     * @param offset         - number of matching transactions to skip, for paging
+     * @param count          - maximum number of transactions to return
+     */
+    virtual std::vector<TransactionInfo*> getByTimestamp(uint64_t min_timestamp, uint64_t max_timestamp, size_t offset = 0, size_t count = (size_t)-1) const = 0;
+    /**
+     * @brief refresh - brings the history up to date with the wallet. Only transfers from
+     *                  blocks not seen yet and pending transfers are looked at, unless blocks
+     *                  were detached or the wallet rescanned. Existing TransactionInfo
+     *                  pointers stay valid, except for pending transfers which disappear.
+     */
     virtual void refresh() = 0;
 };
 
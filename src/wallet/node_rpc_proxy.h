@@ -31,7 +31,7 @@
 #include <string>
 #include <boost/thread/mutex.hpp>
 #include "include_base_utils.h"
-#include "net/http_client.h"
+#include "net/http_client_pool.h"
 
 namespace tools
 {
@@ -39,7 +39,7 @@ namespace tools
 class NodeRPCProxy
 {
 public:
-  NodeRPCProxy(epee::net_utils::http::http_simple_client &http_client, boost::mutex &mutex);
+  NodeRPCProxy(epee::net_utils::http::http_client_pool &http_client_pool);
 
   void invalidate();
 
@@ -51,8 +51,8 @@ public:
   boost::optional<std::string> get_dynamic_per_kb_fee_estimate(uint64_t grace_blocks, uint64_t &fee) const;
 
 private:
-  epee::net_utils::http::http_simple_client &m_http_client;
-  boost::mutex &m_daemon_rpc_mutex;
+  epee::net_utils::http::http_client_pool &m_http_client_pool;
+  mutable boost::mutex m_mutex; // the wallet RPC server calls in from several threads
 
   mutable uint64_t m_height;
   mutable time_t m_height_time;
@@ -0,0 +1,123 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "crypto/hash.h"
+
+namespace tools
+{
+  // Secondary indexes over wallet2::m_payments, by block height and by
+  // payment id then block height, so get_payments does not walk every
+  // payment the wallet ever received. Entries point into the container,
+  // which must be an unordered_multimap, whose elements do not move when it
+  // rehashes; the wallet unindexes an element before erasing it, and
+  // rebuilds the whole thing after bulk changes.
+  template<typename Container>
+  class payment_index
+  {
+  public:
+    typedef typename Container::value_type value_type;
+    typedef std::multimap<uint64_t, const value_type*> height_index;
+    typedef std::vector<const value_type*> id_index;
+
+    void clear()
+    {
+      m_by_height.clear();
+      m_by_id.clear();
+    }
+
+    void insert(const value_type &p)
+    {
+      const uint64_t height = p.second.m_block_height;
+      m_by_height.emplace(height, &p);
+      id_index &by_id = m_by_id[p.first];
+      auto pos = std::upper_bound(by_id.begin(), by_id.end(), height, [](uint64_t h, const value_type *x) { return h < x->second.m_block_height; });
+      by_id.insert(pos, &p);
+    }
+
+    void erase(const value_type &p)
+    {
+      auto range = m_by_height.equal_range(p.second.m_block_height);
+      for (auto i = range.first; i != range.second; ++i)
+      {
+        if (i->second == &p)
+        {
+          m_by_height.erase(i);
+          break;
+        }
+      }
+      auto by_id = m_by_id.find(p.first);
+      if (by_id != m_by_id.end())
+      {
+        by_id->second.erase(std::remove(by_id->second.begin(), by_id->second.end(), &p), by_id->second.end());
+        if (by_id->second.empty())
+          m_by_id.erase(by_id);
+      }
+    }
+
+    // unindexes every payment at or above height, for a detached chain
+    void erase_from_height(uint64_t height)
+    {
+      const auto detached = m_by_height.lower_bound(height);
+      for (auto it = detached; it != m_by_height.end(); ++it)
+      {
+        id_index &by_id = m_by_id[it->second->first];
+        by_id.erase(std::remove(by_id.begin(), by_id.end(), it->second), by_id.end());
+        if (by_id.empty())
+          m_by_id.erase(it->second->first);
+      }
+      m_by_height.erase(detached, m_by_height.end());
+    }
+
+    void rebuild(const Container &payments)
+    {
+      clear();
+      for (const auto &p: payments)
+        insert(p);
+    }
+
+    const height_index &by_height() const { return m_by_height; }
+    // payments with this payment id, by block height, or NULL if none
+    const id_index *find(const crypto::hash &payment_id) const
+    {
+      auto i = m_by_id.find(payment_id);
+      return i == m_by_id.end() ? NULL : &i->second;
+    }
+    size_t size() const { return m_by_height.size(); }
+
+  private:
+    height_index m_by_height;
+    std::unordered_map<crypto::hash, id_index> m_by_id;
+  };
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "misc_log_ex.h"
+#include "misc_language.h"
+#include "common/threadpool.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "shared_block_cache.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "wallet.blockcache"
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+shared_block_cache::shared_block_cache(size_t max_blocks, time_t tip_lifetime):
+  m_daemon_height(0),
+  m_daemon_height_time(0),
+  m_max_blocks(max_blocks),
+  m_tip_lifetime(tip_lifetime)
+{
+}
+//----------------------------------------------------------------------------------------------------
+void shared_block_cache::pull_blocks(const std::list<crypto::hash> &short_chain_history, uint64_t &blocks_start_height,
+    std::list<cryptonote::block_complete_entry> &blocks,
+    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, const fetch_t &fetch)
+{
+  if (get_blocks(short_chain_history, blocks_start_height, blocks, o_indices))
+    return;
+
+  // wallets at the same height all miss at the same time, let one of them
+  // go to the daemon and the others pick its result up; wallets elsewhere
+  // on the chain fetch on their own
+  const crypto::hash top = short_chain_history.empty() ? crypto::null_hash : short_chain_history.front();
+  std::shared_ptr<boost::mutex> fetch_mutex;
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    std::shared_ptr<boost::mutex> &m = m_fetch_mutexes[top];
+    if (!m)
+      m = std::make_shared<boost::mutex>();
+    fetch_mutex = m;
+  }
+  epee::misc_utils::auto_scope_leave_caller fetch_dtor = epee::misc_utils::create_scope_leave_handler([&](){
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    fetch_mutex.reset();
+    auto i = m_fetch_mutexes.find(top);
+    if (i != m_fetch_mutexes.end() && i->second.unique())
+      m_fetch_mutexes.erase(i);
+  });
+
+  boost::lock_guard<boost::mutex> fetch_lock(*fetch_mutex);
+  if (get_blocks(short_chain_history, blocks_start_height, blocks, o_indices))
+    return;
+
+  uint64_t current_height = 0;
+  fetch(blocks_start_height, blocks, o_indices, current_height);
+  add_blocks(blocks_start_height, blocks, o_indices, current_height);
+}
+//----------------------------------------------------------------------------------------------------
+bool shared_block_cache::get_blocks(const std::list<crypto::hash> &short_chain_history, uint64_t &blocks_start_height,
+    std::list<cryptonote::block_complete_entry> &blocks,
+    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices) const
+{
+  if (short_chain_history.empty())
+    return false;
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  auto top_block = m_blocks.find(short_chain_history.front());
+  if (top_block == m_blocks.end())
+    return false;
+  const uint64_t start_height = top_block->second->height;
+  auto c = m_chain.find(start_height);
+  if (c == m_chain.end() || c->second != top_block->first)
+    return false;
+
+  // a single block means the wallet is synced, which we only know if the
+  // daemon told us recently
+  const uint64_t top = m_chain.rbegin()->first;
+  const bool at_tip = m_daemon_height == top + 1 && time(NULL) < m_daemon_height_time + m_tip_lifetime;
+
+  std::list<cryptonote::block_complete_entry> found_blocks;
+  std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> found_o_indices;
+  const crypto::hash *prev_hash = NULL;
+  for (; c != m_chain.end() && found_blocks.size() < COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT; ++c)
+  {
+    if (c->first != start_height + found_blocks.size())
+      break;
+    const std::shared_ptr<const entry> &e = m_blocks.find(c->second)->second;
+    if (prev_hash && e->block.prev_id != *prev_hash)
+      break;
+    found_blocks.push_back(e->bce);
+    found_o_indices.push_back(e->o_indices);
+    prev_hash = &e->hash;
+  }
+  if (found_blocks.size() < 2 && !(start_height == top && at_tip))
+    return false;
+
+  blocks_start_height = start_height;
+  blocks = std::move(found_blocks);
+  o_indices = std::move(found_o_indices);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void shared_block_cache::add_blocks(uint64_t start_height, const std::list<cryptonote::block_complete_entry> &blocks,
+    const std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, uint64_t current_height)
+{
+  if (blocks.empty() || blocks.size() != o_indices.size())
+    return;
+
+  std::vector<std::shared_ptr<entry>> entries(blocks.size());
+  std::vector<const cryptonote::block_complete_entry*> bces;
+  bces.reserve(blocks.size());
+  for (const auto &bce: blocks)
+    bces.push_back(&bce);
+  tools::threadpool::getInstance().parallel_for(blocks.size(), [&](size_t n) {
+    std::shared_ptr<entry> e = std::make_shared<entry>();
+    e->bce = *bces[n];
+    e->o_indices = o_indices[n];
+    if (!cryptonote::parse_and_validate_block_from_blob(e->bce.block, e->block))
+      return;
+    if (e->bce.txs.size() != e->block.tx_hashes.size())
+      return;
+    // entries are read by several wallets at once, so fill the lazy hash
+    // caches now rather than racing to do it later
+    e->hash = cryptonote::get_block_hash(e->block);
+    e->height = start_height + n;
+    cryptonote::get_transaction_hash(e->block.miner_tx);
+    e->txes.reserve(e->bce.txs.size());
+    for (const auto &tx_blob: e->bce.txs)
+    {
+      e->txes.push_back(cryptonote::transaction());
+      cryptonote::transaction &tx = e->txes.back();
+      if (!cryptonote::parse_and_validate_tx_base_from_blob(tx_blob, tx))
+        return;
+      // pruned txes can't be hashed, but the block says what they hash to
+      tx.hash = e->block.tx_hashes[e->txes.size() - 1];
+      tx.set_hash_valid(true);
+    }
+    entries[n] = e;
+  });
+  for (const auto &e: entries)
+  {
+    // the wallet will report the bad block, just don't keep the batch
+    if (!e)
+      return;
+  }
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  for (size_t n = 0; n < entries.size(); ++n)
+  {
+    const uint64_t height = start_height + n;
+    auto existing = m_chain.find(height);
+    if (existing != m_chain.end() && existing->second != entries[n]->hash)
+    {
+      // the daemon reorganized, drop the old branch
+      MDEBUG("Dropping cached blocks from height " << height);
+      drop_chain_from(height);
+    }
+    m_chain[height] = entries[n]->hash;
+    m_blocks[entries[n]->hash] = entries[n];
+  }
+  // cached blocks past this batch are only still on the daemon's chain if
+  // they follow from it and are below the daemon's height
+  const uint64_t end_height = start_height + entries.size();
+  auto next = m_chain.find(end_height);
+  if (next != m_chain.end() && m_blocks.find(next->second)->second->block.prev_id != entries.back()->hash)
+    drop_chain_from(end_height);
+  if (current_height >= end_height)
+    drop_chain_from(current_height);
+  while (m_chain.size() > m_max_blocks)
+  {
+    m_blocks.erase(m_chain.begin()->second);
+    m_chain.erase(m_chain.begin());
+  }
+  m_daemon_height = current_height;
+  m_daemon_height_time = time(NULL);
+}
+//----------------------------------------------------------------------------------------------------
+void shared_block_cache::drop_chain_from(uint64_t height)
+{
+  for (auto i = m_chain.lower_bound(height); i != m_chain.end(); i = m_chain.erase(i))
+    m_blocks.erase(i->second);
+}
+//----------------------------------------------------------------------------------------------------
+std::shared_ptr<const shared_block_cache::entry> shared_block_cache::find(uint64_t height, const cryptonote::blobdata &blob) const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  auto c = m_chain.find(height);
+  if (c == m_chain.end())
+    return NULL;
+  auto i = m_blocks.find(c->second);
+  if (i == m_blocks.end() || i->second->bce.block != blob)
+    return NULL;
+  return i->second;
+}
+//----------------------------------------------------------------------------------------------------
+size_t shared_block_cache::size() const
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  return m_blocks.size();
+}
+//----------------------------------------------------------------------------------------------------
+void shared_block_cache::clear()
+{
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  m_blocks.clear();
+  m_chain.clear();
+  m_daemon_height = 0;
+  m_daemon_height_time = 0;
+}
+//----------------------------------------------------------------------------------------------------
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+
+namespace tools
+{
+  // Recently pulled blocks, shared by the wallets hosted in one process so
+  // that each batch is downloaded and parsed once rather than once per wallet.
+  // Blocks are kept by hash, along with the chain the daemon last showed, and
+  // are only served to a wallet whose top block is on that chain, so anything
+  // unusual (reorgs, wallets far behind) goes to the daemon.
+  class shared_block_cache
+  {
+  public:
+    struct entry
+    {
+      cryptonote::block_complete_entry bce;
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices o_indices;
+      cryptonote::block block;
+      crypto::hash hash;
+      uint64_t height;
+      std::vector<cryptonote::transaction> txes;
+    };
+
+    typedef std::function<void(uint64_t &blocks_start_height, std::list<cryptonote::block_complete_entry> &blocks,
+        std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, uint64_t &current_height)> fetch_t;
+
+    shared_block_cache(size_t max_blocks = 4 * COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, time_t tip_lifetime = 10);
+
+    // same contract as a getblocks.bin call: fetch is only called when the
+    // cache cannot answer, by one of the wallets sharing a top block at a time
+    void pull_blocks(const std::list<crypto::hash> &short_chain_history, uint64_t &blocks_start_height,
+        std::list<cryptonote::block_complete_entry> &blocks,
+        std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, const fetch_t &fetch);
+    // the parsed version of a block pulled through the cache, if still there
+    std::shared_ptr<const entry> find(uint64_t height, const cryptonote::blobdata &blob) const;
+
+    size_t size() const;
+    void clear();
+
+  private:
+    bool get_blocks(const std::list<crypto::hash> &short_chain_history, uint64_t &blocks_start_height,
+        std::list<cryptonote::block_complete_entry> &blocks,
+        std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices) const;
+    void add_blocks(uint64_t start_height, const std::list<cryptonote::block_complete_entry> &blocks,
+        const std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, uint64_t current_height);
+    void drop_chain_from(uint64_t height);
+
+    mutable boost::mutex m_mutex;
+    // one per top block hash with a fetch in flight
+    std::unordered_map<crypto::hash, std::shared_ptr<boost::mutex>> m_fetch_mutexes;
+    std::unordered_map<crypto::hash, std::shared_ptr<const entry>> m_blocks;
+    // height -> hash of the cached blocks on the daemon's chain
+    std::map<uint64_t, crypto::hash> m_chain;
+    uint64_t m_daemon_height;
+    time_t m_daemon_height_time;
+    const size_t m_max_blocks;
+    const time_t m_tip_lifetime;
+  };
+}
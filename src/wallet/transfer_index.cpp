@@ -0,0 +1,150 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <limits>
+#include "transfer_index.h"
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+void transfer_index::clear()
+{
+  m_entries.clear();
+  m_accounts.clear();
+  m_by_unlock_height.clear();
+  m_time_locked.clear();
+}
+//----------------------------------------------------------------------------------------------------
+void transfer_index::insert(size_t idx, const entry &e)
+{
+  erase(idx);
+  m_entries.emplace(idx, e);
+  account &acc = m_accounts[e.subaddr.major];
+  acc.unspent.insert(idx);
+  acc.by_amount.insert(std::make_pair(e.amount, idx));
+  balance &b = acc.balances[e.subaddr.minor];
+  b.amount += e.amount;
+  ++b.outputs;
+  m_by_unlock_height.insert(std::make_pair(e.unlock_height, idx));
+  if (e.time_locked)
+    m_time_locked.insert(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void transfer_index::erase(size_t idx)
+{
+  auto i = m_entries.find(idx);
+  if (i == m_entries.end())
+    return;
+  const entry &e = i->second;
+  auto a = m_accounts.find(e.subaddr.major);
+  if (a != m_accounts.end())
+  {
+    account &acc = a->second;
+    acc.unspent.erase(idx);
+    acc.by_amount.erase(std::make_pair(e.amount, idx));
+    auto b = acc.balances.find(e.subaddr.minor);
+    if (b != acc.balances.end() && --b->second.outputs == 0)
+      acc.balances.erase(b);
+    else if (b != acc.balances.end())
+      b->second.amount -= e.amount;
+    if (acc.unspent.empty())
+      m_accounts.erase(a);
+  }
+  m_by_unlock_height.erase(std::make_pair(e.unlock_height, idx));
+  m_time_locked.erase(idx);
+  m_entries.erase(i);
+}
+//----------------------------------------------------------------------------------------------------
+const std::set<size_t> &transfer_index::unspent(uint32_t index_major) const
+{
+  static const std::set<size_t> empty;
+  auto a = m_accounts.find(index_major);
+  return a == m_accounts.end() ? empty : a->second.unspent;
+}
+//----------------------------------------------------------------------------------------------------
+std::vector<size_t> transfer_index::unspent_at_least(uint32_t index_major, uint64_t amount) const
+{
+  std::vector<size_t> indices;
+  auto a = m_accounts.find(index_major);
+  if (a == m_accounts.end())
+    return indices;
+  const auto &by_amount = a->second.by_amount;
+  for (auto i = by_amount.lower_bound(std::make_pair(amount, (size_t)0)); i != by_amount.end(); ++i)
+    indices.push_back(i->second);
+  std::sort(indices.begin(), indices.end());
+  return indices;
+}
+//----------------------------------------------------------------------------------------------------
+std::map<uint32_t, uint64_t> transfer_index::balance_per_subaddress(uint32_t index_major) const
+{
+  std::map<uint32_t, uint64_t> amount_per_subaddr;
+  auto a = m_accounts.find(index_major);
+  if (a == m_accounts.end())
+    return amount_per_subaddr;
+  for (const auto &b: a->second.balances)
+    amount_per_subaddr[b.first] = b.second.amount;
+  return amount_per_subaddr;
+}
+//----------------------------------------------------------------------------------------------------
+std::map<uint32_t, uint64_t> transfer_index::unlocked_balance_per_subaddress(uint32_t index_major, uint64_t height,
+    const std::function<bool(size_t)> &is_time_unlocked) const
+{
+  std::map<uint32_t, uint64_t> amount_per_subaddr;
+  auto a = m_accounts.find(index_major);
+  if (a == m_accounts.end())
+    return amount_per_subaddr;
+
+  // start from the full balance, and take out what is still locked: only
+  // recent outputs are past the chain height, so this stays small
+  std::map<uint32_t, balance> balances = a->second.balances;
+  auto lock = [&](const entry &e) {
+    balance &b = balances[e.subaddr.minor];
+    b.amount -= e.amount;
+    --b.outputs;
+  };
+  for (auto i = m_by_unlock_height.upper_bound(std::make_pair(height, std::numeric_limits<size_t>::max())); i != m_by_unlock_height.end(); ++i)
+  {
+    const entry &e = m_entries.find(i->second)->second;
+    if (e.subaddr.major == index_major)
+      lock(e);
+  }
+  for (size_t idx: m_time_locked)
+  {
+    const entry &e = m_entries.find(idx)->second;
+    if (e.subaddr.major == index_major && e.unlock_height <= height && !is_time_unlocked(idx))
+      lock(e);
+  }
+
+  for (const auto &b: balances)
+    if (b.second.outputs > 0)
+      amount_per_subaddr[b.first] = b.second.amount;
+  return amount_per_subaddr;
+}
+//----------------------------------------------------------------------------------------------------
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/subaddress_index.h"
+
+namespace tools
+{
+  // Secondary indexes over the unspent entries of wallet2::m_transfers, so
+  // balances and input selection do not need to walk every output the wallet
+  // ever received. Entries are keyed by their index in m_transfers; the
+  // wallet adds an entry when an output becomes unspent and removes it when
+  // it gets spent, and rebuilds the whole thing after bulk changes.
+  class transfer_index
+  {
+  public:
+    struct entry
+    {
+      cryptonote::subaddress_index subaddr;
+      uint64_t amount;
+      uint64_t unlock_height; // first local chain height at which the output is spendable
+      bool time_locked;       // unlock_time is a timestamp, which needs checking on top of unlock_height
+    };
+
+    struct balance
+    {
+      uint64_t amount;
+      size_t outputs;
+    };
+
+    void clear();
+    void insert(size_t idx, const entry &e);
+    void erase(size_t idx);
+    bool contains(size_t idx) const { return m_entries.find(idx) != m_entries.end(); }
+    size_t size() const { return m_entries.size(); }
+
+    // all unspent entries, in m_transfers order
+    const std::map<size_t, entry> &entries() const { return m_entries; }
+    // unspent entries of an account, in m_transfers order
+    const std::set<size_t> &unspent(uint32_t index_major) const;
+    // unspent entries of an account with at least the given amount, in m_transfers order
+    std::vector<size_t> unspent_at_least(uint32_t index_major, uint64_t amount) const;
+
+    std::map<uint32_t, uint64_t> balance_per_subaddress(uint32_t index_major) const;
+    // is_time_unlocked is only called for time locked entries past their unlock height
+    std::map<uint32_t, uint64_t> unlocked_balance_per_subaddress(uint32_t index_major, uint64_t height,
+        const std::function<bool(size_t)> &is_time_unlocked) const;
+
+  private:
+    struct account
+    {
+      std::set<size_t> unspent;
+      std::set<std::pair<uint64_t, size_t>> by_amount;
+      std::map<uint32_t, balance> balances;
+    };
+
+    std::map<size_t, entry> m_entries;
+    std::map<uint32_t, account> m_accounts;
+    std::set<std::pair<uint64_t, size_t>> m_by_unlock_height;
+    std::set<size_t> m_time_locked;
+  };
+}
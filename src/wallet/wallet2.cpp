@@ -115,6 +115,8 @@ using namespace cryptonote;
 #define STAGENET_SEGREGATION_FORK_HEIGHT 1000000
 #define SEGREGATION_FORK_VICINITY 1500 /* blocks */
 
+#define GET_OUTS_MIN_CHUNK_SIZE 256 /* smallest get_outs.bin request worth its own connection */
+
 
 namespace
 {
@@ -626,6 +628,14 @@ uint32_t get_subaddress_clamped_sum(uint32_t idx, uint32_t extra)
   return idx + extra;
 }
 
+void commit(const tools::wallet2::commit_guard &guard, const std::function<void()> &f)
+{
+  if (guard)
+    guard(f);
+  else
+    f();
+}
+
   //-----------------------------------------------------------------
 } //namespace
 
@@ -665,10 +675,11 @@ wallet2::wallet2(network_type nettype, bool restricted):
   m_segregate_pre_fork_outputs(true),
   m_key_reuse_mitigation2(true),
   m_segregation_height(0),
+  m_segregation_limits_fork_height(0),
   m_is_initialized(false),
   m_restricted(restricted),
   is_old_file_format(false),
-  m_node_rpc_proxy(m_http_client, m_daemon_rpc_mutex),
+  m_node_rpc_proxy(m_http_client_pool),
   m_subaddress_lookahead_major(SUBADDRESS_LOOKAHEAD_MAJOR),
   m_subaddress_lookahead_minor(SUBADDRESS_LOOKAHEAD_MINOR),
   m_light_wallet(false),
@@ -765,6 +776,8 @@ bool wallet2::init(std::string daemon_address, boost::optional<epee::net_utils::
   // When switching from light wallet to full wallet, we need to reset the height we got from lw node.
   if(m_light_wallet)
     m_local_bc_height = m_blockchain.size();
+  if (!m_http_client_pool.set_server(get_daemon_address(), get_daemon_login(), ssl))
+    return false;
   return m_http_client.set_server(get_daemon_address(), get_daemon_login(), ssl);
 }
 //----------------------------------------------------------------------------------------------------
@@ -996,6 +1009,7 @@ void wallet2::set_spent(size_t idx, uint64_t height)
   LOG_PRINT_L2("Setting SPENT at " << height << ": ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = true;
   td.m_spent_height = height;
+  m_transfer_index.erase(idx);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_unspent(size_t idx)
@@ -1004,6 +1018,45 @@ void wallet2::set_unspent(size_t idx)
   LOG_PRINT_L2("Setting UNSPENT: ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
   td.m_spent = false;
   td.m_spent_height = 0;
+  index_transfer(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::index_transfer(size_t idx)
+{
+  const transfer_details &td = m_transfers[idx];
+  if (td.m_spent)
+  {
+    m_transfer_index.erase(idx);
+    return;
+  }
+  // same rules as is_transfer_unlocked, as a local chain height
+  transfer_index::entry e;
+  e.subaddr = td.m_subaddr_index;
+  e.amount = td.amount();
+  e.unlock_height = td.m_block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+  e.time_locked = td.m_tx.unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER;
+  if (!e.time_locked && td.m_tx.unlock_time + 1 > CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS)
+    e.unlock_height = std::max<uint64_t>(e.unlock_height, td.m_tx.unlock_time + 1 - CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  m_transfer_index.insert(idx, e);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_transfer_index()
+{
+  m_transfer_index.clear();
+  for (size_t i = 0; i < m_transfers.size(); ++i)
+    index_transfer(i);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_payment(const crypto::hash &payment_id, const payment_details &pd)
+{
+  // elements of an unordered_multimap do not move when it rehashes
+  m_payment_index.insert(*m_payments.emplace(payment_id, pd));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::erase_payment(payment_container::iterator it)
+{
+  m_payment_index.erase(*it);
+  m_payments.erase(it);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::check_acc_out_precomp(const tx_out &o, const crypto::key_derivation &derivation, const std::vector<crypto::key_derivation> &additional_derivations, size_t i, tx_scan_info_t &tx_scan_info) const
@@ -1351,6 +1404,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
             }
             THROW_WALLET_EXCEPTION_IF(td.get_public_key() != tx_scan_info[o].in_ephemeral.pub, error::wallet_internal_error, "Inconsistent public keys");
 	    THROW_WALLET_EXCEPTION_IF(td.m_spent, error::wallet_internal_error, "Inconsistent spent status");
+            index_transfer(kit->second);
 
 	    LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << txid);
 	    if (0 != m_callback)
@@ -1387,6 +1441,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           //   2) the wallet set the highest amount among them to transfer_details::m_amount, and
           //   3) the wallet somehow spent that output with an amount smaller than the above amount, causing inconsistency
           td.m_amount = amount;
+          index_transfer(it->second);
         }
       }
       else
@@ -1495,7 +1550,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
       else
-        m_payments.emplace(payment_id, payment);
+        add_payment(payment_id, payment);
       LOG_PRINT_L2("Payment found in " << (pool ? "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
     }
   }
@@ -1563,7 +1618,7 @@ void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::trans
   add_rings(tx);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const crypto::hash& bl_id, uint64_t height, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices &o_indices)
+void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const crypto::hash& bl_id, uint64_t height, const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices &o_indices, const std::vector<cryptonote::transaction> *txes)
 {
   size_t txidx = 0;
   THROW_WALLET_EXCEPTION_IF(bche.txs.size() + 1 != o_indices.indices.size(), error::wallet_internal_error,
@@ -1581,9 +1636,16 @@ void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cry
 
     TIME_MEASURE_START(txs_handle_time);
     THROW_WALLET_EXCEPTION_IF(bche.txs.size() != b.tx_hashes.size(), error::wallet_internal_error, "Wrong amount of transactions for block");
+    THROW_WALLET_EXCEPTION_IF(txes && txes->size() != bche.txs.size(), error::wallet_internal_error, "Wrong amount of parsed transactions for block");
     size_t idx = 0;
     for (const auto& txblob: bche.txs)
     {
+      if (txes)
+      {
+        process_new_transaction(b.tx_hashes[idx], (*txes)[idx], o_indices.indices[txidx++].indices, height, b.timestamp, false, false, false);
+        ++idx;
+        continue;
+      }
       cryptonote::transaction tx;
       bool r = parse_and_validate_tx_base_from_blob(txblob, tx);
       THROW_WALLET_EXCEPTION_IF(!r, error::tx_parse_error, txblob);
@@ -1644,6 +1706,24 @@ void wallet2::parse_block_round(const cryptonote::blobdata &blob, cryptonote::bl
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices)
+{
+  // an explicit start height is only used on the first pull, and may be
+  // ahead of anything the cache knows about
+  if (m_block_cache && start_height == 0)
+  {
+    m_block_cache->pull_blocks(short_chain_history, blocks_start_height, blocks, o_indices,
+      [&](uint64_t &fetched_start_height, std::list<cryptonote::block_complete_entry> &fetched_blocks,
+          std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &fetched_o_indices, uint64_t &current_height) {
+        pull_blocks_from_daemon(start_height, fetched_start_height, short_chain_history, fetched_blocks, fetched_o_indices, current_height);
+      });
+    return;
+  }
+
+  uint64_t current_height;
+  pull_blocks_from_daemon(start_height, blocks_start_height, short_chain_history, blocks, o_indices, current_height);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_blocks_from_daemon(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, uint64_t &current_height)
 {
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
@@ -1678,9 +1758,7 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
   }
 
   req.start_height = start_height;
-  m_daemon_rpc_mutex.lock();
-  bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, m_http_client, rpc_timeout);
-  m_daemon_rpc_mutex.unlock();
+  bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, *m_http_client_pool.acquire(), rpc_timeout);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "getblocks.bin");
   THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks.bin");
   THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
@@ -1691,6 +1769,7 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
   blocks_start_height = res.start_height;
   blocks = res.blocks;
   o_indices = res.output_indices;
+  current_height = res.current_height;
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<crypto::hash> &hashes)
@@ -1700,9 +1779,7 @@ void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height,
   req.block_ids = short_chain_history;
 
   req.start_height = start_height;
-  m_daemon_rpc_mutex.lock();
-  bool r = net_utils::invoke_http_bin("/gethashes.bin", req, res, m_http_client, rpc_timeout);
-  m_daemon_rpc_mutex.unlock();
+  bool r = net_utils::invoke_http_bin("/gethashes.bin", req, res, *m_http_client_pool.acquire(), rpc_timeout);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "gethashes.bin");
   THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "gethashes.bin");
   THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_hashes_error, res.status);
@@ -1726,6 +1803,7 @@ void wallet2::process_blocks(uint64_t start_height, const std::list<cryptonote::
   {
     std::vector<crypto::hash> round_block_hashes(threads);
     std::vector<cryptonote::block> round_blocks(threads);
+    std::vector<std::shared_ptr<const shared_block_cache::entry>> round_cached(threads);
     std::deque<bool> error(threads);
     size_t blocks_size = blocks.size();
     std::list<block_complete_entry>::const_iterator blocki = blocks.begin();
@@ -1737,8 +1815,11 @@ void wallet2::process_blocks(uint64_t start_height, const std::list<cryptonote::
       std::list<block_complete_entry>::const_iterator tmpblocki = blocki;
       for (size_t i = 0; i < round_size; ++i)
       {
-        tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(tmpblocki->block),
-          std::ref(round_blocks[i]), std::ref(round_block_hashes[i]), std::ref(error[i])));
+        round_cached[i] = m_block_cache ? m_block_cache->find(start_height + b + i, tmpblocki->block) : NULL;
+        error[i] = false;
+        if (!round_cached[i])
+          tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(tmpblocki->block),
+            std::ref(round_blocks[i]), std::ref(round_block_hashes[i]), std::ref(error[i])));
         ++tmpblocki;
       }
       waiter.wait();
@@ -1750,12 +1831,13 @@ void wallet2::process_blocks(uint64_t start_height, const std::list<cryptonote::
       }
       for (size_t i = 0; i < round_size; ++i)
       {
-        const crypto::hash &bl_id = round_block_hashes[i];
-        cryptonote::block &bl = round_blocks[i];
+        const crypto::hash &bl_id = round_cached[i] ? round_cached[i]->hash : round_block_hashes[i];
+        const cryptonote::block &bl = round_cached[i] ? round_cached[i]->block : round_blocks[i];
+        const std::vector<cryptonote::transaction> *txes = round_cached[i] ? &round_cached[i]->txes : NULL;
 
         if(current_index >= m_blockchain.size())
         {
-          process_new_blockchain_entry(bl, *blocki, bl_id, current_index, o_indices[b+i]);
+          process_new_blockchain_entry(bl, *blocki, bl_id, current_index, o_indices[b+i], txes);
           ++blocks_added;
         }
         else if(bl_id != m_blockchain[current_index])
@@ -1767,7 +1849,7 @@ void wallet2::process_blocks(uint64_t start_height, const std::list<cryptonote::
             string_tools::pod_to_hex(m_blockchain[current_index]));
 
           detach_blockchain(current_index);
-          process_new_blockchain_entry(bl, *blocki, bl_id, current_index, o_indices[b+i]);
+          process_new_blockchain_entry(bl, *blocki, bl_id, current_index, o_indices[b+i], txes);
         }
         else
         {
@@ -1782,14 +1864,20 @@ void wallet2::process_blocks(uint64_t start_height, const std::list<cryptonote::
   {
   for(auto& bl_entry: blocks)
   {
-    cryptonote::block bl;
-    bool r = cryptonote::parse_and_validate_block_from_blob(bl_entry.block, bl);
-    THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl_entry.block);
+    std::shared_ptr<const shared_block_cache::entry> cached = m_block_cache ? m_block_cache->find(current_index, bl_entry.block) : NULL;
+    cryptonote::block parsed_bl;
+    if (!cached)
+    {
+      bool r = cryptonote::parse_and_validate_block_from_blob(bl_entry.block, parsed_bl);
+      THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl_entry.block);
+    }
+    const cryptonote::block &bl = cached ? cached->block : parsed_bl;
+    const std::vector<cryptonote::transaction> *txes = cached ? &cached->txes : NULL;
 
-    crypto::hash bl_id = get_block_hash(bl);
+    crypto::hash bl_id = cached ? cached->hash : get_block_hash(bl);
     if(current_index >= m_blockchain.size())
     {
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index, o_indices[tx_o_indices_idx]);
+      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index, o_indices[tx_o_indices_idx], txes);
       ++blocks_added;
     }
     else if(bl_id != m_blockchain[current_index])
@@ -1801,7 +1889,7 @@ void wallet2::process_blocks(uint64_t start_height, const std::list<cryptonote::
         string_tools::pod_to_hex(m_blockchain[current_index]));
 
       detach_blockchain(current_index);
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index, o_indices[tx_o_indices_idx]);
+      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index, o_indices[tx_o_indices_idx], txes);
     }
     else
     {
@@ -1882,7 +1970,7 @@ void wallet2::remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashe
 }
 
 //----------------------------------------------------------------------------------------------------
-void wallet2::update_pool_state(bool refreshed)
+void wallet2::update_pool_state(bool refreshed, const commit_guard &guard)
 {
   MDEBUG("update_pool_state start");
 
@@ -1897,69 +1985,71 @@ void wallet2::update_pool_state(bool refreshed)
   THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_tx_pool_error);
   MDEBUG("update_pool_state got pool");
 
-  // remove any pending tx that's not in the pool
-  std::unordered_map<crypto::hash, wallet2::unconfirmed_transfer_details>::iterator it = m_unconfirmed_txs.begin();
-  while (it != m_unconfirmed_txs.end())
-  {
-    const crypto::hash &txid = it->first;
-    bool found = false;
-    for (const auto &it2: res.tx_hashes)
+  commit(guard, [&]{
+    // remove any pending tx that's not in the pool
+    std::unordered_map<crypto::hash, wallet2::unconfirmed_transfer_details>::iterator it = m_unconfirmed_txs.begin();
+    while (it != m_unconfirmed_txs.end())
     {
-      if (it2 == txid)
-      {
-        found = true;
-        break;
-      }
-    }
-    auto pit = it++;
-    if (!found)
-    {
-      // we want to avoid a false positive when we ask for the pool just after
-      // a tx is removed from the pool due to being found in a new block, but
-      // just before the block is visible by refresh. So we keep a boolean, so
-      // that the first time we don't see the tx, we set that boolean, and only
-      // delete it the second time it is checked (but only when refreshed, so
-      // we're sure we've seen the blockchain state first)
-      if (pit->second.m_state == wallet2::unconfirmed_transfer_details::pending)
+      const crypto::hash &txid = it->first;
+      bool found = false;
+      for (const auto &it2: res.tx_hashes)
       {
-        LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as not in pool");
-        pit->second.m_state = wallet2::unconfirmed_transfer_details::pending_not_in_pool;
+        if (it2 == txid)
+        {
+          found = true;
+          break;
+        }
       }
-      else if (pit->second.m_state == wallet2::unconfirmed_transfer_details::pending_not_in_pool && refreshed)
+      auto pit = it++;
+      if (!found)
       {
-        LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as failed");
-        pit->second.m_state = wallet2::unconfirmed_transfer_details::failed;
-
-        // the inputs aren't spent anymore, since the tx failed
-        remove_rings(pit->second.m_tx);
-        for (size_t vini = 0; vini < pit->second.m_tx.vin.size(); ++vini)
+        // we want to avoid a false positive when we ask for the pool just after
+        // a tx is removed from the pool due to being found in a new block, but
+        // just before the block is visible by refresh. So we keep a boolean, so
+        // that the first time we don't see the tx, we set that boolean, and only
+        // delete it the second time it is checked (but only when refreshed, so
+        // we're sure we've seen the blockchain state first)
+        if (pit->second.m_state == wallet2::unconfirmed_transfer_details::pending)
+        {
+          LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as not in pool");
+          pit->second.m_state = wallet2::unconfirmed_transfer_details::pending_not_in_pool;
+        }
+        else if (pit->second.m_state == wallet2::unconfirmed_transfer_details::pending_not_in_pool && refreshed)
         {
-          if (pit->second.m_tx.vin[vini].type() == typeid(txin_to_key))
+          LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as failed");
+          pit->second.m_state = wallet2::unconfirmed_transfer_details::failed;
+
+          // the inputs aren't spent anymore, since the tx failed
+          remove_rings(pit->second.m_tx);
+          for (size_t vini = 0; vini < pit->second.m_tx.vin.size(); ++vini)
           {
-            txin_to_key &tx_in_to_key = boost::get<txin_to_key>(pit->second.m_tx.vin[vini]);
-            for (size_t i = 0; i < m_transfers.size(); ++i)
+            if (pit->second.m_tx.vin[vini].type() == typeid(txin_to_key))
             {
-              const transfer_details &td = m_transfers[i];
-              if (td.m_key_image == tx_in_to_key.k_image)
+              txin_to_key &tx_in_to_key = boost::get<txin_to_key>(pit->second.m_tx.vin[vini]);
+              for (size_t i = 0; i < m_transfers.size(); ++i)
               {
-                 LOG_PRINT_L1("Resetting spent status for output " << vini << ": " << td.m_key_image);
-                 set_unspent(i);
-                 break;
+                const transfer_details &td = m_transfers[i];
+                if (td.m_key_image == tx_in_to_key.k_image)
+                {
+                   LOG_PRINT_L1("Resetting spent status for output " << vini << ": " << td.m_key_image);
+                   set_unspent(i);
+                   break;
+                }
               }
             }
           }
         }
       }
     }
-  }
-  MDEBUG("update_pool_state done first loop");
+    MDEBUG("update_pool_state done first loop");
 
-  // remove pool txes to us that aren't in the pool anymore
-  // but only if we just refreshed, so that the tx can go in
-  // the in transfers list instead (or nowhere if it just
-  // disappeared without being mined)
-  if (refreshed)
-    remove_obsolete_pool_txs(res.tx_hashes);
+    // remove pool txes to us that aren't in the pool anymore
+    // but only if we just refreshed, so that the tx can go in
+    // the in transfers list instead (or nowhere if it just
+    // disappeared without being mined)
+    if (refreshed)
+      remove_obsolete_pool_txs(res.tx_hashes);
+  });
 
   MDEBUG("update_pool_state done second loop");
 
@@ -2044,49 +2134,51 @@ void wallet2::update_pool_state(bool refreshed)
     {
       if (res.txs.size() == txids.size())
       {
-        for (const auto &tx_entry: res.txs)
-        {
-          if (tx_entry.in_pool)
+        commit(guard, [&]{
+          for (const auto &tx_entry: res.txs)
           {
-            cryptonote::transaction tx;
-            cryptonote::blobdata bd;
-            crypto::hash tx_hash, tx_prefix_hash;
-            if (epee::string_tools::parse_hexstr_to_binbuff(tx_entry.as_hex, bd))
+            if (tx_entry.in_pool)
             {
-              if (cryptonote::parse_and_validate_tx_from_blob(bd, tx, tx_hash, tx_prefix_hash))
+              cryptonote::transaction tx;
+              cryptonote::blobdata bd;
+              crypto::hash tx_hash, tx_prefix_hash;
+              if (epee::string_tools::parse_hexstr_to_binbuff(tx_entry.as_hex, bd))
               {
-                const std::vector<std::pair<crypto::hash, bool>>::const_iterator i = std::find_if(txids.begin(), txids.end(),
-                    [tx_hash](const std::pair<crypto::hash, bool> &e) { return e.first == tx_hash; });
-                if (i != txids.end())
+                if (cryptonote::parse_and_validate_tx_from_blob(bd, tx, tx_hash, tx_prefix_hash))
                 {
-                  process_new_transaction(tx_hash, tx, std::vector<uint64_t>(), 0, time(NULL), false, true, tx_entry.double_spend_seen);
-                  m_scanned_pool_txs[0].insert(tx_hash);
-                  if (m_scanned_pool_txs[0].size() > 5000)
+                  const std::vector<std::pair<crypto::hash, bool>>::const_iterator i = std::find_if(txids.begin(), txids.end(),
+                      [tx_hash](const std::pair<crypto::hash, bool> &e) { return e.first == tx_hash; });
+                  if (i != txids.end())
+                  {
+                    process_new_transaction(tx_hash, tx, std::vector<uint64_t>(), 0, time(NULL), false, true, tx_entry.double_spend_seen);
+                    m_scanned_pool_txs[0].insert(tx_hash);
+                    if (m_scanned_pool_txs[0].size() > 5000)
+                    {
+                      std::swap(m_scanned_pool_txs[0], m_scanned_pool_txs[1]);
+                      m_scanned_pool_txs[0].clear();
+                    }
+                  }
+                  else
                   {
-                    std::swap(m_scanned_pool_txs[0], m_scanned_pool_txs[1]);
-                    m_scanned_pool_txs[0].clear();
+                    MERROR("Got txid " << tx_hash << " which we did not ask for");
                   }
                 }
                 else
                 {
-                  MERROR("Got txid " << tx_hash << " which we did not ask for");
+                  LOG_PRINT_L0("failed to validate transaction from daemon");
                 }
               }
               else
               {
-                LOG_PRINT_L0("failed to validate transaction from daemon");
+                LOG_PRINT_L0("Failed to parse transaction from daemon");
               }
             }
             else
             {
-              LOG_PRINT_L0("Failed to parse transaction from daemon");
+              LOG_PRINT_L1("Transaction from daemon was in pool, but is no more");
             }
           }
-          else
-          {
-            LOG_PRINT_L1("Transaction from daemon was in pool, but is no more");
-          }
-        }
+        });
       }
       else
       {
@@ -2101,19 +2193,21 @@ void wallet2::update_pool_state(bool refreshed)
   MDEBUG("update_pool_state end");
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history)
+void wallet2::fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const commit_guard &guard)
 {
   std::list<crypto::hash> hashes;
 
   const uint64_t checkpoint_height = m_checkpoints.get_max_height();
   if (stop_height > checkpoint_height && m_blockchain.size()-1 < checkpoint_height)
   {
-    // we will drop all these, so don't bother getting them
-    uint64_t missing_blocks = m_checkpoints.get_max_height() - m_blockchain.size();
-    while (missing_blocks-- > 0)
-      m_blockchain.push_back(crypto::null_hash); // maybe a bit suboptimal, but deque won't do huge reallocs like vector
-    m_blockchain.push_back(m_checkpoints.get_points().at(checkpoint_height));
-    m_local_bc_height = m_blockchain.size();
+    commit(guard, [&]{
+      // we will drop all these, so don't bother getting them
+      uint64_t missing_blocks = m_checkpoints.get_max_height() - m_blockchain.size();
+      while (missing_blocks-- > 0)
+        m_blockchain.push_back(crypto::null_hash); // maybe a bit suboptimal, but deque won't do huge reallocs like vector
+      m_blockchain.push_back(m_checkpoints.get_points().at(checkpoint_height));
+      m_local_bc_height = m_blockchain.size();
+    });
     short_chain_history.clear();
     get_short_chain_history(short_chain_history);
   }
@@ -2139,30 +2233,39 @@ void wallet2::fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height,
       }
     }
     current_index = blocks_start_height;
-    for(auto& bl_id: hashes)
-    {
-      if(current_index >= m_blockchain.size())
+    bool done = false;
+    commit(guard, [&]{
+      for(auto& bl_id: hashes)
       {
-        if (!(current_index % 1000))
-          LOG_PRINT_L2( "Skipped block by height: " << current_index);
-        m_blockchain.push_back(bl_id);
-        ++m_local_bc_height;
+        if(current_index >= m_blockchain.size())
+        {
+          if (!(current_index % 1000))
+            LOG_PRINT_L2( "Skipped block by height: " << current_index);
+          m_blockchain.push_back(bl_id);
+          ++m_local_bc_height;
 
-        if (0 != m_callback)
-        { // FIXME: this isn't right, but simplewallet just logs that we got a block.
-          cryptonote::block dummy;
-          m_callback->on_new_block(current_index, dummy);
+          if (0 != m_callback)
+          { // FIXME: this isn't right, but simplewallet just logs that we got a block.
+            cryptonote::block dummy;
+            m_callback->on_new_block(current_index, dummy);
+          }
+        }
+        else if(bl_id != m_blockchain[current_index])
+        {
+          //split detected here !!!
+          done = true;
+          return;
+        }
+        ++current_index;
+        if (current_index >= stop_height)
+        {
+          done = true;
+          return;
         }
       }
-      else if(bl_id != m_blockchain[current_index])
-      {
-        //split detected here !!!
-        return;
-      }
-      ++current_index;
-      if (current_index >= stop_height)
-        return;
-    }
+    });
+    if (done)
+      return;
   }
 }
 
@@ -2193,36 +2296,45 @@ bool wallet2::delete_address_book_row(std::size_t row_id) {
 
 //----------------------------------------------------------------------------------------------------
 void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& received_money)
+{
+  refresh(start_height, blocks_fetched, received_money, commit_guard());
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& received_money, const commit_guard &guard)
 {
   if(m_light_wallet) {
-
-    // MyMonero get_address_info needs to be called occasionally to trigger wallet sync.
-    // This call is not really needed for other purposes and can be removed if mymonero changes their backend.
-    cryptonote::COMMAND_RPC_GET_ADDRESS_INFO::response res;
-
-    // Get basic info
-    if(light_wallet_get_address_info(res)) {
-      // Last stored block height
-      uint64_t prev_height = m_light_wallet_blockchain_height;
-      // Update lw heights
-      m_light_wallet_scanned_block_height = res.scanned_block_height;
-      m_light_wallet_blockchain_height = res.blockchain_height;
-      m_local_bc_height = res.blockchain_height;
-      // If new height - call new_block callback
-      if(m_light_wallet_blockchain_height != prev_height)
-      {
-        MDEBUG("new block since last time!");
-        m_callback->on_lw_new_block(m_light_wallet_blockchain_height - 1);
-      }
-      m_light_wallet_connected = true;
-      MDEBUG("lw scanned block height: " <<  m_light_wallet_scanned_block_height);
-      MDEBUG("lw blockchain height: " <<  m_light_wallet_blockchain_height);
-      MDEBUG(m_light_wallet_blockchain_height-m_light_wallet_scanned_block_height << " blocks behind");
-      // TODO: add wallet created block info
-
-      light_wallet_get_address_txs();
-    } else
-      m_light_wallet_connected = false;
+    // the light wallet server does the scanning, so there's nothing to
+    // keep outside of the guard
+    commit(guard, [&]{
+
+      // MyMonero get_address_info needs to be called occasionally to trigger wallet sync.
+      // This call is not really needed for other purposes and can be removed if mymonero changes their backend.
+      cryptonote::COMMAND_RPC_GET_ADDRESS_INFO::response res;
+
+      // Get basic info
+      if(light_wallet_get_address_info(res)) {
+        // Last stored block height
+        uint64_t prev_height = m_light_wallet_blockchain_height;
+        // Update lw heights
+        m_light_wallet_scanned_block_height = res.scanned_block_height;
+        m_light_wallet_blockchain_height = res.blockchain_height;
+        m_local_bc_height = res.blockchain_height;
+        // If new height - call new_block callback
+        if(m_light_wallet_blockchain_height != prev_height)
+        {
+          MDEBUG("new block since last time!");
+          m_callback->on_lw_new_block(m_light_wallet_blockchain_height - 1);
+        }
+        m_light_wallet_connected = true;
+        MDEBUG("lw scanned block height: " <<  m_light_wallet_scanned_block_height);
+        MDEBUG("lw blockchain height: " <<  m_light_wallet_blockchain_height);
+        MDEBUG(m_light_wallet_blockchain_height-m_light_wallet_scanned_block_height << " blocks behind");
+        // TODO: add wallet created block info
+
+        light_wallet_get_address_txs();
+      } else
+        m_light_wallet_connected = false;
+    });
 
     // Lighwallet refresh done
     return;
@@ -2247,7 +2359,7 @@ void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& re
     if (!start_height)
       start_height = m_refresh_from_block_height;
     // we can shortcut by only pulling hashes up to the start_height
-    fast_refresh(start_height, blocks_start_height, short_chain_history);
+    fast_refresh(start_height, blocks_start_height, short_chain_history, guard);
     // regenerate the history now that we've got a full set of hashes
     short_chain_history.clear();
     get_short_chain_history(short_chain_history);
@@ -2279,12 +2391,12 @@ void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& re
       }
       tpool.submit(&waiter, [&]{pull_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, next_blocks, next_o_indices, error);});
 
-      process_blocks(blocks_start_height, blocks, o_indices, added_blocks);
+      commit(guard, [&]{ process_blocks(blocks_start_height, blocks, o_indices, added_blocks); });
       blocks_fetched += added_blocks;
       waiter.wait();
       if(blocks_start_height == next_blocks_start_height)
       {
-        m_node_rpc_proxy.set_height(m_blockchain.size());
+        commit(guard, [&]{ m_node_rpc_proxy.set_height(m_blockchain.size()); });
         refreshed = true;
         break;
       }
@@ -2323,7 +2435,7 @@ void wallet2::refresh(uint64_t start_height, uint64_t & blocks_fetched, bool& re
   {
     // If stop() is called we don't need to check pending transactions
     if(m_run.load(std::memory_order_relaxed))
-      update_pool_state(refreshed);
+      update_pool_state(refreshed, guard);
   }
   catch (...)
   {
@@ -2454,12 +2566,15 @@ void wallet2::detach_blockchain(uint64_t height)
     THROW_WALLET_EXCEPTION_IF(it_pk == m_pub_keys.end(), error::wallet_internal_error, "public key not found");
     m_pub_keys.erase(it_pk);
   }
+  for(size_t i = i_start; i!= m_transfers.size();i++)
+    m_transfer_index.erase(i);
   m_transfers.erase(it, m_transfers.end());
 
   size_t blocks_detached = m_blockchain.size() - height;
   m_blockchain.crop(height);
   m_local_bc_height -= blocks_detached;
 
+  m_payment_index.erase_from_height(height);
   for (auto it = m_payments.begin(); it != m_payments.end(); )
   {
     if(height <= it->second.m_block_height)
@@ -2482,6 +2597,7 @@ void wallet2::detach_blockchain(uint64_t height)
 bool wallet2::deinit()
 {
   m_is_initialized=false;
+  m_http_client_pool.disconnect();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -2489,10 +2605,12 @@ bool wallet2::clear()
 {
   m_blockchain.clear();
   m_transfers.clear();
+  m_transfer_index.clear();
   m_key_images.clear();
   m_pub_keys.clear();
   m_unconfirmed_txs.clear();
   m_payments.clear();
+  m_payment_index.clear();
   m_tx_keys.clear();
   m_additional_tx_keys.clear();
   m_confirmed_txs.clear();
@@ -2503,6 +2621,10 @@ bool wallet2::clear()
   m_local_bc_height = 1;
   m_subaddresses.clear();
   m_subaddress_labels.clear();
+  {
+    boost::lock_guard<boost::mutex> lock(m_segregation_limits_mutex);
+    m_segregation_limits.clear();
+  }
   return true;
 }
 
@@ -3861,6 +3983,8 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
     add_subaddress_account(tr("Primary account"));
 
   m_local_bc_height = m_blockchain.size();
+  rebuild_transfer_index();
+  m_payment_index.rebuild(m_payments);
 
   try
   {
@@ -4055,18 +4179,7 @@ uint64_t wallet2::unlocked_balance(uint32_t index_major) const
 //----------------------------------------------------------------------------------------------------
 std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major) const
 {
-  std::map<uint32_t, uint64_t> amount_per_subaddr;
-  for (const auto& td: m_transfers)
-  {
-    if (td.m_subaddr_index.major == index_major && !td.m_spent)
-    {
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = td.amount();
-      else
-        found->second += td.amount();
-    }
-  }
+  std::map<uint32_t, uint64_t> amount_per_subaddr = m_transfer_index.balance_per_subaddress(index_major);
   for (const auto& utx: m_unconfirmed_txs)
   {
     if (utx.second.m_subaddr_account == index_major && utx.second.m_state != wallet2::unconfirmed_transfer_details::failed)
@@ -4084,19 +4197,10 @@ std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_majo
 //----------------------------------------------------------------------------------------------------
 std::map<uint32_t, uint64_t> wallet2::unlocked_balance_per_subaddress(uint32_t index_major) const
 {
-  std::map<uint32_t, uint64_t> amount_per_subaddr;
-  for(const transfer_details& td: m_transfers)
-  {
-    if(td.m_subaddr_index.major == index_major && !td.m_spent && is_transfer_unlocked(td))
-    {
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = td.amount();
-      else
-        found->second += td.amount();
-    }
-  }
-  return amount_per_subaddr;
+  return m_transfer_index.unlocked_balance_per_subaddress(index_major, m_local_bc_height, [this](size_t idx) {
+    const transfer_details &td = m_transfers[idx];
+    return is_tx_spendtime_unlocked(td.m_tx.unlock_time, td.m_block_height);
+  });
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance_all() const
@@ -4122,10 +4226,14 @@ void wallet2::get_transfers(wallet2::transfer_container& incoming_transfers) con
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  auto range = m_payments.equal_range(payment_id);
-  std::for_each(range.first, range.second, [&payments, &min_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height &&
-      (!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
+  const payment_index<payment_container>::id_index *by_id = m_payment_index.find(payment_id);
+  if (!by_id)
+    return;
+  const payment_index<payment_container>::id_index &index = *by_id;
+  auto start = std::upper_bound(index.begin(), index.end(), min_height, [](uint64_t height, const payment_container::value_type *p) { return height < p->second.m_block_height; });
+  std::for_each(start, index.end(), [&payments, &subaddr_account, &subaddr_indices](const payment_container::value_type *p) {
+    const payment_container::value_type &x = *p;
+    if ((!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
       (subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1))
     {
       payments.push_back(x.second);
@@ -4135,10 +4243,13 @@ void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::pa
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height, const boost::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
-  auto range = std::make_pair(m_payments.begin(), m_payments.end());
-  std::for_each(range.first, range.second, [&payments, &min_height, &max_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height && max_height >= x.second.m_block_height &&
-      (!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
+  if (max_height < min_height)
+    return;
+  const payment_index<payment_container>::height_index &by_height = m_payment_index.by_height();
+  auto range = std::make_pair(by_height.upper_bound(min_height), by_height.upper_bound(max_height));
+  std::for_each(range.first, range.second, [&payments, &subaddr_account, &subaddr_indices](const std::pair<const uint64_t, const payment_container::value_type*>& i) {
+    const payment_container::value_type &x = *i.second;
+    if ((!subaddr_account || *subaddr_account == x.second.m_subaddr_index.major) &&
       (subaddr_indices.empty() || subaddr_indices.count(x.second.m_subaddr_index.minor) == 1))
     {
       payments.push_back(x);
@@ -5902,40 +6013,85 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> segregation_limit;
     if (is_after_segregation_fork && (m_segregate_pre_fork_outputs || m_key_reuse_mitigation2))
     {
+      auto add_segregation_limit = [&](uint64_t amount, uint64_t start_height, const std::vector<uint64_t> &distribution) {
+        THROW_WALLET_EXCEPTION_IF(start_height > segregation_fork_height, error::get_output_distribution, "Distribution start_height too high");
+        THROW_WALLET_EXCEPTION_IF(segregation_fork_height - start_height >= distribution.size(), error::get_output_distribution, "Distribution size too small");
+        THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS - start_height >= distribution.size(), error::get_output_distribution, "Distribution size too small");
+        THROW_WALLET_EXCEPTION_IF(segregation_fork_height <= RECENT_OUTPUT_BLOCKS, error::wallet_internal_error, "Fork height too low");
+        THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS < start_height, error::get_output_distribution, "Bad start height");
+        uint64_t till_fork = distribution[segregation_fork_height - start_height];
+        uint64_t recent = till_fork - distribution[segregation_fork_height - RECENT_OUTPUT_BLOCKS - start_height];
+        segregation_limit[amount] = std::make_pair(till_fork, recent);
+        boost::lock_guard<boost::mutex> lock(m_segregation_limits_mutex);
+        if (m_segregation_limits_fork_height == segregation_fork_height)
+          m_segregation_limits[amount] = std::make_pair(till_fork, recent);
+      };
+
+      // the limits only depend on the blocks up to the fork, so each amount's
+      // are requested once, and only for the window around the fork
+      {
+        boost::lock_guard<boost::mutex> lock(m_segregation_limits_mutex);
+        if (m_segregation_limits_fork_height != segregation_fork_height)
+        {
+          m_segregation_limits.clear();
+          m_segregation_limits_fork_height = segregation_fork_height;
+        }
+        for(size_t idx: selected_transfers)
+        {
+          const uint64_t amount = m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount();
+          auto it = m_segregation_limits.find(amount);
+          if (it != m_segregation_limits.end())
+            segregation_limit[amount] = it->second;
+        }
+      }
+
       cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req_t = AUTO_VAL_INIT(req_t);
       cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response resp_t = AUTO_VAL_INIT(resp_t);
       for(size_t idx: selected_transfers)
-        req_t.amounts.push_back(m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount());
-      std::sort(req_t.amounts.begin(), req_t.amounts.end());
-      auto end = std::unique(req_t.amounts.begin(), req_t.amounts.end());
-      req_t.amounts.resize(std::distance(req_t.amounts.begin(), end));
-      req_t.from_height = std::max<uint64_t>(segregation_fork_height, RECENT_OUTPUT_BLOCKS) - RECENT_OUTPUT_BLOCKS;
-      req_t.to_height = segregation_fork_height + 1;
-      req_t.cumulative = true;
-      m_daemon_rpc_mutex.lock();
-      bool r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_distribution", req_t, resp_t, m_http_client, rpc_timeout * 1000);
-      m_daemon_rpc_mutex.unlock();
-      THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
-      THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_distribution");
-      THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_output_distribution, resp_t.status);
+      {
+        const uint64_t amount = m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount();
+        if (segregation_limit.find(amount) == segregation_limit.end())
+          req_t.amounts.push_back(amount);
+      }
+      if (!req_t.amounts.empty())
+      {
+        std::sort(req_t.amounts.begin(), req_t.amounts.end());
+        auto end = std::unique(req_t.amounts.begin(), req_t.amounts.end());
+        req_t.amounts.resize(std::distance(req_t.amounts.begin(), end));
+        req_t.from_height = std::max<uint64_t>(segregation_fork_height, RECENT_OUTPUT_BLOCKS) - RECENT_OUTPUT_BLOCKS;
+        req_t.to_height = segregation_fork_height + 1;
+        req_t.cumulative = true;
+        uint32_t rpc_version = 0;
+        m_node_rpc_proxy.get_rpc_version(rpc_version);
+        bool r;
+        m_daemon_rpc_mutex.lock();
+        if (rpc_version >= MAKE_CORE_RPC_VERSION(1, 20))
+        {
+          req_t.compress = true;
+          r = net_utils::invoke_http_bin("/get_output_distribution.bin", req_t, resp_t, m_http_client, rpc_timeout * 1000);
+        }
+        else
+        {
+          r = net_utils::invoke_http_json_rpc("/json_rpc", "get_output_distribution", req_t, resp_t, m_http_client, rpc_timeout * 1000);
+        }
+        m_daemon_rpc_mutex.unlock();
+        THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "transfer_selected");
+        THROW_WALLET_EXCEPTION_IF(resp_t.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_output_distribution");
+        THROW_WALLET_EXCEPTION_IF(resp_t.status != CORE_RPC_STATUS_OK, error::get_output_distribution, resp_t.status);
+      }
 
       // check we got all data
       for(size_t idx: selected_transfers)
       {
         const uint64_t amount = m_transfers[idx].is_rct() ? 0 : m_transfers[idx].amount();
+        if (segregation_limit.find(amount) != segregation_limit.end())
+          continue;
         bool found = false;
         for (const auto &d: resp_t.distributions)
         {
           if (d.amount == amount)
           {
-            THROW_WALLET_EXCEPTION_IF(d.start_height > segregation_fork_height, error::get_output_distribution, "Distribution start_height too high");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height - d.start_height >= d.distribution.size(), error::get_output_distribution, "Distribution size too small");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS - d.start_height >= d.distribution.size(), error::get_output_distribution, "Distribution size too small");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height <= RECENT_OUTPUT_BLOCKS, error::wallet_internal_error, "Fork height too low");
-            THROW_WALLET_EXCEPTION_IF(segregation_fork_height - RECENT_OUTPUT_BLOCKS < d.start_height, error::get_output_distribution, "Bad start height");
-            uint64_t till_fork = d.distribution[segregation_fork_height - d.start_height];
-            uint64_t recent = till_fork - d.distribution[segregation_fork_height - RECENT_OUTPUT_BLOCKS - d.start_height];
-            segregation_limit[amount] = std::make_pair(till_fork, recent);
+            add_segregation_limit(amount, d.start_height, d.distribution);
             found = true;
             break;
           }
@@ -6179,10 +6335,39 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     for (auto i: req.outputs)
       LOG_PRINT_L1("asking for output " << i.index << " for " << print_money(i.amount));
 
-    // get the keys for those
-    m_daemon_rpc_mutex.lock();
-    r = epee::net_utils::invoke_http_bin("/get_outs.bin", req, daemon_resp, m_http_client, rpc_timeout);
-    m_daemon_rpc_mutex.unlock();
+    // get the keys for those; large requests are split over several daemon
+    // connections so the daemon can look them up in parallel
+    const size_t max_chunks = std::max<size_t>(1, m_http_client_pool.get_max_connections());
+    const size_t chunk_size = std::max<size_t>(GET_OUTS_MIN_CHUNK_SIZE, (req.outputs.size() + max_chunks - 1) / max_chunks);
+    const size_t n_chunks = (req.outputs.size() + chunk_size - 1) / chunk_size;
+    if (n_chunks <= 1)
+    {
+      r = epee::net_utils::invoke_http_bin("/get_outs.bin", req, daemon_resp, *m_http_client_pool.acquire(), rpc_timeout);
+    }
+    else
+    {
+      std::vector<COMMAND_RPC_GET_OUTPUTS_BIN::request> chunk_req(n_chunks);
+      std::vector<COMMAND_RPC_GET_OUTPUTS_BIN::response> chunk_resp(n_chunks);
+      std::vector<char> chunk_ok(n_chunks, 0);
+      for (size_t n = 0; n < n_chunks; ++n)
+      {
+        const size_t first = n * chunk_size, last = std::min(first + chunk_size, req.outputs.size());
+        chunk_req[n].outputs.assign(req.outputs.begin() + first, req.outputs.begin() + last);
+      }
+      tools::threadpool::getInstance().parallel_for(n_chunks, [&](size_t n) {
+        chunk_ok[n] = epee::net_utils::invoke_http_bin("/get_outs.bin", chunk_req[n], chunk_resp[n], *m_http_client_pool.acquire(), rpc_timeout);
+      });
+      r = true;
+      daemon_resp.status = CORE_RPC_STATUS_OK;
+      daemon_resp.outs.reserve(req.outputs.size());
+      for (size_t n = 0; n < n_chunks; ++n)
+      {
+        r = r && chunk_ok[n];
+        if (chunk_resp[n].status != CORE_RPC_STATUS_OK && daemon_resp.status == CORE_RPC_STATUS_OK)
+          daemon_resp.status = chunk_resp[n].status;
+        daemon_resp.outs.insert(daemon_resp.outs.end(), chunk_resp[n].outs.begin(), chunk_resp[n].outs.end());
+      }
+    }
     THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_outs.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status != CORE_RPC_STATUS_OK, error::get_random_outs_error, daemon_resp.status);
@@ -6730,7 +6915,7 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
   LOG_PRINT_L2("pick_preferred_rct_inputs: needed_money " << print_money(needed_money));
 
   // try to find a rct input of enough size
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t i: m_transfer_index.unspent_at_least(subaddr_account, needed_money))
   {
     const transfer_details& td = m_transfers[i];
     if (!td.m_spent && td.is_rct() && td.amount() >= needed_money && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
@@ -6745,14 +6930,17 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
   // this could be made better by picking one of the outputs to be a small one, since those
   // are less useful since often below the needed money, so if one can be used in a pair,
   // it gets rid of it for the future
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  const std::set<size_t> &unspent = m_transfer_index.unspent(subaddr_account);
+  for (auto it = unspent.begin(); it != unspent.end(); ++it)
   {
+    const size_t i = *it;
     const transfer_details& td = m_transfers[i];
     if (!td.m_spent && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
     {
       LOG_PRINT_L2("Considering input " << i << ", " << print_money(td.amount()));
-      for (size_t j = i + 1; j < m_transfers.size(); ++j)
+      for (auto jt = std::next(it); jt != unspent.end(); ++jt)
       {
+        const size_t j = *jt;
         const transfer_details& td2 = m_transfers[j];
         if (!td2.m_spent && !td.m_key_image_partial && td2.is_rct() && td.amount() + td2.amount() >= needed_money && is_transfer_unlocked(td2) && td2.m_subaddr_index == td.m_subaddr_index)
         {
@@ -6917,6 +7105,7 @@ void wallet2::light_wallet_get_unspent_outs()
   
   // Clear old outputs
   m_transfers.clear();
+  m_transfer_index.clear();
   
   for (const auto &o: ores.outputs) {
     bool spent = false;
@@ -6952,9 +7141,11 @@ void wallet2::light_wallet_get_unspent_outs()
     string_tools::hex_to_pod(o.public_key, public_key);
     string_tools::hex_to_pod(o.tx_pub_key, tx_pub_key);
     
-    for(auto &t: m_transfers){
+    for(size_t i = 0; i < m_transfers.size(); ++i){
+      transfer_details &t = m_transfers[i];
       if(t.get_public_key() == public_key) {
         t.m_spent = spent;
+        index_transfer(i);
         add_transfer = false;
         break;
       }
@@ -7154,7 +7345,7 @@ void wallet2::light_wallet_get_address_txs()
         }
       } else {
         if (std::find(payments_txs.begin(), payments_txs.end(), tx_hash) == payments_txs.end()) {
-          m_payments.emplace(tx_hash, payment);
+          add_payment(tx_hash, payment);
           if (0 != m_callback) {
             m_callback->on_lw_money_received(t.height, payment.m_tx_hash, payment.m_amount);
           }
@@ -7303,6 +7494,26 @@ bool wallet2::light_wallet_key_image_is_ours(const crypto::key_image& key_image,
   m_key_image_cache.emplace(tx_public_key, index_keyimage_map);
   return key_image == calculated_key_image;
 }
+//----------------------------------------------------------------------------------------------------
+// Builds the final version of already selected, independent txes. With the
+// software device, each tx is built on the threadpool; hardware devices keep
+// state across calls, and multisig needs the signers' nonces, so these are
+// built one after the other.
+void wallet2::construct_final_txes(size_t n_txes, const std::function<void(size_t)> &construct)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  hw::device &hwdev = m_account.get_device();
+  if (n_txes < 2 || m_multisig || &hwdev != &hw::get_device("default") || tpool.get_max_concurrency() < 2)
+  {
+    for (size_t n = 0; n < n_txes; ++n)
+      construct(n);
+    return;
+  }
+
+  // prime the daemon info cache so the workers do not all query it
+  get_upper_transaction_size_limit();
+  tpool.parallel_for(n_txes, construct);
+}
 
 // Another implementation of transaction creation that is hopefully better
 // While there is anything left to pay, it goes through random outputs and tries
@@ -7423,7 +7634,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
   // gather all dust and non-dust outputs belonging to specified subaddresses
   size_t num_nondust_outputs = 0;
   size_t num_dust_outputs = 0;
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t i: m_transfer_index.unspent(subaddr_account))
   {
     const transfer_details& td = m_transfers[i];
     if (!td.m_spent && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
@@ -7774,9 +7985,10 @@ skip_tx:
     " total fee, " << print_money(accumulated_change) << " total change");
 
   hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-  for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
+  // selection is done, the final txes do not depend on each other
+  auto construct_final_tx = [&](size_t n)
   {
-    TX &tx = *i;
+    TX &tx = txes[n];
     cryptonote::transaction test_tx;
     pending_tx test_ptx;
     if (use_rct) {
@@ -7807,7 +8019,8 @@ skip_tx:
     tx.tx = test_tx;
     tx.ptx = test_ptx;
     tx.bytes = txBlob.size();
-  }
+  };
+  construct_final_txes(txes.size(), construct_final_tx);
 
   std::vector<wallet2::pending_tx> ptx_vector;
   for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
@@ -7839,7 +8052,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_all(uint64_t below
 
   // gather all dust and non-dust outputs of specified subaddress (if any) and below specified threshold (if any)
   bool fund_found = false;
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t i: m_transfer_index.unspent(subaddr_account))
   {
     const transfer_details& td = m_transfers[i];
     if (!td.m_spent && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && (subaddr_indices.empty() || subaddr_indices.count(td.m_subaddr_index.minor) == 1))
@@ -8028,9 +8241,10 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
     " total fee, " << print_money(accumulated_change) << " total change");
  
   hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-  for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
+  // selection is done, the final txes do not depend on each other
+  auto construct_final_tx = [&](size_t n)
   {
-    TX &tx = *i;
+    TX &tx = txes[n];
     cryptonote::transaction test_tx;
     pending_tx test_ptx;
     if (use_rct) {
@@ -8044,7 +8258,8 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
     tx.tx = test_tx;
     tx.ptx = test_ptx;
     tx.bytes = txBlob.size();
-  }
+  };
+  construct_final_txes(txes.size(), construct_final_tx);
 
   std::vector<wallet2::pending_tx> ptx_vector;
   for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
@@ -8100,16 +8315,17 @@ uint64_t wallet2::get_upper_transaction_size_limit() const
 std::vector<size_t> wallet2::select_available_outputs(const std::function<bool(const transfer_details &td)> &f) const
 {
   std::vector<size_t> outputs;
-  size_t n = 0;
-  for (transfer_container::const_iterator i = m_transfers.begin(); i != m_transfers.end(); ++i, ++n)
+  for (const auto &e: m_transfer_index.entries())
   {
-    if (i->m_spent)
+    const size_t n = e.first;
+    const transfer_details &td = m_transfers[n];
+    if (td.m_spent)
       continue;
-    if (i->m_key_image_partial)
+    if (td.m_key_image_partial)
       continue;
-    if (!is_transfer_unlocked(*i))
+    if (!is_transfer_unlocked(td))
       continue;
-    if (f(*i))
+    if (f(td))
       outputs.push_back(n);
   }
   return outputs;
@@ -8118,10 +8334,10 @@ std::vector<size_t> wallet2::select_available_outputs(const std::function<bool(c
 std::vector<uint64_t> wallet2::get_unspent_amounts_vector() const
 {
   std::set<uint64_t> set;
-  for (const auto &td: m_transfers)
+  for (const auto &e: m_transfer_index.entries())
   {
-    if (!td.m_spent)
-      set.insert(td.is_rct() ? 0 : td.amount());
+    const transfer_details &td = m_transfers[e.first];
+    set.insert(td.is_rct() ? 0 : td.amount());
   }
   std::vector<uint64_t> vector;
   vector.reserve(set.size());
@@ -9516,6 +9732,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     {
       transfer_details &td = m_transfers[n];
       td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
+      index_transfer(n);
     }
   }
   spent = 0;
@@ -9668,7 +9885,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       {
         if (j->second.m_tx_hash == *spent_txid)
         {
-          m_payments.erase(j);
+          erase_payment(j);
           break;
         }
       }
@@ -9707,6 +9924,7 @@ void wallet2::import_payments(const payment_container &payments)
   {
     m_payments.emplace(p);
   }
+  m_payment_index.rebuild(m_payments);
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
@@ -9767,6 +9985,7 @@ std::vector<tools::wallet2::transfer_details> wallet2::export_outputs() const
 size_t wallet2::import_outputs(const std::vector<tools::wallet2::transfer_details> &outputs)
 {
   m_transfers.clear();
+  m_transfer_index.clear();
   m_transfers.reserve(outputs.size());
   for (size_t i = 0; i < outputs.size(); ++i)
   {
@@ -9791,6 +10010,7 @@ size_t wallet2::import_outputs(const std::vector<tools::wallet2::transfer_detail
     m_key_images[td.m_key_image] = m_transfers.size();
     m_pub_keys[td.get_public_key()] = m_transfers.size();
     m_transfers.push_back(td);
+    index_transfer(m_transfers.size() - 1);
   }
 
   return m_transfers.size();
@@ -51,6 +51,7 @@ using namespace epee;
 #include "mnemonics/electrum-words.h"
 #include "rpc/rpc_args.h"
 #include "rpc/core_rpc_server_commands_defs.h"
+#include "common/threadpool.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "wallet.rpc"
@@ -62,9 +63,25 @@ namespace
   const command_line::arg_descriptor<bool> arg_trusted_daemon = {"trusted-daemon", "Enable commands which rely on a trusted daemon", false};
   const command_line::arg_descriptor<std::string> arg_wallet_dir = {"wallet-dir", "Directory for newly created wallets"};
   const command_line::arg_descriptor<bool> arg_prompt_for_password = {"prompt-for-password", "Prompts for password when not provided", false};
+  const command_line::arg_descriptor<size_t> arg_rpc_threads = {"rpc-threads", "Number of threads serving RPC requests", 4};
+  const command_line::arg_descriptor<bool> arg_multi_wallet = {"multi-wallet", "Keep every wallet opened or created in --wallet-dir loaded, served at /wallet/<name>/json_rpc until stop_wallet is called there", false};
+
+  const char hosted_wallet_prefix[] = "/wallet/";
+  const char hosted_wallet_suffix[] = "/json_rpc";
 
   constexpr const char default_rpc_username[] = "monero";
 
+  // set while a request to (or the refresh of) a hosted wallet runs on
+  // this thread, see wallet_rpc_server::wallet
+  __thread tools::hosted_wallet *current_hosted = NULL;
+
+  struct hosted_wallet_scope
+  {
+    tools::hosted_wallet *previous;
+    hosted_wallet_scope(tools::hosted_wallet *hosted): previous(current_hosted) { current_hosted = hosted; }
+    ~hosted_wallet_scope() { current_hosted = previous; }
+  };
+
   boost::optional<tools::password_container> password_prompter(const char *prompt, bool verify)
   {
     auto pwd_container = tools::password_container::prompt(verify, prompt);
@@ -84,7 +101,7 @@ namespace tools
   }
 
   //------------------------------------------------------------------------------------------------------------------------------
-  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_trusted_daemon(false), m_vm(NULL)
+  wallet_rpc_server::wallet_rpc_server():m_wallet(NULL), rpc_login_file(), m_stop(false), m_trusted_daemon(false), m_vm(NULL), m_multi_wallet(false)
   {
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -99,15 +116,150 @@ namespace tools
     m_wallet = cr;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    LOG_PRINT_L2("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+    bool handled;
+    if (m_multi_wallet && boost::starts_with(query_info.m_URI, hosted_wallet_prefix))
+    {
+      std::shared_ptr<hosted_wallet> hosted = get_hosted_wallet(query_info.m_URI);
+      handled = false;
+      if (hosted)
+      {
+        epee::net_utils::http::http_request_info hosted_query_info = query_info;
+        hosted_query_info.m_URI = "/json_rpc";
+        hosted_wallet_scope scope(hosted.get());
+        handled = handle_http_request_map(hosted_query_info, response, m_conn_context);
+      }
+    }
+    else
+    {
+      handled = handle_http_request_map(query_info, response, m_conn_context);
+    }
+    if (!handled)
+    {
+      response.m_response_code = 404;
+      response.m_response_comment = "Not found";
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::is_hosted() const
+  {
+    return current_hosted != NULL;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  wallet2 *wallet_rpc_server::wallet() const
+  {
+    return current_hosted ? current_hosted->wallet.get() : m_wallet;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  boost::shared_mutex &wallet_rpc_server::wallet_mutex()
+  {
+    return current_hosted ? current_hosted->mutex : m_wallet_mutex;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<hosted_wallet> wallet_rpc_server::get_hosted_wallet(const std::string &uri) const
+  {
+    const size_t prefix_size = sizeof(hosted_wallet_prefix) - 1, suffix_size = sizeof(hosted_wallet_suffix) - 1;
+    if (uri.size() <= prefix_size + suffix_size || !boost::ends_with(uri, hosted_wallet_suffix))
+      return NULL;
+    const std::string name = uri.substr(prefix_size, uri.size() - prefix_size - suffix_size);
+    boost::shared_lock<boost::shared_mutex> lock(m_hosted_wallets_mutex);
+    auto i = m_hosted_wallets.find(name);
+    return i == m_hosted_wallets.end() ? NULL : i->second;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::host_wallet(const std::string &name, std::unique_ptr<wallet2> wal, epee::json_rpc::error& er)
+  {
+    boost::unique_lock<boost::shared_mutex> lock(m_hosted_wallets_mutex);
+    if (m_hosted_wallets.find(name) != m_hosted_wallets.end())
+    {
+      er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
+      er.message = "Wallet is already open: " + name;
+      return false;
+    }
+    wal->set_block_cache(m_block_cache);
+    std::shared_ptr<hosted_wallet> hosted = std::make_shared<hosted_wallet>();
+    hosted->wallet = std::move(wal);
+    hosted->path = m_wallet_dir + "/" + name;
+    m_hosted_wallets.emplace(name, hosted);
+    MINFO("Hosting wallet " << hosted->path << " at " << hosted_wallet_prefix << name << hosted_wallet_suffix);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::unhost_wallet(const hosted_wallet *hosted)
+  {
+    boost::unique_lock<boost::shared_mutex> lock(m_hosted_wallets_mutex);
+    for (auto i = m_hosted_wallets.begin(); i != m_hosted_wallets.end(); ++i)
+    {
+      if (i->second.get() == hosted)
+      {
+        MINFO("Stopped hosting wallet " << hosted->path);
+        m_hosted_wallets.erase(i);
+        return;
+      }
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::not_hosted(epee::json_rpc::error& er)
+  {
+      er.code = WALLET_RPC_ERROR_CODE_DENIED;
+      er.message = "Command unavailable for a hosted wallet, use /json_rpc";
+      return false;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::refresh_hosted_wallets()
+  {
+    std::vector<std::shared_ptr<hosted_wallet>> hosted;
+    {
+      boost::shared_lock<boost::shared_mutex> lock(m_hosted_wallets_mutex);
+      hosted.reserve(m_hosted_wallets.size());
+      for (const auto &i: m_hosted_wallets)
+        hosted.push_back(i.second);
+    }
+
+    // wallets at the same height wait on the same block cache fetch, then
+    // each scans the parsed blocks with its own keys
+    tools::threadpool::getInstance().parallel_for(hosted.size(), [this, &hosted](size_t n) {
+      hosted_wallet_scope scope(hosted[n].get());
+      try {
+        refresh_wallet();
+      } catch (const std::exception& ex) {
+        LOG_ERROR("Exception at while refreshing, what=" << ex.what());
+      }
+    });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::refresh_wallet()
+  {
+    // an upgrade lock keeps other writers out but lets readers in while the
+    // blocks are pulled, it is only made exclusive to scan them in
+    boost::upgrade_lock<boost::shared_mutex> lock(wallet_mutex());
+    wallet2 *wal = wallet();
+    if (!wal)
+      return;
+    uint64_t blocks_fetched;
+    bool received_money;
+    wal->refresh(0, blocks_fetched, received_money, [&lock](const std::function<void()> &f) {
+      boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
+      f();
+    });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::run()
   {
     m_stop = false;
     m_net_server.add_idle_handler([this](){
       try {
-        if (m_wallet) m_wallet->refresh();
+        refresh_wallet();
       } catch (const std::exception& ex) {
         LOG_ERROR("Exception at while refreshing, what=" << ex.what());
       }
+      if (m_multi_wallet)
+        refresh_hosted_wallets();
       return true;
     }, 20000);
     m_net_server.add_idle_handler([this](){
@@ -119,12 +271,25 @@ namespace tools
       return true;
     }, 500);
 
-    //DO NOT START THIS SERVER IN MORE THEN 1 THREADS WITHOUT REFACTORING
-    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(1, true);
+    // handlers lock m_wallet_mutex, so requests can be served concurrently
+    const size_t threads = m_vm ? std::max<size_t>(command_line::get_arg(*m_vm, arg_rpc_threads), 1) : 1;
+    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(threads, true);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::stop()
   {
+    {
+      boost::unique_lock<boost::shared_mutex> lock(m_hosted_wallets_mutex);
+      for (auto &i: m_hosted_wallets)
+      {
+        boost::unique_lock<boost::shared_mutex> wallet_lock(i.second->mutex);
+        try { if (i.second->wallet) i.second->wallet->store(); }
+        catch (const std::exception &e) { LOG_ERROR("Failed to save wallet " << i.second->path << ": " << e.what()); }
+        i.second->wallet.reset();
+      }
+      m_hosted_wallets.clear();
+    }
+    boost::unique_lock<boost::shared_mutex> lock(m_wallet_mutex);
     if (m_wallet)
     {
       m_wallet->store();
@@ -180,6 +345,18 @@ namespace tools
         return false;
       }
     }
+    m_multi_wallet = command_line::get_arg(*m_vm, arg_multi_wallet);
+    if (m_multi_wallet)
+    {
+      if (m_wallet_dir.empty())
+      {
+        LOG_ERROR(tr("--") << arg_multi_wallet.name << tr(" needs --") << arg_wallet_dir.name);
+        return false;
+      }
+      m_block_cache = std::make_shared<shared_block_cache>();
+      if (m_wallet)
+        m_wallet->set_block_cache(m_block_cache);
+    }
 
     if (disable_auth)
     {
@@ -254,10 +431,10 @@ namespace tools
     entry.amount = pd.m_amount;
     entry.unlock_time = pd.m_unlock_time;
     entry.fee = pd.m_fee;
-    entry.note = m_wallet->get_tx_note(pd.m_tx_hash);
+    entry.note = wallet()->get_tx_note(pd.m_tx_hash);
     entry.type = "in";
     entry.subaddr_index = pd.m_subaddr_index;
-    entry.address = m_wallet->get_subaddress_as_str(pd.m_subaddr_index);
+    entry.address = wallet()->get_subaddress_as_str(pd.m_subaddr_index);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const tools::wallet2::confirmed_transfer_details &pd)
@@ -272,18 +449,18 @@ namespace tools
     entry.fee = pd.m_amount_in - pd.m_amount_out;
     uint64_t change = pd.m_change == (uint64_t)-1 ? 0 : pd.m_change; // change may not be known
     entry.amount = pd.m_amount_in - change - entry.fee;
-    entry.note = m_wallet->get_tx_note(txid);
+    entry.note = wallet()->get_tx_note(txid);
 
     for (const auto &d: pd.m_dests) {
       entry.destinations.push_back(wallet_rpc::transfer_destination());
       wallet_rpc::transfer_destination &td = entry.destinations.back();
       td.amount = d.amount;
-      td.address = get_account_address_as_str(m_wallet->nettype(), d.is_subaddress, d.addr);
+      td.address = get_account_address_as_str(wallet()->nettype(), d.is_subaddress, d.addr);
     }
 
     entry.type = "out";
     entry.subaddr_index = { pd.m_subaddr_account, 0 };
-    entry.address = m_wallet->get_subaddress_as_str({pd.m_subaddr_account, 0});
+    entry.address = wallet()->get_subaddress_as_str({pd.m_subaddr_account, 0});
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const tools::wallet2::unconfirmed_transfer_details &pd)
@@ -299,10 +476,10 @@ namespace tools
     entry.fee = pd.m_amount_in - pd.m_amount_out;
     entry.amount = pd.m_amount_in - pd.m_change - entry.fee;
     entry.unlock_time = pd.m_tx.unlock_time;
-    entry.note = m_wallet->get_tx_note(txid);
+    entry.note = wallet()->get_tx_note(txid);
     entry.type = is_failed ? "failed" : "pending";
     entry.subaddr_index = { pd.m_subaddr_account, 0 };
-    entry.address = m_wallet->get_subaddress_as_str({pd.m_subaddr_account, 0});
+    entry.address = wallet()->get_subaddress_as_str({pd.m_subaddr_account, 0});
   }
   //------------------------------------------------------------------------------------------------------------------------------
   void wallet_rpc_server::fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &payment_id, const tools::wallet2::pool_payment_details &ppd)
@@ -317,34 +494,35 @@ namespace tools
     entry.amount = pd.m_amount;
     entry.unlock_time = pd.m_unlock_time;
     entry.fee = pd.m_fee;
-    entry.note = m_wallet->get_tx_note(pd.m_tx_hash);
+    entry.note = wallet()->get_tx_note(pd.m_tx_hash);
     entry.double_spend_seen = ppd.m_double_spend_seen;
     entry.type = "pool";
     entry.subaddr_index = pd.m_subaddr_index;
-    entry.address = m_wallet->get_subaddress_as_str(pd.m_subaddr_index);
+    entry.address = wallet()->get_subaddress_as_str(pd.m_subaddr_index);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getbalance(const wallet_rpc::COMMAND_RPC_GET_BALANCE::request& req, wallet_rpc::COMMAND_RPC_GET_BALANCE::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
-      res.balance = m_wallet->balance(req.account_index);
-      res.unlocked_balance = m_wallet->unlocked_balance(req.account_index);
-      res.multisig_import_needed = m_wallet->multisig() && m_wallet->has_multisig_partial_key_images();
-      std::map<uint32_t, uint64_t> balance_per_subaddress = m_wallet->balance_per_subaddress(req.account_index);
-      std::map<uint32_t, uint64_t> unlocked_balance_per_subaddress = m_wallet->unlocked_balance_per_subaddress(req.account_index);
+      res.balance = wallet()->balance(req.account_index);
+      res.unlocked_balance = wallet()->unlocked_balance(req.account_index);
+      res.multisig_import_needed = wallet()->multisig() && wallet()->has_multisig_partial_key_images();
+      std::map<uint32_t, uint64_t> balance_per_subaddress = wallet()->balance_per_subaddress(req.account_index);
+      std::map<uint32_t, uint64_t> unlocked_balance_per_subaddress = wallet()->unlocked_balance_per_subaddress(req.account_index);
       std::vector<tools::wallet2::transfer_details> transfers;
-      m_wallet->get_transfers(transfers);
+      wallet()->get_transfers(transfers);
       for (const auto& i : balance_per_subaddress)
       {
         wallet_rpc::COMMAND_RPC_GET_BALANCE::per_subaddress_info info;
         info.address_index = i.first;
         cryptonote::subaddress_index index = {req.account_index, info.address_index};
-        info.address = m_wallet->get_subaddress_as_str(index);
+        info.address = wallet()->get_subaddress_as_str(index);
         info.balance = i.second;
         info.unlocked_balance = unlocked_balance_per_subaddress[i.first];
-        info.label = m_wallet->get_subaddress_label(index);
+        info.label = wallet()->get_subaddress_label(index);
         info.num_unspent_outputs = std::count_if(transfers.begin(), transfers.end(), [&](const tools::wallet2::transfer_details& td) { return !td.m_spent && td.m_subaddr_index == index; });
         res.per_subaddress.push_back(info);
       }
@@ -359,14 +537,15 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getaddress(const wallet_rpc::COMMAND_RPC_GET_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_GET_ADDRESS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
       res.addresses.clear();
       std::vector<uint32_t> req_address_index;
       if (req.address_index.empty())
       {
-        for (uint32_t i = 0; i < m_wallet->get_num_subaddresses(req.account_index); ++i)
+        for (uint32_t i = 0; i < wallet()->get_num_subaddresses(req.account_index); ++i)
           req_address_index.push_back(i);
       }
       else
@@ -374,18 +553,18 @@ namespace tools
         req_address_index = req.address_index;
       }
       tools::wallet2::transfer_container transfers;
-      m_wallet->get_transfers(transfers);
+      wallet()->get_transfers(transfers);
       for (uint32_t i : req_address_index)
       {
         res.addresses.resize(res.addresses.size() + 1);
         auto& info = res.addresses.back();
         const cryptonote::subaddress_index index = {req.account_index, i};
-        info.address = m_wallet->get_subaddress_as_str(index);
-        info.label = m_wallet->get_subaddress_label(index);
+        info.address = wallet()->get_subaddress_as_str(index);
+        info.label = wallet()->get_subaddress_label(index);
         info.address_index = index.minor;
         info.used = std::find_if(transfers.begin(), transfers.end(), [&](const tools::wallet2::transfer_details& td) { return td.m_subaddr_index == index; }) != transfers.end();
       }
-      res.address = m_wallet->get_subaddress_as_str({req.account_index, 0});
+      res.address = wallet()->get_subaddress_as_str({req.account_index, 0});
     }
     catch (const std::exception& e)
     {
@@ -397,12 +576,13 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_create_address(const wallet_rpc::COMMAND_RPC_CREATE_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_CREATE_ADDRESS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
-      m_wallet->add_subaddress(req.account_index, req.label);
-      res.address_index = m_wallet->get_num_subaddresses(req.account_index) - 1;
-      res.address = m_wallet->get_subaddress_as_str({req.account_index, res.address_index});
+      wallet()->add_subaddress(req.account_index, req.label);
+      res.address_index = wallet()->get_num_subaddresses(req.account_index) - 1;
+      res.address = wallet()->get_subaddress_as_str({req.account_index, res.address_index});
     }
     catch (const std::exception& e)
     {
@@ -414,10 +594,11 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_label_address(const wallet_rpc::COMMAND_RPC_LABEL_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_LABEL_ADDRESS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
-      m_wallet->set_subaddress_label(req.index, req.label);
+      wallet()->set_subaddress_label(req.index, req.label);
     }
     catch (const std::exception& e)
     {
@@ -429,29 +610,30 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_accounts(const wallet_rpc::COMMAND_RPC_GET_ACCOUNTS::request& req, wallet_rpc::COMMAND_RPC_GET_ACCOUNTS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
       res.total_balance = 0;
       res.total_unlocked_balance = 0;
       cryptonote::subaddress_index subaddr_index = {0,0};
-      const std::pair<std::map<std::string, std::string>, std::vector<std::string>> account_tags = m_wallet->get_account_tags();
+      const std::pair<std::map<std::string, std::string>, std::vector<std::string>> account_tags = wallet()->get_account_tags();
       if (!req.tag.empty() && account_tags.first.count(req.tag) == 0)
       {
         er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
         er.message = (boost::format(tr("Tag %s is unregistered.")) % req.tag).str();
         return false;
       }
-      for (; subaddr_index.major < m_wallet->get_num_subaddress_accounts(); ++subaddr_index.major)
+      for (; subaddr_index.major < wallet()->get_num_subaddress_accounts(); ++subaddr_index.major)
       {
         if (!req.tag.empty() && req.tag != account_tags.second[subaddr_index.major])
           continue;
         wallet_rpc::COMMAND_RPC_GET_ACCOUNTS::subaddress_account_info info;
         info.account_index = subaddr_index.major;
-        info.base_address = m_wallet->get_subaddress_as_str(subaddr_index);
-        info.balance = m_wallet->balance(subaddr_index.major);
-        info.unlocked_balance = m_wallet->unlocked_balance(subaddr_index.major);
-        info.label = m_wallet->get_subaddress_label(subaddr_index);
+        info.base_address = wallet()->get_subaddress_as_str(subaddr_index);
+        info.balance = wallet()->balance(subaddr_index.major);
+        info.unlocked_balance = wallet()->unlocked_balance(subaddr_index.major);
+        info.label = wallet()->get_subaddress_label(subaddr_index);
         info.tag = account_tags.second[subaddr_index.major];
         res.subaddress_accounts.push_back(info);
         res.total_balance += info.balance;
@@ -468,12 +650,13 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_create_account(const wallet_rpc::COMMAND_RPC_CREATE_ACCOUNT::request& req, wallet_rpc::COMMAND_RPC_CREATE_ACCOUNT::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
-      m_wallet->add_subaddress_account(req.label);
-      res.account_index = m_wallet->get_num_subaddress_accounts() - 1;
-      res.address = m_wallet->get_subaddress_as_str({res.account_index, 0});
+      wallet()->add_subaddress_account(req.label);
+      res.account_index = wallet()->get_num_subaddress_accounts() - 1;
+      res.address = wallet()->get_subaddress_as_str({res.account_index, 0});
     }
     catch (const std::exception& e)
     {
@@ -485,10 +668,11 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_label_account(const wallet_rpc::COMMAND_RPC_LABEL_ACCOUNT::request& req, wallet_rpc::COMMAND_RPC_LABEL_ACCOUNT::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
-      m_wallet->set_subaddress_label({req.account_index, 0}, req.label);
+      wallet()->set_subaddress_label({req.account_index, 0}, req.label);
     }
     catch (const std::exception& e)
     {
@@ -500,7 +684,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_account_tags(const wallet_rpc::COMMAND_RPC_GET_ACCOUNT_TAGS::request& req, wallet_rpc::COMMAND_RPC_GET_ACCOUNT_TAGS::response& res, epee::json_rpc::error& er)
   {
-    const std::pair<std::map<std::string, std::string>, std::vector<std::string>> account_tags = m_wallet->get_account_tags();
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    const std::pair<std::map<std::string, std::string>, std::vector<std::string>> account_tags = wallet()->get_account_tags();
     for (const std::pair<std::string, std::string>& p : account_tags.first)
     {
       res.account_tags.resize(res.account_tags.size() + 1);
@@ -518,9 +703,10 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_tag_accounts(const wallet_rpc::COMMAND_RPC_TAG_ACCOUNTS::request& req, wallet_rpc::COMMAND_RPC_TAG_ACCOUNTS::response& res, epee::json_rpc::error& er)
   {
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     try
     {
-      m_wallet->set_account_tag(req.accounts, req.tag);
+      wallet()->set_account_tag(req.accounts, req.tag);
     }
     catch (const std::exception& e)
     {
@@ -532,9 +718,10 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_untag_accounts(const wallet_rpc::COMMAND_RPC_UNTAG_ACCOUNTS::request& req, wallet_rpc::COMMAND_RPC_UNTAG_ACCOUNTS::response& res, epee::json_rpc::error& er)
   {
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     try
     {
-      m_wallet->set_account_tag(req.accounts, "");
+      wallet()->set_account_tag(req.accounts, "");
     }
     catch (const std::exception& e)
     {
@@ -546,9 +733,10 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_set_account_tag_description(const wallet_rpc::COMMAND_RPC_SET_ACCOUNT_TAG_DESCRIPTION::request& req, wallet_rpc::COMMAND_RPC_SET_ACCOUNT_TAG_DESCRIPTION::response& res, epee::json_rpc::error& er)
   {
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     try
     {
-      m_wallet->set_account_tag_description(req.tag, req.description);
+      wallet()->set_account_tag_description(req.tag, req.description);
     }
     catch (const std::exception& e)
     {
@@ -560,10 +748,11 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_getheight(const wallet_rpc::COMMAND_RPC_GET_HEIGHT::request& req, wallet_rpc::COMMAND_RPC_GET_HEIGHT::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
-      res.height = m_wallet->get_blockchain_current_height();
+      res.height = wallet()->get_blockchain_current_height();
     }
     catch (const std::exception& e)
     {
@@ -582,7 +771,7 @@ namespace tools
       cryptonote::address_parse_info info;
       cryptonote::tx_destination_entry de;
       er.message = "";
-      if(!get_account_address_from_str_or_url(info, m_wallet->nettype(), it->address,
+      if(!get_account_address_from_str_or_url(info, wallet()->nettype(), it->address,
         [&er](const std::string &url, const std::vector<std::string> &addresses, bool dnssec_valid)->std::string {
           if (!dnssec_valid)
           {
@@ -729,9 +918,9 @@ namespace tools
       fill(fee, ptx.fee);
     }
 
-    if (m_wallet->multisig())
+    if (wallet()->multisig())
     {
-      multisig_txset = epee::string_tools::buff_to_hex_nodelimer(m_wallet->save_multisig_tx(ptx_vector));
+      multisig_txset = epee::string_tools::buff_to_hex_nodelimer(wallet()->save_multisig_tx(ptx_vector));
       if (multisig_txset.empty())
       {
         er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
@@ -742,7 +931,7 @@ namespace tools
     else
     {
       if (!do_not_relay)
-        m_wallet->commit_tx(ptx_vector);
+        wallet()->commit_tx(ptx_vector);
 
       // populate response with tx hashes
       for (auto & ptx : ptx_vector)
@@ -763,13 +952,16 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_transfer(const wallet_rpc::COMMAND_RPC_TRANSFER::request& req, wallet_rpc::COMMAND_RPC_TRANSFER::response& res, epee::json_rpc::error& er)
   {
+    // building the txes only reads the wallet, so readers can go on during
+    // the get_outs round trips; it is made exclusive to mark transfers spent
+    boost::upgrade_lock<boost::shared_mutex> lock(wallet_mutex());
 
     std::vector<cryptonote::tx_destination_entry> dsts;
     std::vector<uint8_t> extra;
 
     LOG_PRINT_L3("on_transfer starts");
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -787,14 +979,14 @@ namespace tools
       uint64_t mixin;
       if(req.ring_size != 0)
       {
-        mixin = m_wallet->adjust_mixin(req.ring_size - 1);
+        mixin = wallet()->adjust_mixin(req.ring_size - 1);
       }
       else
       {
-        mixin = m_wallet->adjust_mixin(req.mixin);
+        mixin = wallet()->adjust_mixin(req.mixin);
       }
-      uint32_t priority = m_wallet->adjust_priority(req.priority);
-      std::vector<wallet2::pending_tx> ptx_vector = m_wallet->create_transactions_2(dsts, mixin, req.unlock_time, priority, extra, req.account_index, req.subaddr_indices, m_trusted_daemon);
+      uint32_t priority = wallet()->adjust_priority(req.priority);
+      std::vector<wallet2::pending_tx> ptx_vector = wallet()->create_transactions_2(dsts, mixin, req.unlock_time, priority, extra, req.account_index, req.subaddr_indices, m_trusted_daemon);
 
       if (ptx_vector.empty())
       {
@@ -811,6 +1003,7 @@ namespace tools
         return false;
       }
 
+      boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
       return fill_response(ptx_vector, req.get_tx_key, res.tx_key, res.amount, res.fee, res.multisig_txset, req.do_not_relay,
           res.tx_hash, req.get_tx_hex, res.tx_blob, req.get_tx_metadata, res.tx_metadata, er);
     }
@@ -824,12 +1017,14 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_transfer_split(const wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::request& req, wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::response& res, epee::json_rpc::error& er)
   {
+    // exclusive only once the txes are built, as in on_transfer
+    boost::upgrade_lock<boost::shared_mutex> lock(wallet_mutex());
 
     std::vector<cryptonote::tx_destination_entry> dsts;
     std::vector<uint8_t> extra;
 
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -847,17 +1042,18 @@ namespace tools
       uint64_t mixin;
       if(req.ring_size != 0)
       {
-        mixin = m_wallet->adjust_mixin(req.ring_size - 1);
+        mixin = wallet()->adjust_mixin(req.ring_size - 1);
       }
       else
       {
-        mixin = m_wallet->adjust_mixin(req.mixin);
+        mixin = wallet()->adjust_mixin(req.mixin);
       }
-      uint32_t priority = m_wallet->adjust_priority(req.priority);
+      uint32_t priority = wallet()->adjust_priority(req.priority);
       LOG_PRINT_L2("on_transfer_split calling create_transactions_2");
-      std::vector<wallet2::pending_tx> ptx_vector = m_wallet->create_transactions_2(dsts, mixin, req.unlock_time, priority, extra, req.account_index, req.subaddr_indices, m_trusted_daemon);
+      std::vector<wallet2::pending_tx> ptx_vector = wallet()->create_transactions_2(dsts, mixin, req.unlock_time, priority, extra, req.account_index, req.subaddr_indices, m_trusted_daemon);
       LOG_PRINT_L2("on_transfer_split called create_transactions_2");
 
+      boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
       return fill_response(ptx_vector, req.get_tx_keys, res.tx_key_list, res.amount_list, res.fee_list, res.multisig_txset, req.do_not_relay,
           res.tx_hash_list, req.get_tx_hex, res.tx_blob_list, req.get_tx_metadata, res.tx_metadata_list, er);
     }
@@ -871,8 +1067,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sweep_dust(const wallet_rpc::COMMAND_RPC_SWEEP_DUST::request& req, wallet_rpc::COMMAND_RPC_SWEEP_DUST::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -881,7 +1078,7 @@ namespace tools
 
     try
     {
-      std::vector<wallet2::pending_tx> ptx_vector = m_wallet->create_unmixable_sweep_transactions(m_trusted_daemon);
+      std::vector<wallet2::pending_tx> ptx_vector = wallet()->create_unmixable_sweep_transactions(m_trusted_daemon);
 
       return fill_response(ptx_vector, req.get_tx_keys, res.tx_key_list, res.amount_list, res.fee_list, res.multisig_txset, req.do_not_relay,
           res.tx_hash_list, req.get_tx_hex, res.tx_blob_list, req.get_tx_metadata, res.tx_metadata_list, er);
@@ -896,11 +1093,12 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sweep_all(const wallet_rpc::COMMAND_RPC_SWEEP_ALL::request& req, wallet_rpc::COMMAND_RPC_SWEEP_ALL::response& res, epee::json_rpc::error& er)
   {
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     std::vector<cryptonote::tx_destination_entry> dsts;
     std::vector<uint8_t> extra;
 
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -922,14 +1120,14 @@ namespace tools
       uint64_t mixin;
       if(req.ring_size != 0)
       {
-        mixin = m_wallet->adjust_mixin(req.ring_size - 1);
+        mixin = wallet()->adjust_mixin(req.ring_size - 1);
       }
       else
       {
-        mixin = m_wallet->adjust_mixin(req.mixin);
+        mixin = wallet()->adjust_mixin(req.mixin);
       }
-      uint32_t priority = m_wallet->adjust_priority(req.priority);
-      std::vector<wallet2::pending_tx> ptx_vector = m_wallet->create_transactions_all(req.below_amount, dsts[0].addr, dsts[0].is_subaddress, mixin, req.unlock_time, priority, extra, req.account_index, req.subaddr_indices, m_trusted_daemon);
+      uint32_t priority = wallet()->adjust_priority(req.priority);
+      std::vector<wallet2::pending_tx> ptx_vector = wallet()->create_transactions_all(req.below_amount, dsts[0].addr, dsts[0].is_subaddress, mixin, req.unlock_time, priority, extra, req.account_index, req.subaddr_indices, m_trusted_daemon);
 
       return fill_response(ptx_vector, req.get_tx_keys, res.tx_key_list, res.amount_list, res.fee_list, res.multisig_txset, req.do_not_relay,
           res.tx_hash_list, req.get_tx_hex, res.tx_blob_list, req.get_tx_metadata, res.tx_metadata_list, er);
@@ -944,11 +1142,12 @@ namespace tools
 //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sweep_single(const wallet_rpc::COMMAND_RPC_SWEEP_SINGLE::request& req, wallet_rpc::COMMAND_RPC_SWEEP_SINGLE::response& res, epee::json_rpc::error& er)
   {
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     std::vector<cryptonote::tx_destination_entry> dsts;
     std::vector<uint8_t> extra;
 
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -978,14 +1177,14 @@ namespace tools
       uint64_t mixin;
       if(req.ring_size != 0)
       {
-        mixin = m_wallet->adjust_mixin(req.ring_size - 1);
+        mixin = wallet()->adjust_mixin(req.ring_size - 1);
       }
       else
       {
-        mixin = m_wallet->adjust_mixin(req.mixin);
+        mixin = wallet()->adjust_mixin(req.mixin);
       }
-      uint32_t priority = m_wallet->adjust_priority(req.priority);
-      std::vector<wallet2::pending_tx> ptx_vector = m_wallet->create_transactions_single(ki, dsts[0].addr, dsts[0].is_subaddress, mixin, req.unlock_time, priority, extra, m_trusted_daemon);
+      uint32_t priority = wallet()->adjust_priority(req.priority);
+      std::vector<wallet2::pending_tx> ptx_vector = wallet()->create_transactions_single(ki, dsts[0].addr, dsts[0].is_subaddress, mixin, req.unlock_time, priority, extra, m_trusted_daemon);
 
       if (ptx_vector.empty())
       {
@@ -1026,7 +1225,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_relay_tx(const wallet_rpc::COMMAND_RPC_RELAY_TX::request& req, wallet_rpc::COMMAND_RPC_RELAY_TX::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     cryptonote::blobdata blob;
     if (!epee::string_tools::parse_hexstr_to_binbuff(req.hex, blob))
@@ -1052,7 +1252,7 @@ namespace tools
 
     try
     {
-      m_wallet->commit_tx(ptx);
+      wallet()->commit_tx(ptx);
     }
     catch(const std::exception &e)
     {
@@ -1068,7 +1268,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_make_integrated_address(const wallet_rpc::COMMAND_RPC_MAKE_INTEGRATED_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_MAKE_INTEGRATED_ADDRESS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
       crypto::hash8 payment_id;
@@ -1086,7 +1287,7 @@ namespace tools
         }
       }
 
-      res.integrated_address = m_wallet->get_integrated_address_as_str(payment_id);
+      res.integrated_address = wallet()->get_integrated_address_as_str(payment_id);
       res.payment_id = epee::string_tools::pod_to_hex(payment_id);
       return true;
     }
@@ -1100,12 +1301,13 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_split_integrated_address(const wallet_rpc::COMMAND_RPC_SPLIT_INTEGRATED_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_SPLIT_INTEGRATED_ADDRESS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
       cryptonote::address_parse_info info;
 
-      if(!get_account_address_from_str(info, m_wallet->nettype(), req.integrated_address))
+      if(!get_account_address_from_str(info, wallet()->nettype(), req.integrated_address))
       {
         er.code = WALLET_RPC_ERROR_CODE_WRONG_ADDRESS;
         er.message = "Invalid address";
@@ -1117,7 +1319,7 @@ namespace tools
         er.message = "Address is not an integrated address";
         return false;
       }
-      res.standard_address = get_account_address_as_str(m_wallet->nettype(), info.is_subaddress, info.address);
+      res.standard_address = get_account_address_as_str(wallet()->nettype(), info.is_subaddress, info.address);
       res.payment_id = epee::string_tools::pod_to_hex(info.payment_id);
       return true;
     }
@@ -1131,8 +1333,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_store(const wallet_rpc::COMMAND_RPC_STORE::request& req, wallet_rpc::COMMAND_RPC_STORE::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -1141,7 +1344,7 @@ namespace tools
 
     try
     {
-      m_wallet->store();
+      wallet()->store();
     }
     catch (const std::exception& e)
     {
@@ -1153,7 +1356,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_payments(const wallet_rpc::COMMAND_RPC_GET_PAYMENTS::request& req, wallet_rpc::COMMAND_RPC_GET_PAYMENTS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     crypto::hash payment_id;
     crypto::hash8 payment_id8;
     cryptonote::blobdata payment_id_blob;
@@ -1183,7 +1387,7 @@ namespace tools
 
     res.payments.clear();
     std::list<wallet2::payment_details> payment_list;
-    m_wallet->get_payments(payment_id, payment_list);
+    wallet()->get_payments(payment_id, payment_list);
     for (auto & payment : payment_list)
     {
       wallet_rpc::payment_details rpc_payment;
@@ -1193,7 +1397,7 @@ namespace tools
       rpc_payment.block_height = payment.m_block_height;
       rpc_payment.unlock_time  = payment.m_unlock_time;
       rpc_payment.subaddr_index = payment.m_subaddr_index;
-      rpc_payment.address      = m_wallet->get_subaddress_as_str(payment.m_subaddr_index);
+      rpc_payment.address      = wallet()->get_subaddress_as_str(payment.m_subaddr_index);
       res.payments.push_back(rpc_payment);
     }
 
@@ -1202,14 +1406,24 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_bulk_payments(const wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::request& req, wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::response& res, epee::json_rpc::error& er)
   {
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
     res.payments.clear();
-    if (!m_wallet) return not_open(er);
+    if (!wallet()) return not_open(er);
+
+    // most payments go to a handful of subaddresses, so only encode each once
+    std::unordered_map<cryptonote::subaddress_index, std::string> addresses;
+    auto get_address = [this, &addresses](const cryptonote::subaddress_index &index) -> const std::string& {
+      auto i = addresses.find(index);
+      if (i == addresses.end())
+        i = addresses.emplace(index, wallet()->get_subaddress_as_str(index)).first;
+      return i->second;
+    };
 
     /* If the payment ID list is empty, we get payments to any payment ID (or lack thereof) */
     if (req.payment_ids.empty())
     {
       std::list<std::pair<crypto::hash,wallet2::payment_details>> payment_list;
-      m_wallet->get_payments(payment_list, req.min_block_height);
+      wallet()->get_payments(payment_list, req.min_block_height);
 
       for (auto & payment : payment_list)
       {
@@ -1220,7 +1434,7 @@ namespace tools
         rpc_payment.block_height = payment.second.m_block_height;
         rpc_payment.unlock_time  = payment.second.m_unlock_time;
         rpc_payment.subaddr_index = payment.second.m_subaddr_index;
-        rpc_payment.address      = m_wallet->get_subaddress_as_str(payment.second.m_subaddr_index);
+        rpc_payment.address      = get_address(payment.second.m_subaddr_index);
         res.payments.push_back(std::move(rpc_payment));
       }
 
@@ -1260,7 +1474,7 @@ namespace tools
       }
 
       std::list<wallet2::payment_details> payment_list;
-      m_wallet->get_payments(payment_id, payment_list, req.min_block_height);
+      wallet()->get_payments(payment_id, payment_list, req.min_block_height);
 
       for (auto & payment : payment_list)
       {
@@ -1271,7 +1485,7 @@ namespace tools
         rpc_payment.block_height = payment.m_block_height;
         rpc_payment.unlock_time  = payment.m_unlock_time;
         rpc_payment.subaddr_index = payment.m_subaddr_index;
-        rpc_payment.address      = m_wallet->get_subaddress_as_str(payment.m_subaddr_index);
+        rpc_payment.address      = get_address(payment.m_subaddr_index);
         res.payments.push_back(std::move(rpc_payment));
       }
     }
@@ -1281,7 +1495,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_incoming_transfers(const wallet_rpc::COMMAND_RPC_INCOMING_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_INCOMING_TRANSFERS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     if(req.transfer_type.compare("all") != 0 && req.transfer_type.compare("available") != 0 && req.transfer_type.compare("unavailable") != 0)
     {
       er.code = WALLET_RPC_ERROR_CODE_TRANSFER_TYPE;
@@ -1303,7 +1518,7 @@ namespace tools
     }
 
     wallet2::transfer_container transfers;
-    m_wallet->get_transfers(transfers);
+    wallet()->get_transfers(transfers);
 
     bool transfers_found = false;
     for (const auto& td : transfers)
@@ -1334,8 +1549,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_query_key(const wallet_rpc::COMMAND_RPC_QUERY_KEY::request& req, wallet_rpc::COMMAND_RPC_QUERY_KEY::response& res, epee::json_rpc::error& er)
   {
-      if (!m_wallet) return not_open(er);
-      if (m_wallet->restricted())
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+      if (!wallet()) return not_open(er);
+      if (wallet()->restricted())
       {
         er.code = WALLET_RPC_ERROR_CODE_DENIED;
         er.message = "Command unavailable in restricted mode.";
@@ -1344,7 +1560,7 @@ namespace tools
 
       if (req.key_type.compare("mnemonic") == 0)
       {
-        if (!m_wallet->get_seed(res.key))
+        if (!wallet()->get_seed(res.key))
         {
             er.message = "The wallet is non-deterministic. Cannot display seed.";
             return false;
@@ -1352,11 +1568,11 @@ namespace tools
       }
       else if(req.key_type.compare("view_key") == 0)
       {
-          res.key = string_tools::pod_to_hex(m_wallet->get_account().get_keys().m_view_secret_key);
+          res.key = string_tools::pod_to_hex(wallet()->get_account().get_keys().m_view_secret_key);
       }
       else if(req.key_type.compare("spend_key") == 0)
       {
-          res.key = string_tools::pod_to_hex(m_wallet->get_account().get_keys().m_spend_secret_key);
+          res.key = string_tools::pod_to_hex(wallet()->get_account().get_keys().m_spend_secret_key);
       }
       else
       {
@@ -1369,8 +1585,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_rescan_blockchain(const wallet_rpc::COMMAND_RPC_RESCAN_BLOCKCHAIN::request& req, wallet_rpc::COMMAND_RPC_RESCAN_BLOCKCHAIN::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -1379,7 +1596,7 @@ namespace tools
 
     try
     {
-      m_wallet->rescan_blockchain();
+      wallet()->rescan_blockchain();
     }
     catch (const std::exception& e)
     {
@@ -1391,22 +1608,24 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sign(const wallet_rpc::COMMAND_RPC_SIGN::request& req, wallet_rpc::COMMAND_RPC_SIGN::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
       return false;
     }
 
-    res.signature = m_wallet->sign(req.data);
+    res.signature = wallet()->sign(req.data);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_verify(const wallet_rpc::COMMAND_RPC_VERIFY::request& req, wallet_rpc::COMMAND_RPC_VERIFY::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -1415,7 +1634,7 @@ namespace tools
 
     cryptonote::address_parse_info info;
     er.message = "";
-    if(!get_account_address_from_str_or_url(info, m_wallet->nettype(), req.address,
+    if(!get_account_address_from_str_or_url(info, wallet()->nettype(), req.address,
       [&er](const std::string &url, const std::vector<std::string> &addresses, bool dnssec_valid)->std::string {
         if (!dnssec_valid)
         {
@@ -1434,14 +1653,15 @@ namespace tools
       return false;
     }
 
-    res.good = m_wallet->verify(req.data, info.address, req.signature);
+    res.good = wallet()->verify(req.data, info.address, req.signature);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_stop_wallet(const wallet_rpc::COMMAND_RPC_STOP_WALLET::request& req, wallet_rpc::COMMAND_RPC_STOP_WALLET::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -1450,21 +1670,32 @@ namespace tools
 
     try
     {
-      m_wallet->store();
-      m_stop.store(true, std::memory_order_relaxed);
+      wallet()->store();
+      if (current_hosted)
+      {
+        // a hosted wallet is closed, the server keeps running
+        current_hosted->wallet.reset();
+      }
+      else
+        m_stop.store(true, std::memory_order_relaxed);
     }
     catch (const std::exception& e)
     {
       handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
       return false;
     }
+    // stop takes the map lock before the wallet's
+    lock.unlock();
+    if (current_hosted)
+      unhost_wallet(current_hosted);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_set_tx_notes(const wallet_rpc::COMMAND_RPC_SET_TX_NOTES::request& req, wallet_rpc::COMMAND_RPC_SET_TX_NOTES::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -1498,7 +1729,7 @@ namespace tools
     std::list<std::string>::const_iterator in = req.notes.begin();
     while (il != txids.end())
     {
-      m_wallet->set_tx_note(*il++, *in++);
+      wallet()->set_tx_note(*il++, *in++);
     }
 
     return true;
@@ -1506,8 +1737,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_tx_notes(const wallet_rpc::COMMAND_RPC_GET_TX_NOTES::request& req, wallet_rpc::COMMAND_RPC_GET_TX_NOTES::response& res, epee::json_rpc::error& er)
   {
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
     res.notes.clear();
-    if (!m_wallet) return not_open(er);
+    if (!wallet()) return not_open(er);
 
     std::list<crypto::hash> txids;
     std::list<std::string>::const_iterator i = req.txids.begin();
@@ -1528,42 +1760,45 @@ namespace tools
     std::list<crypto::hash>::const_iterator il = txids.begin();
     while (il != txids.end())
     {
-      res.notes.push_back(m_wallet->get_tx_note(*il++));
+      res.notes.push_back(wallet()->get_tx_note(*il++));
     }
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_set_attribute(const wallet_rpc::COMMAND_RPC_SET_ATTRIBUTE::request& req, wallet_rpc::COMMAND_RPC_SET_ATTRIBUTE::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
       return false;
     }
 
-    m_wallet->set_attribute(req.key, req.value);
+    wallet()->set_attribute(req.key, req.value);
 
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_attribute(const wallet_rpc::COMMAND_RPC_GET_ATTRIBUTE::request& req, wallet_rpc::COMMAND_RPC_GET_ATTRIBUTE::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
       return false;
     }
 
-    res.value = m_wallet->get_attribute(req.key);
+    res.value = wallet()->get_attribute(req.key);
     return true;
   }
   bool wallet_rpc_server::on_get_tx_key(const wallet_rpc::COMMAND_RPC_GET_TX_KEY::request& req, wallet_rpc::COMMAND_RPC_GET_TX_KEY::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     crypto::hash txid;
     if (!epee::string_tools::hex_to_pod(req.txid, txid))
@@ -1575,7 +1810,7 @@ namespace tools
 
     crypto::secret_key tx_key;
     std::vector<crypto::secret_key> additional_tx_keys;
-    if (!m_wallet->get_tx_key(txid, tx_key, additional_tx_keys))
+    if (!wallet()->get_tx_key(txid, tx_key, additional_tx_keys))
     {
       er.code = WALLET_RPC_ERROR_CODE_NO_TXKEY;
       er.message = "No tx secret key is stored for this tx";
@@ -1592,7 +1827,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_check_tx_key(const wallet_rpc::COMMAND_RPC_CHECK_TX_KEY::request& req, wallet_rpc::COMMAND_RPC_CHECK_TX_KEY::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     crypto::hash txid;
     if (!epee::string_tools::hex_to_pod(req.txid, txid))
@@ -1625,7 +1861,7 @@ namespace tools
     }
 
     cryptonote::address_parse_info info;
-    if(!get_account_address_from_str(info, m_wallet->nettype(), req.address))
+    if(!get_account_address_from_str(info, wallet()->nettype(), req.address))
     {
       er.code = WALLET_RPC_ERROR_CODE_WRONG_ADDRESS;
       er.message = "Invalid address";
@@ -1634,7 +1870,7 @@ namespace tools
 
     try
     {
-      m_wallet->check_tx_key(txid, tx_key, additional_tx_keys, info.address, res.received, res.in_pool, res.confirmations);
+      wallet()->check_tx_key(txid, tx_key, additional_tx_keys, info.address, res.received, res.in_pool, res.confirmations);
     }
     catch (const std::exception &e)
     {
@@ -1647,7 +1883,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_tx_proof(const wallet_rpc::COMMAND_RPC_GET_TX_PROOF::request& req, wallet_rpc::COMMAND_RPC_GET_TX_PROOF::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     crypto::hash txid;
     if (!epee::string_tools::hex_to_pod(req.txid, txid))
@@ -1658,7 +1895,7 @@ namespace tools
     }
 
     cryptonote::address_parse_info info;
-    if(!get_account_address_from_str(info, m_wallet->nettype(), req.address))
+    if(!get_account_address_from_str(info, wallet()->nettype(), req.address))
     {
       er.code = WALLET_RPC_ERROR_CODE_WRONG_ADDRESS;
       er.message = "Invalid address";
@@ -1667,7 +1904,7 @@ namespace tools
 
     try
     {
-      res.signature = m_wallet->get_tx_proof(txid, info.address, info.is_subaddress, req.message);
+      res.signature = wallet()->get_tx_proof(txid, info.address, info.is_subaddress, req.message);
     }
     catch (const std::exception &e)
     {
@@ -1680,7 +1917,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_check_tx_proof(const wallet_rpc::COMMAND_RPC_CHECK_TX_PROOF::request& req, wallet_rpc::COMMAND_RPC_CHECK_TX_PROOF::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     crypto::hash txid;
     if (!epee::string_tools::hex_to_pod(req.txid, txid))
@@ -1691,7 +1929,7 @@ namespace tools
     }
 
     cryptonote::address_parse_info info;
-    if(!get_account_address_from_str(info, m_wallet->nettype(), req.address))
+    if(!get_account_address_from_str(info, wallet()->nettype(), req.address))
     {
       er.code = WALLET_RPC_ERROR_CODE_WRONG_ADDRESS;
       er.message = "Invalid address";
@@ -1703,7 +1941,7 @@ namespace tools
       uint64_t received;
       bool in_pool;
       uint64_t confirmations;
-      res.good = m_wallet->check_tx_proof(txid, info.address, info.is_subaddress, req.message, req.signature, res.received, res.in_pool, res.confirmations);
+      res.good = wallet()->check_tx_proof(txid, info.address, info.is_subaddress, req.message, req.signature, res.received, res.in_pool, res.confirmations);
     }
     catch (const std::exception &e)
     {
@@ -1716,7 +1954,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_spend_proof(const wallet_rpc::COMMAND_RPC_GET_SPEND_PROOF::request& req, wallet_rpc::COMMAND_RPC_GET_SPEND_PROOF::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     crypto::hash txid;
     if (!epee::string_tools::hex_to_pod(req.txid, txid))
@@ -1728,7 +1967,7 @@ namespace tools
 
     try
     {
-      res.signature = m_wallet->get_spend_proof(txid, req.message);
+      res.signature = wallet()->get_spend_proof(txid, req.message);
     }
     catch (const std::exception &e)
     {
@@ -1741,7 +1980,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_check_spend_proof(const wallet_rpc::COMMAND_RPC_CHECK_SPEND_PROOF::request& req, wallet_rpc::COMMAND_RPC_CHECK_SPEND_PROOF::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     crypto::hash txid;
     if (!epee::string_tools::hex_to_pod(req.txid, txid))
@@ -1753,7 +1993,7 @@ namespace tools
 
     try
     {
-      res.good = m_wallet->check_spend_proof(txid, req.message, req.signature);
+      res.good = wallet()->check_spend_proof(txid, req.message, req.signature);
     }
     catch (const std::exception &e)
     {
@@ -1766,12 +2006,13 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_reserve_proof(const wallet_rpc::COMMAND_RPC_GET_RESERVE_PROOF::request& req, wallet_rpc::COMMAND_RPC_GET_RESERVE_PROOF::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     boost::optional<std::pair<uint32_t, uint64_t>> account_minreserve;
     if (!req.all)
     {
-      if (req.account_index >= m_wallet->get_num_subaddress_accounts())
+      if (req.account_index >= wallet()->get_num_subaddress_accounts())
       {
         er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
         er.message = "Account index is out of bound";
@@ -1782,7 +2023,7 @@ namespace tools
 
     try
     {
-      res.signature = m_wallet->get_reserve_proof(account_minreserve, req.message);
+      res.signature = wallet()->get_reserve_proof(account_minreserve, req.message);
     }
     catch (const std::exception &e)
     {
@@ -1795,10 +2036,11 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_check_reserve_proof(const wallet_rpc::COMMAND_RPC_CHECK_RESERVE_PROOF::request& req, wallet_rpc::COMMAND_RPC_CHECK_RESERVE_PROOF::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
 
     cryptonote::address_parse_info info;
-    if (!get_account_address_from_str(info, m_wallet->nettype(), req.address))
+    if (!get_account_address_from_str(info, wallet()->nettype(), req.address))
     {
       er.code = WALLET_RPC_ERROR_CODE_WRONG_ADDRESS;
       er.message = "Invalid address";
@@ -1813,7 +2055,7 @@ namespace tools
 
     try
     {
-      res.good = m_wallet->check_reserve_proof(info.address, req.message, req.signature, res.total, res.spent);
+      res.good = wallet()->check_reserve_proof(info.address, req.message, req.signature, res.total, res.spent);
     }
     catch (const std::exception &e)
     {
@@ -1826,8 +2068,15 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    // only the pool query updates the wallet
+    boost::shared_lock<boost::shared_mutex> shared_lock(wallet_mutex(), boost::defer_lock);
+    boost::unique_lock<boost::shared_mutex> unique_lock(wallet_mutex(), boost::defer_lock);
+    if (req.pool)
+      unique_lock.lock();
+    else
+      shared_lock.lock();
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -1844,7 +2093,7 @@ namespace tools
     if (req.in)
     {
       std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-      m_wallet->get_payments(payments, min_height, max_height, req.account_index, req.subaddr_indices);
+      wallet()->get_payments(payments, min_height, max_height, req.account_index, req.subaddr_indices);
       for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.in.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.in.back(), i->second.m_tx_hash, i->first, i->second);
@@ -1854,7 +2103,7 @@ namespace tools
     if (req.out)
     {
       std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments;
-      m_wallet->get_payments_out(payments, min_height, max_height, req.account_index, req.subaddr_indices);
+      wallet()->get_payments_out(payments, min_height, max_height, req.account_index, req.subaddr_indices);
       for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.out.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.out.back(), i->first, i->second);
@@ -1863,7 +2112,7 @@ namespace tools
 
     if (req.pending || req.failed) {
       std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments;
-      m_wallet->get_unconfirmed_payments_out(upayments, req.account_index, req.subaddr_indices);
+      wallet()->get_unconfirmed_payments_out(upayments, req.account_index, req.subaddr_indices);
       for (std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>>::const_iterator i = upayments.begin(); i != upayments.end(); ++i) {
         const tools::wallet2::unconfirmed_transfer_details &pd = i->second;
         bool is_failed = pd.m_state == tools::wallet2::unconfirmed_transfer_details::failed;
@@ -1877,10 +2126,10 @@ namespace tools
 
     if (req.pool)
     {
-      m_wallet->update_pool_state();
+      wallet()->update_pool_state();
 
       std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>> payments;
-      m_wallet->get_unconfirmed_payments(payments, req.account_index, req.subaddr_indices);
+      wallet()->get_unconfirmed_payments(payments, req.account_index, req.subaddr_indices);
       for (std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
         res.pool.push_back(wallet_rpc::transfer_entry());
         fill_transfer_entry(res.pool.back(), i->first, i->second);
@@ -1892,8 +2141,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_transfer_by_txid(const wallet_rpc::COMMAND_RPC_GET_TRANSFER_BY_TXID::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFER_BY_TXID::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -1920,7 +2170,7 @@ namespace tools
       return false;
     }
 
-    if (req.account_index >= m_wallet->get_num_subaddress_accounts())
+    if (req.account_index >= wallet()->get_num_subaddress_accounts())
     {
       er.code = WALLET_RPC_ERROR_CODE_ACCOUNT_INDEX_OUT_OF_BOUNDS;
       er.message = "Account index is out of bound";
@@ -1928,7 +2178,7 @@ namespace tools
     }
 
     std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> payments;
-    m_wallet->get_payments(payments, 0, (uint64_t)-1, req.account_index);
+    wallet()->get_payments(payments, 0, (uint64_t)-1, req.account_index);
     for (std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>::const_iterator i = payments.begin(); i != payments.end(); ++i) {
       if (i->second.m_tx_hash == txid)
       {
@@ -1938,7 +2188,7 @@ namespace tools
     }
 
     std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> payments_out;
-    m_wallet->get_payments_out(payments_out, 0, (uint64_t)-1, req.account_index);
+    wallet()->get_payments_out(payments_out, 0, (uint64_t)-1, req.account_index);
     for (std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>::const_iterator i = payments_out.begin(); i != payments_out.end(); ++i) {
       if (i->first == txid)
       {
@@ -1948,7 +2198,7 @@ namespace tools
     }
 
     std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> upayments;
-    m_wallet->get_unconfirmed_payments_out(upayments, req.account_index);
+    wallet()->get_unconfirmed_payments_out(upayments, req.account_index);
     for (std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>>::const_iterator i = upayments.begin(); i != upayments.end(); ++i) {
       if (i->first == txid)
       {
@@ -1957,10 +2207,10 @@ namespace tools
       }
     }
 
-    m_wallet->update_pool_state();
+    wallet()->update_pool_state();
 
     std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>> pool_payments;
-    m_wallet->get_unconfirmed_payments(pool_payments, req.account_index);
+    wallet()->get_unconfirmed_payments(pool_payments, req.account_index);
     for (std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>>::const_iterator i = pool_payments.begin(); i != pool_payments.end(); ++i) {
       if (i->second.m_pd.m_tx_hash == txid)
       {
@@ -1976,10 +2226,11 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_export_key_images(const wallet_rpc::COMMAND_RPC_EXPORT_KEY_IMAGES::request& req, wallet_rpc::COMMAND_RPC_EXPORT_KEY_IMAGES::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     try
     {
-      std::vector<std::pair<crypto::key_image, crypto::signature>> ski = m_wallet->export_key_images();
+      std::vector<std::pair<crypto::key_image, crypto::signature>> ski = wallet()->export_key_images();
       res.signed_key_images.resize(ski.size());
       for (size_t n = 0; n < ski.size(); ++n)
       {
@@ -1999,8 +2250,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_import_key_images(const wallet_rpc::COMMAND_RPC_IMPORT_KEY_IMAGES::request& req, wallet_rpc::COMMAND_RPC_IMPORT_KEY_IMAGES::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -2037,7 +2289,7 @@ namespace tools
         ski[n].second = *reinterpret_cast<const crypto::signature*>(bd.data());
       }
       uint64_t spent = 0, unspent = 0;
-      uint64_t height = m_wallet->import_key_images(ski, spent, unspent);
+      uint64_t height = wallet()->import_key_images(ski, spent, unspent);
       res.spent = spent;
       res.unspent = unspent;
       res.height = height;
@@ -2054,8 +2306,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_make_uri(const wallet_rpc::COMMAND_RPC_MAKE_URI::request& req, wallet_rpc::COMMAND_RPC_MAKE_URI::response& res, epee::json_rpc::error& er)
   {
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
     std::string error;
-    std::string uri = m_wallet->make_uri(req.address, req.payment_id, req.amount, req.tx_description, req.recipient_name, error);
+    std::string uri = wallet()->make_uri(req.address, req.payment_id, req.amount, req.tx_description, req.recipient_name, error);
     if (uri.empty())
     {
       er.code = WALLET_RPC_ERROR_CODE_WRONG_URI;
@@ -2069,9 +2322,10 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_parse_uri(const wallet_rpc::COMMAND_RPC_PARSE_URI::request& req, wallet_rpc::COMMAND_RPC_PARSE_URI::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     std::string error;
-    if (!m_wallet->parse_uri(req.uri, res.uri.address, res.uri.payment_id, res.uri.amount, res.uri.tx_description, res.uri.recipient_name, res.unknown_parameters, error))
+    if (!wallet()->parse_uri(req.uri, res.uri.address, res.uri.payment_id, res.uri.amount, res.uri.tx_description, res.uri.recipient_name, res.unknown_parameters, error))
     {
       er.code = WALLET_RPC_ERROR_CODE_WRONG_URI;
       er.message = "Error parsing URI: " + error;
@@ -2082,13 +2336,14 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_address_book(const wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY::request& req, wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    const auto ab = m_wallet->get_address_book();
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    const auto ab = wallet()->get_address_book();
     if (req.entries.empty())
     {
       uint64_t idx = 0;
       for (const auto &entry: ab)
-        res.entries.push_back(wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY::entry{idx++, get_account_address_as_str(m_wallet->nettype(), entry.m_is_subaddress, entry.m_address), epee::string_tools::pod_to_hex(entry.m_payment_id), entry.m_description});
+        res.entries.push_back(wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY::entry{idx++, get_account_address_as_str(wallet()->nettype(), entry.m_is_subaddress, entry.m_address), epee::string_tools::pod_to_hex(entry.m_payment_id), entry.m_description});
     }
     else
     {
@@ -2101,7 +2356,7 @@ namespace tools
           return false;
         }
         const auto &entry = ab[idx];
-        res.entries.push_back(wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY::entry{idx, get_account_address_as_str(m_wallet->nettype(), entry.m_is_subaddress, entry.m_address), epee::string_tools::pod_to_hex(entry.m_payment_id), entry.m_description});
+        res.entries.push_back(wallet_rpc::COMMAND_RPC_GET_ADDRESS_BOOK_ENTRY::entry{idx, get_account_address_as_str(wallet()->nettype(), entry.m_is_subaddress, entry.m_address), epee::string_tools::pod_to_hex(entry.m_payment_id), entry.m_description});
       }
     }
     return true;
@@ -2109,8 +2364,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_add_address_book(const wallet_rpc::COMMAND_RPC_ADD_ADDRESS_BOOK_ENTRY::request& req, wallet_rpc::COMMAND_RPC_ADD_ADDRESS_BOOK_ENTRY::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -2120,7 +2376,7 @@ namespace tools
     cryptonote::address_parse_info info;
     crypto::hash payment_id = crypto::null_hash;
     er.message = "";
-    if(!get_account_address_from_str_or_url(info, m_wallet->nettype(), req.address,
+    if(!get_account_address_from_str_or_url(info, wallet()->nettype(), req.address,
       [&er](const std::string &url, const std::vector<std::string> &addresses, bool dnssec_valid)->std::string {
         if (!dnssec_valid)
         {
@@ -2172,34 +2428,35 @@ namespace tools
         }
       }
     }
-    if (!m_wallet->add_address_book_row(info.address, payment_id, req.description, info.is_subaddress))
+    if (!wallet()->add_address_book_row(info.address, payment_id, req.description, info.is_subaddress))
     {
       er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
       er.message = "Failed to add address book entry";
       return false;
     }
-    res.index = m_wallet->get_address_book().size() - 1;
+    res.index = wallet()->get_address_book().size() - 1;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_delete_address_book(const wallet_rpc::COMMAND_RPC_DELETE_ADDRESS_BOOK_ENTRY::request& req, wallet_rpc::COMMAND_RPC_DELETE_ADDRESS_BOOK_ENTRY::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
       return false;
     }
 
-    const auto ab = m_wallet->get_address_book();
+    const auto ab = wallet()->get_address_book();
     if (req.index >= ab.size())
     {
       er.code = WALLET_RPC_ERROR_CODE_WRONG_INDEX;
       er.message = "Index out of range: " + std::to_string(req.index);
       return false;
     }
-    if (!m_wallet->delete_address_book_row(req.index))
+    if (!wallet()->delete_address_book_row(req.index))
     {
       er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
       er.message = "Failed to delete address book entry";
@@ -2210,8 +2467,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_rescan_spent(const wallet_rpc::COMMAND_RPC_RESCAN_SPENT::request& req, wallet_rpc::COMMAND_RPC_RESCAN_SPENT::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -2219,7 +2477,7 @@ namespace tools
     }
     try
     {
-      m_wallet->rescan_spent();
+      wallet()->rescan_spent();
       return true;
     }
     catch (const std::exception& e)
@@ -2232,7 +2490,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_start_mining(const wallet_rpc::COMMAND_RPC_START_MINING::request& req, wallet_rpc::COMMAND_RPC_START_MINING::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
     if (!m_trusted_daemon)
     {
       er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
@@ -2249,13 +2508,13 @@ namespace tools
     }
 
     cryptonote::COMMAND_RPC_START_MINING::request daemon_req = AUTO_VAL_INIT(daemon_req); 
-    daemon_req.miner_address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
+    daemon_req.miner_address = wallet()->get_account().get_public_address_str(wallet()->nettype());
     daemon_req.threads_count        = req.threads_count;
     daemon_req.do_background_mining = req.do_background_mining;
     daemon_req.ignore_battery       = req.ignore_battery;
 
     cryptonote::COMMAND_RPC_START_MINING::response daemon_res;
-    bool r = m_wallet->invoke_http_json("/start_mining", daemon_req, daemon_res);
+    bool r = wallet()->invoke_http_json("/start_mining", daemon_req, daemon_res);
     if (!r || daemon_res.status != CORE_RPC_STATUS_OK)
     {
       er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
@@ -2267,9 +2526,10 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_stop_mining(const wallet_rpc::COMMAND_RPC_STOP_MINING::request& req, wallet_rpc::COMMAND_RPC_STOP_MINING::response& res, epee::json_rpc::error& er)
   {
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     cryptonote::COMMAND_RPC_STOP_MINING::request daemon_req;
     cryptonote::COMMAND_RPC_STOP_MINING::response daemon_res;
-    bool r = m_wallet->invoke_http_json("/stop_mining", daemon_req, daemon_res);
+    bool r = wallet()->invoke_http_json("/stop_mining", daemon_req, daemon_res);
     if (!r || daemon_res.status != CORE_RPC_STATUS_OK)
     {
       er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
@@ -2287,6 +2547,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_create_wallet(const wallet_rpc::COMMAND_RPC_CREATE_WALLET::request& req, wallet_rpc::COMMAND_RPC_CREATE_WALLET::response& res, epee::json_rpc::error& er)
   {
+    if (is_hosted()) return not_hosted(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     if (m_wallet_dir.empty())
     {
       er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
@@ -2366,6 +2628,8 @@ namespace tools
       er.message = "Failed to generate wallet";
       return false;
     }
+    if (m_multi_wallet)
+      return host_wallet(req.filename, std::move(wal), er);
     if (m_wallet)
       delete m_wallet;
     m_wallet = wal.release();
@@ -2374,6 +2638,8 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_open_wallet(const wallet_rpc::COMMAND_RPC_OPEN_WALLET::request& req, wallet_rpc::COMMAND_RPC_OPEN_WALLET::response& res, epee::json_rpc::error& er)
   {
+    if (is_hosted()) return not_hosted(er);
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
     if (m_wallet_dir.empty())
     {
       er.code = WALLET_RPC_ERROR_CODE_NO_WALLET_DIR;
@@ -2424,6 +2690,8 @@ namespace tools
       er.message = "Failed to open wallet";
       return false;
     }
+    if (m_multi_wallet)
+      return host_wallet(req.filename, std::move(wal), er);
     if (m_wallet)
       delete m_wallet;
     m_wallet = wal.release();
@@ -2509,53 +2777,56 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_is_multisig(const wallet_rpc::COMMAND_RPC_IS_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_IS_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    res.multisig = m_wallet->multisig(&res.ready, &res.threshold, &res.total);
+    boost::shared_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    res.multisig = wallet()->multisig(&res.ready, &res.threshold, &res.total);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_prepare_multisig(const wallet_rpc::COMMAND_RPC_PREPARE_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_PREPARE_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
       return false;
     }
-    if (m_wallet->multisig())
+    if (wallet()->multisig())
     {
       er.code = WALLET_RPC_ERROR_CODE_ALREADY_MULTISIG;
       er.message = "This wallet is already multisig";
       return false;
     }
-    if (m_wallet->watch_only())
+    if (wallet()->watch_only())
     {
       er.code = WALLET_RPC_ERROR_CODE_WATCH_ONLY;
       er.message = "wallet is watch-only and cannot be made multisig";
       return false;
     }
 
-    res.multisig_info = m_wallet->get_multisig_info();
+    res.multisig_info = wallet()->get_multisig_info();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_make_multisig(const wallet_rpc::COMMAND_RPC_MAKE_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_MAKE_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
       return false;
     }
-    if (m_wallet->multisig())
+    if (wallet()->multisig())
     {
       er.code = WALLET_RPC_ERROR_CODE_ALREADY_MULTISIG;
       er.message = "This wallet is already multisig";
       return false;
     }
-    if (m_wallet->watch_only())
+    if (wallet()->watch_only())
     {
       er.code = WALLET_RPC_ERROR_CODE_WATCH_ONLY;
       er.message = "wallet is watch-only and cannot be made multisig";
@@ -2564,8 +2835,8 @@ namespace tools
 
     try
     {
-      res.multisig_info = m_wallet->make_multisig(req.password, req.multisig_info, req.threshold);
-      res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
+      res.multisig_info = wallet()->make_multisig(req.password, req.multisig_info, req.threshold);
+      res.address = wallet()->get_account().get_public_address_str(wallet()->nettype());
     }
     catch (const std::exception &e)
     {
@@ -2579,15 +2850,16 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_export_multisig(const wallet_rpc::COMMAND_RPC_EXPORT_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_EXPORT_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
       return false;
     }
     bool ready;
-    if (!m_wallet->multisig(&ready))
+    if (!wallet()->multisig(&ready))
     {
       er.code = WALLET_RPC_ERROR_CODE_NOT_MULTISIG;
       er.message = "This wallet is not multisig";
@@ -2603,7 +2875,7 @@ namespace tools
     cryptonote::blobdata info;
     try
     {
-      info = m_wallet->export_multisig();
+      info = wallet()->export_multisig();
     }
     catch (const std::exception &e)
     {
@@ -2619,8 +2891,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_import_multisig(const wallet_rpc::COMMAND_RPC_IMPORT_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_IMPORT_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -2628,7 +2901,7 @@ namespace tools
     }
     bool ready;
     uint32_t threshold, total;
-    if (!m_wallet->multisig(&ready, &threshold, &total))
+    if (!wallet()->multisig(&ready, &threshold, &total))
     {
       er.code = WALLET_RPC_ERROR_CODE_NOT_MULTISIG;
       er.message = "This wallet is not multisig";
@@ -2662,7 +2935,7 @@ namespace tools
 
     try
     {
-      res.n_outputs = m_wallet->import_multisig(info);
+      res.n_outputs = wallet()->import_multisig(info);
     }
     catch (const std::exception &e)
     {
@@ -2675,7 +2948,7 @@ namespace tools
     {
       try
       {
-        m_wallet->rescan_spent();
+        wallet()->rescan_spent();
       }
       catch (const std::exception &e)
       {
@@ -2692,8 +2965,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_finalize_multisig(const wallet_rpc::COMMAND_RPC_FINALIZE_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_FINALIZE_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -2701,7 +2975,7 @@ namespace tools
     }
     bool ready;
     uint32_t threshold, total;
-    if (!m_wallet->multisig(&ready, &threshold, &total))
+    if (!wallet()->multisig(&ready, &threshold, &total))
     {
       er.code = WALLET_RPC_ERROR_CODE_NOT_MULTISIG;
       er.message = "This wallet is not multisig";
@@ -2723,7 +2997,7 @@ namespace tools
 
     try
     {
-      if (!m_wallet->finalize_multisig(req.password, req.multisig_info))
+      if (!wallet()->finalize_multisig(req.password, req.multisig_info))
       {
         er.code = WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR;
         er.message = "Error calling finalize_multisig";
@@ -2736,15 +3010,16 @@ namespace tools
       er.message = std::string("Error calling finalize_multisig: ") + e.what();
       return false;
     }
-    res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
+    res.address = wallet()->get_account().get_public_address_str(wallet()->nettype());
 
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sign_multisig(const wallet_rpc::COMMAND_RPC_SIGN_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_SIGN_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -2752,7 +3027,7 @@ namespace tools
     }
     bool ready;
     uint32_t threshold, total;
-    if (!m_wallet->multisig(&ready, &threshold, &total))
+    if (!wallet()->multisig(&ready, &threshold, &total))
     {
       er.code = WALLET_RPC_ERROR_CODE_NOT_MULTISIG;
       er.message = "This wallet is not multisig";
@@ -2774,7 +3049,7 @@ namespace tools
     }
 
     tools::wallet2::multisig_tx_set txs;
-    bool r = m_wallet->load_multisig_tx(blob, txs, NULL);
+    bool r = wallet()->load_multisig_tx(blob, txs, NULL);
     if (!r)
     {
       er.code = WALLET_RPC_ERROR_CODE_BAD_MULTISIG_TX_DATA;
@@ -2785,7 +3060,7 @@ namespace tools
     std::vector<crypto::hash> txids;
     try
     {
-      bool r = m_wallet->sign_multisig_tx(txs, txids);
+      bool r = wallet()->sign_multisig_tx(txs, txids);
       if (!r)
       {
         er.code = WALLET_RPC_ERROR_CODE_MULTISIG_SIGNATURE;
@@ -2800,7 +3075,7 @@ namespace tools
       return false;
     }
 
-    res.tx_data_hex = epee::string_tools::buff_to_hex_nodelimer(m_wallet->save_multisig_tx(txs));
+    res.tx_data_hex = epee::string_tools::buff_to_hex_nodelimer(wallet()->save_multisig_tx(txs));
     if (!txids.empty())
     {
       for (const crypto::hash &txid: txids)
@@ -2812,8 +3087,9 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_submit_multisig(const wallet_rpc::COMMAND_RPC_SUBMIT_MULTISIG::request& req, wallet_rpc::COMMAND_RPC_SUBMIT_MULTISIG::response& res, epee::json_rpc::error& er)
   {
-    if (!m_wallet) return not_open(er);
-    if (m_wallet->restricted())
+    boost::unique_lock<boost::shared_mutex> lock(wallet_mutex());
+    if (!wallet()) return not_open(er);
+    if (wallet()->restricted())
     {
       er.code = WALLET_RPC_ERROR_CODE_DENIED;
       er.message = "Command unavailable in restricted mode.";
@@ -2821,7 +3097,7 @@ namespace tools
     }
     bool ready;
     uint32_t threshold, total;
-    if (!m_wallet->multisig(&ready, &threshold, &total))
+    if (!wallet()->multisig(&ready, &threshold, &total))
     {
       er.code = WALLET_RPC_ERROR_CODE_NOT_MULTISIG;
       er.message = "This wallet is not multisig";
@@ -2843,7 +3119,7 @@ namespace tools
     }
 
     tools::wallet2::multisig_tx_set txs;
-    bool r = m_wallet->load_multisig_tx(blob, txs, NULL);
+    bool r = wallet()->load_multisig_tx(blob, txs, NULL);
     if (!r)
     {
       er.code = WALLET_RPC_ERROR_CODE_BAD_MULTISIG_TX_DATA;
@@ -2862,7 +3138,7 @@ namespace tools
     {
       for (auto &ptx: txs.m_ptx)
       {
-        m_wallet->commit_tx(ptx);
+        wallet()->commit_tx(ptx);
         res.tx_hash_list.push_back(epee::string_tools::pod_to_hex(cryptonote::get_transaction_hash(ptx.tx)));
       }
     }
@@ -2894,6 +3170,8 @@ int main(int argc, char** argv) {
   command_line::add_arg(desc_params, arg_from_json);
   command_line::add_arg(desc_params, arg_wallet_dir);
   command_line::add_arg(desc_params, arg_prompt_for_password);
+  command_line::add_arg(desc_params, arg_rpc_threads);
+  command_line::add_arg(desc_params, arg_multi_wallet);
 
   const auto vm = wallet_args::main(
     argc, argv,
@@ -32,17 +32,31 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <map>
+#include <memory>
 #include <string>
 #include "common/util.h"
 #include "net/http_server_impl_base.h"
 #include "wallet_rpc_server_commands_defs.h"
 #include "wallet2.h"
+#include "shared_block_cache.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "wallet.rpc"
 
 namespace tools
 {
+  // a wallet kept loaded with --multi-wallet, served at /wallet/<name>/json_rpc
+  struct hosted_wallet
+  {
+    std::unique_ptr<wallet2> wallet;
+    // same use as wallet_rpc_server::m_wallet_mutex
+    boost::shared_mutex mutex;
+    std::string path;
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -61,9 +75,9 @@ namespace tools
     void stop();
     void set_wallet(wallet2 *cr);
 
-  private:
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+  private:
 
     BEGIN_URI_MAP2()
       BEGIN_JSON_RPC_MAP("/json_rpc")
@@ -213,7 +227,18 @@ namespace tools
       void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &txid, const tools::wallet2::unconfirmed_transfer_details &pd);
       void fill_transfer_entry(tools::wallet_rpc::transfer_entry &entry, const crypto::hash &payment_id, const tools::wallet2::pool_payment_details &pd);
       bool not_open(epee::json_rpc::error& er);
+      bool not_hosted(epee::json_rpc::error& er);
       void handle_rpc_exception(const std::exception_ptr& e, epee::json_rpc::error& er, int default_error_code);
+      bool host_wallet(const std::string &name, std::unique_ptr<wallet2> wal, epee::json_rpc::error& er);
+      std::shared_ptr<hosted_wallet> get_hosted_wallet(const std::string &uri) const;
+      void unhost_wallet(const hosted_wallet *hosted);
+      void refresh_hosted_wallets();
+      void refresh_wallet();
+      // the wallet the request being handled on this thread is for, and its
+      // lock: the hosted one it was sent to, if any, else the server's own
+      bool is_hosted() const;
+      wallet2 *wallet() const;
+      boost::shared_mutex &wallet_mutex();
 
       template<typename Ts, typename Tu>
       bool fill_response(std::vector<tools::wallet2::pending_tx> &ptx_vector,
@@ -221,10 +246,21 @@ namespace tools
           Ts &tx_hash, bool get_tx_hex, Ts &tx_blob, bool get_tx_metadata, Ts &tx_metadata, epee::json_rpc::error &er);
 
       wallet2 *m_wallet;
+      // read only handlers share it, anything that changes the wallet
+      // (or m_wallet itself) takes it exclusively; refresh and transfer hold
+      // an upgrade lock over their daemon round trips
+      boost::shared_mutex m_wallet_mutex;
       std::string m_wallet_dir;
       tools::private_file rpc_login_file;
       std::atomic<bool> m_stop;
       bool m_trusted_daemon;
       const boost::program_options::variables_map *m_vm;
+      // with --multi-wallet, every opened or created wallet is kept loaded
+      // with its own lock, reachable at /wallet/<name>/json_rpc, and they
+      // all refresh through one block cache
+      bool m_multi_wallet;
+      std::shared_ptr<shared_block_cache> m_block_cache;
+      std::map<std::string, std::shared_ptr<hosted_wallet>> m_hosted_wallets;
+      mutable boost::shared_mutex m_hosted_wallets_mutex;
   };
 }
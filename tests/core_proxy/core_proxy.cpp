@@ -197,9 +197,18 @@ bool tests::proxy_core::handle_incoming_txs(const std::list<blobdata>& tx_blobs,
     return true;
 }
 
+bool tests::proxy_core::handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, std::vector<crypto::hash>& tx_hashes, bool keeped_by_block, bool relayed, bool do_not_relay)
+{
+    tx_hashes.assign(tx_blobs.size(), crypto::null_hash);
+    return handle_incoming_txs(tx_blobs, tvc, keeped_by_block, relayed, do_not_relay);
+}
+
 bool tests::proxy_core::handle_incoming_block(const cryptonote::blobdata& block_blob, cryptonote::block_verification_context& bvc, bool update_miner_blocktemplate) {
     block b = AUTO_VAL_INIT(b);
+    return handle_incoming_block(block_blob, bvc, b, update_miner_blocktemplate);
+}
 
+bool tests::proxy_core::handle_incoming_block(const cryptonote::blobdata& block_blob, cryptonote::block_verification_context& bvc, cryptonote::block& b, bool update_miner_blocktemplate) {
     if(!parse_and_validate_block_from_blob(block_blob, b)) {
         cerr << "Failed to parse and validate new block" << endl;
         return false;
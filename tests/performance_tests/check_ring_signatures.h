@@ -0,0 +1,93 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "crypto/crypto.h"
+
+class test_check_ring_signatures
+{
+public:
+  static const size_t loop_count = 100;
+
+  test_check_ring_signatures(size_t ring_size, size_t batch_size)
+    : m_ring_size(ring_size)
+    , m_batch_size(batch_size)
+  {
+  }
+
+  bool init()
+  {
+    m_pubs.resize(m_batch_size * m_ring_size);
+    m_images.resize(m_batch_size);
+    m_sigs.resize(m_batch_size * m_ring_size);
+    m_checks.resize(m_batch_size);
+    m_results.reset(new bool[m_batch_size]);
+    crypto::rand(sizeof(m_prefix_hash), (uint8_t*)&m_prefix_hash);
+
+    m_p_pubs.resize(m_batch_size * m_ring_size);
+    for (size_t n = 0; n < m_batch_size; ++n)
+    {
+      const size_t real_index = n % m_ring_size;
+      crypto::secret_key real_sec;
+      for (size_t i = 0; i < m_ring_size; ++i)
+      {
+        crypto::secret_key sec;
+        crypto::generate_keys(m_pubs[n * m_ring_size + i], sec);
+        m_p_pubs[n * m_ring_size + i] = &m_pubs[n * m_ring_size + i];
+        if (i == real_index)
+          real_sec = sec;
+      }
+      crypto::generate_key_image(m_pubs[n * m_ring_size + real_index], real_sec, m_images[n]);
+      crypto::generate_ring_signature(m_prefix_hash, m_images[n], m_p_pubs.data() + n * m_ring_size, m_ring_size, real_sec, real_index, m_sigs.data() + n * m_ring_size);
+    }
+
+    for (size_t n = 0; n < m_batch_size; ++n)
+      m_checks[n] = {&m_prefix_hash, &m_images[n], m_p_pubs.data() + n * m_ring_size, m_ring_size, m_sigs.data() + n * m_ring_size};
+    return true;
+  }
+
+  bool test()
+  {
+    return crypto::check_ring_signatures(m_checks.data(), m_batch_size, m_results.get());
+  }
+
+private:
+  size_t m_ring_size;
+  size_t m_batch_size;
+  crypto::hash m_prefix_hash;
+  std::vector<crypto::public_key> m_pubs;
+  std::vector<const crypto::public_key*> m_p_pubs;
+  std::vector<crypto::key_image> m_images;
+  std::vector<crypto::signature> m_sigs;
+  std::vector<crypto::ring_signature_check> m_checks;
+  std::unique_ptr<bool[]> m_results;
+};
@@ -0,0 +1,90 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "ringct/rctOps.h"
+
+template<bool precomp>
+class test_ge_double_scalarmult_base_vartime
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    m_a = rct::skGen();
+    m_b = rct::skGen();
+    ge_p3 point;
+    if (ge_frombytes_vartime(&point, rct::pkGen().bytes) != 0)
+      return false;
+    m_point = point;
+    ge_dsm_precomp(m_point_precomp, &point);
+    return true;
+  }
+
+  bool test()
+  {
+    ge_p2 res;
+    if (precomp)
+      ge_double_scalarmult_base_precomp_vartime(&res, m_a.bytes, m_point_precomp, m_b.bytes);
+    else
+      ge_double_scalarmult_base_vartime(&res, m_a.bytes, &m_point, m_b.bytes);
+    return true;
+  }
+
+private:
+  rct::key m_a, m_b;
+  ge_p3 m_point;
+  ge_dsmp m_point_precomp;
+};
+
+template<bool precomp>
+class test_scalarmult_H
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    // scalarmultH is called on amounts, so measure it on one
+    m_a = rct::d2h(crypto::rand<uint64_t>());
+    m_expected = rct::scalarmultKey(rct::H, m_a);
+    return true;
+  }
+
+  bool test()
+  {
+    const rct::key res = precomp ? rct::scalarmultH(m_a) : rct::scalarmultKey(rct::H, m_a);
+    return res == m_expected;
+  }
+
+private:
+  rct::key m_a;
+  rct::key m_expected;
+};
@@ -41,6 +41,7 @@
 #include "cn_slow_hash.h"
 #include "derive_public_key.h"
 #include "derive_secret_key.h"
+#include "ge_double_scalarmult.h"
 #include "ge_frombytes_vartime.h"
 #include "generate_key_derivation.h"
 #include "generate_key_image.h"
@@ -51,6 +52,7 @@
 #include "sc_reduce32.h"
 #include "cn_fast_hash.h"
 #include "rct_mlsag.h"
+#include "check_ring_signatures.h"
 
 namespace po = boost::program_options;
 
@@ -77,15 +79,27 @@ int main(int argc, char** argv)
 {
   TRY_ENTRY();
   tools::on_startup();
-  set_process_affinity(1);
-  set_thread_high_priority();
 
   mlog_configure(mlog_get_default_log_path("performance_tests.log"), true);
   mlog_set_log_level(0);
 
   po::options_description desc_options("Command line options");
   const command_line::arg_descriptor<std::string> arg_filter = { "filter", "Regular expression filter for which tests to run" };
+  const command_line::arg_descriptor<size_t> arg_samples = { "samples", "Number of timed samples per test", 10 };
+  const command_line::arg_descriptor<unsigned> arg_min_sample_ms = { "min-sample-ms", "Minimum duration of a sample, the number of calls per sample is raised to match", 10 };
+  const command_line::arg_descriptor<int> arg_cpu = { "cpu", "CPU core to pin the tests to, -1 to not pin", 1 };
+  const command_line::arg_descriptor<std::string> arg_output_format = { "output-format", "Also write the results as json or csv", "" };
+  const command_line::arg_descriptor<std::string> arg_output = { "output", "File to write json or csv results to, instead of stdout" };
+  const command_line::arg_descriptor<std::string> arg_baseline = { "baseline", "csv results of an earlier run to compare the medians against" };
+  const command_line::arg_descriptor<double> arg_regression_threshold = { "regression-threshold", "Slowdown of the median over the baseline, in percent, flagged as a regression", 10.0 };
   command_line::add_arg(desc_options, arg_filter);
+  command_line::add_arg(desc_options, arg_samples);
+  command_line::add_arg(desc_options, arg_min_sample_ms);
+  command_line::add_arg(desc_options, arg_cpu);
+  command_line::add_arg(desc_options, arg_output_format);
+  command_line::add_arg(desc_options, arg_output);
+  command_line::add_arg(desc_options, arg_baseline);
+  command_line::add_arg(desc_options, arg_regression_threshold);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -97,81 +111,142 @@ int main(int argc, char** argv)
   if (!r)
     return 1;
 
-  const std::string filter = glob_to_regex(command_line::get_arg(vm, arg_filter));
+  const std::string output_format = command_line::get_arg(vm, arg_output_format);
+  if (!output_format.empty() && output_format != "json" && output_format != "csv")
+  {
+    std::cerr << "Unknown output format: " << output_format << std::endl;
+    return 1;
+  }
+
+  Params params;
+  params.filter = glob_to_regex(command_line::get_arg(vm, arg_filter));
+  params.samples = command_line::get_arg(vm, arg_samples);
+  params.min_sample_ns = command_line::get_arg(vm, arg_min_sample_ms) * (uint64_t)1000000;
+  params.regression_threshold = command_line::get_arg(vm, arg_regression_threshold) / 100;
+  const std::string baseline = command_line::get_arg(vm, arg_baseline);
+  if (!baseline.empty() && !load_baseline(baseline, params.baseline))
+  {
+    std::cerr << "Failed to load baseline from " << baseline << std::endl;
+    return 1;
+  }
+
+  const int cpu = command_line::get_arg(vm, arg_cpu);
+  if (cpu >= 0)
+    set_process_affinity(cpu);
+  set_thread_high_priority();
 
   performance_timer timer;
   timer.start();
 
-  TEST_PERFORMANCE3(filter, test_construct_tx, 1, 1, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 1, 2, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 1, 10, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 1, 100, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 1, 1000, false);
-
-  TEST_PERFORMANCE3(filter, test_construct_tx, 2, 1, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 2, 2, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 2, 10, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 2, 100, false);
-
-  TEST_PERFORMANCE3(filter, test_construct_tx, 10, 1, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 10, 2, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 10, 10, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 10, 100, false);
-
-  TEST_PERFORMANCE3(filter, test_construct_tx, 100, 1, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 100, 2, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 100, 10, false);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 100, 100, false);
-
-  TEST_PERFORMANCE3(filter, test_construct_tx, 2, 1, true);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 2, 2, true);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 2, 10, true);
-
-  TEST_PERFORMANCE3(filter, test_construct_tx, 10, 1, true);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 10, 2, true);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 10, 10, true);
-
-  TEST_PERFORMANCE3(filter, test_construct_tx, 100, 1, true);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 100, 2, true);
-  TEST_PERFORMANCE3(filter, test_construct_tx, 100, 10, true);
-
-  TEST_PERFORMANCE2(filter, test_check_tx_signature, 1, false);
-  TEST_PERFORMANCE2(filter, test_check_tx_signature, 2, false);
-  TEST_PERFORMANCE2(filter, test_check_tx_signature, 10, false);
-  TEST_PERFORMANCE2(filter, test_check_tx_signature, 100, false);
-
-  TEST_PERFORMANCE2(filter, test_check_tx_signature, 2, true);
-  TEST_PERFORMANCE2(filter, test_check_tx_signature, 10, true);
-  TEST_PERFORMANCE2(filter, test_check_tx_signature, 100, true);
-
-  TEST_PERFORMANCE0(filter, test_is_out_to_acc);
-  TEST_PERFORMANCE0(filter, test_is_out_to_acc_precomp);
-  TEST_PERFORMANCE0(filter, test_generate_key_image_helper);
-  TEST_PERFORMANCE0(filter, test_generate_key_derivation);
-  TEST_PERFORMANCE0(filter, test_generate_key_image);
-  TEST_PERFORMANCE0(filter, test_derive_public_key);
-  TEST_PERFORMANCE0(filter, test_derive_secret_key);
-  TEST_PERFORMANCE0(filter, test_ge_frombytes_vartime);
-  TEST_PERFORMANCE0(filter, test_generate_keypair);
-  TEST_PERFORMANCE0(filter, test_sc_reduce32);
-
-  TEST_PERFORMANCE2(filter, test_wallet2_expand_subaddresses, 50, 200);
-
-  TEST_PERFORMANCE0(filter, test_cn_slow_hash);
-  TEST_PERFORMANCE1(filter, test_cn_fast_hash, 32);
-  TEST_PERFORMANCE1(filter, test_cn_fast_hash, 16384);
-
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 3, false);
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 5, false);
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 10, false);
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 100, false);
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 3, true);
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 5, true);
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 10, true);
-  TEST_PERFORMANCE3(filter, test_ringct_mlsag, 1, 100, true);
+  TEST_PERFORMANCE3(params, test_construct_tx, 1, 1, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 1, 2, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 1, 10, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 1, 100, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 1, 1000, false);
+
+  TEST_PERFORMANCE3(params, test_construct_tx, 2, 1, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 2, 2, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 2, 10, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 2, 100, false);
+
+  TEST_PERFORMANCE3(params, test_construct_tx, 10, 1, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 10, 2, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 10, 10, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 10, 100, false);
+
+  TEST_PERFORMANCE3(params, test_construct_tx, 100, 1, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 100, 2, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 100, 10, false);
+  TEST_PERFORMANCE3(params, test_construct_tx, 100, 100, false);
+
+  TEST_PERFORMANCE3(params, test_construct_tx, 2, 1, true);
+  TEST_PERFORMANCE3(params, test_construct_tx, 2, 2, true);
+  TEST_PERFORMANCE3(params, test_construct_tx, 2, 10, true);
+
+  TEST_PERFORMANCE3(params, test_construct_tx, 10, 1, true);
+  TEST_PERFORMANCE3(params, test_construct_tx, 10, 2, true);
+  TEST_PERFORMANCE3(params, test_construct_tx, 10, 10, true);
+
+  TEST_PERFORMANCE3(params, test_construct_tx, 100, 1, true);
+  TEST_PERFORMANCE3(params, test_construct_tx, 100, 2, true);
+  TEST_PERFORMANCE3(params, test_construct_tx, 100, 10, true);
+
+  TEST_PERFORMANCE2(params, test_check_tx_signature, 1, false);
+  TEST_PERFORMANCE2(params, test_check_tx_signature, 2, false);
+  TEST_PERFORMANCE2(params, test_check_tx_signature, 10, false);
+  TEST_PERFORMANCE2(params, test_check_tx_signature, 100, false);
+
+  TEST_PERFORMANCE2(params, test_check_tx_signature, 2, true);
+  TEST_PERFORMANCE2(params, test_check_tx_signature, 10, true);
+  TEST_PERFORMANCE2(params, test_check_tx_signature, 100, true);
+
+  TEST_PERFORMANCE0(params, test_is_out_to_acc);
+  TEST_PERFORMANCE0(params, test_is_out_to_acc_precomp);
+  TEST_PERFORMANCE0(params, test_generate_key_image_helper);
+  TEST_PERFORMANCE0(params, test_generate_key_derivation);
+  TEST_PERFORMANCE0(params, test_generate_key_image);
+  TEST_PERFORMANCE0(params, test_derive_public_key);
+  TEST_PERFORMANCE0(params, test_derive_secret_key);
+  TEST_PERFORMANCE0(params, test_ge_frombytes_vartime);
+  TEST_PERFORMANCE1(params, test_ge_double_scalarmult_base_vartime, false);
+  TEST_PERFORMANCE1(params, test_ge_double_scalarmult_base_vartime, true);
+  TEST_PERFORMANCE1(params, test_scalarmult_H, false);
+  TEST_PERFORMANCE1(params, test_scalarmult_H, true);
+  TEST_PERFORMANCE0(params, test_generate_keypair);
+  TEST_PERFORMANCE0(params, test_sc_reduce32);
+
+  TEST_PERFORMANCE2(params, test_wallet2_expand_subaddresses, 50, 200);
+
+  TEST_PERFORMANCE0(params, test_cn_slow_hash);
+  TEST_PERFORMANCE1(params, test_cn_fast_hash, 32);
+  TEST_PERFORMANCE1(params, test_cn_fast_hash, 16384);
+
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 3, false);
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 5, false);
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 10, false);
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 100, false);
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 3, true);
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 5, true);
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 10, true);
+  TEST_PERFORMANCE3(params, test_ringct_mlsag, 1, 100, true);
+
+  for (size_t ring_size: {2, 5, 11, 21})
+  {
+    for (size_t batch_size: {1, 16, 256})
+      TEST_PERFORMANCE_ARGS2(params, test_check_ring_signatures, ring_size, batch_size);
+  }
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
-  return 0;
+  if (!output_format.empty())
+  {
+    const std::string output = command_line::get_arg(vm, arg_output);
+    std::ofstream file;
+    if (!output.empty())
+    {
+      file.open(output);
+      if (!file)
+      {
+        std::cerr << "Failed to open " << output << std::endl;
+        return 1;
+      }
+    }
+    std::ostream &out = output.empty() ? std::cout : file;
+    if (output_format == "json")
+      write_json(out, params.results);
+    else
+      write_csv(out, params.results);
+  }
+
+  size_t regressions = 0;
+  for (const auto &result: params.results)
+  {
+    if (result.regression)
+    {
+      std::cout << "Regression: " << result.name << std::endl;
+      ++regressions;
+    }
+  }
+  return regressions ? 2 : 0;
   CATCH_ENTRY_L0("main", 1);
 }
@@ -30,8 +30,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #include <boost/chrono.hpp>
 #include <boost/regex.hpp>
@@ -57,50 +66,127 @@ public:
     return static_cast<int>(boost::chrono::duration_cast<boost::chrono::milliseconds>(elapsed).count());
   }
 
+  uint64_t elapsed_ns()
+  {
+    clock::duration elapsed = clock::now() - m_start;
+    return boost::chrono::duration_cast<boost::chrono::nanoseconds>(elapsed).count();
+  }
+
 private:
   clock::time_point m_base;
   clock::time_point m_start;
 };
 
+struct test_result
+{
+  std::string name;
+  size_t iterations; // per sample
+  std::vector<double> samples; // ns per call
+  double min;
+  double mean;
+  double median;
+  double mad; // median absolute deviation from the median
+  double p99;
+  double baseline; // median ns per call from the baseline file, 0 if none
+  bool regression;
+};
+
+struct Params
+{
+  std::string filter;
+  size_t samples = 10;
+  uint64_t min_sample_ns = 10000000; // iterations per sample are doubled until a sample takes this long
+  std::map<std::string, double> baseline;
+  double regression_threshold = 0.1; // relative slowdown of the median flagged as a regression
+  std::vector<test_result> results;
+};
+
+static double median_of(std::vector<double> values)
+{
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  const size_t n = values.size();
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+static void compute_stats(test_result &result)
+{
+  std::vector<double> sorted = result.samples;
+  std::sort(sorted.begin(), sorted.end());
+  result.min = sorted.front();
+  double sum = 0;
+  for (double v: sorted)
+    sum += v;
+  result.mean = sum / sorted.size();
+  result.median = median_of(sorted);
+  std::vector<double> deviations;
+  deviations.reserve(sorted.size());
+  for (double v: sorted)
+    deviations.push_back(std::fabs(v - result.median));
+  result.mad = median_of(deviations);
+  // nearest rank
+  const size_t rank = (size_t)std::ceil(0.99 * sorted.size());
+  result.p99 = sorted[std::max<size_t>(rank, 1) - 1];
+}
 
 template <typename T>
 class test_runner
 {
 public:
-  test_runner()
-    : m_elapsed(0)
+  test_runner(const Params &params)
+    : m_params(params)
+    , m_iterations(0)
   {
   }
 
-  bool run()
+  template <typename... Args>
+  bool run(Args&&... args)
   {
-    T test;
-    if (!test.init())
+    static_assert(0 < T::loop_count, "T::loop_count must be greater than 0");
+
+    std::unique_ptr<T> test(new T(std::forward<Args>(args)...));
+    if (!test->init())
       return false;
 
-    performance_timer timer;
-    timer.start();
     warm_up();
-    std::cout << "Warm up: " << timer.elapsed_ms() << " ms" << std::endl;
 
-    timer.start();
-    for (size_t i = 0; i < T::loop_count; ++i)
+    // find how many calls make a sample long enough to time reliably, up to
+    // the test's loop count
+    performance_timer timer;
+    size_t iterations = 1;
+    while (true)
+    {
+      timer.start();
+      for (size_t i = 0; i < iterations; ++i)
+      {
+        if (!test->test())
+          return false;
+      }
+      const uint64_t elapsed = timer.elapsed_ns();
+      if (elapsed >= m_params.min_sample_ns || iterations >= T::loop_count)
+        break;
+      iterations = std::min<size_t>(iterations * 2, T::loop_count);
+    }
+    m_iterations = iterations;
+
+    m_samples.clear();
+    for (size_t s = 0; s < std::max<size_t>(m_params.samples, 1); ++s)
     {
-      if (!test.test())
-        return false;
+      timer.start();
+      for (size_t i = 0; i < iterations; ++i)
+      {
+        if (!test->test())
+          return false;
+      }
+      m_samples.push_back(timer.elapsed_ns() / (double)iterations);
     }
-    m_elapsed = timer.elapsed_ms();
 
     return true;
   }
 
-  int elapsed_time() const { return m_elapsed; }
-
-  int time_per_call(int scale = 1) const
-  {
-    static_assert(0 < T::loop_count, "T::loop_count must be greater than 0");
-    return m_elapsed * scale / T::loop_count;
-  }
+  size_t iterations() const { return m_iterations; }
+  const std::vector<double> &samples() const { return m_samples; }
 
 private:
   /**
@@ -119,33 +205,59 @@ private:
 
 private:
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
-  int m_elapsed;
+  const Params &m_params;
+  size_t m_iterations;
+  std::vector<double> m_samples;
 };
 
-template <typename T>
-void run_test(const std::string &filter, const char* test_name)
+static std::string format_ns(double ns)
+{
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(2);
+  if (ns < 1000)
+    ss << ns << " ns";
+  else if (ns < 1000 * 1000)
+#ifdef _WIN32
+    ss << ns / 1000 << " \xb5s";
+#else
+    ss << ns / 1000 << " µs";
+#endif
+  else
+    ss << ns / (1000 * 1000) << " ms";
+  return ss.str();
+}
+
+template <typename T, typename... Args>
+void run_test(Params &params, const std::string &test_name, Args&&... args)
 {
   boost::smatch match;
-  if (!filter.empty() && !boost::regex_match(std::string(test_name), match, boost::regex(filter)))
+  if (!params.filter.empty() && !boost::regex_match(test_name, match, boost::regex(params.filter)))
     return;
 
-  test_runner<T> runner;
-  if (runner.run())
+  test_runner<T> runner(params);
+  if (runner.run(std::forward<Args>(args)...))
   {
+    test_result result;
+    result.name = test_name;
+    result.iterations = runner.iterations();
+    result.samples = runner.samples();
+    compute_stats(result);
+    const auto i = params.baseline.find(test_name);
+    result.baseline = i == params.baseline.end() ? 0 : i->second;
+    result.regression = result.baseline > 0 && result.median > result.baseline * (1 + params.regression_threshold);
+
     std::cout << test_name << " - OK:\n";
-    std::cout << "  loop count:    " << T::loop_count << '\n';
-    std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
-    const char *unit = "ms";
-    int time_per_call = runner.time_per_call();
-    if (time_per_call < 30000) {
-     time_per_call = runner.time_per_call(1000);
-#ifdef _WIN32
-     unit = "\xb5s";
-#else
-     unit = "µs";
-#endif
+    std::cout << "  samples:       " << result.samples.size() << " x " << result.iterations << " calls\n";
+    std::cout << "  median:        " << format_ns(result.median) << "/call (MAD " << format_ns(result.mad) << ")\n";
+    std::cout << "  min/mean/p99:  " << format_ns(result.min) << " / " << format_ns(result.mean) << " / " << format_ns(result.p99) << "\n";
+    if (result.baseline > 0)
+    {
+      std::stringstream change;
+      change << std::showpos << std::fixed << std::setprecision(1) << (result.median / result.baseline - 1) * 100 << "%";
+      std::cout << "  baseline:      " << format_ns(result.baseline) << "/call, " << change.str() << (result.regression ? " - REGRESSION" : "") << "\n";
     }
-    std::cout << "  time per call: " << time_per_call << " " << unit << "/call\n" << std::endl;
+    std::cout << std::endl;
+    params.results.push_back(std::move(result));
   }
   else
   {
@@ -153,8 +265,98 @@ void run_test(const std::string &filter, const char* test_name)
   }
 }
 
+static std::string json_escape(const std::string &s)
+{
+  std::string escaped;
+  for (char c: s)
+  {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+
+static void write_json(std::ostream &out, const std::vector<test_result> &results)
+{
+  out << std::fixed << std::setprecision(1) << "[\n";
+  for (size_t n = 0; n < results.size(); ++n)
+  {
+    const test_result &r = results[n];
+    out << "  {\"name\": \"" << json_escape(r.name) << "\", \"iterations\": " << r.iterations
+      << ", \"min_ns\": " << r.min << ", \"mean_ns\": " << r.mean << ", \"median_ns\": " << r.median
+      << ", \"mad_ns\": " << r.mad << ", \"p99_ns\": " << r.p99;
+    if (r.baseline > 0)
+      out << ", \"baseline_ns\": " << r.baseline << ", \"regression\": " << (r.regression ? "true" : "false");
+    out << ", \"samples_ns\": [";
+    for (size_t i = 0; i < r.samples.size(); ++i)
+      out << (i ? ", " : "") << r.samples[i];
+    out << "]}" << (n + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "]\n";
+}
+
+static void write_csv(std::ostream &out, const std::vector<test_result> &results)
+{
+  out << std::fixed << std::setprecision(1);
+  out << "name,samples,iterations,min_ns,mean_ns,median_ns,mad_ns,p99_ns,baseline_ns,regression\n";
+  for (const test_result &r: results)
+  {
+    // names contain commas, quote them
+    out << "\"" << r.name << "\"," << r.samples.size() << "," << r.iterations << "," << r.min << "," << r.mean << ","
+      << r.median << "," << r.mad << "," << r.p99 << "," << r.baseline << "," << (r.regression ? 1 : 0) << "\n";
+  }
+}
+
+// reads the median of each test from a file written with --output-format csv
+static bool load_baseline(const std::string &filename, std::map<std::string, double> &baseline)
+{
+  std::ifstream in(filename);
+  if (!in)
+    return false;
+  std::string line;
+  std::getline(in, line); // header
+  while (std::getline(in, line))
+  {
+    if (line.size() < 2 || line[0] != '"')
+      continue;
+    const size_t name_end = line.find('"', 1);
+    if (name_end == std::string::npos)
+      continue;
+    std::vector<std::string> fields;
+    std::stringstream ss(line.substr(std::min(name_end + 2, line.size())));
+    std::string field;
+    while (std::getline(ss, field, ','))
+      fields.push_back(field);
+    // samples,iterations,min,mean,median
+    if (fields.size() < 5)
+      continue;
+    baseline[line.substr(1, name_end - 1)] = std::stod(fields[4]);
+  }
+  return true;
+}
+
+template <typename T>
+std::string make_test_name(const std::string &base, const T &arg)
+{
+  std::stringstream ss;
+  ss << base << "<" << arg << ">";
+  return ss.str();
+}
+
+template <typename T0, typename T1>
+std::string make_test_name(const std::string &base, const T0 &arg0, const T1 &arg1)
+{
+  std::stringstream ss;
+  ss << base << "<" << arg0 << ", " << arg1 << ">";
+  return ss.str();
+}
+
 #define QUOTEME(x) #x
-#define TEST_PERFORMANCE0(filter, test_class)         run_test< test_class >(filter, QUOTEME(test_class))
-#define TEST_PERFORMANCE1(filter, test_class, a0)     run_test< test_class<a0> >(filter, QUOTEME(test_class<a0>))
-#define TEST_PERFORMANCE2(filter, test_class, a0, a1) run_test< test_class<a0, a1> >(filter, QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ">")
-#define TEST_PERFORMANCE3(filter, test_class, a0, a1, a2) run_test< test_class<a0, a1, a2> >(filter, QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ", " QUOTEME(a2) ">")
+#define TEST_PERFORMANCE0(params, test_class)         run_test< test_class >(params, QUOTEME(test_class))
+#define TEST_PERFORMANCE1(params, test_class, a0)     run_test< test_class<a0> >(params, QUOTEME(test_class<a0>))
+#define TEST_PERFORMANCE2(params, test_class, a0, a1) run_test< test_class<a0, a1> >(params, QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ">")
+#define TEST_PERFORMANCE3(params, test_class, a0, a1, a2) run_test< test_class<a0, a1, a2> >(params, QUOTEME(test_class) "<" QUOTEME(a0) ", " QUOTEME(a1) ", " QUOTEME(a2) ">")
+// runtime parameters, passed to the test's constructor
+#define TEST_PERFORMANCE_ARGS1(params, test_class, a0)     run_test< test_class >(params, make_test_name(QUOTEME(test_class), a0), a0)
+#define TEST_PERFORMANCE_ARGS2(params, test_class, a0, a1) run_test< test_class >(params, make_test_name(QUOTEME(test_class), a0, a1), a0, a1)
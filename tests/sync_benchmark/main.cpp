@@ -0,0 +1,335 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Replays a bootstrap file into a fresh data dir the way the protocol
+// handler feeds synced blocks to the core, and reports throughput, the
+// time spent under each PERF_TIMER, peak RSS and how much was written.
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "include_base_utils.h"
+#include "misc_os_dependent.h"
+#include "common/command_line.h"
+#include "common/perf_timer.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler_common.h"
+#include "serialization/binary_utils.h"
+#include "bootstrap_file.h"
+#include "bootstrap_serialization.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "sync_benchmark"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+namespace
+{
+  const command_line::arg_descriptor<std::string, true> arg_input_file = {"input-file", "Bootstrap file to replay"};
+  const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop after this height, 0 for the whole file", 0};
+  const command_line::arg_descriptor<size_t> arg_batch_size = {"batch-size", "Blocks handed to the core at once, like a span from a peer", BLOCKS_SYNCHRONIZING_DEFAULT_COUNT};
+  const command_line::arg_descriptor<bool> arg_prevalidate = {"prevalidate-hashes", "Check block hashes against the compiled in hashes of hashes first, as syncing does", false};
+  const command_line::arg_descriptor<bool> arg_keep_data_dir = {"keep-data-dir", "Do not delete the temporary data dir", false};
+  const command_line::arg_descriptor<std::string> arg_log_level = {"log-level", "0-4 or categories", ""};
+
+  // bytes written to storage by this process, where the OS tells us
+  uint64_t get_write_bytes()
+  {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value)
+    {
+      if (key == "write_bytes:")
+        return value;
+    }
+    return 0;
+  }
+
+  uint64_t get_peak_rss()
+  {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+      return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+#endif
+  }
+
+  uint64_t get_allocated_size(const boost::filesystem::path &dir)
+  {
+    uint64_t size = 0;
+    boost::system::error_code ec;
+    for (boost::filesystem::recursive_directory_iterator i(dir, ec), end; !ec && i != end; i.increment(ec))
+    {
+      if (boost::filesystem::is_regular_file(i->path(), ec))
+        size += boost::filesystem::file_size(i->path(), ec);
+    }
+    return size;
+  }
+
+  bool add_blocks(core &core, std::list<block_complete_entry> &blocks, std::list<crypto::hash> &hashes, bool prevalidate, uint64_t &num_txs)
+  {
+    if (prevalidate)
+      core.prevalidate_block_hashes(core.get_current_blockchain_height(), hashes);
+    hashes.clear();
+
+    core.prepare_handle_incoming_blocks(blocks);
+    for (const block_complete_entry &block_entry: blocks)
+    {
+      std::vector<tx_verification_context> tvc;
+      core.handle_incoming_txs(block_entry.txs, tvc, true, true, false);
+      for (const auto &v: tvc)
+      {
+        if (v.m_verifivation_failed)
+        {
+          MERROR("Transaction verification failed");
+          core.cleanup_handle_incoming_blocks();
+          return false;
+        }
+      }
+      num_txs += block_entry.txs.size();
+
+      block_verification_context bvc = boost::value_initialized<block_verification_context>();
+      core.handle_incoming_block(block_entry.block, bvc, false);
+      if (bvc.m_verifivation_failed || bvc.m_marked_as_orphaned)
+      {
+        MERROR("Block verification failed, id = " << epee::string_tools::pod_to_hex(get_blob_hash(block_entry.block)));
+        core.cleanup_handle_incoming_blocks();
+        return false;
+      }
+    }
+    blocks.clear();
+    return core.cleanup_handle_incoming_blocks();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+  tools::on_startup();
+
+  po::options_description desc_options("Command line options");
+  command_line::add_arg(desc_options, arg_input_file);
+  command_line::add_arg(desc_options, arg_block_stop);
+  command_line::add_arg(desc_options, arg_batch_size);
+  command_line::add_arg(desc_options, arg_prevalidate);
+  command_line::add_arg(desc_options, arg_keep_data_dir);
+  command_line::add_arg(desc_options, arg_log_level);
+  command_line::add_arg(desc_options, command_line::arg_help);
+  cryptonote::core::init_options(desc_options);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  mlog_configure(mlog_get_default_log_path("sync_benchmark.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log("0,sync_benchmark:INFO");
+
+  // always start from an empty chain, so runs are comparable
+  boost::filesystem::path data_dir;
+  if (command_line::is_arg_defaulted(vm, cryptonote::arg_data_dir))
+  {
+    data_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("monero-sync-benchmark-%%%%-%%%%");
+    vm.erase(cryptonote::arg_data_dir.name);
+    vm.insert(std::make_pair(std::string(cryptonote::arg_data_dir.name), po::variable_value(data_dir.string(), false)));
+  }
+  else
+  {
+    data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
+    boost::system::error_code ec;
+    if (boost::filesystem::exists(data_dir, ec) && !boost::filesystem::is_empty(data_dir, ec))
+    {
+      std::cerr << "Data dir " << data_dir << " is not empty" << std::endl;
+      return 1;
+    }
+  }
+  const bool keep_data_dir = command_line::get_arg(vm, arg_keep_data_dir);
+
+  const std::string input_file = command_line::get_arg(vm, arg_input_file);
+  const size_t batch_size = std::max<size_t>(command_line::get_arg(vm, arg_batch_size), 1);
+  const bool prevalidate = command_line::get_arg(vm, arg_prevalidate);
+
+  cryptonote::cryptonote_protocol_stub pr;
+  cryptonote::core core(&pr);
+  core.disable_dns_checkpoints(true);
+  if (!core.init(vm, NULL))
+  {
+    std::cerr << "Failed to initialize core" << std::endl;
+    return 1;
+  }
+
+  BootstrapFile bootstrap;
+  std::streampos pos;
+  uint64_t seek_height = 1;
+  const uint64_t total_blocks = bootstrap.count_blocks(input_file, pos, seek_height);
+  uint64_t block_stop = command_line::get_arg(vm, arg_block_stop);
+  if (!block_stop || block_stop >= total_blocks)
+    block_stop = total_blocks - 1;
+
+  std::ifstream import_file(input_file, std::ios_base::binary | std::ifstream::in);
+  if (import_file.fail())
+  {
+    std::cerr << "Failed to open " << input_file << std::endl;
+    return 1;
+  }
+  import_file.seekg(pos);
+  uint64_t h;
+  bool quit = false;
+  bootstrap.count_bytes(import_file, 1 - seek_height, h, quit);
+  h = 1;
+
+  std::cout << "Replaying blocks 1 to " << block_stop << " from " << input_file << " into " << data_dir << std::endl;
+
+  tools::reset_performance_timer_stats();
+  core.get_blockchain_storage().get_db().reset_stats();
+  const uint64_t write_bytes_start = get_write_bytes();
+  const uint64_t t0 = epee::misc_utils::get_ns_count();
+
+  std::list<block_complete_entry> blocks;
+  std::list<crypto::hash> hashes;
+  std::string str;
+  std::vector<char> buffer(BUFFER_SIZE);
+  uint64_t num_blocks = 0, num_txs = 0;
+  bool ok = true;
+  while (ok && h <= block_stop)
+  {
+    uint32_t chunk_size;
+    import_file.read(buffer.data(), sizeof(chunk_size));
+    if (!import_file)
+      break;
+    str.assign(buffer.data(), sizeof(chunk_size));
+    if (!::serialization::parse_binary(str, chunk_size) || chunk_size == 0 || chunk_size > BUFFER_SIZE)
+    {
+      std::cerr << "Bad chunk size at height " << h << std::endl;
+      ok = false;
+      break;
+    }
+    import_file.read(buffer.data(), chunk_size);
+    if (!import_file)
+      break;
+    str.assign(buffer.data(), chunk_size);
+    bootstrap::block_package bp;
+    if (!::serialization::parse_binary(str, bp))
+    {
+      std::cerr << "Failed to parse block at height " << h << std::endl;
+      ok = false;
+      break;
+    }
+
+    block_complete_entry bce;
+    bce.block = block_to_blob(bp.block);
+    for (const auto &tx: bp.txs)
+      bce.txs.push_back(tx_to_blob(tx));
+    blocks.push_back(std::move(bce));
+    hashes.push_back(get_block_hash(bp.block));
+    ++h;
+
+    if (blocks.size() >= batch_size)
+    {
+      num_blocks += blocks.size();
+      ok = add_blocks(core, blocks, hashes, prevalidate, num_txs);
+      if (num_blocks % 1000 < batch_size)
+        MINFO("Height " << core.get_current_blockchain_height());
+    }
+  }
+  if (ok && !blocks.empty())
+  {
+    num_blocks += blocks.size();
+    ok = add_blocks(core, blocks, hashes, prevalidate, num_txs);
+  }
+  core.get_blockchain_storage().get_db().sync();
+
+  const double seconds = (epee::misc_utils::get_ns_count() - t0) / 1e9;
+  const uint64_t write_bytes = get_write_bytes() - write_bytes_start;
+  const auto stats = tools::get_performance_timer_stats();
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << (ok ? "Finished" : "FAILED") << " at height " << core.get_current_blockchain_height() << std::endl;
+  std::cout << "  blocks:      " << num_blocks << " (" << num_blocks / seconds << " blocks/s)" << std::endl;
+  std::cout << "  txs:         " << num_txs << " (" << num_txs / seconds << " txs/s)" << std::endl;
+  std::cout << "  time:        " << seconds << " s" << std::endl;
+  std::cout << "  peak RSS:    " << get_peak_rss() / (1024 * 1024) << " MB" << std::endl;
+  std::cout << "  written:     " << write_bytes / (1024 * 1024) << " MB" << std::endl;
+  std::cout << "  data dir:    " << get_allocated_size(data_dir) / (1024 * 1024) << " MB" << std::endl;
+
+  std::vector<std::pair<std::string, tools::performance_timer_stats>> sorted(stats.begin(), stats.end());
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, tools::performance_timer_stats> &a, const std::pair<std::string, tools::performance_timer_stats> &b) {
+    return a.second.ns > b.second.ns;
+  });
+  std::cout << std::endl << std::setw(40) << std::left << "PERF_TIMER" << std::right << std::setw(12) << "calls" << std::setw(14) << "total ms" << std::setw(12) << "avg us" << std::endl;
+  for (const auto &s: sorted)
+  {
+    std::cout << std::setw(40) << std::left << s.first << std::right << std::setw(12) << s.second.count
+      << std::setw(14) << s.second.ns / 1e6 << std::setw(12) << s.second.ns / 1e3 / std::max<uint64_t>(s.second.count, 1) << std::endl;
+  }
+  std::cout << std::endl;
+  core.get_blockchain_storage().get_db().show_stats();
+
+  core.deinit();
+  if (!keep_data_dir)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(data_dir, ec);
+  }
+
+  return ok ? 0 : 1;
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <functional>
+#include "gtest/gtest.h"
+#include "cryptonote_config.h"
+#include "cryptonote_core/block_hash_check.h"
+
+namespace
+{
+  static const size_t GROUPS = 4;
+
+  struct test_chain
+  {
+    std::vector<crypto::hash> blocks;
+    std::vector<crypto::hash> hash_of_hashes;
+    cryptonote::block_hash_check check;
+
+    test_chain(): blocks(GROUPS * HASH_OF_HASHES_STEP), hash_of_hashes(GROUPS)
+    {
+      for (uint64_t h = 0; h < blocks.size(); ++h)
+        crypto::cn_fast_hash(&h, sizeof(h), blocks[h]);
+      for (size_t n = 0; n < GROUPS; ++n)
+        crypto::cn_fast_hash(blocks.data() + n * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash_of_hashes[n]);
+      check.set_hash_of_hashes(hash_of_hashes.data(), hash_of_hashes.size());
+    }
+
+    std::list<crypto::hash> range(uint64_t start, uint64_t count) const
+    {
+      return std::list<crypto::hash>(blocks.begin() + start, blocks.begin() + start + count);
+    }
+
+    uint64_t prevalidate(uint64_t height, const std::list<crypto::hash> &hashes, uint64_t db_height)
+    {
+      return check.prevalidate(height, hashes, db_height, [this](uint64_t h) { return blocks[h]; });
+    }
+
+    uint64_t prevalidate(uint64_t height, uint64_t count, uint64_t db_height)
+    {
+      return prevalidate(height, range(height, count), db_height);
+    }
+  };
+}
+
+TEST(block_hash_check, partial_groups)
+{
+  test_chain chain;
+  ASSERT_TRUE(chain.check.is_within_area(0));
+  ASSERT_TRUE(chain.check.is_within_area(GROUPS * HASH_OF_HASHES_STEP - 1));
+  ASSERT_FALSE(chain.check.is_within_area(GROUPS * HASH_OF_HASHES_STEP));
+
+  // not enough for a single group: nothing is kept
+  ASSERT_EQ(chain.prevalidate(0, 100, 0), 100);
+  ASSERT_EQ(chain.check.groups(), 0);
+  ASSERT_EQ(chain.check.check(0, chain.blocks[0]), cryptonote::block_hash_check::unknown);
+
+  // the first group is complete, the second is not
+  ASSERT_EQ(chain.prevalidate(0, HASH_OF_HASHES_STEP + 100, 0), HASH_OF_HASHES_STEP);
+  ASSERT_EQ(chain.check.groups(), 1);
+  ASSERT_EQ(chain.check.check(HASH_OF_HASHES_STEP - 1, chain.blocks[HASH_OF_HASHES_STEP - 1]), cryptonote::block_hash_check::valid);
+  ASSERT_EQ(chain.check.check(HASH_OF_HASHES_STEP, chain.blocks[HASH_OF_HASHES_STEP]), cryptonote::block_hash_check::unknown);
+
+  // starting mid group, the start of the group comes from the chain
+  ASSERT_EQ(chain.prevalidate(HASH_OF_HASHES_STEP + 100, HASH_OF_HASHES_STEP - 100, HASH_OF_HASHES_STEP + 100), HASH_OF_HASHES_STEP - 100);
+  ASSERT_EQ(chain.check.groups(), 2);
+  ASSERT_EQ(chain.check.check(HASH_OF_HASHES_STEP, chain.blocks[HASH_OF_HASHES_STEP]), cryptonote::block_hash_check::valid);
+
+  // starting mid group past the chain, the partial group is not checked,
+  // so its blocks will be verified fully
+  ASSERT_EQ(chain.prevalidate(2 * HASH_OF_HASHES_STEP + 100, 2 * HASH_OF_HASHES_STEP - 100, HASH_OF_HASHES_STEP), 2 * HASH_OF_HASHES_STEP - 100);
+  ASSERT_EQ(chain.check.groups(), 3);
+  ASSERT_EQ(chain.check.check(2 * HASH_OF_HASHES_STEP + 100, chain.blocks[2 * HASH_OF_HASHES_STEP + 100]), cryptonote::block_hash_check::unknown);
+  ASSERT_EQ(chain.check.check(3 * HASH_OF_HASHES_STEP, chain.blocks[3 * HASH_OF_HASHES_STEP]), cryptonote::block_hash_check::valid);
+}
+
+TEST(block_hash_check, prevalidate_erased_group)
+{
+  test_chain chain;
+  ASSERT_EQ(chain.prevalidate(0, 2 * HASH_OF_HASHES_STEP, 0), 2 * HASH_OF_HASHES_STEP);
+  ASSERT_EQ(chain.check.groups(), 2);
+
+  // groups are dropped once all their blocks are added
+  chain.check.cleanup(HASH_OF_HASHES_STEP - 1);
+  ASSERT_EQ(chain.check.groups(), 2);
+  chain.check.cleanup(HASH_OF_HASHES_STEP);
+  ASSERT_EQ(chain.check.groups(), 1);
+  ASSERT_EQ(chain.check.check(0, chain.blocks[0]), cryptonote::block_hash_check::unknown);
+
+  // a peer sending them again gets them checked again, and the group
+  // still held is matched against the new batch
+  ASSERT_EQ(chain.prevalidate(0, 2 * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP), 2 * HASH_OF_HASHES_STEP);
+  ASSERT_EQ(chain.check.groups(), 2);
+  ASSERT_EQ(chain.check.check(0, chain.blocks[0]), cryptonote::block_hash_check::valid);
+  ASSERT_EQ(chain.check.check(HASH_OF_HASHES_STEP, chain.blocks[HASH_OF_HASHES_STEP]), cryptonote::block_hash_check::valid);
+}
+
+TEST(block_hash_check, mismatch)
+{
+  test_chain chain;
+  ASSERT_EQ(chain.prevalidate(0, HASH_OF_HASHES_STEP, 0), HASH_OF_HASHES_STEP);
+  ASSERT_EQ(chain.check.check(5, chain.blocks[6]), cryptonote::block_hash_check::invalid);
+  ASSERT_EQ(chain.check.check(5, crypto::null_hash), cryptonote::block_hash_check::invalid);
+
+  // a batch with a wrong hash in the second group only gets the first one
+  std::list<crypto::hash> hashes = chain.range(0, 3 * HASH_OF_HASHES_STEP);
+  *std::next(hashes.begin(), HASH_OF_HASHES_STEP + 10) = crypto::null_hash;
+  ASSERT_EQ(chain.prevalidate(0, hashes, 0), HASH_OF_HASHES_STEP);
+  ASSERT_EQ(chain.check.groups(), 1);
+  ASSERT_EQ(chain.check.check(HASH_OF_HASHES_STEP + 10, crypto::null_hash), cryptonote::block_hash_check::unknown);
+
+  // a group already held which the new batch disagrees with
+  hashes = chain.range(0, HASH_OF_HASHES_STEP);
+  hashes.front() = crypto::null_hash;
+  ASSERT_EQ(chain.prevalidate(0, hashes, 0), 0);
+  ASSERT_EQ(chain.check.check(0, chain.blocks[0]), cryptonote::block_hash_check::valid);
+}
+
+TEST(block_hash_check, dropped_past_area)
+{
+  test_chain chain;
+  const uint64_t end = GROUPS * HASH_OF_HASHES_STEP;
+  ASSERT_EQ(chain.prevalidate(end - HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP, end - HASH_OF_HASHES_STEP), HASH_OF_HASHES_STEP);
+
+  chain.check.cleanup(end + 4096);
+  ASSERT_EQ(chain.check.size(), GROUPS);
+  ASSERT_EQ(chain.check.groups(), 0);
+  ASSERT_TRUE(chain.check.is_within_area(end - 1));
+
+  chain.check.cleanup(end + 4097);
+  ASSERT_EQ(chain.check.size(), 0);
+  ASSERT_FALSE(chain.check.is_within_area(0));
+  ASSERT_EQ(chain.prevalidate(0, HASH_OF_HASHES_STEP, 0), HASH_OF_HASHES_STEP);
+  ASSERT_EQ(chain.check.groups(), 0);
+  ASSERT_EQ(chain.check.check(0, chain.blocks[0]), cryptonote::block_hash_check::unknown);
+}
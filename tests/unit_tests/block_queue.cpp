@@ -85,3 +85,43 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1());
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, reserve_and_fill)
+{
+  cryptonote::block_queue bq;
+  std::list<crypto::hash> hashes;
+  for (int n = 0; n < 10; ++n)
+    hashes.push_back(crypto::rand<crypto::hash>());
+
+  std::pair<uint64_t, uint64_t> span = bq.reserve_span(1, 10, 5, uuid1(), hashes);
+  ASSERT_EQ(span.first, 1);
+  ASSERT_EQ(span.second, 5);
+  ASSERT_TRUE(bq.requested(hashes.front()));
+  ASSERT_FALSE(bq.requested(hashes.back()));
+  span = bq.reserve_span(1, 10, 5, uuid2(), hashes);
+  ASSERT_EQ(span.first, 6);
+  ASSERT_EQ(span.second, 5);
+  ASSERT_TRUE(bq.requested(hashes.back()));
+  ASSERT_EQ(bq.get_num_filled_spans(), 0);
+  ASSERT_EQ(bq.get_data_size(), 0);
+
+  uint64_t height;
+  boost::uuids::uuid connection_id;
+  ASSERT_FALSE(bq.get_next_span(height, connection_id, true));
+  bq.add_blocks(6, std::vector<cryptonote::block_complete_entry>(5), uuid2(), 1.0f, 1000);
+  ASSERT_TRUE(bq.requested(hashes.back()));
+  ASSERT_EQ(bq.get_num_filled_spans(), 1);
+  ASSERT_EQ(bq.get_data_size(), 1000);
+  ASSERT_TRUE(bq.get_next_span(height, connection_id, true));
+  ASSERT_EQ(height, 6);
+  ASSERT_EQ(connection_id, uuid2());
+  ASSERT_TRUE(bq.get_next_span(height, connection_id, false));
+  ASSERT_EQ(height, 1);
+
+  ASSERT_TRUE(bq.remove_span(6));
+  ASSERT_FALSE(bq.requested(hashes.back()));
+  ASSERT_EQ(bq.get_num_filled_spans(), 0);
+  ASSERT_EQ(bq.get_data_size(), 0);
+  bq.flush_spans(uuid1());
+  ASSERT_FALSE(bq.requested(hashes.front()));
+}
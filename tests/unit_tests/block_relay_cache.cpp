@@ -0,0 +1,104 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/block_relay_cache.h"
+
+TEST(block_relay_cache, empty)
+{
+  cryptonote::block_relay_cache cache(4, 60);
+  cryptonote::block_relay_cache::payload_ptr block_blob;
+  std::vector<crypto::hash> tx_hashes;
+  ASSERT_FALSE(cache.get_block(crypto::rand<crypto::hash>(), block_blob, tx_hashes));
+  ASSERT_EQ(cache.size(), 0);
+}
+
+TEST(block_relay_cache, block_and_txes)
+{
+  cryptonote::block_relay_cache cache(4, 60);
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  const std::vector<crypto::hash> tx_hashes = {crypto::rand<crypto::hash>(), crypto::rand<crypto::hash>()};
+  cache.add_block(block_hash, "block", tx_hashes);
+
+  cryptonote::block_relay_cache::payload_ptr block_blob;
+  std::vector<crypto::hash> hashes;
+  ASSERT_TRUE(cache.get_block(block_hash, block_blob, hashes));
+  ASSERT_EQ(*block_blob, "block");
+  ASSERT_EQ(hashes, tx_hashes);
+
+  std::vector<cryptonote::block_relay_cache::payload_ptr> tx_blobs;
+  ASSERT_TRUE(cache.get_tx_blobs(block_hash, {0, 1}, tx_blobs));
+  ASSERT_EQ(tx_blobs.size(), 2);
+  ASSERT_FALSE(tx_blobs[0]);
+  ASSERT_FALSE(tx_blobs[1]);
+
+  cache.add_tx_blob(block_hash, 1, "tx1");
+  ASSERT_TRUE(cache.get_tx_blobs(block_hash, {1}, tx_blobs));
+  ASSERT_EQ(tx_blobs.size(), 1);
+  ASSERT_EQ(*tx_blobs[0], "tx1");
+
+  ASSERT_FALSE(cache.get_tx_blobs(block_hash, {2}, tx_blobs));
+}
+
+TEST(block_relay_cache, fluffy_response)
+{
+  cryptonote::block_relay_cache cache(4, 60);
+  const crypto::hash block_hash = crypto::rand<crypto::hash>();
+  cache.add_block(block_hash, "block", {crypto::rand<crypto::hash>()});
+  ASSERT_FALSE(cache.get_fluffy_response(block_hash, 10, {0}));
+  cache.add_fluffy_response(block_hash, 10, {0}, "response");
+  ASSERT_EQ(*cache.get_fluffy_response(block_hash, 10, {0}), "response");
+  ASSERT_FALSE(cache.get_fluffy_response(block_hash, 11, {0}));
+}
+
+TEST(block_relay_cache, evict)
+{
+  cryptonote::block_relay_cache cache(2, 60);
+  std::vector<crypto::hash> block_hashes;
+  for (int n = 0; n < 3; ++n)
+  {
+    block_hashes.push_back(crypto::rand<crypto::hash>());
+    cache.add_block(block_hashes.back(), "block", {});
+  }
+  ASSERT_EQ(cache.size(), 2);
+  cryptonote::block_relay_cache::payload_ptr block_blob;
+  std::vector<crypto::hash> tx_hashes;
+  ASSERT_FALSE(cache.get_block(block_hashes[0], block_blob, tx_hashes));
+  ASSERT_TRUE(cache.get_block(block_hashes[2], block_blob, tx_hashes));
+}
+
+TEST(block_relay_cache, prune)
+{
+  cryptonote::block_relay_cache cache(4, 60);
+  cache.add_block(crypto::rand<crypto::hash>(), "block", {});
+  cache.prune(time(NULL));
+  ASSERT_EQ(cache.size(), 1);
+  cache.prune(time(NULL) + 61);
+  ASSERT_EQ(cache.size(), 0);
+}
@@ -344,4 +344,62 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, BatchLookups)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // a missing hash in the middle, and the rest in reverse so the db has to reorder
+  std::vector<crypto::hash> hashes;
+  std::vector<crypto::key_image> key_images;
+  for (size_t n = 0; n < 2; ++n)
+  {
+    for (const auto &tx: this->m_txs[n])
+    {
+      hashes.push_back(get_transaction_hash(tx));
+      for (const auto &in: tx.vin)
+        if (in.type() == typeid(txin_to_key))
+          key_images.push_back(boost::get<txin_to_key>(in).k_image);
+    }
+  }
+  std::reverse(hashes.begin(), hashes.end());
+  hashes.insert(hashes.begin() + hashes.size() / 2, crypto::null_hash);
+  std::reverse(key_images.begin(), key_images.end());
+  key_images.insert(key_images.begin() + key_images.size() / 2, crypto::key_image());
+
+  std::vector<blobdata> blobs;
+  std::vector<bool> found;
+  ASSERT_NO_THROW(this->m_db->get_tx_blobs(hashes, blobs, found));
+  ASSERT_EQ(hashes.size(), blobs.size());
+  ASSERT_EQ(hashes.size(), found.size());
+  for (size_t n = 0; n < hashes.size(); ++n)
+  {
+    ASSERT_EQ(hashes[n] != crypto::null_hash, found[n]);
+    if (found[n])
+    {
+      transaction tx;
+      ASSERT_TRUE(parse_and_validate_tx_from_blob(blobs[n], tx));
+      ASSERT_HASH_EQ(hashes[n], get_transaction_hash(tx));
+    }
+  }
+
+  std::vector<bool> spent;
+  ASSERT_NO_THROW(this->m_db->has_key_images(key_images, spent));
+  ASSERT_EQ(key_images.size(), spent.size());
+  for (size_t n = 0; n < key_images.size(); ++n)
+  {
+    ASSERT_EQ(this->m_db->has_key_image(key_images[n]), spent[n]);
+    ASSERT_EQ(!(key_images[n] == crypto::key_image()), spent[n]);
+  }
+}
+
 }  // anonymous namespace
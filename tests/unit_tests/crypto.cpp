@@ -27,10 +27,12 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cstdint>
+#include <cstring>
 #include <gtest/gtest.h>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 
@@ -73,3 +75,62 @@ TEST(Crypto, Ostream)
   EXPECT_TRUE(is_formatted<crypto::key_derivation>());
   EXPECT_TRUE(is_formatted<crypto::key_image>());
 }
+
+TEST(Crypto, check_ring_signatures)
+{
+  static const size_t ring_size = 5;
+  static const size_t batch_size = 4;
+  std::vector<crypto::public_key> pubs(ring_size * batch_size);
+  std::vector<const crypto::public_key*> pub_ptrs(pubs.size());
+  std::vector<crypto::key_image> images(batch_size);
+  std::vector<crypto::hash> prefix_hashes(batch_size);
+  std::vector<crypto::signature> sigs(ring_size * batch_size);
+  std::vector<crypto::ring_signature_check> checks(batch_size);
+  for (size_t n = 0; n < batch_size; ++n)
+  {
+    const size_t real_index = n % ring_size;
+    crypto::secret_key real_sec;
+    for (size_t i = 0; i < ring_size; ++i)
+    {
+      crypto::secret_key sec;
+      crypto::generate_keys(pubs[n * ring_size + i], sec);
+      pub_ptrs[n * ring_size + i] = &pubs[n * ring_size + i];
+      if (i == real_index)
+        real_sec = sec;
+    }
+    crypto::generate_key_image(pubs[n * ring_size + real_index], real_sec, images[n]);
+    prefix_hashes[n] = crypto::rand<crypto::hash>();
+    crypto::generate_ring_signature(prefix_hashes[n], images[n], &pub_ptrs[n * ring_size], ring_size, real_sec, real_index, &sigs[n * ring_size]);
+    checks[n] = {&prefix_hashes[n], &images[n], &pub_ptrs[n * ring_size], ring_size, &sigs[n * ring_size]};
+  }
+
+  bool results[batch_size];
+  ASSERT_TRUE(crypto::check_ring_signatures(checks.data(), checks.size(), results));
+  for (size_t n = 0; n < batch_size; ++n)
+  {
+    ASSERT_TRUE(results[n]);
+    ASSERT_TRUE(crypto::check_ring_signature(prefix_hashes[n], images[n], &pub_ptrs[n * ring_size], ring_size, &sigs[n * ring_size]));
+  }
+
+  // a bad signature only fails its own entry
+  prefix_hashes[1] = crypto::rand<crypto::hash>();
+  ASSERT_FALSE(crypto::check_ring_signatures(checks.data(), checks.size(), results));
+  ASSERT_TRUE(results[0]);
+  ASSERT_FALSE(results[1]);
+  ASSERT_TRUE(results[2]);
+  ASSERT_TRUE(results[3]);
+
+  // so does a key image which is not a point
+  do
+  {
+    images[3] = crypto::rand<crypto::key_image>();
+  } while (crypto::check_key((const crypto::public_key&)images[3]));
+  ASSERT_FALSE(crypto::check_ring_signatures(checks.data(), checks.size(), results));
+  ASSERT_TRUE(results[0]);
+  ASSERT_FALSE(results[1]);
+  ASSERT_TRUE(results[2]);
+  ASSERT_FALSE(results[3]);
+
+  ASSERT_TRUE(crypto::check_ring_signatures(checks.data(), 1, NULL));
+  ASSERT_TRUE(crypto::check_ring_signatures(NULL, 0, NULL));
+}
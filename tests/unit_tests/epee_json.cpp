@@ -0,0 +1,175 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <list>
+#include <string>
+#include <vector>
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  struct inner
+  {
+    std::string name;
+    int64_t delta;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(delta)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct outer
+  {
+    std::string text;
+    uint64_t amount;
+    double ratio;
+    bool flag;
+    std::vector<uint64_t> indices;
+    std::list<inner> items;
+    std::vector<std::string> hashes;
+    std::string blob;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(text)
+      KV_SERIALIZE(amount)
+      KV_SERIALIZE(ratio)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(indices)
+      KV_SERIALIZE(items)
+      KV_SERIALIZE(hashes)
+      KV_SERIALIZE(blob)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  std::string lenient_parse(const std::string &json)
+  {
+    epee::serialization::portable_storage ps;
+    std::string::const_iterator it = json.begin();
+    epee::serialization::json::run_handler(nullptr, it, json.end(), ps);
+    std::string out;
+    ps.dump_as_json(out);
+    return out;
+  }
+
+  std::string parse(const std::string &json)
+  {
+    epee::serialization::portable_storage ps;
+    if (!ps.load_from_json(json))
+      return "failed";
+    std::string out;
+    ps.dump_as_json(out);
+    return out;
+  }
+}
+
+TEST(epee_json, round_trip)
+{
+  outer o;
+  o.text = "quote \" backslash \\ slash / newline \n";
+  o.amount = 18446744073709551615ull;
+  o.ratio = 0.25;
+  o.flag = true;
+  o.indices = {0, 1, 9223372036854775807ull};
+  o.items.push_back({"a", -5});
+  o.items.push_back({"b", 9223372036854775807ll});
+  o.hashes = {"00", "ff"};
+  // control characters and NULs, which only the lenient parser accepts
+  o.blob = std::string("\x00\x01\x7f\x80\xff", 5);
+
+  std::string json;
+  ASSERT_TRUE(epee::serialization::store_t_to_json(o, json));
+  outer r;
+  ASSERT_TRUE(epee::serialization::load_t_from_json(r, json));
+  ASSERT_EQ(r.text, o.text);
+  ASSERT_EQ(r.amount, o.amount);
+  ASSERT_EQ(r.ratio, o.ratio);
+  ASSERT_EQ(r.flag, o.flag);
+  ASSERT_EQ(r.indices, o.indices);
+  ASSERT_EQ(r.items.size(), 2);
+  ASSERT_EQ(r.items.front().name, "a");
+  ASSERT_EQ(r.items.front().delta, -5);
+  ASSERT_EQ(r.items.back().delta, 9223372036854775807ll);
+  ASSERT_EQ(r.hashes, o.hashes);
+  ASSERT_EQ(r.blob, o.blob);
+}
+
+TEST(epee_json, same_as_lenient_parser)
+{
+  static const char * const inputs[] = {
+    "{}",
+    "  {\"a\": 1, \"b\": -1, \"c\": 1.5, \"d\": true, \"e\": false, \"f\": null, \"g\": \"x\"}  trailing",
+    "{\"a\": {\"b\": {\"c\": [1, 2, 3]}}, \"d\": [], \"e\": [{}, {\"f\": \"g\"}]}",
+    "{\"a\": [-1, 18446744073709551615], \"b\": [true, false], \"c\": [\"x\", \"y\"], \"d\": [0.5, 1.5]}",
+    "{\"a\": 1, \"a\": \"overwritten\"}",
+    "{\"method\": \"get_outs\", \"params\": {\"outputs\": [{\"amount\": 0, \"index\": 1}, {\"amount\": 0, \"index\": 2}]}}",
+  };
+  for (const char *input: inputs)
+  {
+    std::string expected;
+    try { expected = lenient_parse(input); }
+    catch (...) { expected = "failed"; }
+    EXPECT_EQ(parse(input), expected) << input;
+  }
+}
+
+TEST(epee_json, invalid)
+{
+  EXPECT_EQ(parse("[1]"), "failed");
+  EXPECT_EQ(parse("{\"a\": [[1]]}"), "failed");
+  EXPECT_EQ(parse("{\"a\": [1, \"x\"]}"), "failed");
+  EXPECT_EQ(parse("{\"a\": [null]}"), "failed");
+  EXPECT_EQ(parse("{\"a\": 18446744073709551616}"), "failed");
+  EXPECT_EQ(parse("{\"a\": 1"), "failed");
+}
+
+TEST(epee_json, unicode_escapes)
+{
+  // the lenient parser kept the letter and dropped the backslash
+  EXPECT_EQ(lenient_parse("{\"a\": \"\\u0041\"}"), "{\r\n  \"a\": \"u0041\"\r\n}");
+
+  // \uXXXX, including surrogate pairs, is now decoded to UTF-8
+  epee::serialization::portable_storage ps;
+  ASSERT_TRUE(ps.load_from_json("{\"a\": \"\\u0041\\u00e9\", \"b\": \"\\ud83d\\ude00\"}"));
+  std::string a, b;
+  ASSERT_TRUE(ps.get_value("a", a, nullptr));
+  ASSERT_EQ(a, "A\xc3\xa9");
+  ASSERT_TRUE(ps.get_value("b", b, nullptr));
+  ASSERT_EQ(b, "\xf0\x9f\x98\x80");
+
+  // a lone surrogate is not valid JSON, so that input still goes through
+  // the lenient parser and keeps the old result
+  epee::serialization::portable_storage lone;
+  ASSERT_TRUE(lone.load_from_json("{\"a\": \"\\ud83d\"}"));
+  ASSERT_TRUE(lone.get_value("a", a, nullptr));
+  ASSERT_EQ(a, "ud83d");
+}
@@ -149,6 +149,12 @@ namespace
       return m_send_return;
     }
 
+    virtual bool do_send(const std::shared_ptr<const std::string>& buffer)
+    {
+      m_last_send_buffer = buffer;
+      return do_send(buffer->data(), buffer->size());
+    }
+
     virtual bool close()                              { /*std::cout << "test_connection::close()" << std::endl; */return true; }
     virtual bool call_run_once_service_io()           { std::cout << "test_connection::call_run_once_service_io()" << std::endl; return true; }
     virtual bool request_callback()                   { std::cout << "test_connection::request_callback()" << std::endl; return true; }
@@ -159,6 +165,7 @@ namespace
     size_t send_counter() const { return m_send_counter.get(); }
 
     const std::string& last_send_data() const { return m_last_send_data; }
+    const std::shared_ptr<const std::string>& last_send_buffer() const { return m_last_send_buffer; }
     void reset_last_send_data() { boost::unique_lock<boost::mutex> lock(m_mutex); m_last_send_data.clear(); }
 
     bool send_return() const { return m_send_return; }
@@ -175,6 +182,7 @@ namespace
     boost::mutex m_mutex;
 
     std::string m_last_send_data;
+    std::shared_ptr<const std::string> m_last_send_buffer;
 
     bool m_send_return;
   };
@@ -413,6 +421,34 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, shared_notify_is_sent_without_copy)
+{
+  // Setup
+  const int expected_command = 4673262;
+
+  test_connection_ptr conn1 = create_connection();
+  test_connection_ptr conn2 = create_connection();
+
+  std::string in_data(256, 'n');
+
+  ASSERT_EQ(1, conn1->m_protocol_handler.notify(expected_command, in_data));
+  const std::string expected_data = conn1->last_send_data();
+  conn1->reset_last_send_data();
+
+  // Test
+  const std::shared_ptr<const std::string> message = epee::levin::make_notify(expected_command, in_data);
+  ASSERT_EQ(1, conn1->m_protocol_handler.notify(message));
+  ASSERT_EQ(1, conn2->m_protocol_handler.notify(message));
+
+  // Check the framed message is the same as a plain notify, and both connections got the same buffer
+  ASSERT_EQ(expected_data, *message);
+  ASSERT_EQ(expected_data, conn1->last_send_data());
+  ASSERT_EQ(expected_data, conn2->last_send_data());
+  ASSERT_EQ(message.get(), conn1->last_send_buffer().get());
+  ASSERT_EQ(message.get(), conn2->last_send_buffer().get());
+  ASSERT_EQ(1, conn2->send_counter());
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
   test_connection_ptr conn = create_connection();
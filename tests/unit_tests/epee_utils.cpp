@@ -379,6 +379,60 @@ TEST(ToHex, Formatted)
   EXPECT_EQ(expected, out.str());
 }
 
+TEST(FromHex, String)
+{
+  std::string out;
+  EXPECT_TRUE(epee::from_hex::string(out, nullptr));
+  EXPECT_TRUE(out.empty());
+
+  const std::string hex{"ffAB0100"};
+  EXPECT_TRUE(epee::from_hex::string(out, {hex.data(), hex.size()}));
+  EXPECT_EQ(std::string("\xff\xab\x01\x00", 4), out);
+
+  const std::vector<unsigned char> all_bytes = get_all_bytes();
+  const std::string all_hex = std_to_hex(all_bytes);
+  EXPECT_TRUE(epee::from_hex::string(out, {all_hex.data(), all_hex.size()}));
+  EXPECT_EQ(std::string(all_bytes.begin(), all_bytes.end()), out);
+
+  EXPECT_FALSE(epee::from_hex::string(out, {hex.data(), 3}));
+  for (const char *bad : {"0g", "g0", " a", "+a", "-1", "0x"})
+  {
+    EXPECT_FALSE(epee::from_hex::string(out, {bad, 2})) << bad;
+    EXPECT_TRUE(out.empty());
+  }
+}
+
+TEST(FromHex, Buffer)
+{
+  std::uint8_t out[4] = {};
+  EXPECT_TRUE(epee::from_hex::buffer(out, {"ffab0100", 8}));
+  EXPECT_EQ(0xff, out[0]);
+  EXPECT_EQ(0xab, out[1]);
+  EXPECT_EQ(0x01, out[2]);
+  EXPECT_EQ(0x00, out[3]);
+  EXPECT_FALSE(epee::from_hex::buffer(out, {"ffab01", 6}));
+  EXPECT_FALSE(epee::from_hex::buffer(out, {"ffab0100ff", 10}));
+  EXPECT_FALSE(epee::from_hex::buffer(out, {"ffab01z0", 8}));
+}
+
+TEST(StringTools, ParseHexstrToBinbuff)
+{
+  std::string out;
+  EXPECT_TRUE(epee::string_tools::parse_hexstr_to_binbuff(std::string("ffab01"), out));
+  EXPECT_EQ(std::string("\xff\xab\x01"), out);
+  EXPECT_FALSE(epee::string_tools::parse_hexstr_to_binbuff(std::string("ffab0"), out));
+  EXPECT_TRUE(epee::string_tools::parse_hexstr_to_binbuff(std::string("ffab0"), out, true));
+  EXPECT_EQ(std::string("\xff\xab\x00", 3), out);
+  EXPECT_FALSE(epee::string_tools::parse_hexstr_to_binbuff(std::string("ffabx"), out, true));
+
+  struct some_pod { unsigned char data[2]; } pod{{1, 2}};
+  EXPECT_FALSE(epee::string_tools::parse_tpod_from_hex_string(std::string("ffxx"), pod));
+  EXPECT_EQ(1, pod.data[0]);
+  EXPECT_TRUE(epee::string_tools::parse_tpod_from_hex_string(std::string("ffab"), pod));
+  EXPECT_EQ(0xff, pod.data[0]);
+  EXPECT_EQ(0xab, pod.data[1]);
+}
+
 TEST(StringTools, BuffToHex)
 {
   const std::vector<unsigned char> all_bytes = get_all_bytes();
@@ -28,6 +28,8 @@
 
 #include "gtest/gtest.h"
 #include "net/http_auth.h"
+#include "net/http_client_pool.h"
+#include "net/http_protocol_handler.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -51,6 +53,8 @@
 #include <boost/spirit/include/qi_plus.hpp>
 #include <boost/spirit/include/qi_sequence.hpp>
 #include <boost/spirit/include/qi_string.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
 #include <cstdint>
 #include <iterator>
 #include <string>
@@ -743,3 +747,239 @@ TEST(HTTP, Add_Field)
 
   EXPECT_STREQ("leading textfoo: bar\r\nbar: foo\r\nmoarbars: moarfoo\r\n", str.c_str());
 }
+
+TEST(HTTP, Parse_Request_Line)
+{
+  http::http_request_info info{};
+  ASSERT_TRUE(http::parse_request_line("post /json_rpc?a=b HTTP/1.0", info));
+  EXPECT_EQ(http::http_method_post, info.m_http_method);
+  EXPECT_EQ("post", info.m_http_method_str);
+  EXPECT_EQ("/json_rpc?a=b", info.m_URI);
+  EXPECT_EQ(1, info.m_http_ver_hi);
+  EXPECT_EQ(0, info.m_http_ver_lo);
+
+  ASSERT_TRUE(http::parse_request_line("DELETE / HTTP/1.1", info));
+  EXPECT_EQ(http::http_method_etc, info.m_http_method);
+  EXPECT_EQ(1, info.m_http_ver_lo);
+
+  EXPECT_FALSE(http::parse_request_line("", info));
+  EXPECT_FALSE(http::parse_request_line("GET", info));
+  EXPECT_FALSE(http::parse_request_line("GET  HTTP/1.1", info));
+  EXPECT_FALSE(http::parse_request_line("PATCH / HTTP/1.1", info));
+  EXPECT_FALSE(http::parse_request_line("GET / HTTP/1", info));
+  EXPECT_FALSE(http::parse_request_line("GET / HTTP/1.1 ", info));
+  EXPECT_FALSE(http::parse_request_line("GET / FTP/1.1", info));
+}
+
+TEST(HTTP, Parse_Header_Fields)
+{
+  http::http_header_info info{};
+  http::parse_header_fields(
+    "content-length:  12 \r\n"
+    "Connection: keep-alive, Upgrade\r\n"
+    "no colon here\r\n"
+    "X-Custom:\tvalue: with colon\n"
+    "\r\n"
+    "Host: after the end\r\n", info);
+
+  EXPECT_EQ("12", info.m_content_length);
+  EXPECT_EQ("keep-alive, Upgrade", info.m_connection);
+  EXPECT_TRUE(info.m_host.empty());
+  ASSERT_EQ(1u, info.m_etc_fields.size());
+  EXPECT_EQ("X-Custom", info.m_etc_fields.front().first);
+  EXPECT_EQ("value: with colon", info.m_etc_fields.front().second);
+
+  EXPECT_TRUE(http::has_connection_token(info.m_connection, "upgrade"));
+  EXPECT_TRUE(http::has_connection_token(info.m_connection, "Keep-Alive"));
+  EXPECT_FALSE(http::has_connection_token(info.m_connection, "close"));
+  EXPECT_FALSE(http::has_connection_token("", "close"));
+
+  std::size_t len = 0;
+  EXPECT_TRUE(http::parse_content_length(info.m_content_length, len));
+  EXPECT_EQ(12u, len);
+  EXPECT_FALSE(http::parse_content_length("", len));
+  EXPECT_FALSE(http::parse_content_length("-1", len));
+  EXPECT_FALSE(http::parse_content_length("99999999999999999999999", len));
+}
+
+namespace
+{
+  struct test_endpoint final : epee::net_utils::i_service_endpoint
+  {
+    std::string sent;
+    std::size_t sends = 0;
+
+    virtual bool do_send(const void* ptr, size_t cb) override
+    {
+      sent.append(static_cast<const char*>(ptr), cb);
+      ++sends;
+      return true;
+    }
+    virtual bool close() override { return true; }
+    virtual bool call_run_once_service_io() override { return true; }
+    virtual bool request_callback() override { return true; }
+    virtual boost::asio::io_service& get_io_service() override { return io_service; }
+    virtual bool add_ref() override { return true; }
+    virtual bool release() override { return true; }
+
+    boost::asio::io_service io_service;
+  };
+
+  struct echo_handler final : http::simple_http_connection_handler<>
+  {
+    echo_handler(epee::net_utils::i_service_endpoint* endpoint, http::http_server_config& config)
+      : http::simple_http_connection_handler<>(endpoint, config)
+    {}
+
+    virtual bool handle_request(const http::http_request_info& query_info, http::http_response_info& response) override
+    {
+      response.m_response_code = 200;
+      response.m_response_comment = "OK";
+      response.m_body = query_info.m_URI + "=" + query_info.m_body;
+      return true;
+    }
+  };
+
+  std::vector<std::string> response_bodies(const std::string& sent)
+  {
+    std::vector<std::string> bodies;
+    std::size_t pos = 0;
+    while ((pos = sent.find("\r\n\r\n", pos)) != std::string::npos)
+    {
+      const std::size_t len_pos = sent.rfind("Content-Length: ", pos);
+      const std::size_t len = std::stoul(sent.substr(len_pos + 16));
+      bodies.push_back(sent.substr(pos + 4, len));
+      pos += 4 + len;
+    }
+    return bodies;
+  }
+}
+
+TEST(HTTP_Server, Pipelining)
+{
+  const std::string requests =
+    "POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\none"
+    "GET /b HTTP/1.1\r\n\r\n"
+    "POST /c HTTP/1.1\r\nContent-Length: 5\r\n\r\nthree";
+  const std::vector<std::string> expected{"/a=one", "/b=", "/c=three"};
+
+  // all at once
+  {
+    http::http_server_config config{};
+    test_endpoint endpoint;
+    echo_handler handler(&endpoint, config);
+    EXPECT_TRUE(handler.handle_recv(requests.data(), requests.size()));
+    EXPECT_EQ(expected, response_bodies(endpoint.sent));
+    EXPECT_EQ(3u, endpoint.sends);
+  }
+
+  // a byte at a time
+  {
+    http::http_server_config config{};
+    test_endpoint endpoint;
+    echo_handler handler(&endpoint, config);
+    for (const char c: requests)
+      EXPECT_TRUE(handler.handle_recv(&c, 1));
+    EXPECT_EQ(expected, response_bodies(endpoint.sent));
+  }
+}
+
+TEST(HTTP_Server, Connection_Close)
+{
+  {
+    // nothing after a close is answered
+    const std::string requests =
+      "GET /a HTTP/1.1\r\nConnection: close\r\n\r\n"
+      "GET /b HTTP/1.1\r\n\r\n";
+    http::http_server_config config{};
+    test_endpoint endpoint;
+    echo_handler handler(&endpoint, config);
+    EXPECT_FALSE(handler.handle_recv(requests.data(), requests.size()));
+    EXPECT_EQ(std::vector<std::string>{"/a="}, response_bodies(endpoint.sent));
+    EXPECT_NE(std::string::npos, endpoint.sent.find("Connection: close\r\n"));
+  }
+  {
+    const std::string request = "GET /a HTTP/1.0\r\n\r\n";
+    http::http_server_config config{};
+    test_endpoint endpoint;
+    echo_handler handler(&endpoint, config);
+    EXPECT_FALSE(handler.handle_recv(request.data(), request.size()));
+    EXPECT_NE(std::string::npos, endpoint.sent.find("Connection: close\r\n"));
+  }
+  {
+    const std::string request = "GET /a HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n";
+    http::http_server_config config{};
+    test_endpoint endpoint;
+    echo_handler handler(&endpoint, config);
+    EXPECT_TRUE(handler.handle_recv(request.data(), request.size()));
+    EXPECT_NE(std::string::npos, endpoint.sent.find("Connection: keep-alive\r\n"));
+  }
+}
+
+namespace
+{
+  struct test_client
+  {
+    static std::atomic<unsigned> constructed;
+    std::string host;
+    std::string port;
+    bool connected = false;
+
+    test_client() { ++constructed; }
+    void set_server(std::string host_, std::string port_, boost::optional<http::login>, bool)
+    {
+      host = std::move(host_);
+      port = std::move(port_);
+      connected = false;
+    }
+    bool disconnect() { connected = false; return true; }
+  };
+  std::atomic<unsigned> test_client::constructed{0};
+}
+
+TEST(HTTP_Client_Pool, Reuse)
+{
+  test_client::constructed = 0;
+  http::http_client_pool_template<test_client> pool{2};
+  ASSERT_TRUE(pool.set_server("http://127.0.0.1:18081", boost::none));
+
+  test_client* first = nullptr;
+  {
+    auto client = pool.acquire();
+    EXPECT_EQ("127.0.0.1", client->host);
+    EXPECT_EQ("18081", client->port);
+    client->connected = true;
+    first = std::addressof(*client);
+  }
+  {
+    auto a = pool.acquire();
+    auto b = pool.acquire();
+    EXPECT_EQ(first, std::addressof(*a));
+    EXPECT_TRUE(a->connected);
+    EXPECT_NE(first, std::addressof(*b));
+  }
+  EXPECT_EQ(2u, test_client::constructed);
+
+  pool.set_server("127.0.0.2", "18089", boost::none);
+  {
+    auto client = pool.acquire();
+    EXPECT_EQ("127.0.0.2", client->host);
+    EXPECT_FALSE(client->connected);
+  }
+  EXPECT_EQ(3u, test_client::constructed);
+}
+
+TEST(HTTP_Client_Pool, Limit)
+{
+  http::http_client_pool_template<test_client> pool{1};
+  pool.set_server("127.0.0.1", "18081", boost::none);
+
+  std::atomic<bool> acquired{false};
+  boost::optional<http::http_client_pool_template<test_client>::handle> held{pool.acquire()};
+  boost::thread waiter([&]{ auto client = pool.acquire(); acquired = true; });
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+  EXPECT_FALSE(acquired);
+  held = boost::none;
+  waiter.join();
+  EXPECT_TRUE(acquired);
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/known_tx_filter.h"
+
+TEST(known_tx_filter, insert)
+{
+  cryptonote::known_tx_filter filter(16);
+  const crypto::hash h = crypto::rand<crypto::hash>();
+  ASSERT_FALSE(filter.contains(h));
+  ASSERT_TRUE(filter.insert(h));
+  ASSERT_TRUE(filter.contains(h));
+  ASSERT_FALSE(filter.insert(h));
+  ASSERT_EQ(filter.size(), 1);
+}
+
+TEST(known_tx_filter, evicts_oldest)
+{
+  cryptonote::known_tx_filter filter(4);
+  std::vector<crypto::hash> hashes;
+  for (int n = 0; n < 6; ++n)
+  {
+    hashes.push_back(crypto::rand<crypto::hash>());
+    ASSERT_TRUE(filter.insert(hashes.back()));
+  }
+  ASSERT_EQ(filter.size(), 4);
+  ASSERT_FALSE(filter.contains(hashes[0]));
+  ASSERT_FALSE(filter.contains(hashes[1]));
+  for (int n = 2; n < 6; ++n)
+    ASSERT_TRUE(filter.contains(hashes[n]));
+}
+
+TEST(known_tx_filter, clear)
+{
+  cryptonote::known_tx_filter filter(4);
+  const crypto::hash h = crypto::rand<crypto::hash>();
+  filter.insert(h);
+  filter.clear();
+  ASSERT_EQ(filter.size(), 0);
+  ASSERT_FALSE(filter.contains(h));
+  ASSERT_TRUE(filter.insert(h));
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "metrics.h"
+#include "common/perf_timer.h"
+
+TEST(metrics, bucket_bounds)
+{
+  for (size_t i = 0; i < epee::metrics::histogram::N_BUCKETS; ++i)
+  {
+    const uint64_t lower = epee::metrics::histogram::bucket_lower_bound(i);
+    const uint64_t upper = epee::metrics::histogram::bucket_upper_bound(i);
+    ASSERT_LE(lower, upper);
+    ASSERT_EQ(epee::metrics::histogram::bucket_index(lower), i);
+    ASSERT_EQ(epee::metrics::histogram::bucket_index(upper), i);
+    if (i > 0)
+      ASSERT_EQ(epee::metrics::histogram::bucket_upper_bound(i - 1) + 1, lower);
+  }
+  ASSERT_EQ(epee::metrics::histogram::bucket_upper_bound(epee::metrics::histogram::N_BUCKETS - 1), std::numeric_limits<uint64_t>::max());
+}
+
+TEST(metrics, quantiles)
+{
+  epee::metrics::histogram h;
+  ASSERT_EQ(h.quantile(0.5), 0);
+  for (uint64_t v = 1; v <= 10000; ++v)
+    h.record(v);
+  ASSERT_EQ(h.count(), 10000);
+  ASSERT_EQ(h.sum(), 10000 * 10001 / 2);
+  ASSERT_EQ(h.max(), 10000);
+  // within the 12.5% bucket resolution
+  ASSERT_GE(h.quantile(0.5), 5000);
+  ASSERT_LE(h.quantile(0.5), 5000 * 9 / 8);
+  ASSERT_GE(h.quantile(0.99), 9900);
+  ASSERT_LE(h.quantile(0.99), 10000);
+  ASSERT_EQ(h.quantile(1.0), 10000);
+  ASSERT_EQ(h.count_below(16), 15);
+  ASSERT_EQ(h.count_below(1024), 1023);
+  ASSERT_EQ(h.count_through(15), 15);
+  // counts the whole bucket 1024 is in, 1024 to 1151
+  ASSERT_EQ(epee::metrics::histogram::bucket_upper_bound(epee::metrics::histogram::bucket_index(1024)), 1151);
+  ASSERT_EQ(h.count_through(1024), 1151);
+  ASSERT_EQ(h.count_through(1151), 1151);
+  ASSERT_EQ(h.count_through(1152), 1151 + 128);
+  h.reset();
+  ASSERT_EQ(h.count(), 0);
+  ASSERT_EQ(h.max(), 0);
+  ASSERT_EQ(h.count_below(1024), 0);
+}
+
+TEST(metrics, registry)
+{
+  epee::metrics::counter &c0 = epee::metrics::get_counter("unit_test_events_total{kind=\"a\"}", "Test events");
+  epee::metrics::counter &c1 = epee::metrics::get_counter("unit_test_events_total{kind=\"a\"}");
+  epee::metrics::counter &c2 = epee::metrics::get_counter("unit_test_events_total{kind=\"b\"}");
+  ASSERT_EQ(&c0, &c1);
+  ASSERT_NE(&c0, &c2);
+  c0.inc(3);
+  c2.inc();
+  ASSERT_EQ(c1.get(), 3);
+  ASSERT_THROW(epee::metrics::get_gauge("unit_test_events_total"), std::exception);
+
+  epee::metrics::gauge &g = epee::metrics::get_gauge("unit_test_level");
+  g.set(10);
+  g.dec(4);
+  ASSERT_EQ(g.get(), 6);
+
+  epee::metrics::histogram &h = epee::metrics::get_histogram("unit_test_latency_seconds", "Test latency", 1e-9);
+  h.record(2000);
+  h.record(5000000);
+  // le is inclusive, and is the top of the bucket holding 4^i
+  epee::metrics::histogram &reorgs = epee::metrics::get_histogram("unit_test_depth_blocks");
+  reorgs.record(1);
+  reorgs.record(4);
+  reorgs.record(17);
+  reorgs.record(18);
+  reorgs.record(71);
+  reorgs.record(72);
+
+  const std::string text = epee::metrics::to_prometheus();
+  ASSERT_NE(text.find("# HELP unit_test_events_total Test events\n# TYPE unit_test_events_total counter\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_events_total{kind=\"a\"} 3\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_events_total{kind=\"b\"} 1\n"), std::string::npos);
+  ASSERT_NE(text.find("# TYPE unit_test_level gauge\nunit_test_level 6\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_latency_seconds_bucket{le=\"1.151e-06\"} 0\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_latency_seconds_bucket{le=\"4.607e-06\"} 1\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_latency_seconds_bucket{le=\"+Inf\"} 2\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_latency_seconds_count 2\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_depth_blocks_bucket{le=\"1\"} 1\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_depth_blocks_bucket{le=\"4\"} 2\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_depth_blocks_bucket{le=\"17\"} 3\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_depth_blocks_bucket{le=\"71\"} 5\n"), std::string::npos);
+  ASSERT_NE(text.find("unit_test_depth_blocks_bucket{le=\"287\"} 6\n"), std::string::npos);
+  // the TYPE line is only given once per family
+  ASSERT_EQ(text.find("# TYPE unit_test_events_total", text.find("# TYPE unit_test_events_total") + 1), std::string::npos);
+}
+
+TEST(metrics, perf_timer)
+{
+  tools::reset_performance_timer_stats();
+  for (int i = 0; i < 3; ++i)
+  {
+    PERF_TIMER(unit_test_timer);
+  }
+  const auto stats = tools::get_performance_timer_stats();
+  const auto i = stats.find("unit_test_timer");
+  ASSERT_TRUE(i != stats.end());
+  ASSERT_EQ(i->second.count, 3);
+  ASSERT_NE(epee::metrics::to_prometheus().find("perf_timer_seconds_count{timer=\"unit_test_timer\"} 3\n"), std::string::npos);
+}
@@ -202,3 +202,22 @@ TEST(mnemonics, language_detection_with_bad_checksum)
     ASSERT_EQ(true, res);
     ASSERT_STREQ(language_name.c_str(), "Português");
 }
+
+TEST(mnemonics, word_lookup)
+{
+  const Language::Base &language = *Language::Singleton<Language::English>::instance();
+  const std::vector<std::string> &word_list = language.get_word_list();
+  ASSERT_EQ(word_list.size(), (size_t)Language::Base::NUM_WORDS);
+  for (uint32_t i = 0; i < Language::Base::NUM_WORDS; ++i)
+  {
+    uint32_t index;
+    ASSERT_EQ(word_list[i], language.get_word(i));
+    ASSERT_TRUE(language.find_word(word_list[i], index));
+    ASSERT_EQ(index, i);
+    ASSERT_TRUE(language.find_word_prefix(word_list[i].substr(0, language.get_unique_prefix_length()), index));
+    ASSERT_EQ(index, i);
+  }
+  uint32_t index;
+  ASSERT_FALSE(language.find_word("notaword", index));
+  ASSERT_FALSE(language.find_word_prefix("zzz", index));
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+TEST(output_distribution, compress_integer_array)
+{
+  const std::vector<uint64_t> empty;
+  ASSERT_TRUE(cryptonote::compress_integer_array(empty).empty());
+  ASSERT_EQ(empty, cryptonote::decompress_integer_array(""));
+
+  std::vector<uint64_t> v = {0, 3, 3, 10, 2, 0, std::numeric_limits<uint64_t>::max(), 1, 0x8000000000000000ull, 12345678901234ull};
+  ASSERT_EQ(v, cryptonote::decompress_integer_array(cryptonote::compress_integer_array(v)));
+
+  // a cumulative distribution takes one byte per block for small counts
+  std::vector<uint64_t> cumulative;
+  uint64_t total = 1000000;
+  for (size_t n = 0; n < 1000; ++n)
+    cumulative.push_back(total += n % 40);
+  const std::string compressed = cryptonote::compress_integer_array(cumulative);
+  ASSERT_EQ(cumulative, cryptonote::decompress_integer_array(compressed));
+  ASSERT_LT(compressed.size(), cumulative.size() + 8);
+}
+
+TEST(output_distribution, decompress_truncated)
+{
+  std::string compressed = cryptonote::compress_integer_array({1, 1000000});
+  compressed.pop_back();
+  ASSERT_THROW(cryptonote::decompress_integer_array(compressed), std::runtime_error);
+}
+
+TEST(output_distribution, serialize_compressed)
+{
+  for (bool compress: {false, true})
+  {
+    cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res), res2 = AUTO_VAL_INIT(res2);
+    res.status = CORE_RPC_STATUS_OK;
+    res.distributions.push_back({0, 1009827, {5, 9, 9, 14, 20}, 0, compress});
+    res.distributions.push_back({1000000, 1000, {}, 3, compress});
+    std::string data;
+    ASSERT_TRUE(epee::serialization::store_t_to_binary(res, data));
+    ASSERT_TRUE(epee::serialization::load_t_from_binary(res2, data));
+    ASSERT_EQ(2, res2.distributions.size());
+    for (size_t n = 0; n < res.distributions.size(); ++n)
+    {
+      ASSERT_EQ(res.distributions[n].amount, res2.distributions[n].amount);
+      ASSERT_EQ(res.distributions[n].start_height, res2.distributions[n].start_height);
+      ASSERT_EQ(res.distributions[n].distribution, res2.distributions[n].distribution);
+      ASSERT_EQ(res.distributions[n].base, res2.distributions[n].base);
+      ASSERT_EQ(compress, res2.distributions[n].compress);
+    }
+  }
+}
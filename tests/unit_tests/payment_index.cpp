@@ -0,0 +1,199 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <unordered_map>
+#include "crypto/crypto.h"
+#include "wallet/payment_index.h"
+
+namespace
+{
+  struct payment
+  {
+    uint64_t m_block_height;
+    uint64_t m_amount;
+  };
+
+  typedef std::unordered_multimap<crypto::hash, payment> payment_container;
+  typedef tools::payment_index<payment_container> payment_index;
+
+  crypto::hash make_id(uint64_t n)
+  {
+    crypto::hash h = crypto::null_hash;
+    memcpy(&h, &n, sizeof(n));
+    return h;
+  }
+
+  void add(payment_container &payments, payment_index &index, uint64_t id, uint64_t height, uint64_t amount)
+  {
+    index.insert(*payments.emplace(make_id(id), payment{height, amount}));
+  }
+
+  payment_container::iterator find_amount(payment_container &payments, uint64_t amount)
+  {
+    for (auto i = payments.begin(); i != payments.end(); ++i)
+      if (i->second.m_amount == amount)
+        return i;
+    return payments.end();
+  }
+
+  // every indexed pointer still points at the element it was taken from,
+  // and the index matches one built from scratch
+  void check_index(const payment_container &payments, const payment_index &index)
+  {
+    payment_index rebuilt;
+    rebuilt.rebuild(payments);
+    ASSERT_EQ(index.size(), payments.size());
+    ASSERT_EQ(rebuilt.size(), payments.size());
+
+    uint64_t prev_height = 0;
+    for (const auto &e: index.by_height())
+    {
+      ASSERT_EQ(e.first, e.second->second.m_block_height);
+      ASSERT_GE(e.first, prev_height);
+      prev_height = e.first;
+      bool found = false;
+      for (const auto &p: payments)
+        found |= &p == e.second;
+      ASSERT_TRUE(found);
+    }
+
+    for (const auto &p: payments)
+    {
+      const payment_index::id_index *by_id = index.find(p.first);
+      const payment_index::id_index *rebuilt_by_id = rebuilt.find(p.first);
+      ASSERT_TRUE(by_id != NULL);
+      ASSERT_TRUE(rebuilt_by_id != NULL);
+      ASSERT_EQ(by_id->size(), rebuilt_by_id->size());
+      ASSERT_EQ(std::count(by_id->begin(), by_id->end(), &p), 1);
+      for (size_t n = 0; n < by_id->size(); ++n)
+      {
+        ASSERT_EQ((*by_id)[n]->first, p.first);
+        ASSERT_EQ((*by_id)[n]->second.m_block_height, (*rebuilt_by_id)[n]->second.m_block_height);
+        if (n > 0)
+          ASSERT_LE((*by_id)[n - 1]->second.m_block_height, (*by_id)[n]->second.m_block_height);
+      }
+    }
+  }
+}
+
+TEST(payment_index, stable_across_rehashes)
+{
+  payment_container payments;
+  payment_index index;
+  add(payments, index, 1, 10, 0);
+  const payment_container::value_type *first = &*payments.begin();
+  const size_t buckets = payments.bucket_count();
+
+  // enough inserts to rehash the container several times over
+  for (uint64_t n = 1; n < 2000; ++n)
+    add(payments, index, n % 37, 10 + n % 101, n);
+  ASSERT_GT(payments.bucket_count(), buckets);
+  ASSERT_EQ(index.find(make_id(1))->front(), first);
+  ASSERT_EQ(index.find(make_id(1))->front()->second.m_amount, 0);
+  check_index(payments, index);
+}
+
+TEST(payment_index, erase)
+{
+  payment_container payments;
+  payment_index index;
+  for (uint64_t n = 0; n < 500; ++n)
+    add(payments, index, n % 7, n / 3, n);
+
+  // unindex then erase, as wallet2::erase_payment does, interleaved with inserts
+  for (uint64_t n = 0; n < 500; n += 2)
+  {
+    auto i = find_amount(payments, n);
+    ASSERT_TRUE(i != payments.end());
+    index.erase(*i);
+    payments.erase(i);
+    add(payments, index, n % 11, 1000 + n, 1000 + n);
+  }
+  check_index(payments, index);
+
+  // erasing every payment of an id drops the id
+  for (auto i = payments.begin(); i != payments.end(); )
+  {
+    if (i->first == make_id(3))
+    {
+      index.erase(*i);
+      i = payments.erase(i);
+    }
+    else
+      ++i;
+  }
+  ASSERT_TRUE(index.find(make_id(3)) == NULL);
+  check_index(payments, index);
+}
+
+TEST(payment_index, erase_from_height)
+{
+  payment_container payments;
+  payment_index index;
+  for (uint64_t n = 0; n < 300; ++n)
+    add(payments, index, n % 5, n, n);
+
+  // as wallet2::detach_blockchain does: unindex, then erase from the container
+  index.erase_from_height(150);
+  for (auto i = payments.begin(); i != payments.end(); )
+  {
+    if (i->second.m_block_height >= 150)
+      i = payments.erase(i);
+    else
+      ++i;
+  }
+  ASSERT_EQ(payments.size(), 150);
+  ASSERT_EQ(index.by_height().rbegin()->first, 149);
+  check_index(payments, index);
+
+  index.erase_from_height(0);
+  payments.clear();
+  ASSERT_EQ(index.size(), 0);
+  ASSERT_TRUE(index.find(make_id(0)) == NULL);
+}
+
+TEST(payment_index, rebuild)
+{
+  payment_container payments;
+  payment_index index;
+  for (uint64_t n = 0; n < 100; ++n)
+    add(payments, index, n % 3, 100 - n, n);
+
+  // a copy's elements are new objects, which the old index knows nothing of
+  payment_container copy = payments;
+  index.rebuild(copy);
+  check_index(copy, index);
+  for (const auto &e: index.by_height())
+    ASSERT_TRUE(copy.find(e.second->first) != copy.end());
+
+  index.clear();
+  ASSERT_EQ(index.size(), 0);
+  ASSERT_TRUE(index.by_height().empty());
+}
@@ -1061,3 +1061,14 @@ TEST(ringct, key_ostream)
     out.str()
   );
 }
+
+TEST(ringct, precomputed_H)
+{
+  const rct::key a = rct::skGen(), b = rct::skGen();
+  ASSERT_EQ(rct::scalarmultH(a), rct::scalarmultKey(rct::H, a));
+
+  rct::key aGbH, aGbH_precomp;
+  rct::addKeys2(aGbH, a, b, rct::H);
+  rct::addKeys2(aGbH_precomp, a, b, rct::precompH());
+  ASSERT_EQ(aGbH, aGbH_precomp);
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <deque>
+#include "gtest/gtest.h"
+#include "misc_language.h"
+#include "crypto/crypto.h"
+#include "common/rolling_window.h"
+
+TEST(rolling_window, empty)
+{
+  tools::rolling_window<uint64_t> w(4);
+  ASSERT_TRUE(w.empty());
+  ASSERT_EQ(w.size(), 0);
+  ASSERT_EQ(w.median(), 0);
+}
+
+TEST(rolling_window, evicts_oldest)
+{
+  tools::rolling_window<uint64_t> w(3);
+  for (uint64_t v: {5, 1, 9, 7})
+    w.push_back(v);
+  ASSERT_EQ(w.size(), 3);
+  ASSERT_EQ(w.front(), 1);
+  ASSERT_EQ(w[1], 9);
+  ASSERT_EQ(w.back(), 7);
+  ASSERT_EQ(w.nth(0), 1);
+  ASSERT_EQ(w.nth(1), 7);
+  ASSERT_EQ(w.nth(2), 9);
+  ASSERT_EQ(w.median(), 7);
+  w.push_back(2);
+  ASSERT_EQ(w.median(), 7);
+  w.push_back(3);
+  ASSERT_EQ(w.median(), 3);
+}
+
+TEST(rolling_window, matches_sorted_window)
+{
+  static const size_t capacity = 100;
+  tools::rolling_window<uint64_t> w(capacity);
+  std::deque<uint64_t> values;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    // few distinct values, to get plenty of duplicates
+    const uint64_t v = crypto::rand<uint64_t>() % 50;
+    w.push_back(v);
+    values.push_back(v);
+    if (values.size() > capacity)
+      values.pop_front();
+
+    ASSERT_EQ(w.size(), values.size());
+    std::vector<uint64_t> sorted(values.begin(), values.end());
+    ASSERT_EQ(w.median(), epee::misc_utils::median(sorted));
+    for (size_t k = 0; k < values.size(); ++k)
+    {
+      ASSERT_EQ(w[k], values[k]);
+      ASSERT_EQ(w.nth(k), sorted[k]);
+    }
+  }
+}
+
+TEST(rolling_window, copies_are_independent)
+{
+  tools::rolling_window<uint64_t> w(4);
+  for (uint64_t v: {4, 3, 2, 1})
+    w.push_back(v);
+  tools::rolling_window<uint64_t> fork = w;
+  w.push_back(10);
+  fork.push_back(0);
+  ASSERT_EQ(w.nth(0), 1);
+  ASSERT_EQ(w.nth(3), 10);
+  ASSERT_EQ(fork.nth(0), 0);
+  ASSERT_EQ(fork.nth(3), 3);
+}
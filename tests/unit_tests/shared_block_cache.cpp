@@ -0,0 +1,203 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "wallet/shared_block_cache.h"
+
+typedef cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices block_output_indices;
+
+namespace
+{
+  struct fake_chain
+  {
+    std::vector<cryptonote::block> blocks;
+    std::vector<crypto::hash> hashes;
+    size_t fetches = 0;
+
+    fake_chain(size_t n, uint64_t nonce = 0) { extend(n, nonce); }
+
+    void extend(size_t n, uint64_t nonce = 0)
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        cryptonote::block b = AUTO_VAL_INIT(b);
+        b.nonce = nonce;
+        b.timestamp = blocks.size();
+        b.prev_id = hashes.empty() ? crypto::null_hash : hashes.back();
+        blocks.push_back(b);
+        hashes.push_back(cryptonote::get_block_hash(b));
+      }
+    }
+
+    tools::shared_block_cache::fetch_t fetcher(uint64_t start)
+    {
+      return [this, start](uint64_t &blocks_start_height, std::list<cryptonote::block_complete_entry> &bces,
+          std::vector<block_output_indices> &o_indices, uint64_t &current_height) {
+        ++fetches;
+        blocks_start_height = start;
+        for (size_t i = start; i < blocks.size(); ++i)
+        {
+          cryptonote::block_complete_entry bce;
+          bce.block = cryptonote::block_to_blob(blocks[i]);
+          bces.push_back(bce);
+          o_indices.push_back(block_output_indices());
+        }
+        current_height = blocks.size();
+      };
+    }
+  };
+}
+
+TEST(shared_block_cache, serves_cached_blocks)
+{
+  tools::shared_block_cache cache;
+  fake_chain chain(10);
+  uint64_t start_height;
+  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<block_output_indices> o_indices;
+
+  cache.pull_blocks({chain.hashes[0]}, start_height, blocks, o_indices, chain.fetcher(0));
+  ASSERT_EQ(chain.fetches, 1);
+  ASSERT_EQ(start_height, 0);
+  ASSERT_EQ(blocks.size(), 10);
+  ASSERT_EQ(cache.size(), 10);
+
+  // another wallet, further along the same chain
+  blocks.clear();
+  o_indices.clear();
+  cache.pull_blocks({chain.hashes[4], chain.hashes[0]}, start_height, blocks, o_indices, chain.fetcher(4));
+  ASSERT_EQ(chain.fetches, 1);
+  ASSERT_EQ(start_height, 4);
+  ASSERT_EQ(blocks.size(), 6);
+  ASSERT_EQ(o_indices.size(), 6);
+  ASSERT_EQ(blocks.front().block, cryptonote::block_to_blob(chain.blocks[4]));
+
+  // the tip was just seen, so a synced wallet doesn't need the daemon
+  blocks.clear();
+  o_indices.clear();
+  cache.pull_blocks({chain.hashes[9]}, start_height, blocks, o_indices, chain.fetcher(9));
+  ASSERT_EQ(chain.fetches, 1);
+  ASSERT_EQ(start_height, 9);
+  ASSERT_EQ(blocks.size(), 1);
+
+  std::shared_ptr<const tools::shared_block_cache::entry> e = cache.find(3, cryptonote::block_to_blob(chain.blocks[3]));
+  ASSERT_TRUE(e != NULL);
+  ASSERT_EQ(e->hash, chain.hashes[3]);
+  ASSERT_TRUE(e->block.is_hash_valid());
+  ASSERT_TRUE(e->block.miner_tx.is_hash_valid());
+  ASSERT_TRUE(cache.find(3, cryptonote::block_to_blob(chain.blocks[4])) == NULL);
+  ASSERT_TRUE(cache.find(10, cryptonote::block_to_blob(chain.blocks[4])) == NULL);
+}
+
+TEST(shared_block_cache, stale_tip_goes_to_daemon)
+{
+  tools::shared_block_cache cache(100, 0);
+  fake_chain chain(5);
+  uint64_t start_height;
+  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<block_output_indices> o_indices;
+
+  cache.pull_blocks({chain.hashes[0]}, start_height, blocks, o_indices, chain.fetcher(0));
+  ASSERT_EQ(chain.fetches, 1);
+
+  chain.extend(2);
+  blocks.clear();
+  o_indices.clear();
+  cache.pull_blocks({chain.hashes[4]}, start_height, blocks, o_indices, chain.fetcher(4));
+  ASSERT_EQ(chain.fetches, 2);
+  ASSERT_EQ(start_height, 4);
+  ASSERT_EQ(blocks.size(), 3);
+  ASSERT_EQ(cache.size(), 7);
+}
+
+TEST(shared_block_cache, reorg_and_eviction)
+{
+  tools::shared_block_cache cache(6, 0);
+  fake_chain chain(5);
+  uint64_t start_height;
+  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<block_output_indices> o_indices;
+
+  cache.pull_blocks({chain.hashes[0]}, start_height, blocks, o_indices, chain.fetcher(0));
+  ASSERT_EQ(cache.size(), 5);
+
+  // replace the last two blocks with an alternative branch
+  fake_chain alt = chain;
+  alt.blocks.resize(3);
+  alt.hashes.resize(3);
+  alt.extend(4, 1);
+  alt.fetches = 0;
+  blocks.clear();
+  o_indices.clear();
+  cache.pull_blocks({chain.hashes[4], chain.hashes[2]}, start_height, blocks, o_indices, alt.fetcher(3));
+  ASSERT_EQ(alt.fetches, 1);
+  ASSERT_EQ(cache.size(), 6);
+  ASSERT_TRUE(cache.find(0, cryptonote::block_to_blob(chain.blocks[0])) == NULL);
+  ASSERT_TRUE(cache.find(3, cryptonote::block_to_blob(chain.blocks[3])) == NULL);
+  ASSERT_TRUE(cache.find(3, cryptonote::block_to_blob(alt.blocks[3])) != NULL);
+
+  // a wallet on the old branch is not served from the cache
+  blocks.clear();
+  o_indices.clear();
+  cache.pull_blocks({chain.hashes[4]}, start_height, blocks, o_indices, alt.fetcher(3));
+  ASSERT_EQ(alt.fetches, 2);
+}
+
+TEST(shared_block_cache, drops_blocks_past_daemon_height)
+{
+  tools::shared_block_cache cache(100, 0);
+  fake_chain chain(10);
+  uint64_t start_height;
+  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<block_output_indices> o_indices;
+
+  cache.pull_blocks({chain.hashes[0]}, start_height, blocks, o_indices, chain.fetcher(0));
+  ASSERT_EQ(cache.size(), 10);
+
+  // the daemon popped its last four blocks, which a wallet the cache can't
+  // serve finds out
+  fake_chain shorter = chain;
+  shorter.blocks.resize(6);
+  shorter.hashes.resize(6);
+  shorter.fetches = 0;
+  blocks.clear();
+  o_indices.clear();
+  cache.pull_blocks({crypto::null_hash}, start_height, blocks, o_indices, shorter.fetcher(2));
+  ASSERT_EQ(shorter.fetches, 1);
+  ASSERT_EQ(cache.size(), 6);
+  ASSERT_TRUE(cache.find(5, cryptonote::block_to_blob(chain.blocks[5])) != NULL);
+  ASSERT_TRUE(cache.find(8, cryptonote::block_to_blob(chain.blocks[8])) == NULL);
+
+  // so a wallet on the popped blocks goes to the daemon
+  blocks.clear();
+  o_indices.clear();
+  cache.pull_blocks({chain.hashes[7], chain.hashes[2]}, start_height, blocks, o_indices, shorter.fetcher(2));
+  ASSERT_EQ(shorter.fetches, 2);
+}
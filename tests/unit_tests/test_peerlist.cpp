@@ -83,3 +83,111 @@ TEST(peer_list, merge_peer_lists)
 
 
 }
+
+TEST(peer_list, table_bounded_and_bucketed)
+{
+  nodetool::peerlist_table table(100);
+  for (uint32_t n = 0; n < 1000; ++n)
+  {
+    nodetool::peerlist_entry ple;
+    ple.adr = MAKE_IPV4_ADDRESS(10, n % 20, n / 20, 1, 18080);
+    ple.id = n;
+    ple.last_seen = n;
+    ASSERT_TRUE(table.insert(ple) || table.size() == 100);
+    ASSERT_LE(table.size(), 100);
+  }
+  ASSERT_EQ(table.size(), 100);
+
+  size_t found = 0;
+  for (const nodetool::peerlist_entry &pe: table)
+  {
+    const nodetool::peerlist_entry *p = table.find(pe.adr);
+    ASSERT_TRUE(p != NULL);
+    ASSERT_EQ(p->id, pe.id);
+    ++found;
+  }
+  ASSERT_EQ(found, 100);
+
+  std::vector<const nodetool::peerlist_entry*> recent = table.get_most_recent(10, true);
+  ASSERT_EQ(recent.size(), 10);
+  for (size_t n = 1; n < recent.size(); ++n)
+    ASSERT_GE(recent[n - 1]->last_seen, recent[n]->last_seen);
+
+  while (!table.empty())
+  {
+    const nodetool::peerlist_entry *p = table.get_random();
+    ASSERT_TRUE(p != NULL);
+    const epee::net_utils::network_address adr = p->adr;
+    ASSERT_TRUE(table.erase(adr));
+    ASSERT_FALSE(table.find(adr));
+  }
+  ASSERT_TRUE(table.get_random() == NULL);
+}
+
+TEST(peer_list, store_load)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(false);
+  ADD_WHITE_NODE(MAKE_IPV4_ADDRESS(123,43,12,1, 8080), 1, 34345);
+  ADD_WHITE_NODE(MAKE_IPV4_ADDRESS(124,43,12,2, 8080), 2, 34346);
+  ADD_GRAY_NODE(MAKE_IPV4_ADDRESS(125,43,12,3, 8080), 3, 34347);
+  nodetool::anchor_peerlist_entry ape;
+  ape.adr = MAKE_IPV4_ADDRESS(126,43,12,4, 8080);
+  ape.id = 4;
+  ape.first_seen = 34348;
+  plm.append_with_peer_anchor(ape);
+
+  std::string blob;
+  ASSERT_TRUE(plm.store(blob));
+
+  nodetool::peerlist_manager loaded;
+  ASSERT_TRUE(loaded.load(blob));
+  ASSERT_EQ(loaded.get_white_peers_count(), 2);
+  ASSERT_EQ(loaded.get_gray_peers_count(), 1);
+  std::list<nodetool::peerlist_entry> gray, white;
+  ASSERT_TRUE(loaded.get_peerlist_full(gray, white));
+  ASSERT_EQ(white.front().id, 2);
+  ASSERT_EQ(white.front().last_seen, 34346);
+  const epee::net_utils::network_address gray_address = MAKE_IPV4_ADDRESS(125,43,12,3, 8080);
+  ASSERT_EQ(gray.front().adr, gray_address);
+  std::vector<nodetool::anchor_peerlist_entry> anchors;
+  ASSERT_TRUE(loaded.get_and_empty_anchor_peerlist(anchors));
+  ASSERT_EQ(anchors.size(), 1);
+  ASSERT_EQ(anchors[0].first_seen, 34348);
+
+  ASSERT_FALSE(loaded.load(blob.substr(0, blob.size() - 1)));
+  ASSERT_FALSE(loaded.load("not a peerlist"));
+}
+
+TEST(peer_list, table_most_recent_follows_updates)
+{
+  nodetool::peerlist_table table(0);
+  for (uint32_t n = 0; n < 50; ++n)
+  {
+    nodetool::peerlist_entry ple;
+    ple.adr = MAKE_IPV4_ADDRESS(10, n % 5, n, 1, 18080);
+    ple.id = n;
+    ple.last_seen = n % 10 == 0 ? 0 : 1000 + n;
+    ASSERT_TRUE(table.insert(ple));
+  }
+
+  // seeing an old peer again brings it to the front
+  nodetool::peerlist_entry ple = *table.find(MAKE_IPV4_ADDRESS(10, 3, 3, 1, 18080));
+  ple.last_seen = 5000;
+  ASSERT_TRUE(table.insert(ple));
+  std::vector<const nodetool::peerlist_entry*> recent = table.get_most_recent(3, true);
+  ASSERT_EQ(recent.size(), 3);
+  ASSERT_EQ(recent[0]->id, 3);
+  ASSERT_EQ(recent[1]->id, 49);
+  ASSERT_EQ(recent[2]->id, 48);
+
+  // erasing moves entries around, which the order must survive
+  ASSERT_TRUE(table.erase(MAKE_IPV4_ADDRESS(10, 3, 3, 1, 18080)));
+  ASSERT_TRUE(table.erase(MAKE_IPV4_ADDRESS(10, 0, 5, 1, 18080)));
+  recent = table.get_most_recent(table.size(), true);
+  ASSERT_EQ(recent.size(), 48 - 5);
+  ASSERT_EQ(recent[0]->id, 49);
+  for (size_t n = 1; n < recent.size(); ++n)
+    ASSERT_GT(recent[n - 1]->last_seen, recent[n]->last_seen);
+  ASSERT_EQ(table.get_most_recent(100, false).size(), 48);
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/transfer_index.h"
+
+static tools::transfer_index::entry make_entry(uint32_t major, uint32_t minor, uint64_t amount, uint64_t unlock_height, bool time_locked = false)
+{
+  tools::transfer_index::entry e;
+  e.subaddr.major = major;
+  e.subaddr.minor = minor;
+  e.amount = amount;
+  e.unlock_height = unlock_height;
+  e.time_locked = time_locked;
+  return e;
+}
+
+static const auto never_time_locked = [](size_t) { return true; };
+
+TEST(transfer_index, balances)
+{
+  tools::transfer_index index;
+  index.insert(0, make_entry(0, 0, 100, 10));
+  index.insert(1, make_entry(0, 1, 200, 10));
+  index.insert(2, make_entry(0, 1, 300, 20));
+  index.insert(3, make_entry(1, 0, 400, 10));
+
+  std::map<uint32_t, uint64_t> balance = index.balance_per_subaddress(0);
+  ASSERT_EQ(balance.size(), 2);
+  ASSERT_EQ(balance[0], 100);
+  ASSERT_EQ(balance[1], 500);
+  balance = index.balance_per_subaddress(1);
+  ASSERT_EQ(balance.size(), 1);
+  ASSERT_EQ(balance[0], 400);
+  ASSERT_TRUE(index.balance_per_subaddress(2).empty());
+
+  index.erase(2);
+  index.erase(2);
+  balance = index.balance_per_subaddress(0);
+  ASSERT_EQ(balance[1], 200);
+  index.erase(1);
+  balance = index.balance_per_subaddress(0);
+  ASSERT_EQ(balance.size(), 1);
+  ASSERT_EQ(index.size(), 2);
+
+  // reinserting an entry replaces it
+  index.insert(0, make_entry(0, 0, 150, 10));
+  ASSERT_EQ(index.balance_per_subaddress(0)[0], 150);
+  ASSERT_EQ(index.size(), 2);
+}
+
+TEST(transfer_index, unlocked_balances)
+{
+  tools::transfer_index index;
+  index.insert(0, make_entry(0, 0, 100, 10));
+  index.insert(1, make_entry(0, 1, 200, 15));
+  index.insert(2, make_entry(0, 1, 300, 20));
+  index.insert(3, make_entry(1, 0, 400, 30));
+
+  std::map<uint32_t, uint64_t> unlocked = index.unlocked_balance_per_subaddress(0, 9, never_time_locked);
+  ASSERT_TRUE(unlocked.empty());
+  unlocked = index.unlocked_balance_per_subaddress(0, 10, never_time_locked);
+  ASSERT_EQ(unlocked.size(), 1);
+  ASSERT_EQ(unlocked[0], 100);
+  unlocked = index.unlocked_balance_per_subaddress(0, 15, never_time_locked);
+  ASSERT_EQ(unlocked.size(), 2);
+  ASSERT_EQ(unlocked[1], 200);
+  unlocked = index.unlocked_balance_per_subaddress(0, 100, never_time_locked);
+  ASSERT_EQ(unlocked[1], 500);
+
+  // going back down after a reorg locks outputs again
+  unlocked = index.unlocked_balance_per_subaddress(0, 12, never_time_locked);
+  ASSERT_EQ(unlocked.size(), 1);
+}
+
+TEST(transfer_index, time_locked)
+{
+  tools::transfer_index index;
+  index.insert(0, make_entry(0, 0, 100, 10, true));
+  index.insert(1, make_entry(0, 0, 200, 10));
+
+  size_t calls = 0;
+  auto still_locked = [&calls](size_t idx) { ++calls; return idx != 0; };
+  std::map<uint32_t, uint64_t> unlocked = index.unlocked_balance_per_subaddress(0, 5, still_locked);
+  ASSERT_TRUE(unlocked.empty());
+  ASSERT_EQ(calls, 0);
+  unlocked = index.unlocked_balance_per_subaddress(0, 10, still_locked);
+  ASSERT_EQ(unlocked[0], 200);
+  ASSERT_EQ(calls, 1);
+  unlocked = index.unlocked_balance_per_subaddress(0, 10, never_time_locked);
+  ASSERT_EQ(unlocked[0], 300);
+}
+
+TEST(transfer_index, unspent)
+{
+  tools::transfer_index index;
+  index.insert(5, make_entry(0, 0, 100, 10));
+  index.insert(2, make_entry(0, 1, 300, 10));
+  index.insert(7, make_entry(0, 0, 200, 10));
+  index.insert(3, make_entry(1, 0, 400, 10));
+
+  const std::set<size_t> &unspent = index.unspent(0);
+  ASSERT_EQ(std::vector<size_t>(unspent.begin(), unspent.end()), std::vector<size_t>({2, 5, 7}));
+  ASSERT_TRUE(index.unspent(2).empty());
+
+  ASSERT_EQ(index.unspent_at_least(0, 150), std::vector<size_t>({2, 7}));
+  ASSERT_EQ(index.unspent_at_least(0, 300), std::vector<size_t>({2}));
+  ASSERT_TRUE(index.unspent_at_least(0, 301).empty());
+  ASSERT_EQ(index.unspent_at_least(1, 0), std::vector<size_t>({3}));
+
+  index.erase(2);
+  ASSERT_EQ(index.unspent_at_least(0, 150), std::vector<size_t>({7}));
+  index.erase(3);
+  ASSERT_TRUE(index.unspent(1).empty());
+}
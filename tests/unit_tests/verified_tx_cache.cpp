@@ -0,0 +1,137 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <functional>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_core/verified_tx_cache.h"
+
+namespace
+{
+  struct verifier
+  {
+    size_t calls;
+    bool result;
+    verifier(bool result): calls(0), result(result) {}
+    bool operator()() { ++calls; return result; }
+  };
+}
+
+TEST(verified_tx_cache, cached_tx_is_not_verified_again)
+{
+  cryptonote::verified_tx_cache cache(16);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  const crypto::hash ring_members_hash = crypto::rand<crypto::hash>();
+  verifier v(true);
+
+  ASSERT_TRUE(cache.check(txid, ring_members_hash, 7, std::ref(v)));
+  ASSERT_EQ(v.calls, 1);
+  ASSERT_TRUE(cache.is_verified(txid, ring_members_hash, 7));
+  ASSERT_TRUE(cache.check(txid, ring_members_hash, 7, std::ref(v)));
+  ASSERT_EQ(v.calls, 1);
+}
+
+TEST(verified_tx_cache, different_ring_members_are_verified)
+{
+  cryptonote::verified_tx_cache cache(16);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  const crypto::hash ring_members_hash = crypto::rand<crypto::hash>();
+  const crypto::hash other_ring_members_hash = crypto::rand<crypto::hash>();
+  verifier v(true);
+
+  ASSERT_TRUE(cache.check(txid, ring_members_hash, 7, std::ref(v)));
+  ASSERT_FALSE(cache.is_verified(txid, other_ring_members_hash, 7));
+  ASSERT_TRUE(cache.check(txid, other_ring_members_hash, 7, std::ref(v)));
+  ASSERT_EQ(v.calls, 2);
+
+  // the entry now holds the ring members last verified
+  ASSERT_TRUE(cache.is_verified(txid, other_ring_members_hash, 7));
+  ASSERT_FALSE(cache.is_verified(txid, ring_members_hash, 7));
+  ASSERT_EQ(cache.size(), 1);
+
+  verifier failing(false);
+  ASSERT_FALSE(cache.check(txid, ring_members_hash, 7, std::ref(failing)));
+  ASSERT_EQ(failing.calls, 1);
+}
+
+TEST(verified_tx_cache, different_hf_version_is_verified)
+{
+  cryptonote::verified_tx_cache cache(16);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  const crypto::hash ring_members_hash = crypto::rand<crypto::hash>();
+  verifier v(true);
+
+  ASSERT_TRUE(cache.check(txid, ring_members_hash, 7, std::ref(v)));
+  ASSERT_FALSE(cache.is_verified(txid, ring_members_hash, 8));
+  ASSERT_TRUE(cache.check(txid, ring_members_hash, 8, std::ref(v)));
+  ASSERT_EQ(v.calls, 2);
+
+  verifier failing(false);
+  ASSERT_FALSE(cache.check(txid, ring_members_hash, 7, std::ref(failing)));
+  ASSERT_EQ(failing.calls, 1);
+}
+
+TEST(verified_tx_cache, failed_verification_is_not_cached)
+{
+  cryptonote::verified_tx_cache cache(16);
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  const crypto::hash ring_members_hash = crypto::rand<crypto::hash>();
+  verifier failing(false);
+
+  ASSERT_FALSE(cache.check(txid, ring_members_hash, 7, std::ref(failing)));
+  ASSERT_FALSE(cache.check(txid, ring_members_hash, 7, std::ref(failing)));
+  ASSERT_EQ(failing.calls, 2);
+  ASSERT_FALSE(cache.is_verified(txid, ring_members_hash, 7));
+  ASSERT_EQ(cache.size(), 0);
+
+  verifier v(true);
+  ASSERT_TRUE(cache.check(txid, ring_members_hash, 7, std::ref(v)));
+  ASSERT_EQ(v.calls, 1);
+  ASSERT_TRUE(cache.is_verified(txid, ring_members_hash, 7));
+}
+
+TEST(verified_tx_cache, oldest_is_evicted)
+{
+  cryptonote::verified_tx_cache cache(4);
+  const crypto::hash ring_members_hash = crypto::rand<crypto::hash>();
+  std::vector<crypto::hash> txids;
+  for (size_t n = 0; n < 6; ++n)
+  {
+    txids.push_back(crypto::rand<crypto::hash>());
+    cache.add(txids.back(), ring_members_hash, 7);
+  }
+  ASSERT_EQ(cache.size(), 4);
+  ASSERT_FALSE(cache.is_verified(txids[0], ring_members_hash, 7));
+  ASSERT_FALSE(cache.is_verified(txids[1], ring_members_hash, 7));
+  for (size_t n = 2; n < 6; ++n)
+    ASSERT_TRUE(cache.is_verified(txids[n], ring_members_hash, 7));
+
+  cache.clear();
+  ASSERT_EQ(cache.size(), 0);
+  ASSERT_FALSE(cache.is_verified(txids[5], ring_members_hash, 7));
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "crypto/crypto.h"
+#include "wallet/wallet2.h"
+#include "wallet/api/wallet.h"
+#include "wallet/api/transaction_history.h"
+
+class WalletTransactionHistory : public ::testing::Test
+{
+protected:
+  WalletTransactionHistory(): wallet(Monero::MAINNET) {}
+
+  tools::wallet2 &w2() { return *wallet.m_wallet; }
+  Monero::TransactionHistoryImpl &history() { return *wallet.m_history; }
+
+  void add_blocks(size_t count)
+  {
+    while (count--)
+      w2().m_blockchain.push_back(crypto::rand<crypto::hash>());
+    w2().m_local_bc_height = w2().m_blockchain.size();
+  }
+
+  void add_unconfirmed_out(const crypto::hash &txid, uint64_t amount)
+  {
+    tools::wallet2::unconfirmed_transfer_details utd;
+    utd.m_amount_in = amount + 10;
+    utd.m_amount_out = amount;
+    utd.m_change = 0;
+    utd.m_sent_time = 0;
+    utd.m_payment_id = crypto::null_hash;
+    utd.m_state = tools::wallet2::unconfirmed_transfer_details::pending;
+    utd.m_timestamp = 0;
+    utd.m_subaddr_account = 0;
+    utd.m_subaddr_indices.insert(0);
+    w2().m_unconfirmed_txs[txid] = utd;
+  }
+
+  void confirm_out(const crypto::hash &txid, uint64_t height)
+  {
+    auto i = w2().m_unconfirmed_txs.find(txid);
+    ASSERT_TRUE(i != w2().m_unconfirmed_txs.end());
+    w2().m_confirmed_txs[txid] = tools::wallet2::confirmed_transfer_details(i->second, height);
+    w2().m_unconfirmed_txs.erase(i);
+  }
+
+  static tools::wallet2::payment_details make_payment(const crypto::hash &txid, uint64_t height)
+  {
+    tools::wallet2::payment_details pd;
+    pd.m_tx_hash = txid;
+    pd.m_amount = 1000;
+    pd.m_fee = 0;
+    pd.m_block_height = height;
+    pd.m_unlock_time = 0;
+    pd.m_timestamp = 0;
+    pd.m_subaddr_index = {0, 0};
+    return pd;
+  }
+
+  void add_pool_payment(const crypto::hash &txid)
+  {
+    tools::wallet2::pool_payment_details ppd;
+    ppd.m_pd = make_payment(txid, 0);
+    ppd.m_double_spend_seen = false;
+    w2().m_unconfirmed_payments.emplace(crypto::null_hash, ppd);
+  }
+
+  void add_payment(const crypto::hash &txid, uint64_t height)
+  {
+    w2().add_payment(crypto::null_hash, make_payment(txid, height));
+  }
+
+  void clear_pending()
+  {
+    w2().m_unconfirmed_payments.clear();
+    w2().m_unconfirmed_txs.clear();
+  }
+
+  void clear_payments()
+  {
+    w2().m_payments.clear();
+    w2().rebuild_payment_index();
+  }
+
+  Monero::WalletImpl wallet;
+};
+
+TEST_F(WalletTransactionHistory, confirm_in_place)
+{
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  add_blocks(10);
+  add_unconfirmed_out(txid, 500);
+  history().refresh();
+  ASSERT_EQ(history().count(), 1);
+  Monero::TransactionInfo *ti = history().transaction(0);
+  ASSERT_TRUE(ti != nullptr);
+  ASSERT_TRUE(ti->isPending());
+
+  confirm_out(txid, 10);
+  add_blocks(2);
+  history().refresh();
+  ASSERT_EQ(history().count(), 1);
+  ASSERT_EQ(history().transaction(0), ti);
+  ASSERT_FALSE(ti->isPending());
+  ASSERT_EQ(ti->blockHeight(), 10);
+  ASSERT_EQ(ti->confirmations(), 2);
+  ASSERT_EQ(history().getByHeight(10, 10, 0, 10).size(), 1);
+}
+
+TEST_F(WalletTransactionHistory, drop_pending)
+{
+  add_blocks(10);
+  add_pool_payment(crypto::rand<crypto::hash>());
+  add_unconfirmed_out(crypto::rand<crypto::hash>(), 500);
+  history().refresh();
+  ASSERT_EQ(history().count(), 2);
+
+  clear_pending();
+  history().refresh();
+  ASSERT_EQ(history().count(), 0);
+  ASSERT_TRUE(history().getByHeight(0, 100, 0, 10).empty());
+}
+
+TEST_F(WalletTransactionHistory, invalidate)
+{
+  add_blocks(10);
+  add_payment(crypto::rand<crypto::hash>(), 4);
+  history().refresh();
+  ASSERT_EQ(history().count(), 1);
+
+  // changed below the height the history was refreshed to, as when
+  // importing key images
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  clear_payments();
+  add_payment(txid, 5);
+  history().invalidate();
+  history().refresh();
+  ASSERT_EQ(history().count(), 1);
+  ASSERT_EQ(history().transaction(0)->hash(), epee::string_tools::pod_to_hex(txid));
+}